@@ -24,14 +24,15 @@ namespace UnrealBuildTool.Rules
 				{
 					"Core",
 					"CoreUObject",
-					"Engine"
+					"Engine",
+					"RovrImaging"
 					// ... add other public dependencies that you statically link with here ...
 				}
 				);
 
 			PrivateDependencyModuleNames.AddRange(
 				new string[]
-				{                    
+				{
 					// ... add private dependencies that you statically link with here ...
 				}
 				);
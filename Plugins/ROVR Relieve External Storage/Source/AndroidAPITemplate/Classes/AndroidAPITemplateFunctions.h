@@ -3,6 +3,7 @@
 #pragma once
 
 #include "Engine/Texture2D.h"
+#include "RovrThumbnailAtlas.h"
 #include "AndroidAPITemplateFunctions.generated.h"
 
 
@@ -30,4 +31,11 @@ public:
 	UFUNCTION(BlueprintCallable, meta = (Keywords = "Get Video Thumbnail", DisplayName = "Get Video Thumbnail"), Category = "ROVR Relieve External Storage")
 		static UTexture2D* AndroidAPITemplate_Test2(int32 thumbNum,bool headset);
 
+	/**
+	 * Puts a video thumbnail into a lobby atlas, for Image widgets to draw with Make Brush. Every call
+	 * holds the slot, and must be matched by a Release on the atlas
+	 */
+	UFUNCTION(BlueprintCallable, meta = (Keywords = "Get Video Thumbnail Slot Atlas", DisplayName = "Get Video Thumbnail Slot"), Category = "ROVR Relieve External Storage")
+		static FRovrAtlasSlot AndroidAPITemplate_GetVideoThumbnailSlot(URovrThumbnailAtlas* Atlas, int32 thumbNum, bool headset);
+
 };
@@ -4,6 +4,10 @@
 #include "Engine/GameEngine.h"
 #include "Engine/Engine.h"
 #include "AndroidAPITemplatePrivatePCH.h"
+#include "RovrTexturePool.h"
+#include "RovrThumbnailCache.h"
+#include "HAL/FileManager.h"
+#include "Hash/CityHash.h"
 
 #if PLATFORM_ANDROID
 
@@ -25,6 +29,7 @@ static jmethodID name = NULL;
 DECLARE_JAVA_METHOD(AndroidThunkJava_AndroidAPI_ShowToast);
 DECLARE_JAVA_METHOD(AndroidThunkJava_AndroidAPI_Test);
 DECLARE_JAVA_METHOD(AndroidThunkJava_AndroidAPI_Test2);
+DECLARE_JAVA_METHOD(AndroidThunkJava_AndroidAPI_GetVideoPath);
 
 
 void UAndroidAPITemplateFunctions::InitJavaFunctions()
@@ -35,6 +40,7 @@ void UAndroidAPITemplateFunctions::InitJavaFunctions()
 	INIT_JAVA_METHOD(AndroidThunkJava_AndroidAPI_ShowToast, "(Ljava/lang/String;)V");
 	INIT_JAVA_METHOD(AndroidThunkJava_AndroidAPI_Test, "([I)V");
 	INIT_JAVA_METHOD(AndroidThunkJava_AndroidAPI_Test2, "([IIZ)V");
+	INIT_JAVA_METHOD(AndroidThunkJava_AndroidAPI_GetVideoPath, "(I)Ljava/lang/String;");
 
 }
 #undef DECLARE_JAVA_METHOD
@@ -93,98 +99,151 @@ FString UAndroidAPITemplateFunctions::AndroidAPITemplate_Test() {
 }
 
 
-UTexture2D* UAndroidAPITemplateFunctions::AndroidAPITemplate_Test2(int32 thumbNum, bool headset) {
 #if PLATFORM_ANDROID
-	//working
-	if (JNIEnv* Env = FAndroidApplication::GetJavaEnv(true))
-	{
-		jintArray jarray = Env->NewIntArray(185000);
 
-		jint testjint = thumbNum;
-
-		jboolean testjbool = headset;
+/** Identity of a video thumbnail in the thumbnail cache */
+struct FVideoThumbnailKey
+{
+	uint64 fileId = 0;
+	uint64 cacheKey = 0;
+	uint64 stamp = 0;
 
-		FJavaWrapper::CallVoidMethod(Env, FJavaWrapper::GameActivityThis, AndroidThunkJava_AndroidAPI_Test2, jarray, testjint, testjbool);
-		
-		jint* ResultArr = Env->GetIntArrayElements(jarray, 0);
+	/** Whether the video could be found on disk, without which nothing is cached */
+	bool bStamped = false;
+};
 
-		const int ResultInt = ResultArr[0];
-		int length = Env->GetArrayLength(jarray);
+static FVideoThumbnailKey GetVideoThumbnailKey(JNIEnv* Env, int32 thumbNum, bool headset)
+{
+	FString videoPath;
+	if (jstring javaPath = (jstring)FJavaWrapper::CallObjectMethod(Env, FJavaWrapper::GameActivityThis, AndroidThunkJava_AndroidAPI_GetVideoPath, (jint)thumbNum))
+	{
+		const char* pathChars = Env->GetStringUTFChars(javaPath, 0);
+		videoPath = UTF8_TO_TCHAR(pathChars);
+		Env->ReleaseStringUTFChars(javaPath, pathChars);
+		Env->DeleteLocalRef(javaPath);
+	}
 
+	const FFileStatData stat = videoPath.IsEmpty() ? FFileStatData() : IFileManager::Get().GetStatData(*videoPath);
 
-		
+	FVideoThumbnailKey key;
+	key.fileId = FRovrThumbnailCache::MakeFileId(videoPath);
+	key.stamp = FRovrThumbnailCache::MakeStamp(stat.FileSize, stat.ModificationTime);
 
-		int imageWidth = ResultArr[0];
-		int imageHeight = ResultArr[1];
+	// Copies of a video the media index fingerprinted share one thumbnail
+	FRovrThumbnailCache::Get().ResolveContent(key.fileId, key.stamp);
+	key.cacheKey = headset ? key.fileId : ~key.fileId;
+	key.bStamped = stat.bIsValid;
+	return key;
+}
 
-		//uint8 alpha((ResultArr[2] & 0xC0) >> 6) * 64;
-		//uint8 red = ((ResultArr[2] & 0x30) >> 4) * 64;
-		//uint8 green = ((ResultArr[2] & 0x0C) >> 2) * 64;
-		//uint8 blue = ((ResultArr[2] & 0x0C) >> 2) * 64;
+/**
+ * Has Java decode the thumbnail of a video and copies its pixels out of the Java array
+ *
+ * @param pixels Receives the pixels as 0xAARRGGBB ints, ERovrPixelLayout::ARGB32
+ * @return Whether Java returned a usable bitmap
+ */
+static bool ReadVideoThumbnail(JNIEnv* Env, int32 thumbNum, bool headset, TArray<uint8>& pixels, int32& imageWidth, int32& imageHeight)
+{
+	jintArray jarray = Env->NewIntArray(185000);
 
-		TArray<FColor> colourArray;
-		//sizeof(&ResultArr)/sizeof(&ResultArr[0])
+	jint testjint = thumbNum;
 
-		
-		for (int x = 2; x < length; x++) {
-			//int alpha = ((ResultArr[2] >> 24) & 0xff);
-			//int red = ((ResultArr[2] >> 16) & 0xff);
-			//int green = ((ResultArr[2] >> 8) & 0xff);
-			//int blue = ((ResultArr[2]) & 0xff);
+	jboolean testjbool = headset;
 
-			colourArray.Add(FColor(((ResultArr[x] >> 16) & 0xff), ((ResultArr[x] >> 8) & 0xff), ((ResultArr[x]) & 0xff), ((ResultArr[x] >> 24) & 0xff)));
-		}
+	FJavaWrapper::CallVoidMethod(Env, FJavaWrapper::GameActivityThis, AndroidThunkJava_AndroidAPI_Test2, jarray, testjint, testjbool);
 
+	jint* ResultArr = Env->GetIntArrayElements(jarray, 0);
 
+	int length = Env->GetArrayLength(jarray);
 
-		//u8 red = ((color & 0xC0) >> 6) * 64;
-		//u8 green = ((color & 0x30) >> 4) * 64;
-		//u8 blue = ((color & 0x0C) >> 2) * 64;
+	imageWidth = ResultArr[0];
+	imageHeight = ResultArr[1];
 
-		//input[i*4+2]   = (store[i] >> 24) & 0xff;  //splitting each ARGB value to 4 separate ints  = *4 and then +1 for each separate value
-		//input[i*4+3] = (store[i] >> 16) & 0xff;
-		//input[i*4+4] = (store[i] >>  8) & 0xff;  //first two values are height and width  = another +2 in final array
-		//input[i*4+5] = (store[i]      ) & 0xff;
+	// The first two ints hold the size, the pixels follow as 0xAARRGGBB
+	const bool bValid = imageWidth > 0 && imageHeight > 0 && int64(imageWidth) * imageHeight <= length - 2;
+	if (bValid)
+	{
+		pixels.SetNumUninitialized(int64(imageWidth) * imageHeight * sizeof(jint));
+		FMemory::Memcpy(pixels.GetData(), ResultArr + 2, pixels.Num());
+	}
+	else
+	{
+		UE_LOG(LogAndroidAPITemplate, Warning, TEXT("Thumbnail %d has an invalid size %dx%d"), thumbNum, imageWidth, imageHeight);
+	}
 
+	Env->ReleaseIntArrayElements(jarray, ResultArr, JNI_ABORT);
+	Env->DeleteLocalRef(jarray);
+	return bValid;
+}
 
+/** Adds a freshly encoded thumbnail to the thumbnail cache; safe on any thread */
+static void CacheVideoThumbnail(const FVideoThumbnailKey& key, const FRovrImageView& image, const FRovrTextureDataView& data)
+{
+	// On errors Java hands out a transparent bitmap, which is not worth caching
+	if (key.bStamped && RovrPixelConvert::IsOpaque(image.Data.GetData(), image.Layout, image.Stride, image.Width, image.Height))
+	{
+		FRovrThumbnailCache::Get().Add(key.cacheKey, key.fileId, key.stamp, data);
+	}
+}
 
-		// 
-		// 
-		// 
+/**
+ * Hands the encoded thumbnail of a video to Visitor, from the thumbnail cache or decoded by Java and
+ * encoded on the calling thread
+ *
+ * @return Whether Java returned a usable bitmap; Visitor is not called otherwise
+ */
+static bool VisitVideoThumbnail(JNIEnv* Env, int32 thumbNum, bool headset, const FVideoThumbnailKey& key, TFunctionRef<void(const FRovrTextureDataView&)> Visitor)
+{
+	// Thumbnails of videos unchanged since they were last decoded come from the cache
+	if (key.bStamped && FRovrThumbnailCache::Get().Find(key.cacheKey, key.stamp, Visitor))
+	{
+		return true;
+	}
 
-		UTexture2D* texture = UTexture2D::CreateTransient(imageWidth, imageHeight, EPixelFormat::PF_B8G8R8A8);
+	TArray<uint8> pixels;
+	int32 imageWidth = 0;
+	int32 imageHeight = 0;
+	if (!ReadVideoThumbnail(Env, thumbNum, headset, pixels, imageWidth, imageHeight))
+	{
+		return false;
+	}
 
-		// Create the texture
+	const FRovrImageView image(pixels, imageWidth, imageHeight, ERovrPixelLayout::ARGB32);
+	FRovrTextureData encoded;
+	RovrTexture::Encode(image, ERovrPixelConvertFlags::ForceOpaque, RovrTexture::GetDefaultMipFilter(), RovrTexture::GetDefaultCompression(), encoded);
 
+	CacheVideoThumbnail(key, image, encoded.GetView());
+	Visitor(encoded.GetView());
+	return true;
+}
 
-		// Lock the texture so it can be modified
-		uint8* MipData = static_cast<uint8*>(texture->PlatformData->Mips[0].BulkData.Lock(LOCK_READ_WRITE));
+#endif
 
-		// Create base mip.
-		uint8* DestPtr = NULL;
-		const FColor* SrcPtr = NULL;
-		for (int32 y = 0; y < imageHeight; y++)
+UTexture2D* UAndroidAPITemplateFunctions::AndroidAPITemplate_Test2(int32 thumbNum, bool headset) {
+#if PLATFORM_ANDROID
+	//working
+	if (JNIEnv* Env = FAndroidApplication::GetJavaEnv(true))
+	{
+		UTexture2D* texture = nullptr;
+		const FVideoThumbnailKey key = GetVideoThumbnailKey(Env, thumbNum, headset);
+		if (!key.bStamped || !FRovrThumbnailCache::Get().Find(key.cacheKey, key.stamp, [&texture](const FRovrTextureDataView& data)
+		{
+			texture = FRovrTexturePool::Get().Acquire(data);
+		}))
 		{
-			DestPtr = &MipData[(imageHeight - 1 - y) * imageWidth * sizeof(FColor)];
-			SrcPtr = const_cast<FColor*>(&colourArray[(imageHeight - 1 - y) * imageWidth]);
-			for (int32 x = 0; x < imageWidth; x++)
+			// Mips and ETC2 blocks are made on a worker thread, which fills the texture and the cache
+			TArray<uint8> pixels;
+			int32 imageWidth = 0;
+			int32 imageHeight = 0;
+			if (ReadVideoThumbnail(Env, thumbNum, headset, pixels, imageWidth, imageHeight))
 			{
-				*DestPtr++ = SrcPtr->B;
-				*DestPtr++ = SrcPtr->G;
-				*DestPtr++ = SrcPtr->R;
-
-				*DestPtr++ = 0xFF;
-				SrcPtr++;
+				texture = FRovrTexturePool::Get().Acquire(MoveTemp(pixels), imageWidth, imageHeight, ERovrPixelLayout::ARGB32, 0, ERovrPixelConvertFlags::ForceOpaque, RovrTexture::GetDefaultMipFilter(), RovrTexture::GetDefaultCompression(), [key](const FRovrImageView& image, const FRovrTextureDataView& data)
+				{
+					CacheVideoThumbnail(key, image, data);
+				});
 			}
 		}
-
-		// Unlock the texture
-		texture->PlatformData->Mips[0].BulkData.Unlock();
-		texture->UpdateResource();
-		
-
-		Env->DeleteLocalRef(jarray);
-		return texture;
+		return texture ? texture : UTexture2D::CreateTransient(300, 300, EPixelFormat::PF_B8G8R8A8);
 	}
 	else
 	{
@@ -195,3 +254,35 @@ UTexture2D* UAndroidAPITemplateFunctions::AndroidAPITemplate_Test2(int32 thumbNu
 	return UTexture2D::CreateTransient(300, 300, EPixelFormat::PF_B8G8R8A8);
 #endif
 }
+
+FRovrAtlasSlot UAndroidAPITemplateFunctions::AndroidAPITemplate_GetVideoThumbnailSlot(URovrThumbnailAtlas* Atlas, int32 thumbNum, bool headset) {
+	FRovrAtlasSlot slot;
+#if PLATFORM_ANDROID
+	if (!Atlas)
+	{
+		return slot;
+	}
+
+	if (JNIEnv* Env = FAndroidApplication::GetJavaEnv(true))
+	{
+		// The stamp is part of the atlas key, so a rewritten video does not keep its old slot
+		const FVideoThumbnailKey key = GetVideoThumbnailKey(Env, thumbNum, headset);
+		const uint64 atlasKey = CityHash128to64(Uint128_64(key.cacheKey, key.stamp));
+
+		// Every call holds the slot, so each widget showing the thumbnail releases it once
+		slot = Atlas->Acquire(atlasKey);
+		if (!slot.IsValid())
+		{
+			VisitVideoThumbnail(Env, thumbNum, headset, key, [Atlas, atlasKey, &slot](const FRovrTextureDataView& data)
+			{
+				slot = Atlas->Add(atlasKey, data);
+			});
+		}
+	}
+	else
+	{
+		UE_LOG(LogAndroid, Warning, TEXT("ERROR: Could not get Java ENV\n"));
+	}
+#endif
+	return slot;
+}
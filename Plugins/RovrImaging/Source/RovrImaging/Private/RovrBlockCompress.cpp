@@ -0,0 +1,409 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RovrBlockCompress.h"
+#include "Async/ParallelFor.h"
+#include "RHI.h"
+
+
+namespace
+{
+	/** Below this many blocks an image is encoded on the calling thread */
+	const int64 MinBlocksForParallelCompress = 64;
+
+	/** Blocks encoded per task when an image is split over worker threads */
+	const int64 BlocksPerTask = 1024;
+
+	/** Bytes of an ETC2 RGB block */
+	const int32 BlockBytes = 8;
+
+	/** Intensity modifiers of the eight ETC tables, small and large */
+	const int32 Modifiers[8][2] = { { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 } };
+
+	/** Texels of each subblock in ETC order (x * 4 + y), without and with the flip bit */
+	const int32 SubblockTexels[2][2][8] =
+	{
+		{ { 0, 1, 2, 3, 4, 5, 6, 7 }, { 8, 9, 10, 11, 12, 13, 14, 15 } },
+		{ { 0, 1, 4, 5, 8, 9, 12, 13 }, { 2, 3, 6, 7, 10, 11, 14, 15 } }
+	};
+
+	/** Texels of a 4x4 block as R, G, B, indexed column by column like the selectors */
+	struct FBlock
+	{
+		int32 Texels[16][3];
+	};
+
+	/** Table and per texel selectors of one subblock */
+	struct FSubblockFit
+	{
+		uint32 Error = MAX_uint32;
+		int32 Table = 0;
+		int32 Color[3] = { 0, 0, 0 };
+		uint8 Selectors[16];
+	};
+
+	/** An encoded block and its squared error */
+	struct FEncodedBlock
+	{
+		uint32 Error = MAX_uint32;
+		uint8 Bytes[BlockBytes];
+	};
+
+	int32 Expand4(int32 Value) { return (Value << 4) | Value; }
+	int32 Expand5(int32 Value) { return (Value << 3) | (Value >> 2); }
+	int32 Expand6(int32 Value) { return (Value << 2) | (Value >> 4); }
+	int32 Expand7(int32 Value) { return (Value << 1) | (Value >> 6); }
+
+	int32 Quantize(float Value, int32 MaxValue)
+	{
+		return FMath::Clamp(FMath::RoundToInt(Value * MaxValue / 255.0f), 0, MaxValue);
+	}
+
+	int32 Square(int32 Value)
+	{
+		return Value * Value;
+	}
+
+	void LoadBlock(const uint8* Source, int64 SourceStride, int32 Width, int32 Height, int32 BlockX, int32 BlockY, FBlock& OutBlock)
+	{
+		for (int32 X = 0; X < 4; ++X)
+		{
+			const int32 SourceX = FMath::Min(BlockX * 4 + X, Width - 1);
+			for (int32 Y = 0; Y < 4; ++Y)
+			{
+				const int32 SourceY = FMath::Min(BlockY * 4 + Y, Height - 1);
+				const uint8* Texel = Source + SourceY * SourceStride + SourceX * 4;
+
+				int32* Out = OutBlock.Texels[X * 4 + Y];
+				Out[0] = Texel[2];
+				Out[1] = Texel[1];
+				Out[2] = Texel[0];
+			}
+		}
+	}
+
+	/**
+	 * Pick the table and selectors of a subblock around an 8 bit base color, keeping them if they beat Best
+	 *
+	 * @return Whether Best was replaced
+	 */
+	bool FitSubblock(const FBlock& Block, const int32* Texels, const int32* Color, const int32* Base, FSubblockFit& Best)
+	{
+		bool bImproved = false;
+		for (int32 Table = 0; Table < 8; ++Table)
+		{
+			const int32 Offsets[4] = { Modifiers[Table][0], Modifiers[Table][1], -Modifiers[Table][0], -Modifiers[Table][1] };
+
+			int32 Candidates[4][3];
+			for (int32 Selector = 0; Selector < 4; ++Selector)
+			{
+				for (int32 Channel = 0; Channel < 3; ++Channel)
+				{
+					Candidates[Selector][Channel] = FMath::Clamp(Base[Channel] + Offsets[Selector], 0, 255);
+				}
+			}
+
+			uint32 Error = 0;
+			uint8 Selectors[8];
+			for (int32 Index = 0; Index < 8 && Error < Best.Error; ++Index)
+			{
+				const int32* Texel = Block.Texels[Texels[Index]];
+
+				uint32 BestTexelError = MAX_uint32;
+				for (int32 Selector = 0; Selector < 4; ++Selector)
+				{
+					const uint32 TexelError = Square(Texel[0] - Candidates[Selector][0]) + Square(Texel[1] - Candidates[Selector][1]) + Square(Texel[2] - Candidates[Selector][2]);
+					if (TexelError < BestTexelError)
+					{
+						BestTexelError = TexelError;
+						Selectors[Index] = uint8(Selector);
+					}
+				}
+				Error += BestTexelError;
+			}
+
+			if (Error < Best.Error)
+			{
+				Best.Error = Error;
+				Best.Table = Table;
+				FMemory::Memcpy(Best.Color, Color, sizeof(Best.Color));
+				for (int32 Index = 0; Index < 8; ++Index)
+				{
+					Best.Selectors[Texels[Index]] = Selectors[Index];
+				}
+				bImproved = true;
+			}
+		}
+		return bImproved;
+	}
+
+	/**
+	 * Fit a subblock with a quantized base color, searching one step around it per channel when refining
+	 *
+	 * @param Color Quantized base color to start from
+	 * @param MinColor Lowest quantized value allowed per channel
+	 * @param MaxColor Highest quantized value allowed per channel
+	 * @param bFiveBits Whether the color has 5 bits per channel, or 4
+	 */
+	FSubblockFit FitQuantized(const FBlock& Block, const int32* Texels, const int32* Color, const int32* MinColor, const int32* MaxColor, bool bFiveBits, bool bRefine)
+	{
+		const int32 Range = bRefine ? 1 : 0;
+
+		FSubblockFit Best;
+		for (int32 DeltaR = -Range; DeltaR <= Range; ++DeltaR)
+		{
+			for (int32 DeltaG = -Range; DeltaG <= Range; ++DeltaG)
+			{
+				for (int32 DeltaB = -Range; DeltaB <= Range; ++DeltaB)
+				{
+					const int32 Trial[3] = { Color[0] + DeltaR, Color[1] + DeltaG, Color[2] + DeltaB };
+					if (Trial[0] < MinColor[0] || Trial[0] > MaxColor[0] || Trial[1] < MinColor[1] || Trial[1] > MaxColor[1] || Trial[2] < MinColor[2] || Trial[2] > MaxColor[2])
+					{
+						continue;
+					}
+
+					const int32 Base[3] =
+					{
+						bFiveBits ? Expand5(Trial[0]) : Expand4(Trial[0]),
+						bFiveBits ? Expand5(Trial[1]) : Expand4(Trial[1]),
+						bFiveBits ? Expand5(Trial[2]) : Expand4(Trial[2])
+					};
+					FitSubblock(Block, Texels, Trial, Base, Best);
+				}
+			}
+		}
+		return Best;
+	}
+
+	void WriteSelectors(const FSubblockFit& First, const FSubblockFit& Second, bool bFlip, uint8* Out)
+	{
+		uint32 Msb = 0;
+		uint32 Lsb = 0;
+		for (int32 Subblock = 0; Subblock < 2; ++Subblock)
+		{
+			const FSubblockFit& Fit = Subblock == 0 ? First : Second;
+			for (const int32 Texel : SubblockTexels[bFlip][Subblock])
+			{
+				Msb |= uint32(Fit.Selectors[Texel] >> 1) << Texel;
+				Lsb |= uint32(Fit.Selectors[Texel] & 1) << Texel;
+			}
+		}
+
+		Out[4] = uint8(Msb >> 8);
+		Out[5] = uint8(Msb);
+		Out[6] = uint8(Lsb >> 8);
+		Out[7] = uint8(Lsb);
+	}
+
+	/** Encode a block in the individual or differential mode, keeping it if it beats Best */
+	void EncodeSubblocks(const FBlock& Block, bool bFlip, bool bDifferential, bool bRefine, FEncodedBlock& Best)
+	{
+		const int32* First = SubblockTexels[bFlip][0];
+		const int32* Second = SubblockTexels[bFlip][1];
+
+		float Averages[2][3] = {};
+		for (int32 Index = 0; Index < 8; ++Index)
+		{
+			for (int32 Channel = 0; Channel < 3; ++Channel)
+			{
+				Averages[0][Channel] += Block.Texels[First[Index]][Channel] / 8.0f;
+				Averages[1][Channel] += Block.Texels[Second[Index]][Channel] / 8.0f;
+			}
+		}
+
+		const int32 MaxValue = bDifferential ? 31 : 15;
+		const int32 Zero[3] = { 0, 0, 0 };
+		const int32 Max[3] = { MaxValue, MaxValue, MaxValue };
+
+		const int32 FirstColor[3] = { Quantize(Averages[0][0], MaxValue), Quantize(Averages[0][1], MaxValue), Quantize(Averages[0][2], MaxValue) };
+		const FSubblockFit FirstFit = FitQuantized(Block, First, FirstColor, Zero, Max, bDifferential, bRefine);
+		if (FirstFit.Error >= Best.Error)
+		{
+			return;
+		}
+
+		int32 SecondColor[3] = { Quantize(Averages[1][0], MaxValue), Quantize(Averages[1][1], MaxValue), Quantize(Averages[1][2], MaxValue) };
+		int32 SecondMin[3] = { 0, 0, 0 };
+		int32 SecondMax[3] = { MaxValue, MaxValue, MaxValue };
+		if (bDifferential)
+		{
+			// The second color is stored as a 3 bit signed offset from the first
+			for (int32 Channel = 0; Channel < 3; ++Channel)
+			{
+				SecondMin[Channel] = FMath::Max(FirstFit.Color[Channel] - 4, 0);
+				SecondMax[Channel] = FMath::Min(FirstFit.Color[Channel] + 3, 31);
+				SecondColor[Channel] = FMath::Clamp(SecondColor[Channel], SecondMin[Channel], SecondMax[Channel]);
+			}
+		}
+		const FSubblockFit SecondFit = FitQuantized(Block, Second, SecondColor, SecondMin, SecondMax, bDifferential, bRefine);
+
+		const uint32 Error = FirstFit.Error + SecondFit.Error;
+		if (Error >= Best.Error)
+		{
+			return;
+		}
+
+		Best.Error = Error;
+		for (int32 Channel = 0; Channel < 3; ++Channel)
+		{
+			Best.Bytes[Channel] = bDifferential
+				? uint8((FirstFit.Color[Channel] << 3) | ((SecondFit.Color[Channel] - FirstFit.Color[Channel]) & 7))
+				: uint8((FirstFit.Color[Channel] << 4) | SecondFit.Color[Channel]);
+		}
+		Best.Bytes[3] = uint8((FirstFit.Table << 5) | (SecondFit.Table << 2) | (bDifferential ? 2 : 0) | (bFlip ? 1 : 0));
+		WriteSelectors(FirstFit, SecondFit, bFlip, Best.Bytes);
+	}
+
+	/** Encode a block as a color gradient in the ETC2 planar mode, keeping it if it beats Best */
+	void EncodePlanar(const FBlock& Block, FEncodedBlock& Best)
+	{
+		// Least squares plane through the texels; over a 4x4 grid the x and y terms are independent
+		int32 Planes[3][3];
+		for (int32 Channel = 0; Channel < 3; ++Channel)
+		{
+			float Mean = 0.0f;
+			float SlopeX = 0.0f;
+			float SlopeY = 0.0f;
+			for (int32 Texel = 0; Texel < 16; ++Texel)
+			{
+				const float Value = float(Block.Texels[Texel][Channel]);
+				Mean += Value / 16.0f;
+				SlopeX += ((Texel >> 2) - 1.5f) * Value / 20.0f;
+				SlopeY += ((Texel & 3) - 1.5f) * Value / 20.0f;
+			}
+
+			// Origin, horizontal and vertical colors sit at texel (0, 0), (4, 0) and (0, 4)
+			const float Origin = Mean - 1.5f * SlopeX - 1.5f * SlopeY;
+			const int32 MaxValue = Channel == 1 ? 127 : 63;
+			Planes[Channel][0] = Quantize(Origin, MaxValue);
+			Planes[Channel][1] = Quantize(Origin + 4.0f * SlopeX, MaxValue);
+			Planes[Channel][2] = Quantize(Origin + 4.0f * SlopeY, MaxValue);
+		}
+
+		int32 Expanded[3][3];
+		for (int32 Channel = 0; Channel < 3; ++Channel)
+		{
+			for (int32 Point = 0; Point < 3; ++Point)
+			{
+				Expanded[Channel][Point] = Channel == 1 ? Expand7(Planes[Channel][Point]) : Expand6(Planes[Channel][Point]);
+			}
+		}
+
+		uint32 Error = 0;
+		for (int32 Texel = 0; Texel < 16 && Error < Best.Error; ++Texel)
+		{
+			const int32 X = Texel >> 2;
+			const int32 Y = Texel & 3;
+			for (int32 Channel = 0; Channel < 3; ++Channel)
+			{
+				const int32* Points = Expanded[Channel];
+				const int32 Value = FMath::Clamp((X * (Points[1] - Points[0]) + Y * (Points[2] - Points[0]) + 4 * Points[0] + 2) >> 2, 0, 255);
+				Error += Square(Block.Texels[Texel][Channel] - Value);
+			}
+		}
+
+		if (Error >= Best.Error)
+		{
+			return;
+		}
+
+		const int32 RO = Planes[0][0], GO = Planes[1][0], BO = Planes[2][0];
+		const int32 RH = Planes[0][1], GH = Planes[1][1], BH = Planes[2][1];
+		const int32 RV = Planes[0][2], GV = Planes[1][2], BV = Planes[2][2];
+
+		uint8* Out = Best.Bytes;
+		Out[0] = uint8((RO << 1) | (GO >> 6));
+		Out[1] = uint8(((GO & 0x3F) << 1) | (BO >> 5));
+		Out[2] = uint8((BO & 0x18) | ((BO >> 1) & 0x3));
+		Out[3] = uint8(((BO & 0x1) << 7) | ((RH >> 1) << 2) | 0x2 | (RH & 0x1));
+		Out[4] = uint8((GH << 1) | (BH >> 5));
+		Out[5] = uint8(((BH & 0x1F) << 3) | (RV >> 3));
+		Out[6] = uint8(((RV & 0x7) << 5) | (GV >> 2));
+		Out[7] = uint8(((GV & 0x3) << 6) | BV);
+
+		// Planar blocks are differential blocks whose blue overflows while red and green do not; the
+		// remaining free bits are set to make that so
+		if (Out[0] & 0x4)
+		{
+			Out[0] |= 0x80;
+		}
+		if (Out[1] & 0x4)
+		{
+			Out[1] |= 0x80;
+		}
+		if (((Out[2] >> 3) & 0x3) + (Out[2] & 0x3) < 4)
+		{
+			Out[2] |= 0x4;
+		}
+		else
+		{
+			Out[2] |= 0xE0;
+		}
+
+		Best.Error = Error;
+	}
+
+	void CompressBlock(const FBlock& Block, ERovrCompressQuality Quality, uint8* Dest)
+	{
+		const bool bRefine = Quality == ERovrCompressQuality::High;
+
+		FEncodedBlock Best;
+		for (int32 Flip = 0; Flip < 2; ++Flip)
+		{
+			EncodeSubblocks(Block, Flip != 0, true, bRefine, Best);
+			if (Quality != ERovrCompressQuality::Fast)
+			{
+				EncodeSubblocks(Block, Flip != 0, false, bRefine, Best);
+			}
+		}
+
+		if (Quality != ERovrCompressQuality::Fast)
+		{
+			EncodePlanar(Block, Best);
+		}
+
+		FMemory::Memcpy(Dest, Best.Bytes, BlockBytes);
+	}
+}
+
+bool RovrBlockCompress::IsETC2Supported()
+{
+	return GPixelFormats[PF_ETC2_RGB].Supported;
+}
+
+void RovrBlockCompress::CompressETC2(const uint8* Source, int64 SourceStride, int32 Width, int32 Height, uint8* Dest, ERovrCompressQuality Quality)
+{
+	if (Width <= 0 || Height <= 0)
+	{
+		return;
+	}
+
+	const int32 NumBlocksX = FMath::DivideAndRoundUp(Width, 4);
+	const int32 NumBlocksY = FMath::DivideAndRoundUp(Height, 4);
+
+	auto CompressRows = [&](int32 FirstRow, int32 EndRow)
+	{
+		FBlock Block;
+		for (int32 BlockY = FirstRow; BlockY < EndRow; ++BlockY)
+		{
+			uint8* Out = Dest + int64(BlockY) * NumBlocksX * BlockBytes;
+			for (int32 BlockX = 0; BlockX < NumBlocksX; ++BlockX, Out += BlockBytes)
+			{
+				LoadBlock(Source, SourceStride, Width, Height, BlockX, BlockY, Block);
+				CompressBlock(Block, Quality, Out);
+			}
+		}
+	};
+
+	if (int64(NumBlocksX) * NumBlocksY < MinBlocksForParallelCompress)
+	{
+		CompressRows(0, NumBlocksY);
+		return;
+	}
+
+	const int32 RowsPerTask = int32(FMath::Max<int64>(1, BlocksPerTask / NumBlocksX));
+	ParallelFor(FMath::DivideAndRoundUp(NumBlocksY, RowsPerTask), [&](int32 Task)
+	{
+		const int32 FirstRow = Task * RowsPerTask;
+		CompressRows(FirstRow, FMath::Min(FirstRow + RowsPerTask, NumBlocksY));
+	});
+}
@@ -0,0 +1,378 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RovrCubemap.h"
+#include "RovrImagingDefines.h"
+#include "Async/ParallelFor.h"
+#include "Engine/TextureCube.h"
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS_NEON
+#define ROVR_CUBEMAP_NEON 1
+#include <arm_neon.h>
+#elif PLATFORM_ENABLE_VECTORINTRINSICS && PLATFORM_CPU_X86_FAMILY
+#define ROVR_CUBEMAP_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#ifndef ROVR_CUBEMAP_NEON
+#define ROVR_CUBEMAP_NEON 0
+#endif
+#ifndef ROVR_CUBEMAP_SSE2
+#define ROVR_CUBEMAP_SSE2 0
+#endif
+
+
+namespace
+{
+	/** Below this many destination pixels the faces are computed on the calling thread */
+	const int64 MinPixelsForParallelResample = 128 * 128;
+
+	/** Destination pixels computed per task */
+	const int64 PixelsPerTask = 64 * 1024;
+
+	/** Faces whose texels all lie at the same latitude along a face column, in UE's face order */
+	const int32 SideFaces[] = { 0, 1, 4, 5 };
+	const int32 TopFace = 2;
+	const int32 BottomFace = 3;
+
+	/** Splits the rows of the faces over worker threads when they are large enough */
+	template <typename RowsFunctionType>
+	void ForEachRowBand(int32 Width, int32 Height, RowsFunctionType&& ProcessRows)
+	{
+		if (int64(Width) * Height < MinPixelsForParallelResample)
+		{
+			ProcessRows(0, Height);
+			return;
+		}
+
+		const int32 RowsPerTask = int32(FMath::Max<int64>(1, PixelsPerTask / Width));
+		ParallelFor(FMath::DivideAndRoundUp(Height, RowsPerTask), [&](int32 Task)
+		{
+			const int32 FirstRow = Task * RowsPerTask;
+			ProcessRows(FirstRow, FMath::Min(FirstRow + RowsPerTask, Height));
+		});
+	}
+
+	// The filters weigh the four channels of a texel at once
+#if ROVR_CUBEMAP_SSE2
+	typedef __m128 FTexel;
+
+	FORCEINLINE FTexel LoadTexel(const uint8* Texel)
+	{
+		int32 Bits;
+		FMemory::Memcpy(&Bits, Texel, sizeof(Bits));
+
+		const __m128i Zero = _mm_setzero_si128();
+		const __m128i Bytes = _mm_cvtsi32_si128(Bits);
+		return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(Bytes, Zero), Zero));
+	}
+
+	FORCEINLINE FTexel Weigh(const FTexel& Texel, float Weight)
+	{
+		return _mm_mul_ps(Texel, _mm_set1_ps(Weight));
+	}
+
+	FORCEINLINE FTexel WeighAdd(const FTexel& Sum, const FTexel& Texel, float Weight)
+	{
+		return _mm_add_ps(Sum, _mm_mul_ps(Texel, _mm_set1_ps(Weight)));
+	}
+
+	FORCEINLINE void StoreTexel(const FTexel& Texel, uint8* Dest)
+	{
+		// Rounds to nearest; the saturating packs clamp bicubic overshoot
+		__m128i Integers = _mm_cvtps_epi32(Texel);
+		Integers = _mm_packs_epi32(Integers, Integers);
+		const int32 Bits = _mm_cvtsi128_si32(_mm_packus_epi16(Integers, Integers));
+		FMemory::Memcpy(Dest, &Bits, sizeof(Bits));
+	}
+#elif ROVR_CUBEMAP_NEON
+	typedef float32x4_t FTexel;
+
+	FORCEINLINE FTexel LoadTexel(const uint8* Texel)
+	{
+		uint32 Bits;
+		FMemory::Memcpy(&Bits, Texel, sizeof(Bits));
+
+		const uint16x8_t Words = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(Bits)));
+		return vcvtq_f32_u32(vmovl_u16(vget_low_u16(Words)));
+	}
+
+	FORCEINLINE FTexel Weigh(const FTexel& Texel, float Weight)
+	{
+		return vmulq_n_f32(Texel, Weight);
+	}
+
+	FORCEINLINE FTexel WeighAdd(const FTexel& Sum, const FTexel& Texel, float Weight)
+	{
+		return vmlaq_n_f32(Sum, Texel, Weight);
+	}
+
+	FORCEINLINE void StoreTexel(const FTexel& Texel, uint8* Dest)
+	{
+		// Conversion truncates towards zero, so half is added first; the saturating narrows clamp bicubic overshoot
+		const int32x4_t Integers = vcvtq_s32_f32(vaddq_f32(Texel, vdupq_n_f32(0.5f)));
+		const uint16x4_t Words = vqmovun_s32(Integers);
+		const uint8x8_t Bytes = vqmovn_u16(vcombine_u16(Words, Words));
+		vst1_lane_u32(reinterpret_cast<uint32_t*>(Dest), vreinterpret_u32_u8(Bytes), 0);
+	}
+#else
+	struct FTexel
+	{
+		float Channels[4];
+	};
+
+	FORCEINLINE FTexel LoadTexel(const uint8* Texel)
+	{
+		return FTexel{ { float(Texel[0]), float(Texel[1]), float(Texel[2]), float(Texel[3]) } };
+	}
+
+	FORCEINLINE FTexel Weigh(const FTexel& Texel, float Weight)
+	{
+		FTexel Result;
+		for (int32 Channel = 0; Channel < 4; ++Channel)
+		{
+			Result.Channels[Channel] = Texel.Channels[Channel] * Weight;
+		}
+		return Result;
+	}
+
+	FORCEINLINE FTexel WeighAdd(const FTexel& Sum, const FTexel& Texel, float Weight)
+	{
+		FTexel Result;
+		for (int32 Channel = 0; Channel < 4; ++Channel)
+		{
+			Result.Channels[Channel] = Sum.Channels[Channel] + Texel.Channels[Channel] * Weight;
+		}
+		return Result;
+	}
+
+	FORCEINLINE void StoreTexel(const FTexel& Texel, uint8* Dest)
+	{
+		for (int32 Channel = 0; Channel < 4; ++Channel)
+		{
+			Dest[Channel] = uint8(FMath::Clamp(FMath::RoundToInt(Texel.Channels[Channel]), 0, 255));
+		}
+	}
+#endif
+
+	/** Column of the image, continuing across the left and right edge; X lies within two texels of the image */
+	FORCEINLINE int32 WrapColumn(int32 X, int32 Width)
+	{
+		return X < 0 ? X + Width : (X >= Width ? X - Width : X);
+	}
+
+	/** Catmull-Rom weights of the texels before, at, after and two after a position Fraction past a texel */
+	FORCEINLINE void GetCubicWeights(float Fraction, float (&OutWeights)[4])
+	{
+		OutWeights[0] = ((-0.5f * Fraction + 1.0f) * Fraction - 0.5f) * Fraction;
+		OutWeights[1] = (1.5f * Fraction - 2.5f) * Fraction * Fraction + 1.0f;
+		OutWeights[2] = ((-1.5f * Fraction + 2.0f) * Fraction + 0.5f) * Fraction;
+		OutWeights[3] = (0.5f * Fraction - 0.5f) * Fraction * Fraction;
+	}
+
+	/**
+	 * Filter a row of destination texels from the equirect image, wrapping horizontally and clamping at the poles
+	 *
+	 * @param SourceX, SourceY Position of every destination texel in the image, in texels from the centre of its top left texel
+	 */
+	void SampleRow(const FRovrImageView& Image, ERovrResampleFilter Filter, const float* SourceX, const float* SourceY, int32 Count, uint8* Dest)
+	{
+		const uint8* Data = Image.Data.GetData();
+		const int32 LastRow = Image.Height - 1;
+
+		for (int32 Index = 0; Index < Count; ++Index, Dest += 4)
+		{
+			const float FloorX = FMath::FloorToFloat(SourceX[Index]);
+			const float FloorY = FMath::FloorToFloat(SourceY[Index]);
+			const float FractionX = SourceX[Index] - FloorX;
+			const float FractionY = SourceY[Index] - FloorY;
+			const int32 X = int32(FloorX);
+			const int32 Y = int32(FloorY);
+
+			if (Filter == ERovrResampleFilter::Bicubic)
+			{
+				float WeightsX[4];
+				float WeightsY[4];
+				GetCubicWeights(FractionX, WeightsX);
+				GetCubicWeights(FractionY, WeightsY);
+
+				int32 Columns[4];
+				for (int32 Tap = 0; Tap < 4; ++Tap)
+				{
+					Columns[Tap] = WrapColumn(X - 1 + Tap, Image.Width) * 4;
+				}
+
+				FTexel Sum;
+				for (int32 TapY = 0; TapY < 4; ++TapY)
+				{
+					const uint8* Row = Data + FMath::Clamp(Y - 1 + TapY, 0, LastRow) * Image.Stride;
+
+					FTexel RowSum = Weigh(LoadTexel(Row + Columns[0]), WeightsX[0]);
+					RowSum = WeighAdd(RowSum, LoadTexel(Row + Columns[1]), WeightsX[1]);
+					RowSum = WeighAdd(RowSum, LoadTexel(Row + Columns[2]), WeightsX[2]);
+					RowSum = WeighAdd(RowSum, LoadTexel(Row + Columns[3]), WeightsX[3]);
+					Sum = TapY == 0 ? Weigh(RowSum, WeightsY[0]) : WeighAdd(Sum, RowSum, WeightsY[TapY]);
+				}
+				StoreTexel(Sum, Dest);
+			}
+			else
+			{
+				const int32 Column0 = WrapColumn(X, Image.Width) * 4;
+				const int32 Column1 = WrapColumn(X + 1, Image.Width) * 4;
+				const uint8* Row0 = Data + FMath::Clamp(Y, 0, LastRow) * Image.Stride;
+				const uint8* Row1 = Data + FMath::Clamp(Y + 1, 0, LastRow) * Image.Stride;
+
+				const FTexel Top = WeighAdd(Weigh(LoadTexel(Row0 + Column0), 1.0f - FractionX), LoadTexel(Row0 + Column1), FractionX);
+				const FTexel Bottom = WeighAdd(Weigh(LoadTexel(Row1 + Column0), 1.0f - FractionX), LoadTexel(Row1 + Column1), FractionX);
+				StoreTexel(WeighAdd(Weigh(Top, 1.0f - FractionY), Bottom, FractionY), Dest);
+			}
+		}
+	}
+
+	/** Position across a face from -1 to 1 of the centre of texel Index, as the tangent of the angle from the face centre */
+	float GetFaceCoordinate(int32 Index, int32 FaceSize, ERovrCubeProjection Projection)
+	{
+		const float Coordinate = 2.0f * (Index + 0.5f) / FaceSize - 1.0f;
+		return Projection == ERovrCubeProjection::EquiAngular ? FMath::Tan(Coordinate * (PI / 4.0f)) : Coordinate;
+	}
+
+	/** Image column of a longitude from -PI to PI, in texels from the centre of the first column */
+	FORCEINLINE float LongitudeToSourceX(float Longitude, int32 Width)
+	{
+		return (Longitude / (2.0f * PI) + 0.5f) * Width - 0.5f;
+	}
+
+	/** Image row of a latitude from -PI / 2 at the bottom to PI / 2 at the top */
+	FORCEINLINE float LatitudeToSourceY(float Latitude, int32 Height)
+	{
+		return (0.5f - Latitude / PI) * Height - 0.5f;
+	}
+}
+
+int32 RovrCubemap::GetFaceSize(int32 EquirectWidth)
+{
+	return FMath::Clamp(FMath::RoundToInt(EquirectWidth / 16.0f) * 4, 4, MaxFaceSize);
+}
+
+bool RovrCubemap::FromEquirect(const FRovrImageView& Equirect, int32 FaceSize, ERovrCubeProjection Projection, ERovrResampleFilter Filter, uint8* Dest)
+{
+	if (!Equirect.IsValid() || Equirect.Width < 4 || FaceSize <= 0 || FaceSize > MaxFaceSize)
+	{
+		return false;
+	}
+
+	// Face texel (S, T) looks along (1, -S, -T) on +X, (-1, S, -T) on -X, (S, T, 1) on +Z, (S, -T, -1) on -Z,
+	// (S, 1, -T) on +Y and (-S, -1, -T) on -Y, following UE's TransformSideToWorldSpace
+	TArray<float> Coordinates;
+	TArray<float> SideRadii;
+	Coordinates.SetNumUninitialized(FaceSize);
+	SideRadii.SetNumUninitialized(FaceSize);
+	for (int32 Index = 0; Index < FaceSize; ++Index)
+	{
+		Coordinates[Index] = GetFaceCoordinate(Index, FaceSize, Projection);
+		SideRadii[Index] = FMath::Sqrt(1.0f + FMath::Square(Coordinates[Index]));
+	}
+
+	// Longitudes on the side faces change along rows only, so their columns are shared by every row
+	TArray<float> SideColumns;
+	SideColumns.SetNumUninitialized(FaceSize * 4);
+	for (int32 Index = 0; Index < FaceSize; ++Index)
+	{
+		const float S = Coordinates[Index];
+		SideColumns[Index] = LongitudeToSourceX(FMath::Atan2(-S, 1.0f), Equirect.Width);
+		SideColumns[FaceSize + Index] = LongitudeToSourceX(FMath::Atan2(S, -1.0f), Equirect.Width);
+		SideColumns[FaceSize * 2 + Index] = LongitudeToSourceX(FMath::Atan2(1.0f, S), Equirect.Width);
+		SideColumns[FaceSize * 3 + Index] = LongitudeToSourceX(FMath::Atan2(-1.0f, -S), Equirect.Width);
+	}
+
+	const int64 FaceStride = int64(FaceSize) * 4;
+	const int64 FaceBytes = FaceStride * FaceSize;
+
+	ForEachRowBand(FaceSize * NumFaces, FaceSize, [&](int32 FirstRow, int32 EndRow)
+	{
+		TArray<float> Positions;
+		Positions.SetNumUninitialized(FaceSize * 5);
+		float* SideY = Positions.GetData();
+		float* TopX = SideY + FaceSize;
+		float* TopY = TopX + FaceSize;
+		float* BottomX = TopY + FaceSize;
+		float* BottomY = BottomX + FaceSize;
+
+		for (int32 Row = FirstRow; Row < EndRow; ++Row)
+		{
+			const float T = Coordinates[Row];
+
+			for (int32 Index = 0; Index < FaceSize; ++Index)
+			{
+				const float S = Coordinates[Index];
+
+				// The side faces share one latitude per texel
+				SideY[Index] = LatitudeToSourceY(FMath::Atan2(-T, SideRadii[Index]), Equirect.Height);
+
+				// -Z mirrors +Z: the negated longitude at the opposite latitude
+				const float Longitude = FMath::Atan2(T, S);
+				const float Latitude = FMath::Atan2(1.0f, FMath::Sqrt(S * S + T * T));
+				TopX[Index] = LongitudeToSourceX(Longitude, Equirect.Width);
+				TopY[Index] = LatitudeToSourceY(Latitude, Equirect.Height);
+				BottomX[Index] = LongitudeToSourceX(-Longitude, Equirect.Width);
+				BottomY[Index] = LatitudeToSourceY(-Latitude, Equirect.Height);
+			}
+
+			uint8* RowDest = Dest + Row * FaceStride;
+			for (int32 Side = 0; Side < UE_ARRAY_COUNT(SideFaces); ++Side)
+			{
+				SampleRow(Equirect, Filter, &SideColumns[FaceSize * Side], SideY, FaceSize, RowDest + SideFaces[Side] * FaceBytes);
+			}
+			SampleRow(Equirect, Filter, TopX, TopY, FaceSize, RowDest + TopFace * FaceBytes);
+			SampleRow(Equirect, Filter, BottomX, BottomY, FaceSize, RowDest + BottomFace * FaceBytes);
+		}
+	});
+
+	return true;
+}
+
+void RovrCubemap::PackFaces3x2(const uint8* Faces, int32 FaceSize, uint8* Dest)
+{
+	const int64 FaceStride = int64(FaceSize) * 4;
+	const int64 DestStride = FaceStride * 3;
+
+	for (int32 Face = 0; Face < NumFaces; ++Face)
+	{
+		const uint8* Source = Faces + Face * FaceStride * FaceSize;
+		uint8* FaceDest = Dest + (Face / 3) * DestStride * FaceSize + (Face % 3) * FaceStride;
+		for (int32 Row = 0; Row < FaceSize; ++Row)
+		{
+			FMemory::Memcpy(FaceDest + Row * DestStride, Source + Row * FaceStride, FaceStride);
+		}
+	}
+}
+
+UTextureCube* RovrCubemap::CreateTextureCube(const TArray<uint8>& Faces, int32 FaceSize, FName Name)
+{
+	check(IsInGameThread());
+
+	const int64 FaceBytes = int64(FaceSize) * FaceSize * 4;
+	if (FaceSize <= 0 || Faces.Num() != FaceBytes * NumFaces)
+	{
+		UE_LOG(LogRovrImaging, Warning, TEXT("Unable to create a cube texture with %d byte faces from %d bytes"), int32(FaceBytes), Faces.Num());
+		return nullptr;
+	}
+
+	UTextureCube* Texture = NewObject<UTextureCube>(GetTransientPackage(), Name, RF_Transient);
+	Texture->PlatformData = new FTexturePlatformData();
+	Texture->PlatformData->SizeX = FaceSize;
+	Texture->PlatformData->SizeY = FaceSize;
+	Texture->PlatformData->PixelFormat = PF_B8G8R8A8;
+	Texture->PlatformData->SetNumSlices(NumFaces);
+
+	// The faces of a mip follow one another in its bulk data
+	FTexture2DMipMap* Mip = new FTexture2DMipMap();
+	Texture->PlatformData->Mips.Add(Mip);
+	Mip->SizeX = FaceSize;
+	Mip->SizeY = FaceSize;
+	Mip->BulkData.Lock(LOCK_READ_WRITE);
+	FMemory::Memcpy(Mip->BulkData.Realloc(Faces.Num()), Faces.GetData(), Faces.Num());
+	Mip->BulkData.Unlock();
+
+	Texture->UpdateResource();
+	return Texture;
+}
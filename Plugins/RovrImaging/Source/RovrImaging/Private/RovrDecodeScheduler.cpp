@@ -0,0 +1,220 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RovrDecodeScheduler.h"
+#include "Async/Async.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformMemory.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/ScopeLock.h"
+
+
+namespace
+{
+	TAutoConsoleVariable<int32> CVarDecodeSchedulerMaxConcurrent(
+		TEXT("rovr.DecodeScheduler.MaxConcurrent"),
+		2,
+		TEXT("Image decodes the decode scheduler runs at once. The decoders split large images over worker\n")
+		TEXT("threads themselves, so a few at a time keep the workers busy without starving the rest of the game."),
+		ECVF_Default);
+
+	TAutoConsoleVariable<int32> CVarDecodeSchedulerMemoryBudgetMB(
+		TEXT("rovr.DecodeScheduler.MemoryBudgetMB"),
+		256,
+		TEXT("Memory the image decodes the decode scheduler runs may take together, in megabytes"),
+		ECVF_Default);
+
+	/** Reading the free memory is slow on some platforms, e.g. through /proc/meminfo on Android */
+	const double MemoryCheckInterval = 2.0;
+}
+
+FRovrDecodeScheduler& FRovrDecodeScheduler::Get()
+{
+	static FRovrDecodeScheduler Scheduler;
+	return Scheduler;
+}
+
+int32 FRovrDecodeScheduler::Enqueue(ERovrDecodePriority Priority, int64 MemoryBytes, FWork&& Work)
+{
+	int32 Id;
+	{
+		FScopeLock ScopeLock(&Lock);
+
+		Id = NextId;
+		NextId = NextId < MAX_int32 ? NextId + 1 : 1;
+
+		Queues[FMath::Min(int32(Priority), NumPriorities - 1)].Add(FJob{ Id, FMath::Max<int64>(MemoryBytes, 0), MoveTemp(Work), MakeShared<FThreadSafeBool, ESPMode::ThreadSafe>(false) });
+	}
+
+	Dispatch();
+	return Id;
+}
+
+void FRovrDecodeScheduler::Cancel(int32 Id)
+{
+	FScopeLock ScopeLock(&Lock);
+
+	for (TArray<FJob>& Queue : Queues)
+	{
+		const int32 Index = Queue.IndexOfByPredicate([Id](const FJob& Job) { return Job.Id == Id; });
+		if (Index != INDEX_NONE)
+		{
+			Queue.RemoveAt(Index);
+			++NumCancelled;
+			return;
+		}
+	}
+
+	// Started decodes, including finished ones whose result still waits for the game thread
+	if (const TWeakPtr<FThreadSafeBool, ESPMode::ThreadSafe>* WeakCancelled = StartedFlags.Find(Id))
+	{
+		const TSharedPtr<FThreadSafeBool, ESPMode::ThreadSafe> bCancelled = WeakCancelled->Pin();
+		if (!bCancelled.IsValid())
+		{
+			StartedFlags.Remove(Id);
+		}
+		else if (!*bCancelled)
+		{
+			*bCancelled = true;
+			++NumCancelled;
+		}
+	}
+}
+
+void FRovrDecodeScheduler::SetPriority(int32 Id, ERovrDecodePriority Priority)
+{
+	{
+		FScopeLock ScopeLock(&Lock);
+
+		TArray<FJob>& Target = Queues[FMath::Min(int32(Priority), NumPriorities - 1)];
+		for (TArray<FJob>& Queue : Queues)
+		{
+			const int32 Index = Queue.IndexOfByPredicate([Id](const FJob& Job) { return Job.Id == Id; });
+			if (Index != INDEX_NONE)
+			{
+				FJob Job = MoveTemp(Queue[Index]);
+				Queue.RemoveAt(Index);
+				Target.Add(MoveTemp(Job));
+				break;
+			}
+		}
+	}
+
+	// A decode promoted to visible may take the slot kept free for visible work
+	Dispatch();
+}
+
+FRovrDecodeScheduler::FStats FRovrDecodeScheduler::GetStats() const
+{
+	FScopeLock ScopeLock(&Lock);
+
+	FStats Stats;
+	for (int32 Priority = 0; Priority < NumPriorities; ++Priority)
+	{
+		Stats.NumQueued[Priority] = Queues[Priority].Num();
+	}
+	Stats.NumRunning = Running.Num();
+	Stats.RunningBytes = RunningBytes;
+	Stats.NumStarted = NumStarted;
+	Stats.NumCancelled = NumCancelled;
+	return Stats;
+}
+
+void FRovrDecodeScheduler::Dispatch()
+{
+	TArray<FJob, TInlineAllocator<4>> Started;
+	{
+		FScopeLock ScopeLock(&Lock);
+
+		const int32 MaxConcurrent = FMath::Max(CVarDecodeSchedulerMaxConcurrent.GetValueOnAnyThread(), 1);
+		const int64 Budget = GetMemoryBudget();
+
+		bool bBlocked = false;
+		for (int32 Priority = 0; Priority < NumPriorities && !bBlocked; ++Priority)
+		{
+			// Work nobody is looking at leaves a slot for what scrolls into view next
+			const int32 MaxRunning = Priority == int32(ERovrDecodePriority::Visible) ? MaxConcurrent : FMath::Max(MaxConcurrent - 1, 1);
+
+			TArray<FJob>& Queue = Queues[Priority];
+			while (Queue.Num() > 0 && Running.Num() < MaxRunning)
+			{
+				FJob& Job = Queue.Last();
+				if (Running.Num() > 0 && RunningBytes + Job.MemoryBytes > Budget)
+				{
+					bBlocked = true;
+					break;
+				}
+
+				RunningBytes += Job.MemoryBytes;
+				Running.Add(Job.Id);
+				StartedFlags.Add(Job.Id, Job.bCancelled);
+				Started.Add(Queue.Pop(false));
+			}
+
+			// Less urgent decodes wait until every more urgent one started
+			bBlocked |= Queue.Num() > 0;
+		}
+
+		NumStarted += Started.Num();
+	}
+
+	for (FJob& Job : Started)
+	{
+		Async(EAsyncExecution::ThreadPool, [this, Job = MoveTemp(Job)]() mutable
+		{
+			// Cancelled between leaving the queue and reaching a worker
+			if (!*Job.bCancelled)
+			{
+				Job.Work(Job.bCancelled);
+			}
+
+			Finish(Job.Id, Job.MemoryBytes);
+		});
+	}
+}
+
+void FRovrDecodeScheduler::Finish(int32 Id, int64 MemoryBytes)
+{
+	{
+		FScopeLock ScopeLock(&Lock);
+
+		Running.Remove(Id);
+		RunningBytes -= MemoryBytes;
+
+		// Flags of earlier decodes whose callbacks have all run; this one's work still holds its own
+		for (auto It = StartedFlags.CreateIterator(); It; ++It)
+		{
+			if (!It.Value().IsValid())
+			{
+				It.RemoveCurrent();
+			}
+		}
+	}
+
+	Dispatch();
+}
+
+int64 FRovrDecodeScheduler::GetMemoryBudget()
+{
+	const double Now = FPlatformTime::Seconds();
+	if (LastMemoryCheck < 0.0 || Now - LastMemoryCheck > MemoryCheckInterval)
+	{
+		// Platforms that cannot tell report nothing free
+		const uint64 Available = FPlatformMemory::GetStats().AvailablePhysical;
+		AvailablePhysical = Available > 0 ? Available : MAX_uint64;
+		LastMemoryCheck = Now;
+	}
+
+	// Half of the free memory stays for everything else the app loads meanwhile
+	const int64 Budget = int64(FMath::Max(CVarDecodeSchedulerMemoryBudgetMB.GetValueOnAnyThread(), 1)) << 20;
+	return FMath::Min<int64>(Budget, int64(FMath::Min<uint64>(AvailablePhysical / 2, uint64(MAX_int64))));
+}
+
+void URovrDecodeLibrary::CancelImageDecode(int32 DecodeId)
+{
+	FRovrDecodeScheduler::Get().Cancel(DecodeId);
+}
+
+void URovrDecodeLibrary::SetImageDecodePriority(int32 DecodeId, ERovrDecodePriority Priority)
+{
+	FRovrDecodeScheduler::Get().SetPriority(DecodeId, Priority);
+}
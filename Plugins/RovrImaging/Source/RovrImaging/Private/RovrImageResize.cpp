@@ -0,0 +1,143 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RovrImageResize.h"
+#include "Async/ParallelFor.h"
+
+
+namespace
+{
+	/** Below this many destination pixels an image is resized on the calling thread */
+	const int64 MinPixelsForParallelResize = 128 * 128;
+
+	/** Destination pixels computed per task */
+	const int64 PixelsPerTask = 64 * 1024;
+
+	/** Fixed point weights: 14 bits per axis keep both passes within 32 bit sums */
+	const int32 WeightBits = 14;
+	const int32 WeightOne = 1 << WeightBits;
+
+	/** Intermediate values keep 8 fractional bits between the vertical and the horizontal pass */
+	const int32 VerticalShift = WeightBits - 8;
+	const int32 HorizontalShift = WeightBits + 8;
+
+	/** Source pixels each destination pixel along one axis covers, with their weights */
+	struct FContributions
+	{
+		TArray<int32> First;
+		TArray<int32> Count;
+		TArray<int32> WeightOffset;
+		TArray<int32> Weights;
+	};
+
+	void BuildContributions(int32 SourceSize, int32 DestSize, FContributions& Out)
+	{
+		const double Scale = double(SourceSize) / DestSize;
+
+		Out.First.SetNumUninitialized(DestSize);
+		Out.Count.SetNumUninitialized(DestSize);
+		Out.WeightOffset.SetNumUninitialized(DestSize);
+		Out.Weights.Reset(DestSize * (FMath::CeilToInt(Scale) + 1));
+
+		for (int32 Index = 0; Index < DestSize; ++Index)
+		{
+			const double Start = Index * Scale;
+			const double End = FMath::Min((Index + 1) * Scale, double(SourceSize));
+			const int32 First = FMath::Min(FMath::FloorToInt(Start), SourceSize - 1);
+			const int32 Last = FMath::Clamp(FMath::CeilToInt(End), First + 1, SourceSize) - 1;
+
+			Out.First[Index] = First;
+			Out.Count[Index] = Last - First + 1;
+			Out.WeightOffset[Index] = Out.Weights.Num();
+
+			// Each weight is the difference of the rounded coverage up to the ends of its tap, so the rounding error
+			// spreads over every tap of a large reduction and the weights sum to one, keeping flat areas exact
+			const double Span = End - Start;
+			int32 Covered = 0;
+			for (int32 SourceIndex = First; SourceIndex <= Last; ++SourceIndex)
+			{
+				const int32 CoveredToEnd = FMath::RoundToInt(float((FMath::Min(End, SourceIndex + 1.0) - Start) / Span * WeightOne));
+				Out.Weights.Add(CoveredToEnd - Covered);
+				Covered = CoveredToEnd;
+			}
+		}
+	}
+}
+
+FIntPoint RovrImageResize::FitSize(int32 Width, int32 Height, int32 MaxWidth, int32 MaxHeight)
+{
+	if (Width <= 0 || Height <= 0 || MaxWidth <= 0 || MaxHeight <= 0)
+	{
+		return FIntPoint::ZeroValue;
+	}
+
+	const double Scale = FMath::Min(1.0, FMath::Min(double(MaxWidth) / Width, double(MaxHeight) / Height));
+	return FIntPoint(FMath::Max(FMath::RoundToInt(float(Width * Scale)), 1), FMath::Max(FMath::RoundToInt(float(Height * Scale)), 1));
+}
+
+void RovrImageResize::ResizeArea(const uint8* Source, int64 SourceStride, int32 SourceWidth, int32 SourceHeight, uint8* Dest, int64 DestStride, int32 DestWidth, int32 DestHeight)
+{
+	if (SourceWidth <= 0 || SourceHeight <= 0 || DestWidth <= 0 || DestHeight <= 0)
+	{
+		return;
+	}
+
+	FContributions Columns;
+	FContributions Rows;
+	BuildContributions(SourceWidth, DestWidth, Columns);
+	BuildContributions(SourceHeight, DestHeight, Rows);
+
+	auto ResizeRows = [&](int32 FirstRow, int32 EndRow)
+	{
+		// Each destination row first blends its source rows, then its columns
+		TArray<uint16> Blended;
+		Blended.SetNumUninitialized(SourceWidth * 4);
+
+		for (int32 Y = FirstRow; Y < EndRow; ++Y)
+		{
+			const int32* RowWeights = Rows.Weights.GetData() + Rows.WeightOffset[Y];
+			for (int32 Channel = 0; Channel < SourceWidth * 4; ++Channel)
+			{
+				uint32 Sum = 0;
+				for (int32 Tap = 0; Tap < Rows.Count[Y]; ++Tap)
+				{
+					Sum += uint32(RowWeights[Tap]) * Source[(Rows.First[Y] + Tap) * SourceStride + Channel];
+				}
+				Blended[Channel] = uint16((Sum + (1 << (VerticalShift - 1))) >> VerticalShift);
+			}
+
+			uint8* DestRow = Dest + Y * DestStride;
+			for (int32 X = 0; X < DestWidth; ++X)
+			{
+				const int32* ColumnWeights = Columns.Weights.GetData() + Columns.WeightOffset[X];
+				const uint16* Pixel = Blended.GetData() + Columns.First[X] * 4;
+
+				uint32 Sum[4] = { 0, 0, 0, 0 };
+				for (int32 Tap = 0; Tap < Columns.Count[X]; ++Tap)
+				{
+					for (int32 Channel = 0; Channel < 4; ++Channel)
+					{
+						Sum[Channel] += uint32(ColumnWeights[Tap]) * Pixel[Tap * 4 + Channel];
+					}
+				}
+
+				for (int32 Channel = 0; Channel < 4; ++Channel)
+				{
+					DestRow[X * 4 + Channel] = uint8(FMath::Min<uint32>((Sum[Channel] + (1u << (HorizontalShift - 1))) >> HorizontalShift, 255));
+				}
+			}
+		}
+	};
+
+	if (int64(DestWidth) * DestHeight < MinPixelsForParallelResize)
+	{
+		ResizeRows(0, DestHeight);
+		return;
+	}
+
+	const int32 RowsPerTask = int32(FMath::Max<int64>(1, PixelsPerTask / DestWidth));
+	ParallelFor(FMath::DivideAndRoundUp(DestHeight, RowsPerTask), [&](int32 Task)
+	{
+		const int32 FirstRow = Task * RowsPerTask;
+		ResizeRows(FirstRow, FMath::Min(FirstRow + RowsPerTask, DestHeight));
+	});
+}
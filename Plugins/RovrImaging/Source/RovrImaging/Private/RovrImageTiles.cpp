@@ -0,0 +1,126 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RovrImageTiles.h"
+#include "RovrImagingDefines.h"
+#include "RovrBlockCompress.h"
+#include "RovrMipChain.h"
+
+
+namespace
+{
+	/** Copy a tile and its border out of a BGRA8 level, clamping at the level's edges or wrapping around horizontally */
+	void CopyTile(const uint8* Level, int64 Stride, FIntPoint LevelSize, FIntPoint Origin, int32 TextureSize, bool bWrapX, uint8* Out)
+	{
+		for (int32 Y = 0; Y < TextureSize; ++Y)
+		{
+			const int32 SourceY = FMath::Clamp(Origin.Y + Y, 0, LevelSize.Y - 1);
+			const uint32* SourceRow = reinterpret_cast<const uint32*>(Level + SourceY * Stride);
+			uint32* OutRow = reinterpret_cast<uint32*>(Out) + Y * TextureSize;
+
+			for (int32 X = 0; X < TextureSize; ++X)
+			{
+				const int32 SourceX = Origin.X + X;
+				OutRow[X] = SourceRow[bWrapX ? (SourceX % LevelSize.X + LevelSize.X) % LevelSize.X : FMath::Clamp(SourceX, 0, LevelSize.X - 1)];
+			}
+		}
+	}
+}
+
+FIntPoint IRovrTileSource::GetNumTiles(int32 Level) const
+{
+	const FIntPoint Size = GetLevelSize(Level);
+	return FIntPoint(FMath::DivideAndRoundUp(Size.X, GetTileSize()), FMath::DivideAndRoundUp(Size.Y, GetTileSize()));
+}
+
+TSharedPtr<FRovrMemoryTileSource, ESPMode::ThreadSafe> FRovrMemoryTileSource::Build(const FRovrImageView& Image, int32 TileSize, ERovrCompressQuality Compression, bool bWrapX, bool bIgnoreRHISupport)
+{
+	if (!Image.IsValid() || Image.Layout != ERovrPixelLayout::BGRA8 || TileSize <= 0 || TileSize % 4 != 0)
+	{
+		return nullptr;
+	}
+
+	TSharedRef<FRovrMemoryTileSource, ESPMode::ThreadSafe> Source = MakeShared<FRovrMemoryTileSource, ESPMode::ThreadSafe>();
+	Source->TileSize = TileSize;
+	Source->Format = Compression != ERovrCompressQuality::None && (bIgnoreRHISupport || RovrBlockCompress::IsETC2Supported()) ? PF_ETC2_RGB : PF_B8G8R8A8;
+
+	const int32 TextureSize = Source->GetTileTextureSize();
+	TArray<uint8> Texels;
+	Texels.SetNumUninitialized(TextureSize * TextureSize * 4);
+
+	const uint8* LevelData = Image.Data.GetData();
+	int64 Stride = Image.Stride;
+	FIntPoint Size(Image.Width, Image.Height);
+	TArray<uint8> Level;
+	TArray<uint8> NextLevel;
+
+	for (int32 LevelIndex = 0;; ++LevelIndex)
+	{
+		Source->LevelSizes.Add(Size);
+		Source->FirstTiles.Add(Source->Tiles.Num());
+
+		const FIntPoint NumTiles = Source->GetNumTiles(LevelIndex);
+		for (int32 TileY = 0; TileY < NumTiles.Y; ++TileY)
+		{
+			for (int32 TileX = 0; TileX < NumTiles.X; ++TileX)
+			{
+				CopyTile(LevelData, Stride, Size, FIntPoint(TileX * TileSize - Border, TileY * TileSize - Border), TextureSize, bWrapX, Texels.GetData());
+
+				TArray<uint8>& Tile = Source->Tiles.AddDefaulted_GetRef();
+				if (Source->Format == PF_ETC2_RGB)
+				{
+					Tile.SetNumUninitialized(RovrTexture::CalcMipSize(TextureSize, TextureSize, PF_ETC2_RGB));
+					RovrBlockCompress::CompressETC2(Texels.GetData(), TextureSize * 4, TextureSize, TextureSize, Tile.GetData(), Compression);
+				}
+				else
+				{
+					Tile = Texels;
+				}
+			}
+		}
+
+		if (NumTiles.X <= 1 && NumTiles.Y <= 1)
+		{
+			break;
+		}
+
+		// Lower levels are only seen at the edge of the view, where the box filter is good enough
+		const FIntPoint NextSize(FMath::Max(Size.X / 2, 1), FMath::Max(Size.Y / 2, 1));
+		NextLevel.SetNumUninitialized(NextSize.X * NextSize.Y * 4);
+		RovrMipChain::Downsample(LevelData, Stride, Size.X, Size.Y, NextLevel.GetData(), ERovrMipFilter::Box);
+
+		Swap(Level, NextLevel);
+		LevelData = Level.GetData();
+		Stride = NextSize.X * 4;
+		Size = NextSize;
+	}
+
+	UE_LOG(LogRovrImaging, Log, TEXT("Cut a %dx%d image into %d tiles over %d levels, %lld KB"), Image.Width, Image.Height, Source->Tiles.Num(), Source->LevelSizes.Num(), Source->GetAllocatedSize() / 1024);
+	return Source;
+}
+
+bool FRovrMemoryTileSource::ReadTile(const FRovrTileId& Tile, TArray<uint8>& OutData) const
+{
+	if (Tile.Level < 0 || Tile.Level >= LevelSizes.Num())
+	{
+		return false;
+	}
+
+	const FIntPoint NumTiles = GetNumTiles(Tile.Level);
+	if (Tile.X < 0 || Tile.X >= NumTiles.X || Tile.Y < 0 || Tile.Y >= NumTiles.Y)
+	{
+		return false;
+	}
+
+	OutData = Tiles[FirstTiles[Tile.Level] + Tile.Y * NumTiles.X + Tile.X];
+	return true;
+}
+
+int64 FRovrMemoryTileSource::GetAllocatedSize() const
+{
+	int64 Size = 0;
+	for (const TArray<uint8>& Tile : Tiles)
+	{
+		Size += Tile.Num();
+	}
+	return Size;
+}
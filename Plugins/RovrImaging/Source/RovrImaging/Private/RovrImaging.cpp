@@ -0,0 +1,32 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RovrImaging.h"
+#include "RovrImagingDefines.h"
+#include "RovrThumbnailCache.h"
+#include "Misc/CoreDelegates.h"
+
+#define LOCTEXT_NAMESPACE "FRovrImagingModule"
+
+void FRovrImagingModule::StartupModule()
+{
+	// Android may kill a backgrounded app without exiting it, so the thumbnail cache is saved on both
+	BackgroundHandle = FCoreDelegates::ApplicationWillEnterBackgroundDelegate.AddStatic(&FRovrImagingModule::SaveCaches);
+	PreExitHandle = FCoreDelegates::OnPreExit.AddStatic(&FRovrImagingModule::SaveCaches);
+}
+
+void FRovrImagingModule::ShutdownModule()
+{
+	FCoreDelegates::ApplicationWillEnterBackgroundDelegate.Remove(BackgroundHandle);
+	FCoreDelegates::OnPreExit.Remove(PreExitHandle);
+}
+
+void FRovrImagingModule::SaveCaches()
+{
+	FRovrThumbnailCache::Get().Save();
+}
+
+#undef LOCTEXT_NAMESPACE
+
+IMPLEMENT_MODULE(FRovrImagingModule, RovrImaging)
+
+DEFINE_LOG_CATEGORY(LogRovrImaging);
@@ -0,0 +1,942 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RovrJpegDecoder.h"
+#include "RovrImagingDefines.h"
+#include "Async/ParallelFor.h"
+
+
+namespace
+{
+	/** Codes up to this long are decoded with a single table lookup */
+	const int32 FastBits = 9;
+
+	/** Position of each zigzag ordered coefficient in the block, padded so corrupt run lengths stay inside the block */
+	const uint8 ZigZag[64 + 16] =
+	{
+		0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+		12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+		35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+		58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+		63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63
+	};
+
+	/** The MCU of a JPEG file has at most ten blocks */
+	const int32 MaxBlocksPerMcu = 10;
+
+	FORCEINLINE uint8 ClampToByte(int32 Value)
+	{
+		return uint8(FMath::Clamp(Value, 0, 255));
+	}
+
+	FORCEINLINE int32 ReadUint16(const uint8* Bytes)
+	{
+		return (Bytes[0] << 8) | Bytes[1];
+	}
+
+	/** Fixed point constants of the inverse DCT, scaled by 4096 */
+	constexpr int32 FixedPoint(double Value)
+	{
+		return int32(Value * 4096 + 0.5);
+	}
+
+	/**
+	 * One dimensional inverse DCT after Loeffler, Ligtenberg and Moschytz, as libjpeg's integer IDCT uses it.
+	 * Even outputs come out in X0..X3, odd terms in T0..T3
+	 */
+	struct FIdct1D
+	{
+		int32 X0, X1, X2, X3;
+		int32 T0, T1, T2, T3;
+
+		FORCEINLINE FIdct1D(int32 S0, int32 S1, int32 S2, int32 S3, int32 S4, int32 S5, int32 S6, int32 S7)
+		{
+			int32 P1 = (S2 + S6) * FixedPoint(0.5411961);
+			T2 = P1 + S6 * FixedPoint(-1.847759065);
+			T3 = P1 + S2 * FixedPoint(0.765366865);
+			T0 = (S0 + S4) * 4096;
+			T1 = (S0 - S4) * 4096;
+			X0 = T0 + T3;
+			X3 = T0 - T3;
+			X1 = T1 + T2;
+			X2 = T1 - T2;
+
+			T0 = S7;
+			T1 = S5;
+			T2 = S3;
+			T3 = S1;
+			int32 P3 = T0 + T2;
+			int32 P4 = T1 + T3;
+			P1 = T0 + T3;
+			int32 P2 = T1 + T2;
+			const int32 P5 = (P3 + P4) * FixedPoint(1.175875602);
+			T0 *= FixedPoint(0.298631336);
+			T1 *= FixedPoint(2.053119869);
+			T2 *= FixedPoint(3.072711026);
+			T3 *= FixedPoint(1.501321110);
+			P1 = P5 + P1 * FixedPoint(-0.899976223);
+			P2 = P5 + P2 * FixedPoint(-2.562915447);
+			P3 *= FixedPoint(-1.961570560);
+			P4 *= FixedPoint(-0.390180644);
+			T3 += P1 + P4;
+			T2 += P2 + P3;
+			T1 += P2 + P4;
+			T0 += P1 + P3;
+		}
+	};
+
+	/** Dequantize a block of coefficients in natural order and write its 8x8 samples */
+	void InverseDct(const int16* Block, const uint16* Quant, uint8* Out, int32 OutStride)
+	{
+		int32 Columns[64];
+
+		for (int32 Column = 0; Column < 8; ++Column)
+		{
+			const int16* In = Block + Column;
+			const uint16* Q = Quant + Column;
+			int32* Temp = Columns + Column;
+
+			// Most columns of a photo hold nothing but their first coefficient
+			if (In[8] == 0 && In[16] == 0 && In[24] == 0 && In[32] == 0 && In[40] == 0 && In[48] == 0 && In[56] == 0)
+			{
+				const int32 DC = In[0] * Q[0] * 4;
+				for (int32 Row = 0; Row < 8; ++Row)
+				{
+					Temp[Row * 8] = DC;
+				}
+				continue;
+			}
+
+			FIdct1D Idct(In[0] * Q[0], In[8] * Q[8], In[16] * Q[16], In[24] * Q[24], In[32] * Q[32], In[40] * Q[40], In[48] * Q[48], In[56] * Q[56]);
+
+			// Two bits of the 4096 scale are kept for the row pass
+			Idct.X0 += 512;
+			Idct.X1 += 512;
+			Idct.X2 += 512;
+			Idct.X3 += 512;
+			Temp[0] = (Idct.X0 + Idct.T3) >> 10;
+			Temp[56] = (Idct.X0 - Idct.T3) >> 10;
+			Temp[8] = (Idct.X1 + Idct.T2) >> 10;
+			Temp[48] = (Idct.X1 - Idct.T2) >> 10;
+			Temp[16] = (Idct.X2 + Idct.T1) >> 10;
+			Temp[40] = (Idct.X2 - Idct.T1) >> 10;
+			Temp[24] = (Idct.X3 + Idct.T0) >> 10;
+			Temp[32] = (Idct.X3 - Idct.T0) >> 10;
+		}
+
+		for (int32 Row = 0; Row < 8; ++Row)
+		{
+			const int32* In = Columns + Row * 8;
+			uint8* Pixels = Out + Row * OutStride;
+
+			FIdct1D Idct(In[0], In[1], In[2], In[3], In[4], In[5], In[6], In[7]);
+
+			// Removes the 4096 scale, the two kept bits and the 8 both passes gain together, rounds, and adds the 128 level shift
+			const int32 Bias = 65536 + (128 << 17);
+			Idct.X0 += Bias;
+			Idct.X1 += Bias;
+			Idct.X2 += Bias;
+			Idct.X3 += Bias;
+			Pixels[0] = ClampToByte((Idct.X0 + Idct.T3) >> 17);
+			Pixels[7] = ClampToByte((Idct.X0 - Idct.T3) >> 17);
+			Pixels[1] = ClampToByte((Idct.X1 + Idct.T2) >> 17);
+			Pixels[6] = ClampToByte((Idct.X1 - Idct.T2) >> 17);
+			Pixels[2] = ClampToByte((Idct.X2 + Idct.T1) >> 17);
+			Pixels[5] = ClampToByte((Idct.X2 - Idct.T1) >> 17);
+			Pixels[3] = ClampToByte((Idct.X3 + Idct.T0) >> 17);
+			Pixels[4] = ClampToByte((Idct.X3 - Idct.T0) >> 17);
+		}
+	}
+
+	/**
+	 * Basis of the reduced inverse DCTs: the 8 point basis function of each of the lowest coefficients, with
+	 * its normalization, sampled at the centres of 4 or 2 output pixels, scaled by 4096. Row is the output
+	 * pixel, column the coefficient
+	 */
+	const int32 ReducedBasis4[4][4] =
+	{
+		{ FixedPoint(0.353553391), FixedPoint(0.461939766), FixedPoint(0.353553391), FixedPoint(0.191341716) },
+		{ FixedPoint(0.353553391), FixedPoint(0.191341716), -FixedPoint(0.353553391), -FixedPoint(0.461939766) },
+		{ FixedPoint(0.353553391), -FixedPoint(0.191341716), -FixedPoint(0.353553391), FixedPoint(0.461939766) },
+		{ FixedPoint(0.353553391), -FixedPoint(0.461939766), FixedPoint(0.353553391), -FixedPoint(0.191341716) }
+	};
+
+	const int32 ReducedBasis2[2][2] =
+	{
+		{ FixedPoint(0.353553391), FixedPoint(0.353553391) },
+		{ FixedPoint(0.353553391), -FixedPoint(0.353553391) }
+	};
+
+	/**
+	 * Dequantize the lowest Size x Size coefficients of a block and write Size x Size samples, one for every
+	 * 8 / Size pixels square of the block. The higher coefficients only hold detail finer than an output
+	 * pixel and are dropped. A Size of 1 reads the DC coefficient alone, so Block may hold only that
+	 */
+	void InverseDctReduced(const int16* Block, const uint16* Quant, int32 Size, uint8* Out, int32 OutStride)
+	{
+		if (Size == 1)
+		{
+			// The DC coefficient is eight times the block's average
+			Out[0] = ClampToByte(((Block[0] * Quant[0] + 4) >> 3) + 128);
+			return;
+		}
+
+		const int32* Basis = Size == 4 ? &ReducedBasis4[0][0] : &ReducedBasis2[0][0];
+		int32 Columns[16];
+
+		for (int32 Column = 0; Column < Size; ++Column)
+		{
+			for (int32 Row = 0; Row < Size; ++Row)
+			{
+				int32 Sum = 0;
+				for (int32 Index = 0; Index < Size; ++Index)
+				{
+					Sum += Block[Index * 8 + Column] * Quant[Index * 8 + Column] * Basis[Row * Size + Index];
+				}
+
+				// Two bits of the 4096 scale are kept for the row pass
+				Columns[Row * Size + Column] = (Sum + 512) >> 10;
+			}
+		}
+
+		for (int32 Row = 0; Row < Size; ++Row)
+		{
+			const int32* In = Columns + Row * Size;
+			uint8* Pixels = Out + Row * OutStride;
+			for (int32 X = 0; X < Size; ++X)
+			{
+				int32 Sum = 0;
+				for (int32 Index = 0; Index < Size; ++Index)
+				{
+					Sum += In[Index] * Basis[X * Size + Index];
+				}
+
+				// Removes the 4096 scale and the two kept bits, rounds, and adds the 128 level shift
+				Pixels[X] = ClampToByte((Sum + 8192 + (128 << 14)) >> 14);
+			}
+		}
+	}
+
+	/** JFIF YCbCr to BGRA8, with 16 bit fixed point factors */
+	FORCEINLINE void YCbCrToBgra(int32 Y, int32 Cb, int32 Cr, uint8* Out)
+	{
+		Cb -= 128;
+		Cr -= 128;
+		Out[0] = ClampToByte(Y + ((116130 * Cb + 32768) >> 16));
+		Out[1] = ClampToByte(Y - ((22554 * Cb + 46802 * Cr - 32768) >> 16));
+		Out[2] = ClampToByte(Y + ((91881 * Cr + 32768) >> 16));
+		Out[3] = 255;
+	}
+
+	/** Convert a row of component samples, already at full resolution, to BGRA8 */
+	void ConvertRow(const uint8* const* Rows, int32 NumComponents, int32 Width, uint8* Out)
+	{
+		if (NumComponents == 1)
+		{
+			for (int32 X = 0; X < Width; ++X, Out += 4)
+			{
+				Out[0] = Out[1] = Out[2] = Rows[0][X];
+				Out[3] = 255;
+			}
+			return;
+		}
+
+		for (int32 X = 0; X < Width; ++X, Out += 4)
+		{
+			YCbCrToBgra(Rows[0][X], Rows[1][X], Rows[2][X], Out);
+		}
+	}
+
+	/** Repeat each sample of a subsampled row Factor times */
+	void UpsampleRow(const uint8* In, int32 Factor, int32 Width, uint8* Out)
+	{
+		if (Factor == 2)
+		{
+			for (int32 X = 0; X + 1 < Width; X += 2)
+			{
+				Out[X] = Out[X + 1] = In[X >> 1];
+			}
+			if (Width & 1)
+			{
+				Out[Width - 1] = In[(Width - 1) >> 1];
+			}
+			return;
+		}
+
+		for (int32 X = 0; X < Width; ++X)
+		{
+			Out[X] = In[X / Factor];
+		}
+	}
+
+	bool BuildHuffmanTable(const uint8* Counts, const uint8* Symbols, int32 NumSymbols, uint8* OutFastSymbol, uint8* OutFastLength, uint32* OutMaxCode, int32* OutValueOffset, uint8* OutSymbols)
+	{
+		FMemory::Memzero(OutFastLength, 1 << FastBits);
+		FMemory::Memcpy(OutSymbols, Symbols, NumSymbols);
+
+		int32 Code = 0;
+		int32 Index = 0;
+		for (int32 Length = 1; Length <= 16; ++Length)
+		{
+			OutValueOffset[Length] = Index - Code;
+			for (int32 Count = 0; Count < Counts[Length - 1]; ++Count, ++Code, ++Index)
+			{
+				// Codes of one length are consecutive; running out of them means a broken table
+				if (Code >= (1 << Length))
+				{
+					return false;
+				}
+
+				if (Length <= FastBits)
+				{
+					const int32 First = Code << (FastBits - Length);
+					const int32 Num = 1 << (FastBits - Length);
+					FMemory::Memset(OutFastSymbol + First, Symbols[Index], Num);
+					FMemory::Memset(OutFastLength + First, uint8(Length), Num);
+				}
+			}
+
+			OutMaxCode[Length] = uint32(Code) << (16 - Length);
+			Code <<= 1;
+		}
+
+		OutMaxCode[17] = MAX_uint32;
+		return true;
+	}
+}
+
+void FRovrJpegDecoder::FBitReader::Fill()
+{
+	while (NumBits <= 56)
+	{
+		uint8 Byte = 0;
+		if (!bMarker && Position < Size)
+		{
+			Byte = Data[Position];
+			if (Byte != 0xFF)
+			{
+				++Position;
+			}
+			else if (Position + 1 < Size && Data[Position + 1] == 0x00)
+			{
+				// A stuffed zero follows every 0xFF that belongs to the scan
+				Position += 2;
+			}
+			else
+			{
+				// A marker ends the entropy coded data; it is left for Restart to find
+				bMarker = true;
+				Byte = 0;
+			}
+		}
+
+		Bits = (Bits << 8) | Byte;
+		NumBits += 8;
+	}
+}
+
+uint32 FRovrJpegDecoder::FBitReader::Peek(int32 Count)
+{
+	if (NumBits < Count)
+	{
+		Fill();
+	}
+	return uint32(Bits >> (NumBits - Count)) & ((1u << Count) - 1);
+}
+
+void FRovrJpegDecoder::FBitReader::Skip(int32 Count)
+{
+	NumBits -= Count;
+}
+
+int32 FRovrJpegDecoder::FBitReader::Receive(int32 Count)
+{
+	if (Count == 0)
+	{
+		return 0;
+	}
+
+	const int32 Value = int32(Peek(Count));
+	Skip(Count);
+
+	// Values with a leading zero bit are negative
+	return Value < (1 << (Count - 1)) ? Value - (1 << Count) + 1 : Value;
+}
+
+void FRovrJpegDecoder::FBitReader::Restart()
+{
+	Bits = 0;
+	NumBits = 0;
+	bMarker = false;
+
+	while (Position + 1 < Size)
+	{
+		if (Data[Position] == 0xFF && Data[Position + 1] >= 0xD0 && Data[Position + 1] <= 0xD7)
+		{
+			Position += 2;
+			return;
+		}
+		++Position;
+	}
+}
+
+bool FRovrJpegDecoder::Open(TArrayView<const uint8> InData)
+{
+	Data = InData;
+	Width = 0;
+	Height = 0;
+	RestartInterval = 0;
+	Components.Reset();
+	for (int32 Index = 0; Index < 4; ++Index)
+	{
+		DCTables[Index].bValid = false;
+		ACTables[Index].bValid = false;
+	}
+
+	const uint8* Bytes = Data.GetData();
+	const int64 Size = Data.Num();
+	if (Size < 4 || Bytes[0] != 0xFF || Bytes[1] != 0xD8)
+	{
+		return false;
+	}
+
+	int64 Position = 2;
+	while (Position + 4 <= Size)
+	{
+		if (Bytes[Position] != 0xFF)
+		{
+			return false;
+		}
+
+		const uint8 Marker = Bytes[Position + 1];
+		if (Marker == 0xFF)
+		{
+			++Position;
+			continue;
+		}
+
+		const int32 Length = ReadUint16(Bytes + Position + 2);
+		if (Length < 2 || Position + 2 + Length > Size)
+		{
+			return false;
+		}
+
+		const uint8* Segment = Bytes + Position + 4;
+		const int32 SegmentLength = Length - 2;
+
+		switch (Marker)
+		{
+		case 0xDB:
+		{
+			for (int32 Offset = 0; Offset < SegmentLength;)
+			{
+				const int32 Precision = Segment[Offset] >> 4;
+				const int32 Table = Segment[Offset] & 15;
+				const int32 ValueSize = Precision ? 2 : 1;
+				if (Table > 3 || Offset + 1 + 64 * ValueSize > SegmentLength)
+				{
+					return false;
+				}
+
+				const uint8* Values = Segment + Offset + 1;
+				for (int32 Index = 0; Index < 64; ++Index)
+				{
+					QuantTables[Table][ZigZag[Index]] = uint16(Precision ? ReadUint16(Values + Index * 2) : Values[Index]);
+				}
+				Offset += 1 + 64 * ValueSize;
+			}
+			break;
+		}
+
+		case 0xC4:
+		{
+			for (int32 Offset = 0; Offset < SegmentLength;)
+			{
+				const int32 Class = Segment[Offset] >> 4;
+				const int32 Table = Segment[Offset] & 15;
+				if (Class > 1 || Table > 3 || Offset + 17 > SegmentLength)
+				{
+					return false;
+				}
+
+				const uint8* Counts = Segment + Offset + 1;
+				int32 NumSymbols = 0;
+				for (int32 Index = 0; Index < 16; ++Index)
+				{
+					NumSymbols += Counts[Index];
+				}
+				if (NumSymbols > 256 || Offset + 17 + NumSymbols > SegmentLength)
+				{
+					return false;
+				}
+
+				FHuffmanTable& Huffman = Class ? ACTables[Table] : DCTables[Table];
+				Huffman.bValid = BuildHuffmanTable(Counts, Counts + 16, NumSymbols, Huffman.FastSymbol, Huffman.FastLength, Huffman.MaxCode, Huffman.ValueOffset, Huffman.Symbols);
+				if (!Huffman.bValid)
+				{
+					return false;
+				}
+				Offset += 17 + NumSymbols;
+			}
+			break;
+		}
+
+		case 0xC0:
+		case 0xC1:
+		{
+			if (SegmentLength < 6 || Segment[0] != 8)
+			{
+				return false;
+			}
+
+			Height = ReadUint16(Segment + 1);
+			Width = ReadUint16(Segment + 3);
+			const int32 NumComponents = Segment[5];
+			if (Width == 0 || Height == 0 || (NumComponents != 1 && NumComponents != 3) || SegmentLength < 6 + NumComponents * 3)
+			{
+				return false;
+			}
+
+			MaxH = 1;
+			MaxV = 1;
+			for (int32 Index = 0; Index < NumComponents; ++Index)
+			{
+				FComponent& Component = Components.AddDefaulted_GetRef();
+				Component.Id = Segment[6 + Index * 3];
+				Component.H = Segment[7 + Index * 3] >> 4;
+				Component.V = Segment[7 + Index * 3] & 15;
+				Component.QuantTable = Segment[8 + Index * 3];
+				if (Component.H < 1 || Component.H > 4 || Component.V < 1 || Component.V > 4 || Component.QuantTable > 3)
+				{
+					return false;
+				}
+				MaxH = FMath::Max(MaxH, Component.H);
+				MaxV = FMath::Max(MaxV, Component.V);
+			}
+
+			// A single component is coded one block at a time, whatever sampling it declares
+			if (NumComponents == 1)
+			{
+				Components[0].H = Components[0].V = MaxH = MaxV = 1;
+			}
+
+			BlocksPerMcu = 0;
+			for (const FComponent& Component : Components)
+			{
+				// Only whole subsampling factors map samples onto pixels by repetition
+				if (MaxH % Component.H != 0 || MaxV % Component.V != 0)
+				{
+					return false;
+				}
+				BlocksPerMcu += Component.H * Component.V;
+			}
+			if (BlocksPerMcu > MaxBlocksPerMcu)
+			{
+				return false;
+			}
+
+			McusX = FMath::DivideAndRoundUp(Width, 8 * MaxH);
+			McusY = FMath::DivideAndRoundUp(Height, 8 * MaxV);
+			for (FComponent& Component : Components)
+			{
+				Component.BlocksX = McusX * Component.H;
+				Component.BlocksY = McusY * Component.V;
+			}
+			break;
+		}
+
+		// Progressive, lossless, hierarchical and arithmetic coded frames
+		case 0xC2: case 0xC3: case 0xC5: case 0xC6: case 0xC7:
+		case 0xC9: case 0xCA: case 0xCB: case 0xCD: case 0xCE: case 0xCF:
+			return false;
+
+		case 0xDD:
+			if (SegmentLength < 2)
+			{
+				return false;
+			}
+			RestartInterval = ReadUint16(Segment);
+			break;
+
+		case 0xDA:
+			if (Components.Num() == 0 || !ParseScanHeader(Segment, SegmentLength))
+			{
+				return false;
+			}
+			ScanStart = Position + 2 + Length;
+			return true;
+
+		default:
+			break;
+		}
+
+		Position += 2 + Length;
+	}
+
+	return false;
+}
+
+bool FRovrJpegDecoder::ParseScanHeader(const uint8* Segment, int32 Length)
+{
+	// Baseline files that code their components in separate scans are rare enough to leave to ImageWrapper
+	const int32 NumComponents = Length > 0 ? Segment[0] : 0;
+	if (NumComponents != Components.Num() || Length < 4 + NumComponents * 2)
+	{
+		return false;
+	}
+
+	for (int32 Index = 0; Index < NumComponents; ++Index)
+	{
+		const int32 Id = Segment[1 + Index * 2];
+		const int32 Found = Components.IndexOfByPredicate([Id](const FComponent& Component) { return Component.Id == Id; });
+		if (Found < Index)
+		{
+			return false;
+		}
+
+		// Blocks of an MCU come in scan order
+		Components.Swap(Index, Found);
+		FComponent& Component = Components[Index];
+		Component.DCTable = Segment[2 + Index * 2] >> 4;
+		Component.ACTable = Segment[2 + Index * 2] & 15;
+		if (Component.DCTable > 3 || Component.ACTable > 3 || !DCTables[Component.DCTable].bValid || !ACTables[Component.ACTable].bValid)
+		{
+			return false;
+		}
+	}
+
+	const uint8* Selection = Segment + 1 + NumComponents * 2;
+	return Selection[0] == 0 && Selection[1] == 63 && Selection[2] == 0;
+}
+
+void FRovrJpegDecoder::BeginScan()
+{
+	Reader = FBitReader();
+	Reader.Data = Data.GetData();
+	Reader.Size = Data.Num();
+	Reader.Position = ScanStart;
+
+	for (FComponent& Component : Components)
+	{
+		Component.DCPrediction = 0;
+	}
+	McusToRestart = RestartInterval;
+}
+
+int32 FRovrJpegDecoder::DecodeSymbol(const FHuffmanTable& Table)
+{
+	const uint32 Look = Reader.Peek(16);
+
+	const uint32 Fast = Look >> (16 - FastBits);
+	if (Table.FastLength[Fast])
+	{
+		Reader.Skip(Table.FastLength[Fast]);
+		return Table.FastSymbol[Fast];
+	}
+
+	for (int32 Length = FastBits + 1; Length <= 16; ++Length)
+	{
+		if (Look < Table.MaxCode[Length])
+		{
+			Reader.Skip(Length);
+			const int32 Index = int32(Look >> (16 - Length)) + Table.ValueOffset[Length];
+			return Index >= 0 && Index < 256 ? Table.Symbols[Index] : -1;
+		}
+	}
+
+	return -1;
+}
+
+bool FRovrJpegDecoder::DecodeBlock(FComponent& Component, int16* Block, bool bDCOnly)
+{
+	const int32 DCSize = DecodeSymbol(DCTables[Component.DCTable]);
+	if (DCSize < 0 || DCSize > 11)
+	{
+		return false;
+	}
+
+	Component.DCPrediction += Reader.Receive(DCSize);
+
+	const FHuffmanTable& ACTable = ACTables[Component.ACTable];
+	if (bDCOnly)
+	{
+		Block[0] = int16(Component.DCPrediction);
+
+		// The AC codes still have to be read to find the next block
+		for (int32 Index = 1; Index < 64;)
+		{
+			const int32 Symbol = DecodeSymbol(ACTable);
+			if (Symbol < 0)
+			{
+				return false;
+			}
+
+			const int32 Size = Symbol & 15;
+			if (Size == 0)
+			{
+				if (Symbol != 0xF0)
+				{
+					break;
+				}
+				Index += 16;
+				continue;
+			}
+
+			Reader.Peek(Size);
+			Reader.Skip(Size);
+			Index += (Symbol >> 4) + 1;
+		}
+		return true;
+	}
+
+	FMemory::Memzero(Block, 64 * sizeof(int16));
+	Block[0] = int16(Component.DCPrediction);
+
+	for (int32 Index = 1; Index < 64;)
+	{
+		const int32 Symbol = DecodeSymbol(ACTable);
+		if (Symbol < 0)
+		{
+			return false;
+		}
+
+		const int32 Size = Symbol & 15;
+		if (Size == 0)
+		{
+			// Sixteen zeros, or the end of the block
+			if (Symbol != 0xF0)
+			{
+				break;
+			}
+			Index += 16;
+			continue;
+		}
+
+		Index += Symbol >> 4;
+		Block[ZigZag[Index]] = int16(Reader.Receive(Size));
+		++Index;
+	}
+
+	return true;
+}
+
+bool FRovrJpegDecoder::DecodeMcu(int16* Blocks, bool bDCOnly)
+{
+	if (RestartInterval)
+	{
+		if (McusToRestart == 0)
+		{
+			Reader.Restart();
+			for (FComponent& Component : Components)
+			{
+				Component.DCPrediction = 0;
+			}
+			McusToRestart = RestartInterval;
+		}
+		--McusToRestart;
+	}
+
+	const int32 BlockSize = bDCOnly ? 1 : 64;
+	for (FComponent& Component : Components)
+	{
+		for (int32 Block = 0; Block < Component.H * Component.V; ++Block, Blocks += BlockSize)
+		{
+			if (!DecodeBlock(Component, Blocks, bDCOnly))
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool FRovrJpegDecoder::DecodePreview(TArray<uint8>& OutPixels)
+{
+	if (Components.Num() == 0)
+	{
+		return false;
+	}
+
+	BeginScan();
+
+	// One sample per block and component; blocks past a decoding error stay mid grey
+	TArray<TArray<uint8>, TInlineAllocator<3>> Planes;
+	for (const FComponent& Component : Components)
+	{
+		Planes.AddDefaulted_GetRef().Init(128, Component.BlocksX * Component.BlocksY);
+	}
+
+	bool bDecoded = true;
+	int16 DC[MaxBlocksPerMcu];
+	for (int32 McuY = 0; McuY < McusY && bDecoded; ++McuY)
+	{
+		for (int32 McuX = 0; McuX < McusX; ++McuX)
+		{
+			if (!DecodeMcu(DC, true))
+			{
+				UE_LOG(LogRovrImaging, Warning, TEXT("Corrupt JPEG data at MCU %d,%d of the preview"), McuX, McuY);
+				bDecoded = false;
+				break;
+			}
+
+			const int16* Value = DC;
+			for (int32 Index = 0; Index < Components.Num(); ++Index)
+			{
+				const FComponent& Component = Components[Index];
+				const int32 DCQuant = QuantTables[Component.QuantTable][0];
+				for (int32 BlockY = 0; BlockY < Component.V; ++BlockY)
+				{
+					uint8* Row = Planes[Index].GetData() + (McuY * Component.V + BlockY) * Component.BlocksX + McuX * Component.H;
+					for (int32 BlockX = 0; BlockX < Component.H; ++BlockX, ++Value)
+					{
+						// The DC coefficient is eight times the block's average
+						Row[BlockX] = ClampToByte(((*Value * DCQuant + 4) >> 3) + 128);
+					}
+				}
+			}
+		}
+	}
+
+	const FIntPoint Size = GetPreviewSize();
+	OutPixels.SetNumUninitialized(Size.X * Size.Y * 4);
+
+	TArray<uint8> Upsampled;
+	Upsampled.SetNumUninitialized(Size.X * Components.Num());
+	const uint8* Rows[3];
+
+	for (int32 Y = 0; Y < Size.Y; ++Y)
+	{
+		for (int32 Index = 0; Index < Components.Num(); ++Index)
+		{
+			const FComponent& Component = Components[Index];
+			const uint8* Row = Planes[Index].GetData() + (Y * Component.V / MaxV) * Component.BlocksX;
+			if (Component.H == MaxH)
+			{
+				Rows[Index] = Row;
+			}
+			else
+			{
+				uint8* Out = Upsampled.GetData() + Index * Size.X;
+				UpsampleRow(Row, MaxH / Component.H, Size.X, Out);
+				Rows[Index] = Out;
+			}
+		}
+
+		ConvertRow(Rows, Components.Num(), Size.X, OutPixels.GetData() + int64(Y) * Size.X * 4);
+	}
+
+	return bDecoded;
+}
+
+bool FRovrJpegDecoder::Decode(int32 BandHeight, TFunctionRef<bool(const uint8* Pixels, int32 FirstRow, int32 NumRows)> OnBand, int32 ScaleShift)
+{
+	if (Components.Num() == 0)
+	{
+		return false;
+	}
+
+	BeginScan();
+
+	// Samples each block decodes to along each side; at one sample only the DC coefficients are kept
+	const int32 BlockSize = 8 >> FMath::Clamp(ScaleShift, 0, MaxScaleShift);
+	const bool bDCOnly = BlockSize == 1;
+	const int32 CoefficientsPerBlock = bDCOnly ? 1 : 64;
+	const FIntPoint Size = GetScaledSize(FMath::Clamp(ScaleShift, 0, MaxScaleShift));
+
+	const int32 McuHeight = BlockSize * MaxV;
+	const int32 McuRowsPerBand = FMath::Max(FMath::DivideAndRoundUp(BandHeight, McuHeight), 1);
+	const int32 CoefficientsPerMcuRow = McusX * BlocksPerMcu * CoefficientsPerBlock;
+
+	TArray<int16> Coefficients;
+	Coefficients.SetNumUninitialized(McuRowsPerBand * CoefficientsPerMcuRow);
+
+	// Samples of each component for the rows of one band, at the component's own resolution
+	TArray<TArray<uint8>, TInlineAllocator<3>> Planes;
+	TArray<int32, TInlineAllocator<3>> PlaneStrides;
+	for (const FComponent& Component : Components)
+	{
+		PlaneStrides.Add(Component.BlocksX * BlockSize);
+		Planes.AddDefaulted_GetRef().SetNumUninitialized(PlaneStrides.Last() * McuRowsPerBand * Component.V * BlockSize);
+	}
+
+	TArray<uint8> Pixels;
+	Pixels.SetNumUninitialized(int64(Size.X) * McuRowsPerBand * McuHeight * 4);
+
+	for (int32 FirstMcuRow = 0; FirstMcuRow < McusY; FirstMcuRow += McuRowsPerBand)
+	{
+		const int32 NumMcuRows = FMath::Min(McuRowsPerBand, McusY - FirstMcuRow);
+		for (int32 Mcu = 0; Mcu < NumMcuRows * McusX; ++Mcu)
+		{
+			if (!DecodeMcu(Coefficients.GetData() + Mcu * BlocksPerMcu * CoefficientsPerBlock, bDCOnly))
+			{
+				UE_LOG(LogRovrImaging, Warning, TEXT("Corrupt JPEG data at MCU %d,%d"), Mcu % McusX, FirstMcuRow + Mcu / McusX);
+				return false;
+			}
+		}
+
+		const int32 FirstRow = FirstMcuRow * McuHeight;
+		const int32 NumRows = FMath::Min(NumMcuRows * McuHeight, Size.Y - FirstRow);
+
+		ParallelFor(NumMcuRows, [this, &Coefficients, &Planes, &PlaneStrides, &Pixels, CoefficientsPerMcuRow, CoefficientsPerBlock, BlockSize, McuHeight, NumRows, &Size](int32 McuRow)
+		{
+			const int16* Block = Coefficients.GetData() + McuRow * CoefficientsPerMcuRow;
+			for (int32 McuX = 0; McuX < McusX; ++McuX)
+			{
+				for (int32 Index = 0; Index < Components.Num(); ++Index)
+				{
+					const FComponent& Component = Components[Index];
+					const int32 Stride = PlaneStrides[Index];
+					uint8* McuSamples = Planes[Index].GetData() + McuRow * Component.V * BlockSize * Stride + McuX * Component.H * BlockSize;
+					for (int32 BlockY = 0; BlockY < Component.V; ++BlockY)
+					{
+						for (int32 BlockX = 0; BlockX < Component.H; ++BlockX, Block += CoefficientsPerBlock)
+						{
+							uint8* BlockSamples = McuSamples + BlockY * BlockSize * Stride + BlockX * BlockSize;
+							if (BlockSize == 8)
+							{
+								InverseDct(Block, QuantTables[Component.QuantTable], BlockSamples, Stride);
+							}
+							else
+							{
+								InverseDctReduced(Block, QuantTables[Component.QuantTable], BlockSize, BlockSamples, Stride);
+							}
+						}
+					}
+				}
+			}
+
+			TArray<uint8> Upsampled;
+			Upsampled.SetNumUninitialized(Size.X * Components.Num());
+			const uint8* Rows[3];
+
+			const int32 LastRow = FMath::Min((McuRow + 1) * McuHeight, NumRows);
+			for (int32 Y = McuRow * McuHeight; Y < LastRow; ++Y)
+			{
+				for (int32 Index = 0; Index < Components.Num(); ++Index)
+				{
+					const FComponent& Component = Components[Index];
+					const uint8* Row = Planes[Index].GetData() + (Y * Component.V / MaxV) * PlaneStrides[Index];
+					if (Component.H == MaxH)
+					{
+						Rows[Index] = Row;
+					}
+					else
+					{
+						uint8* Out = Upsampled.GetData() + Index * Size.X;
+						UpsampleRow(Row, MaxH / Component.H, Size.X, Out);
+						Rows[Index] = Out;
+					}
+				}
+
+				ConvertRow(Rows, Components.Num(), Size.X, Pixels.GetData() + int64(Y) * Size.X * 4);
+			}
+		});
+
+		if (!OnBand(Pixels.GetData(), FirstRow, NumRows))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
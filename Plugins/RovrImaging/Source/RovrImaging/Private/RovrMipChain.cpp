@@ -0,0 +1,263 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RovrMipChain.h"
+#include "Async/ParallelFor.h"
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS_NEON
+#define ROVR_MIP_CHAIN_NEON 1
+#include <arm_neon.h>
+#elif PLATFORM_ENABLE_VECTORINTRINSICS && PLATFORM_CPU_X86_FAMILY
+#define ROVR_MIP_CHAIN_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#ifndef ROVR_MIP_CHAIN_NEON
+#define ROVR_MIP_CHAIN_NEON 0
+#endif
+#ifndef ROVR_MIP_CHAIN_SSE2
+#define ROVR_MIP_CHAIN_SSE2 0
+#endif
+
+
+namespace
+{
+	/** Below this many destination pixels a level is computed on the calling thread */
+	const int64 MinPixelsForParallelDownsample = 128 * 128;
+
+	/** Destination pixels computed per task */
+	const int64 PixelsPerTask = 64 * 1024;
+
+	/** Taps of the Kaiser filter per axis; the weights are the same for every texel of a 2x reduction */
+	const int32 KaiserTaps = 8;
+	const float KaiserAlpha = 4.0f;
+
+	/** Splits the rows of a destination image over worker threads when it is large enough */
+	template <typename RowsFunctionType>
+	void ForEachRowBand(int32 Width, int32 Height, RowsFunctionType&& ProcessRows)
+	{
+		if (int64(Width) * Height < MinPixelsForParallelDownsample)
+		{
+			ProcessRows(0, Height);
+			return;
+		}
+
+		const int32 RowsPerTask = int32(FMath::Max<int64>(1, PixelsPerTask / Width));
+		ParallelFor(FMath::DivideAndRoundUp(Height, RowsPerTask), [&](int32 Task)
+		{
+			const int32 FirstRow = Task * RowsPerTask;
+			ProcessRows(FirstRow, FMath::Min(FirstRow + RowsPerTask, Height));
+		});
+	}
+
+	/** Average 2x2 blocks of two source rows into one destination row; returns how many texels were done */
+	int32 BoxRowVector(const uint8* Row0, const uint8* Row1, uint8* Dest, int32 DestWidth)
+	{
+		int32 X = 0;
+#if ROVR_MIP_CHAIN_SSE2
+		const __m128i Zero = _mm_setzero_si128();
+		const __m128i Rounding = _mm_set1_epi16(2);
+		for (; X + 2 <= DestWidth; X += 2)
+		{
+			// Four source texels per row make two destination texels
+			const __m128i Top = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Row0 + X * 8));
+			const __m128i Bottom = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Row1 + X * 8));
+
+			const __m128i Low = _mm_add_epi16(_mm_unpacklo_epi8(Top, Zero), _mm_unpacklo_epi8(Bottom, Zero));
+			const __m128i High = _mm_add_epi16(_mm_unpackhi_epi8(Top, Zero), _mm_unpackhi_epi8(Bottom, Zero));
+
+			// Pair the horizontal neighbours: texels 0 + 1 and 2 + 3
+			const __m128i Sum = _mm_add_epi16(_mm_unpacklo_epi64(Low, High), _mm_unpackhi_epi64(Low, High));
+			const __m128i Average = _mm_srli_epi16(_mm_add_epi16(Sum, Rounding), 2);
+
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(Dest + X * 4), _mm_packus_epi16(Average, Zero));
+		}
+#elif ROVR_MIP_CHAIN_NEON
+		for (; X + 2 <= DestWidth; X += 2)
+		{
+			const uint8x16_t Top = vld1q_u8(Row0 + X * 8);
+			const uint8x16_t Bottom = vld1q_u8(Row1 + X * 8);
+
+			const uint16x8_t Low = vaddl_u8(vget_low_u8(Top), vget_low_u8(Bottom));
+			const uint16x8_t High = vaddl_u8(vget_high_u8(Top), vget_high_u8(Bottom));
+
+			const uint16x8_t Sum = vcombine_u16(vadd_u16(vget_low_u16(Low), vget_high_u16(Low)), vadd_u16(vget_low_u16(High), vget_high_u16(High)));
+
+			// Rounding narrowing shift computes (Sum + 2) >> 2
+			vst1_u8(Dest + X * 4, vrshrn_n_u16(Sum, 2));
+		}
+#endif
+		return X;
+	}
+
+	void DownsampleBox(const uint8* Source, int64 SourceStride, int32 Width, int32 Height, uint8* Dest, int32 DestWidth, int32 DestHeight)
+	{
+		ForEachRowBand(DestWidth, DestHeight, [&](int32 FirstRow, int32 EndRow)
+		{
+			for (int32 Y = FirstRow; Y < EndRow; ++Y)
+			{
+				const uint8* Row0 = Source + FMath::Min(Y * 2, Height - 1) * SourceStride;
+				const uint8* Row1 = Source + FMath::Min(Y * 2 + 1, Height - 1) * SourceStride;
+				uint8* DestRow = Dest + int64(Y) * DestWidth * 4;
+
+				// A one texel wide source has no horizontal neighbour to pair with
+				const int32 Done = Width >= 2 ? BoxRowVector(Row0, Row1, DestRow, DestWidth) : 0;
+
+				for (int32 X = Done; X < DestWidth; ++X)
+				{
+					const int32 X0 = FMath::Min(X * 2, Width - 1) * 4;
+					const int32 X1 = FMath::Min(X * 2 + 1, Width - 1) * 4;
+					for (int32 Channel = 0; Channel < 4; ++Channel)
+					{
+						DestRow[X * 4 + Channel] = uint8((Row0[X0 + Channel] + Row0[X1 + Channel] + Row1[X0 + Channel] + Row1[X1 + Channel] + 2) >> 2);
+					}
+				}
+			}
+		});
+	}
+
+	float BesselI0(float X)
+	{
+		float Sum = 1.0f;
+		float Term = 1.0f;
+		for (int32 K = 1; K < 20; ++K)
+		{
+			Term *= (X / (2.0f * K)) * (X / (2.0f * K));
+			Sum += Term;
+		}
+		return Sum;
+	}
+
+	/** Normalized weights of the source texels 2x - 3 .. 2x + 4 contributing to destination texel x */
+	void ComputeKaiserWeights(float (&OutWeights)[KaiserTaps])
+	{
+		const float Radius = KaiserTaps / 4.0f;
+
+		float Total = 0.0f;
+		for (int32 Tap = 0; Tap < KaiserTaps; ++Tap)
+		{
+			// Distance from the destination texel center in destination texels
+			const float T = ((Tap - KaiserTaps / 2 + 1) + 0.5f - 1.0f) / 2.0f;
+
+			const float Sinc = FMath::IsNearlyZero(T) ? 1.0f : FMath::Sin(PI * T) / (PI * T);
+			const float Ratio = FMath::Clamp(T / Radius, -1.0f, 1.0f);
+			const float Window = BesselI0(KaiserAlpha * FMath::Sqrt(1.0f - Ratio * Ratio)) / BesselI0(KaiserAlpha);
+
+			OutWeights[Tap] = Sinc * Window;
+			Total += OutWeights[Tap];
+		}
+
+		for (float& Weight : OutWeights)
+		{
+			Weight /= Total;
+		}
+	}
+
+	void DownsampleKaiser(const uint8* Source, int64 SourceStride, int32 Width, int32 Height, uint8* Dest, int32 DestWidth, int32 DestHeight)
+	{
+		float Weights[KaiserTaps];
+		ComputeKaiserWeights(Weights);
+
+		// Horizontal pass into floats, keeping every source row
+		TArray<float> Horizontal;
+		Horizontal.SetNumUninitialized(DestWidth * Height * 4);
+
+		ForEachRowBand(DestWidth, Height, [&](int32 FirstRow, int32 EndRow)
+		{
+			for (int32 Y = FirstRow; Y < EndRow; ++Y)
+			{
+				const uint8* Row = Source + Y * SourceStride;
+				float* Out = &Horizontal[(Y * DestWidth) * 4];
+
+				for (int32 X = 0; X < DestWidth; ++X, Out += 4)
+				{
+					float Sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+					for (int32 Tap = 0; Tap < KaiserTaps; ++Tap)
+					{
+						const uint8* Texel = Row + FMath::Clamp(X * 2 - KaiserTaps / 2 + 1 + Tap, 0, Width - 1) * 4;
+						for (int32 Channel = 0; Channel < 4; ++Channel)
+						{
+							Sum[Channel] += Weights[Tap] * Texel[Channel];
+						}
+					}
+					FMemory::Memcpy(Out, Sum, sizeof(Sum));
+				}
+			}
+		});
+
+		ForEachRowBand(DestWidth, DestHeight, [&](int32 FirstRow, int32 EndRow)
+		{
+			for (int32 Y = FirstRow; Y < EndRow; ++Y)
+			{
+				uint8* Out = Dest + int64(Y) * DestWidth * 4;
+
+				for (int32 X = 0; X < DestWidth; ++X)
+				{
+					float Sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+					for (int32 Tap = 0; Tap < KaiserTaps; ++Tap)
+					{
+						const float* Texel = &Horizontal[(FMath::Clamp(Y * 2 - KaiserTaps / 2 + 1 + Tap, 0, Height - 1) * DestWidth + X) * 4];
+						for (int32 Channel = 0; Channel < 4; ++Channel)
+						{
+							Sum[Channel] += Weights[Tap] * Texel[Channel];
+						}
+					}
+
+					// The negative lobes can overshoot at hard edges
+					for (int32 Channel = 0; Channel < 4; ++Channel)
+					{
+						Out[X * 4 + Channel] = uint8(FMath::Clamp(FMath::RoundToInt(Sum[Channel]), 0, 255));
+					}
+				}
+			}
+		});
+	}
+}
+
+int32 RovrMipChain::GetNumMips(int32 Width, int32 Height)
+{
+	return FMath::FloorLog2(uint32(FMath::Max(FMath::Max(Width, Height), 1))) + 1;
+}
+
+void RovrMipChain::Downsample(const uint8* Source, int64 SourceStride, int32 Width, int32 Height, uint8* Dest, ERovrMipFilter Filter)
+{
+	const int32 DestWidth = FMath::Max(Width / 2, 1);
+	const int32 DestHeight = FMath::Max(Height / 2, 1);
+
+	if (Filter == ERovrMipFilter::Kaiser)
+	{
+		DownsampleKaiser(Source, SourceStride, Width, Height, Dest, DestWidth, DestHeight);
+	}
+	else
+	{
+		DownsampleBox(Source, SourceStride, Width, Height, Dest, DestWidth, DestHeight);
+	}
+}
+
+void RovrMipChain::Generate(const uint8* Base, int64 Stride, int32 Width, int32 Height, ERovrMipFilter Filter, TArray<TArray<uint8>>& OutMips)
+{
+	OutMips.Reset();
+	if (Filter == ERovrMipFilter::None || Width <= 0 || Height <= 0)
+	{
+		return;
+	}
+
+	const int32 NumMips = GetNumMips(Width, Height);
+	OutMips.Reserve(NumMips - 1);
+
+	const uint8* Source = Base;
+	int64 SourceStride = Stride;
+	for (int32 Mip = 1; Mip < NumMips; ++Mip)
+	{
+		const int32 DestWidth = FMath::Max(Width / 2, 1);
+		const int32 DestHeight = FMath::Max(Height / 2, 1);
+
+		TArray<uint8>& Dest = OutMips.AddDefaulted_GetRef();
+		Dest.SetNumUninitialized(DestWidth * DestHeight * 4);
+		Downsample(Source, SourceStride, Width, Height, Dest.GetData(), Filter);
+
+		Source = Dest.GetData();
+		SourceStride = int64(DestWidth) * 4;
+		Width = DestWidth;
+		Height = DestHeight;
+	}
+}
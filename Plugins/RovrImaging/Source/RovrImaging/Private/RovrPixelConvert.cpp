@@ -0,0 +1,243 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RovrPixelConvert.h"
+#include "Async/ParallelFor.h"
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS_NEON
+#define ROVR_PIXEL_CONVERT_NEON 1
+#include <arm_neon.h>
+#elif PLATFORM_ENABLE_VECTORINTRINSICS && PLATFORM_CPU_X86_FAMILY
+#define ROVR_PIXEL_CONVERT_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#ifndef ROVR_PIXEL_CONVERT_NEON
+#define ROVR_PIXEL_CONVERT_NEON 0
+#endif
+#ifndef ROVR_PIXEL_CONVERT_SSE2
+#define ROVR_PIXEL_CONVERT_SSE2 0
+#endif
+
+
+namespace
+{
+	/** Below this many pixels an image is converted on the calling thread */
+	const int64 MinPixelsForParallelConvert = 512 * 512;
+
+	/** Pixels converted per task when an image is split over worker threads */
+	const int64 PixelsPerTask = 256 * 1024;
+
+	/** Alpha of a BGRA8 or RGBA8 pixel loaded as a little endian 32 bit integer */
+	const uint32 AlphaMask = 0xFF000000u;
+
+	/** Bytes holding green and alpha of an RGBA8 or BGRA8 pixel loaded as a little endian 32 bit integer */
+	const uint32 GreenAlphaMask = 0xFF00FF00u;
+
+	template <ERovrPixelLayout Layout>
+	void ConvertScalar(const uint8* Source, uint8* Dest, int64 NumPixels, bool bForceOpaque)
+	{
+		for (int64 Index = 0; Index < NumPixels; ++Index, Source += 4, Dest += 4)
+		{
+			uint8 B, G, R, A;
+			if (Layout == ERovrPixelLayout::BGRA8)
+			{
+				B = Source[0]; G = Source[1]; R = Source[2]; A = Source[3];
+			}
+			else if (Layout == ERovrPixelLayout::RGBA8)
+			{
+				R = Source[0]; G = Source[1]; B = Source[2]; A = Source[3];
+			}
+			else
+			{
+				uint32 Pixel;
+				FMemory::Memcpy(&Pixel, Source, sizeof(Pixel));
+				A = uint8(Pixel >> 24); R = uint8(Pixel >> 16); G = uint8(Pixel >> 8); B = uint8(Pixel);
+			}
+
+			Dest[0] = B;
+			Dest[1] = G;
+			Dest[2] = R;
+			Dest[3] = bForceOpaque ? 0xFF : A;
+		}
+	}
+
+	/** Copy pixels whose bytes are already in BGRA order, setting alpha; returns how many were done */
+	int64 CopyOpaqueVector(const uint8* Source, uint8* Dest, int64 NumPixels)
+	{
+		int64 Index = 0;
+#if ROVR_PIXEL_CONVERT_SSE2
+		const __m128i Alpha = _mm_set1_epi32(int32(AlphaMask));
+		for (; Index + 4 <= NumPixels; Index += 4)
+		{
+			const __m128i Pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Source + Index * 4));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(Dest + Index * 4), _mm_or_si128(Pixels, Alpha));
+		}
+#elif ROVR_PIXEL_CONVERT_NEON
+		const uint32x4_t Alpha = vdupq_n_u32(AlphaMask);
+		for (; Index + 4 <= NumPixels; Index += 4)
+		{
+			const uint32x4_t Pixels = vreinterpretq_u32_u8(vld1q_u8(Source + Index * 4));
+			vst1q_u8(Dest + Index * 4, vreinterpretq_u8_u32(vorrq_u32(Pixels, Alpha)));
+		}
+#endif
+		return Index;
+	}
+
+	/** Swap red and blue, optionally setting alpha; returns how many pixels were done */
+	int64 SwapRedBlueVector(const uint8* Source, uint8* Dest, int64 NumPixels, bool bForceOpaque)
+	{
+		int64 Index = 0;
+#if ROVR_PIXEL_CONVERT_SSE2
+		const __m128i GreenAlpha = _mm_set1_epi32(int32(GreenAlphaMask));
+		const __m128i Alpha = _mm_set1_epi32(bForceOpaque ? int32(AlphaMask) : 0);
+		for (; Index + 4 <= NumPixels; Index += 4)
+		{
+			const __m128i Pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Source + Index * 4));
+
+			// 0x00BB00RR per pixel; moving each channel 16 bits swaps them
+			const __m128i RedBlue = _mm_andnot_si128(GreenAlpha, Pixels);
+			const __m128i Swapped = _mm_or_si128(_mm_slli_epi32(RedBlue, 16), _mm_srli_epi32(RedBlue, 16));
+
+			const __m128i Result = _mm_or_si128(_mm_or_si128(_mm_and_si128(Pixels, GreenAlpha), Swapped), Alpha);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(Dest + Index * 4), Result);
+		}
+#elif ROVR_PIXEL_CONVERT_NEON
+		const uint8x16_t Opaque = vdupq_n_u8(0xFF);
+		for (; Index + 16 <= NumPixels; Index += 16)
+		{
+			// De-interleaves the channels of 16 pixels, so the swap is a register rename
+			const uint8x16x4_t Pixels = vld4q_u8(Source + Index * 4);
+
+			uint8x16x4_t Result;
+			Result.val[0] = Pixels.val[2];
+			Result.val[1] = Pixels.val[1];
+			Result.val[2] = Pixels.val[0];
+			Result.val[3] = bForceOpaque ? Opaque : Pixels.val[3];
+			vst4q_u8(Dest + Index * 4, Result);
+		}
+#endif
+		return Index;
+	}
+}
+
+void RovrPixelConvert::ConvertRow(const void* Source, ERovrPixelLayout SourceLayout, uint8* Dest, int64 NumPixels, bool bForceOpaque)
+{
+	const uint8* SourceBytes = static_cast<const uint8*>(Source);
+
+	int64 Done = 0;
+
+	switch (SourceLayout)
+	{
+	case ERovrPixelLayout::BGRA8:
+#if PLATFORM_LITTLE_ENDIAN
+	case ERovrPixelLayout::ARGB32:
+		// 0xAARRGGBB stored little endian is B, G, R, A
+#endif
+		if (!bForceOpaque)
+		{
+			if (SourceBytes != Dest)
+			{
+				FMemory::Memcpy(Dest, SourceBytes, NumPixels * 4);
+			}
+			return;
+		}
+		Done = CopyOpaqueVector(SourceBytes, Dest, NumPixels);
+		ConvertScalar<ERovrPixelLayout::BGRA8>(SourceBytes + Done * 4, Dest + Done * 4, NumPixels - Done, true);
+		break;
+
+	case ERovrPixelLayout::RGBA8:
+		Done = SwapRedBlueVector(SourceBytes, Dest, NumPixels, bForceOpaque);
+		ConvertScalar<ERovrPixelLayout::RGBA8>(SourceBytes + Done * 4, Dest + Done * 4, NumPixels - Done, bForceOpaque);
+		break;
+
+	default:
+		ConvertScalar<ERovrPixelLayout::ARGB32>(SourceBytes, Dest, NumPixels, bForceOpaque);
+		break;
+	}
+}
+
+void RovrPixelConvert::ConvertImage(const void* Source, ERovrPixelLayout SourceLayout, int64 SourceStride, uint8* Dest, int64 DestStride, int32 Width, int32 Height, ERovrPixelConvertFlags Flags)
+{
+	if (Width <= 0 || Height <= 0)
+	{
+		return;
+	}
+
+	const uint8* SourceBytes = static_cast<const uint8*>(Source);
+	const bool bForceOpaque = EnumHasAnyFlags(Flags, ERovrPixelConvertFlags::ForceOpaque);
+	const bool bFlip = EnumHasAnyFlags(Flags, ERovrPixelConvertFlags::FlipVertically);
+
+	// Converting row y into row Height - 1 - y in place would overwrite rows that are still to be read
+	if (bFlip && SourceBytes == Dest)
+	{
+		ConvertImage(Source, SourceLayout, SourceStride, Dest, DestStride, Width, Height, Flags & ~ERovrPixelConvertFlags::FlipVertically);
+		FlipVertically(Dest, DestStride, Height);
+		return;
+	}
+
+	auto ConvertRows = [&](int32 FirstRow, int32 EndRow)
+	{
+		for (int32 Row = FirstRow; Row < EndRow; ++Row)
+		{
+			const int32 DestRow = bFlip ? Height - 1 - Row : Row;
+			ConvertRow(SourceBytes + Row * SourceStride, SourceLayout, Dest + DestRow * DestStride, Width, bForceOpaque);
+		}
+	};
+
+	if (int64(Width) * Height < MinPixelsForParallelConvert)
+	{
+		ConvertRows(0, Height);
+		return;
+	}
+
+	const int32 RowsPerTask = int32(FMath::Max<int64>(1, PixelsPerTask / Width));
+	const int32 NumTasks = FMath::DivideAndRoundUp(Height, RowsPerTask);
+
+	ParallelFor(NumTasks, [&](int32 Task)
+	{
+		const int32 FirstRow = Task * RowsPerTask;
+		ConvertRows(FirstRow, FMath::Min(FirstRow + RowsPerTask, Height));
+	});
+}
+
+bool RovrPixelConvert::IsOpaque(const void* Source, ERovrPixelLayout SourceLayout, int64 SourceStride, int32 Width, int32 Height)
+{
+	// Alpha is the fourth byte of every layout, except for ARGB32 on big endian machines
+	const int32 AlphaOffset = (SourceLayout == ERovrPixelLayout::ARGB32 && !PLATFORM_LITTLE_ENDIAN) ? 0 : 3;
+
+	const uint8* SourceBytes = static_cast<const uint8*>(Source);
+	for (int32 Row = 0; Row < Height; ++Row)
+	{
+		const uint8* Alpha = SourceBytes + Row * SourceStride + AlphaOffset;
+
+		// ANDing the whole row keeps the loop free of branches
+		uint8 Combined = 0xFF;
+		for (int32 Index = 0; Index < Width; ++Index)
+		{
+			Combined &= Alpha[Index * 4];
+		}
+		if (Combined != 0xFF)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void RovrPixelConvert::SetOpaque(uint8* Pixels, int64 NumPixels)
+{
+	// Alpha is the fourth byte in both layouts, so the BGRA path serves RGBA as well
+	const int64 Done = CopyOpaqueVector(Pixels, Pixels, NumPixels);
+	for (int64 Index = Done; Index < NumPixels; ++Index)
+	{
+		Pixels[Index * 4 + 3] = 0xFF;
+	}
+}
+
+void RovrPixelConvert::FlipVertically(uint8* Pixels, int64 Stride, int32 Height)
+{
+	for (int32 Row = 0; Row < Height / 2; ++Row)
+	{
+		FMemory::Memswap(Pixels + Row * Stride, Pixels + (Height - 1 - Row) * Stride, Stride);
+	}
+}
@@ -0,0 +1,415 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RovrPngDecoder.h"
+#include "RovrImagingDefines.h"
+
+THIRD_PARTY_INCLUDES_START
+#include "zlib.h"
+THIRD_PARTY_INCLUDES_END
+
+
+namespace
+{
+	const uint8 Signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+	/** Passes an interlaced image needs for each ScaleShift: all seven at full size, only the first at an eighth */
+	const int32 PassesForScaleShift[4] = { 7, 5, 3, 1 };
+
+	FORCEINLINE uint32 ReadUint32(const uint8* Bytes)
+	{
+		return (uint32(Bytes[0]) << 24) | (uint32(Bytes[1]) << 16) | (uint32(Bytes[2]) << 8) | Bytes[3];
+	}
+
+	FORCEINLINE uint16 ReadUint16(const uint8* Bytes)
+	{
+		return uint16((Bytes[0] << 8) | Bytes[1]);
+	}
+
+	FORCEINLINE uint32 IdFromChars(char A, char B, char C, char D)
+	{
+		return (uint32(uint8(A)) << 24) | (uint32(uint8(B)) << 16) | (uint32(uint8(C)) << 8) | uint8(D);
+	}
+
+	/** Sample Index of a row of Depth bit samples, packed from the most significant bit */
+	FORCEINLINE uint32 ReadSample(const uint8* Row, int32 Index, int32 Depth)
+	{
+		if (Depth == 8)
+		{
+			return Row[Index];
+		}
+		if (Depth == 16)
+		{
+			return ReadUint16(Row + Index * 2);
+		}
+
+		const int32 Bit = Index * Depth;
+		return (Row[Bit >> 3] >> (8 - Depth - (Bit & 7))) & ((1 << Depth) - 1);
+	}
+
+	FORCEINLINE uint8 SampleToByte(uint32 Value, int32 Depth)
+	{
+		if (Depth == 8)
+		{
+			return uint8(Value);
+		}
+		if (Depth == 16)
+		{
+			return uint8(Value >> 8);
+		}
+		return uint8(Value * 255 / ((1 << Depth) - 1));
+	}
+
+	FORCEINLINE uint8 Paeth(int32 Left, int32 Up, int32 UpLeft)
+	{
+		const int32 Estimate = Left + Up - UpLeft;
+		const int32 DistanceLeft = FMath::Abs(Estimate - Left);
+		const int32 DistanceUp = FMath::Abs(Estimate - Up);
+		const int32 DistanceUpLeft = FMath::Abs(Estimate - UpLeft);
+		if (DistanceLeft <= DistanceUp && DistanceLeft <= DistanceUpLeft)
+		{
+			return uint8(Left);
+		}
+		return uint8(DistanceUp <= DistanceUpLeft ? Up : UpLeft);
+	}
+
+	/**
+	 * Undo the filter of one row in place
+	 *
+	 * @param Previous The row above, already unfiltered, or nullptr for the first row of a pass
+	 * @param PixelBytes Bytes per pixel, at least 1, that the filters look back by
+	 */
+	bool UnfilterRow(uint8 Filter, uint8* Row, const uint8* Previous, int32 NumBytes, int32 PixelBytes)
+	{
+		switch (Filter)
+		{
+		case 0:
+			return true;
+
+		case 1:
+			for (int32 Index = PixelBytes; Index < NumBytes; ++Index)
+			{
+				Row[Index] += Row[Index - PixelBytes];
+			}
+			return true;
+
+		case 2:
+			if (Previous)
+			{
+				for (int32 Index = 0; Index < NumBytes; ++Index)
+				{
+					Row[Index] += Previous[Index];
+				}
+			}
+			return true;
+
+		case 3:
+			for (int32 Index = 0; Index < NumBytes; ++Index)
+			{
+				const int32 Left = Index >= PixelBytes ? Row[Index - PixelBytes] : 0;
+				const int32 Up = Previous ? Previous[Index] : 0;
+				Row[Index] += uint8((Left + Up) >> 1);
+			}
+			return true;
+
+		case 4:
+			for (int32 Index = 0; Index < NumBytes; ++Index)
+			{
+				const int32 Left = Index >= PixelBytes ? Row[Index - PixelBytes] : 0;
+				const int32 Up = Previous ? Previous[Index] : 0;
+				const int32 UpLeft = Previous && Index >= PixelBytes ? Previous[Index - PixelBytes] : 0;
+				Row[Index] += Paeth(Left, Up, UpLeft);
+			}
+			return true;
+
+		default:
+			return false;
+		}
+	}
+}
+
+bool FRovrPngDecoder::Open(TArrayView<const uint8> InData)
+{
+	Data = InData;
+	ImageData.Reset();
+	Palette.Reset();
+	Width = 0;
+	Height = 0;
+	bHasColorKey = false;
+
+	const uint8* Bytes = Data.GetData();
+	const int64 Size = Data.Num();
+	if (Size < 8 || FMemory::Memcmp(Bytes, Signature, 8) != 0)
+	{
+		return false;
+	}
+
+	int64 Position = 8;
+	while (Position + 12 <= Size)
+	{
+		const int64 Length = ReadUint32(Bytes + Position);
+		const uint32 Id = ReadUint32(Bytes + Position + 4);
+		if (Position + 12 + Length > Size)
+		{
+			return false;
+		}
+
+		const uint8* Chunk = Bytes + Position + 8;
+		if (Id == IdFromChars('I', 'H', 'D', 'R'))
+		{
+			if (Length < 13)
+			{
+				return false;
+			}
+
+			Width = int32(ReadUint32(Chunk));
+			Height = int32(ReadUint32(Chunk + 4));
+			BitDepth = Chunk[8];
+			ColorType = Chunk[9];
+			bInterlaced = Chunk[12] == 1;
+			if (Width <= 0 || Height <= 0 || Chunk[10] != 0 || Chunk[11] != 0 || Chunk[12] > 1)
+			{
+				return false;
+			}
+
+			// Grey allows every depth, palettes up to 8 bits, the others 8 or 16
+			const bool bValidDepth = ColorType == 0 ? FMath::IsPowerOfTwo(BitDepth) && BitDepth <= 16
+				: ColorType == 3 ? FMath::IsPowerOfTwo(BitDepth) && BitDepth <= 8
+				: BitDepth == 8 || BitDepth == 16;
+			static const int32 ChannelsPerType[7] = { 1, 0, 3, 1, 2, 0, 4 };
+			NumChannels = ColorType <= 6 ? ChannelsPerType[ColorType] : 0;
+			if (!bValidDepth || NumChannels == 0)
+			{
+				return false;
+			}
+		}
+		else if (Width == 0)
+		{
+			// IHDR has to come first
+			return false;
+		}
+		else if (Id == IdFromChars('P', 'L', 'T', 'E'))
+		{
+			const int32 NumEntries = FMath::Min(int32(Length / 3), 256);
+			Palette.SetNumUninitialized(NumEntries * 4);
+			for (int32 Entry = 0; Entry < NumEntries; ++Entry)
+			{
+				Palette[Entry * 4 + 0] = Chunk[Entry * 3 + 2];
+				Palette[Entry * 4 + 1] = Chunk[Entry * 3 + 1];
+				Palette[Entry * 4 + 2] = Chunk[Entry * 3 + 0];
+				Palette[Entry * 4 + 3] = 255;
+			}
+		}
+		else if (Id == IdFromChars('t', 'R', 'N', 'S'))
+		{
+			if (ColorType == 3)
+			{
+				for (int32 Entry = 0; Entry < FMath::Min(int32(Length), Palette.Num() / 4); ++Entry)
+				{
+					Palette[Entry * 4 + 3] = Chunk[Entry];
+				}
+			}
+			else if ((ColorType == 0 && Length >= 2) || (ColorType == 2 && Length >= 6))
+			{
+				bHasColorKey = true;
+				for (int32 Channel = 0; Channel < NumChannels; ++Channel)
+				{
+					ColorKey[Channel] = ReadUint16(Chunk + Channel * 2);
+				}
+			}
+		}
+		else if (Id == IdFromChars('I', 'D', 'A', 'T'))
+		{
+			ImageData.Add(TArrayView<const uint8>(Chunk, Length));
+		}
+		else if (Id == IdFromChars('I', 'E', 'N', 'D'))
+		{
+			break;
+		}
+
+		Position += 12 + Length;
+	}
+
+	return ImageData.Num() > 0 && (ColorType != 3 || Palette.Num() > 0);
+}
+
+bool FRovrPngDecoder::Decode(TArray<uint8>& OutPixels, int32 ScaleShift)
+{
+	if (ImageData.Num() == 0)
+	{
+		return false;
+	}
+
+	ScaleShift = FMath::Clamp(ScaleShift, 0, GetMaxScaleShift());
+
+	static const FPass Adam7[7] =
+	{
+		{ 0, 0, 8, 8 }, { 4, 0, 8, 8 }, { 0, 4, 4, 8 }, { 2, 0, 4, 4 }, { 0, 2, 2, 4 }, { 1, 0, 2, 2 }, { 0, 1, 1, 2 }
+	};
+	static const FPass WholeImage = { 0, 0, 1, 1 };
+
+	const FPass* Passes = bInterlaced ? Adam7 : &WholeImage;
+	const int32 NumPasses = bInterlaced ? PassesForScaleShift[ScaleShift] : 1;
+	const int32 BitsPerPixel = NumChannels * BitDepth;
+	const int32 PixelBytes = FMath::Max(BitsPerPixel / 8, 1);
+
+	// The passes needed come first in the stream; only they are inflated
+	int32 PassWidths[7];
+	int32 PassHeights[7];
+	int64 PassOffsets[7];
+	int64 NumBytes = 0;
+	for (int32 Pass = 0; Pass < NumPasses; ++Pass)
+	{
+		const FPass& Grid = Passes[Pass];
+		PassWidths[Pass] = Width > Grid.StartX ? (Width - Grid.StartX + Grid.StepX - 1) / Grid.StepX : 0;
+		PassHeights[Pass] = Height > Grid.StartY ? (Height - Grid.StartY + Grid.StepY - 1) / Grid.StepY : 0;
+		PassOffsets[Pass] = NumBytes;
+
+		// Empty passes store no rows at all, not even filter bytes
+		if (PassWidths[Pass] > 0)
+		{
+			NumBytes += PassHeights[Pass] * (1 + (int64(PassWidths[Pass]) * BitsPerPixel + 7) / 8);
+		}
+	}
+
+	if (NumBytes > MAX_int32)
+	{
+		UE_LOG(LogRovrImaging, Warning, TEXT("PNG image of %dx%d is too large to decode"), Width, Height);
+		return false;
+	}
+
+	TArray<uint8> Filtered;
+	Filtered.SetNumUninitialized(NumBytes);
+
+	z_stream Stream;
+	FMemory::Memzero(Stream);
+	if (inflateInit(&Stream) != Z_OK)
+	{
+		return false;
+	}
+
+	Stream.next_out = Filtered.GetData();
+	Stream.avail_out = uInt(NumBytes);
+	for (const TArrayView<const uint8>& Chunk : ImageData)
+	{
+		Stream.next_in = const_cast<Bytef*>(Chunk.GetData());
+		Stream.avail_in = uInt(Chunk.Num());
+
+		const int32 Result = inflate(&Stream, Z_SYNC_FLUSH);
+		if (Stream.avail_out == 0 || Result == Z_STREAM_END)
+		{
+			break;
+		}
+		if (Result != Z_OK && Result != Z_BUF_ERROR)
+		{
+			break;
+		}
+	}
+	const bool bInflated = Stream.avail_out == 0;
+	inflateEnd(&Stream);
+
+	if (!bInflated)
+	{
+		UE_LOG(LogRovrImaging, Warning, TEXT("Corrupt or truncated PNG data"));
+		return false;
+	}
+
+	const FIntPoint Size = GetScaledSize(ScaleShift);
+	OutPixels.SetNumUninitialized(int64(Size.X) * Size.Y * 4);
+
+	for (int32 Pass = 0; Pass < NumPasses; ++Pass)
+	{
+		if (PassWidths[Pass] == 0 || PassHeights[Pass] == 0)
+		{
+			continue;
+		}
+
+		// Every pixel of the passes decoded lies on the grid of the reduced image
+		const FPass& Grid = Passes[Pass];
+		const int32 RowBytes = int32((int64(PassWidths[Pass]) * BitsPerPixel + 7) / 8);
+		const int32 OutStep = (Grid.StepX >> ScaleShift) * 4;
+
+		uint8* Row = Filtered.GetData() + PassOffsets[Pass];
+		const uint8* Previous = nullptr;
+		for (int32 PassRow = 0; PassRow < PassHeights[Pass]; ++PassRow, Row += 1 + RowBytes)
+		{
+			if (!UnfilterRow(Row[0], Row + 1, Previous, RowBytes, PixelBytes))
+			{
+				UE_LOG(LogRovrImaging, Warning, TEXT("Corrupt PNG data: unknown filter %d"), Row[0]);
+				return false;
+			}
+			Previous = Row + 1;
+
+			const int32 Y = (Grid.StartY + PassRow * Grid.StepY) >> ScaleShift;
+			uint8* Out = OutPixels.GetData() + (int64(Y) * Size.X + (Grid.StartX >> ScaleShift)) * 4;
+			ConvertRow(Row + 1, PassWidths[Pass], Out, OutStep);
+		}
+	}
+
+	return true;
+}
+
+void FRovrPngDecoder::ConvertRow(const uint8* Row, int32 NumPixels, uint8* Out, int32 OutStep) const
+{
+	switch (ColorType)
+	{
+	case 0:
+		for (int32 X = 0; X < NumPixels; ++X, Out += OutStep)
+		{
+			const uint32 Grey = ReadSample(Row, X, BitDepth);
+			Out[0] = Out[1] = Out[2] = SampleToByte(Grey, BitDepth);
+			Out[3] = bHasColorKey && Grey == ColorKey[0] ? 0 : 255;
+		}
+		break;
+
+	case 2:
+		for (int32 X = 0; X < NumPixels; ++X, Out += OutStep)
+		{
+			const uint32 Red = ReadSample(Row, X * 3, BitDepth);
+			const uint32 Green = ReadSample(Row, X * 3 + 1, BitDepth);
+			const uint32 Blue = ReadSample(Row, X * 3 + 2, BitDepth);
+			Out[0] = SampleToByte(Blue, BitDepth);
+			Out[1] = SampleToByte(Green, BitDepth);
+			Out[2] = SampleToByte(Red, BitDepth);
+			Out[3] = bHasColorKey && Red == ColorKey[0] && Green == ColorKey[1] && Blue == ColorKey[2] ? 0 : 255;
+		}
+		break;
+
+	case 3:
+	{
+		const uint32 NumEntries = uint32(Palette.Num() / 4);
+		for (int32 X = 0; X < NumPixels; ++X, Out += OutStep)
+		{
+			// Indices past the palette's end are an error libpng tolerates as black
+			const uint32 Entry = ReadSample(Row, X, BitDepth);
+			if (Entry < NumEntries)
+			{
+				FMemory::Memcpy(Out, Palette.GetData() + Entry * 4, 4);
+			}
+			else
+			{
+				Out[0] = Out[1] = Out[2] = 0;
+				Out[3] = 255;
+			}
+		}
+		break;
+	}
+
+	case 4:
+		for (int32 X = 0; X < NumPixels; ++X, Out += OutStep)
+		{
+			Out[0] = Out[1] = Out[2] = SampleToByte(ReadSample(Row, X * 2, BitDepth), BitDepth);
+			Out[3] = SampleToByte(ReadSample(Row, X * 2 + 1, BitDepth), BitDepth);
+		}
+		break;
+
+	default:
+		for (int32 X = 0; X < NumPixels; ++X, Out += OutStep)
+		{
+			Out[0] = SampleToByte(ReadSample(Row, X * 4 + 2, BitDepth), BitDepth);
+			Out[1] = SampleToByte(ReadSample(Row, X * 4 + 1, BitDepth), BitDepth);
+			Out[2] = SampleToByte(ReadSample(Row, X * 4, BitDepth), BitDepth);
+			Out[3] = SampleToByte(ReadSample(Row, X * 4 + 3, BitDepth), BitDepth);
+		}
+		break;
+	}
+}
@@ -0,0 +1,203 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RovrProgressiveImage.h"
+#include "RovrImagingDefines.h"
+#include "RovrDecodeScheduler.h"
+#include "RovrJpegDecoder.h"
+#include "RovrTexture.h"
+#include "Async/Async.h"
+#include "Engine/Texture2D.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/ThreadSafeBool.h"
+#include "HAL/ThreadSafeCounter.h"
+
+
+namespace
+{
+	TAutoConsoleVariable<int32> CVarProgressiveBandHeight(
+		TEXT("rovr.ProgressiveImage.BandHeight"),
+		256,
+		TEXT("Rows of a large JPEG decoded and uploaded to its texture at a time.\n")
+		TEXT("Smaller bands reach the screen sooner and upload in smaller steps; rounded up to whole MCU rows."),
+		ECVF_Default);
+
+	/** Bands queued for upload at most; the decoder waits for the game thread beyond that rather than holding the whole image in memory */
+	const int32 MaxBandsInFlight = 4;
+
+	/** Longest wait for an upload to finish before the decoder checks again whether to carry on */
+	const uint32 UploadWaitMs = 100;
+
+	/** State the decoding worker shares with the uploads it queues on the game thread */
+	struct FProgress
+	{
+		FProgress()
+			: UploadDone(FPlatformProcess::GetSynchEventFromPool(false))
+		{
+		}
+
+		~FProgress()
+		{
+			FPlatformProcess::ReturnSynchEventToPool(UploadDone);
+		}
+
+		/** Whether the texture was released or the decode cancelled through the scheduler */
+		bool IsStopped() const
+		{
+			return bCancelled || (bDecodeCancelled.IsValid() && *bDecodeCancelled);
+		}
+
+		TWeakObjectPtr<UTexture2D> Texture;
+		TWeakObjectPtr<UTexture2D> Preview;
+		FThreadSafeCounter BandsInFlight;
+		FThreadSafeBool bCancelled;
+
+		/** Set by FRovrDecodeScheduler::Cancel; assigned once the decode starts */
+		TSharedPtr<FThreadSafeBool, ESPMode::ThreadSafe> bDecodeCancelled;
+
+		/** Triggered by every upload, waking the decoder when it waits for room in the queue */
+		FEvent* UploadDone;
+	};
+
+	typedef TSharedRef<FProgress, ESPMode::ThreadSafe> FProgressRef;
+
+	/**
+	 * Queue rows of an image for upload into the texture or its preview, waiting while too many are queued already
+	 *
+	 * @return False once the texture has been released, which stops decoding
+	 */
+	bool QueueBand(const FProgressRef& Progress, bool bPreview, TArray<uint8>&& Pixels, int32 Width, int32 FirstRow, int32 NumRows)
+	{
+		while (Progress->BandsInFlight.GetValue() >= MaxBandsInFlight && !Progress->IsStopped())
+		{
+			// The game thread stops running tasks on exit, so the uploads this waits for may never come
+			if (IsEngineExitRequested())
+			{
+				Progress->bCancelled = true;
+				break;
+			}
+
+			Progress->UploadDone->Wait(UploadWaitMs);
+		}
+
+		if (Progress->IsStopped())
+		{
+			return false;
+		}
+
+		Progress->BandsInFlight.Increment();
+		AsyncTask(ENamedThreads::GameThread, [Progress, bPreview, Pixels = MoveTemp(Pixels), Width, FirstRow, NumRows]() mutable
+		{
+			Progress->BandsInFlight.Decrement();
+			Progress->UploadDone->Trigger();
+
+			UTexture2D* Texture = Progress->Texture.Get();
+			if (!Texture)
+			{
+				Progress->bCancelled = true;
+				return;
+			}
+
+			if (bPreview)
+			{
+				Texture = Progress->Preview.Get();
+				if (!Texture)
+				{
+					return;
+				}
+			}
+
+			RovrTexture::UploadRegion(Texture, 0, FIntPoint(0, FirstRow), MoveTemp(Pixels), Width, NumRows);
+		});
+
+		return true;
+	}
+}
+
+UTexture2D* RovrProgressiveImage::DecodeJpeg(TArray<uint8>&& Compressed, ERovrDecodePriority Priority, FOnDecoded OnDecoded, UTexture2D** OutPreview, int32* OutDecodeId)
+{
+	check(IsInGameThread());
+
+	if (OutDecodeId)
+	{
+		*OutDecodeId = 0;
+	}
+
+	// Only the headers are read here; the worker opens the data again for itself
+	FRovrJpegDecoder Headers;
+	if (!Headers.Open(Compressed))
+	{
+		return nullptr;
+	}
+
+	UTexture2D* Texture = RovrTexture::CreateForUpload(FRovrUploadTextureDesc(Headers.GetWidth(), Headers.GetHeight()));
+	if (!Texture)
+	{
+		return nullptr;
+	}
+
+	FProgressRef Progress = MakeShared<FProgress, ESPMode::ThreadSafe>();
+	Progress->Texture = Texture;
+
+	if (OutPreview)
+	{
+		*OutPreview = RovrTexture::CreateForUpload(FRovrUploadTextureDesc(Headers.GetPreviewSize().X, Headers.GetPreviewSize().Y));
+		Progress->Preview = *OutPreview;
+	}
+
+	const int32 BandHeight = FMath::Max(CVarProgressiveBandHeight.GetValueOnGameThread(), 8);
+
+	// The pixels go straight to the texture, so only the compressed data and the queued bands are held
+	const int64 MemoryBytes = Compressed.Num() + int64(Headers.GetWidth()) * BandHeight * 4 * (MaxBandsInFlight + 1);
+
+	const int32 DecodeId = FRovrDecodeScheduler::Get().Enqueue(Priority, MemoryBytes, [Compressed = MoveTemp(Compressed), Progress, BandHeight, OnDecoded = MoveTemp(OnDecoded)](const FRovrDecodeScheduler::FCancelFlag& bCancelled) mutable
+	{
+		Progress->bDecodeCancelled = bCancelled;
+
+		FRovrJpegDecoder Decoder;
+		bool bSuccess = Decoder.Open(Compressed);
+		const int32 Width = Decoder.GetWidth();
+
+		// The preview is cheap next to the full decode: no inverse DCT, and a 64th of the samples. It goes
+		// into a texture of its own, so none of the full image's memory is spent on it
+		if (bSuccess && Progress->Preview.IsValid())
+		{
+			TArray<uint8> Preview;
+			if (Decoder.DecodePreview(Preview))
+			{
+				const FIntPoint PreviewSize = Decoder.GetPreviewSize();
+				bSuccess = QueueBand(Progress, true, MoveTemp(Preview), PreviewSize.X, 0, PreviewSize.Y);
+			}
+		}
+
+		bSuccess = bSuccess && Decoder.Decode(BandHeight, [&Progress, Width](const uint8* Pixels, int32 FirstRow, int32 NumRows)
+		{
+			return QueueBand(Progress, false, TArray<uint8>(Pixels, Width * NumRows * 4), Width, FirstRow, NumRows);
+		});
+
+		AsyncTask(ENamedThreads::GameThread, [Progress, OnDecoded = MoveTemp(OnDecoded), bSuccess, bCancelled]()
+		{
+			if (*bCancelled)
+			{
+				return;
+			}
+
+			UTexture2D* Texture = Progress->Texture.Get();
+			if (!bSuccess && Texture)
+			{
+				UE_LOG(LogRovrImaging, Warning, TEXT("Unable to decode all of %s, part of it may be missing"), *Texture->GetName());
+			}
+
+			if (OnDecoded)
+			{
+				OnDecoded(Texture, bSuccess && Texture != nullptr);
+			}
+		});
+	});
+
+	if (OutDecodeId)
+	{
+		*OutDecodeId = DecodeId;
+	}
+
+	return Texture;
+}
@@ -0,0 +1,340 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RovrPyramidFile.h"
+#include "RovrImagingDefines.h"
+#include "RovrBlockCompress.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+
+
+namespace
+{
+	const uint32 PyramidMagic = 0x52595052;
+	const uint32 PyramidVersion = 1;
+
+	/** Levels are never larger than this along either axis, which bounds the tile count of damaged files */
+	const int32 MaxLevelSize = 65536;
+
+	/** Tile data starts on this boundary, so mapped tiles are aligned for copying */
+	const int64 DataAlignment = 16;
+
+	/** Layout: header, one record per level, one record per tile, then the tile data */
+	struct FFileHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint64 SourceStamp;
+		int32 TileSize;
+		int32 Border;
+		int32 NumLevels;
+		uint8 Format;
+		uint8 Padding[3];
+	};
+
+	struct FLevelRecord
+	{
+		int32 Width;
+		int32 Height;
+		int32 FirstTile;
+		int32 NumTiles;
+	};
+
+	struct FTileRecord
+	{
+		int64 Offset;
+		int64 Size;
+	};
+	static_assert(sizeof(FFileHeader) == 32, "The pyramid header must not change size");
+	static_assert(sizeof(FLevelRecord) == 16, "Pyramid level records must not change size");
+	static_assert(sizeof(FTileRecord) == 16, "Pyramid tile records must not change size");
+
+	/** Pixel formats as stored in the file, independent of the engine's enum */
+	uint8 ToFileFormat(EPixelFormat Format)
+	{
+		return Format == PF_ETC2_RGB ? 1 : 0;
+	}
+
+	EPixelFormat FromFileFormat(uint8 Format)
+	{
+		switch (Format)
+		{
+		case 0:
+			return PF_B8G8R8A8;
+		case 1:
+			return PF_ETC2_RGB;
+		default:
+			return PF_Unknown;
+		}
+	}
+
+	/** Read a whole range of the file at an offset */
+	bool ReadAt(IFileHandle& File, int64 Offset, uint8* Dest, int64 Size)
+	{
+		return File.Seek(Offset) && File.Read(Dest, Size);
+	}
+}
+
+const TCHAR* const FRovrPyramidFile::Extension = TEXT("rovrpyr");
+
+bool FRovrPyramidFile::Write(const IRovrTileSource& Source, uint64 SourceStamp, const FString& Filename)
+{
+	const int32 NumLevels = Source.GetNumLevels();
+	if (NumLevels <= 0 || Source.GetTileSize() <= 0)
+	{
+		return false;
+	}
+
+	TArray<FLevelRecord> Levels;
+	int32 NumTiles = 0;
+	for (int32 Level = 0; Level < NumLevels; ++Level)
+	{
+		const FIntPoint Size = Source.GetLevelSize(Level);
+		const FIntPoint LevelTiles = Source.GetNumTiles(Level);
+
+		FLevelRecord& Record = Levels.AddZeroed_GetRef();
+		Record.Width = Size.X;
+		Record.Height = Size.Y;
+		Record.FirstTile = NumTiles;
+		Record.NumTiles = LevelTiles.X * LevelTiles.Y;
+		NumTiles += Record.NumTiles;
+	}
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(Filename));
+
+	const FString TempFilename = Filename + TEXT(".tmp");
+	TUniquePtr<IFileHandle> File(PlatformFile.OpenWrite(*TempFilename));
+	if (!File.IsValid())
+	{
+		UE_LOG(LogRovrImaging, Warning, TEXT("Unable to write pyramid %s"), *TempFilename);
+		return false;
+	}
+
+	FFileHeader Header = {};
+	Header.Magic = PyramidMagic;
+	Header.Version = PyramidVersion;
+	Header.SourceStamp = SourceStamp;
+	Header.TileSize = Source.GetTileSize();
+	Header.Border = Border;
+	Header.NumLevels = NumLevels;
+	Header.Format = ToFileFormat(Source.GetFormat());
+
+	// The tile table is filled in once the tile offsets are known; the data goes after it, lowest level first
+	TArray<FTileRecord> Records;
+	Records.SetNumZeroed(NumTiles);
+
+	const int64 TableEnd = int64(sizeof(FFileHeader)) + NumLevels * int64(sizeof(FLevelRecord)) + NumTiles * int64(sizeof(FTileRecord));
+	const uint8 Padding[DataAlignment] = {};
+	bool bWritten = File->Write(reinterpret_cast<const uint8*>(&Header), sizeof(Header))
+		&& File->Write(reinterpret_cast<const uint8*>(Levels.GetData()), Levels.Num() * sizeof(FLevelRecord))
+		&& File->Write(reinterpret_cast<const uint8*>(Records.GetData()), Records.Num() * sizeof(FTileRecord))
+		&& File->Write(Padding, Align(TableEnd, DataAlignment) - TableEnd);
+
+	TArray<uint8> Data;
+	for (int32 Level = NumLevels - 1; Level >= 0 && bWritten; --Level)
+	{
+		const FIntPoint LevelTiles = Source.GetNumTiles(Level);
+		for (int32 Index = 0; Index < Levels[Level].NumTiles && bWritten; ++Index)
+		{
+			bWritten = Source.ReadTile(FRovrTileId(Level, Index % LevelTiles.X, Index / LevelTiles.X), Data);
+			if (bWritten)
+			{
+				FTileRecord& Record = Records[Levels[Level].FirstTile + Index];
+				Record.Offset = File->Tell();
+				Record.Size = Data.Num();
+
+				const int64 End = Record.Offset + Record.Size;
+				bWritten = File->Write(Data.GetData(), Data.Num()) && File->Write(Padding, Align(End, DataAlignment) - End);
+			}
+		}
+	}
+
+	bWritten = bWritten && File->Seek(TableEnd - Records.Num() * int64(sizeof(FTileRecord)))
+		&& File->Write(reinterpret_cast<const uint8*>(Records.GetData()), Records.Num() * sizeof(FTileRecord));
+	File.Reset();
+
+	if (!bWritten)
+	{
+		UE_LOG(LogRovrImaging, Warning, TEXT("Unable to write pyramid %s"), *TempFilename);
+		PlatformFile.DeleteFile(*TempFilename);
+		return false;
+	}
+
+	PlatformFile.DeleteFile(*Filename);
+	if (!PlatformFile.MoveFile(*Filename, *TempFilename))
+	{
+		UE_LOG(LogRovrImaging, Warning, TEXT("Unable to replace pyramid %s"), *Filename);
+		PlatformFile.DeleteFile(*TempFilename);
+		return false;
+	}
+
+	return true;
+}
+
+TSharedPtr<FRovrPyramidFile, ESPMode::ThreadSafe> FRovrPyramidFile::Open(const FString& Filename)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+	// Private constructor, so no MakeShared
+	TSharedPtr<FRovrPyramidFile, ESPMode::ThreadSafe> Pyramid(new FRovrPyramidFile());
+	Pyramid->Filename = Filename;
+
+	Pyramid->MappedFile.Reset(PlatformFile.OpenMapped(*Filename));
+	if (Pyramid->MappedFile.IsValid() && Pyramid->MappedFile->GetFileSize() > 0)
+	{
+		Pyramid->MappedRegion.Reset(Pyramid->MappedFile->MapRegion(0, Pyramid->MappedFile->GetFileSize()));
+	}
+
+	int64 FileSize = 0;
+	if (Pyramid->MappedRegion.IsValid())
+	{
+		FileSize = Pyramid->MappedRegion->GetMappedSize();
+	}
+	else
+	{
+		// Not every platform file can map, e.g. files inside a pak; tiles are then read one range at a time
+		Pyramid->MappedFile.Reset();
+		Pyramid->File.Reset(PlatformFile.OpenRead(*Filename));
+		if (!Pyramid->File.IsValid())
+		{
+			return nullptr;
+		}
+		FileSize = Pyramid->File->Size();
+	}
+
+	// The header and index are read the same way either way
+	TArray<uint8> Index;
+	auto ReadIndex = [&Pyramid, &Index, FileSize](int64 Size)
+	{
+		if (Size > FileSize)
+		{
+			return false;
+		}
+
+		Index.SetNumUninitialized(Size);
+		if (Pyramid->MappedRegion.IsValid())
+		{
+			FMemory::Memcpy(Index.GetData(), Pyramid->MappedRegion->GetMappedPtr(), Size);
+			return true;
+		}
+		return ReadAt(*Pyramid->File, 0, Index.GetData(), Size);
+	};
+
+	FFileHeader Header;
+	if (!ReadIndex(sizeof(Header)))
+	{
+		return nullptr;
+	}
+	FMemory::Memcpy(&Header, Index.GetData(), sizeof(Header));
+
+	if (Header.Magic != PyramidMagic || Header.Version != PyramidVersion || Header.Border != Border || Header.TileSize <= 0 || Header.TileSize % 4 != 0 || Header.NumLevels <= 0 || FromFileFormat(Header.Format) == PF_Unknown)
+	{
+		UE_LOG(LogRovrImaging, Warning, TEXT("Ignoring pyramid %s: unknown version or damaged"), *Filename);
+		return nullptr;
+	}
+
+	Pyramid->SourceStamp = Header.SourceStamp;
+	Pyramid->TileSize = Header.TileSize;
+	Pyramid->Format = FromFileFormat(Header.Format);
+
+	if (Pyramid->Format == PF_ETC2_RGB && !RovrBlockCompress::IsETC2Supported())
+	{
+		UE_LOG(LogRovrImaging, Warning, TEXT("Ignoring pyramid %s: this RHI cannot sample its ETC2 tiles"), *Filename);
+		return nullptr;
+	}
+
+	const int64 LevelsEnd = int64(sizeof(FFileHeader)) + Header.NumLevels * int64(sizeof(FLevelRecord));
+	if (!ReadIndex(LevelsEnd))
+	{
+		return nullptr;
+	}
+
+	int32 NumTiles = 0;
+	for (int32 Level = 0; Level < Header.NumLevels; ++Level)
+	{
+		FLevelRecord Record;
+		FMemory::Memcpy(&Record, Index.GetData() + sizeof(FFileHeader) + Level * sizeof(FLevelRecord), sizeof(Record));
+
+		Pyramid->LevelSizes.Add(FIntPoint(Record.Width, Record.Height));
+		Pyramid->FirstTiles.Add(NumTiles);
+
+		const FIntPoint LevelTiles = Pyramid->GetNumTiles(Level);
+		if (Record.Width <= 0 || Record.Height <= 0 || Record.Width > MaxLevelSize || Record.Height > MaxLevelSize || Record.FirstTile != NumTiles || Record.NumTiles != LevelTiles.X * LevelTiles.Y)
+		{
+			UE_LOG(LogRovrImaging, Warning, TEXT("Ignoring pyramid %s: damaged level %d"), *Filename, Level);
+			return nullptr;
+		}
+		NumTiles += Record.NumTiles;
+	}
+
+	const int64 TableEnd = LevelsEnd + NumTiles * int64(sizeof(FTileRecord));
+	if (!ReadIndex(TableEnd))
+	{
+		return nullptr;
+	}
+
+	const int32 TextureSize = Pyramid->GetTileTextureSize();
+	const int64 TileBytes = RovrTexture::CalcMipSize(TextureSize, TextureSize, Pyramid->Format);
+	Pyramid->Tiles.SetNum(NumTiles);
+	for (int32 Tile = 0; Tile < NumTiles; ++Tile)
+	{
+		FTileRecord Record;
+		FMemory::Memcpy(&Record, Index.GetData() + LevelsEnd + Tile * sizeof(FTileRecord), sizeof(Record));
+
+		if (Record.Offset < TableEnd || Record.Size != TileBytes || Record.Offset + Record.Size > FileSize)
+		{
+			UE_LOG(LogRovrImaging, Warning, TEXT("Ignoring pyramid %s: damaged tile %d"), *Filename, Tile);
+			return nullptr;
+		}
+
+		Pyramid->Tiles[Tile].Offset = Record.Offset;
+		Pyramid->Tiles[Tile].Size = Record.Size;
+	}
+
+	UE_LOG(LogRovrImaging, Log, TEXT("Opened pyramid %s: %dx%d, %d tiles over %d levels, %s"), *Filename, Pyramid->LevelSizes[0].X, Pyramid->LevelSizes[0].Y, NumTiles, Header.NumLevels, Pyramid->MappedRegion.IsValid() ? TEXT("mapped") : TEXT("read"));
+	return Pyramid;
+}
+
+FRovrPyramidFile::~FRovrPyramidFile()
+{
+	// The region points into the handle, so it goes first
+	MappedRegion.Reset();
+	MappedFile.Reset();
+}
+
+const FRovrPyramidFile::FTileLocation* FRovrPyramidFile::FindTile(const FRovrTileId& Tile) const
+{
+	if (Tile.Level < 0 || Tile.Level >= LevelSizes.Num())
+	{
+		return nullptr;
+	}
+
+	const FIntPoint NumTiles = GetNumTiles(Tile.Level);
+	if (Tile.X < 0 || Tile.X >= NumTiles.X || Tile.Y < 0 || Tile.Y >= NumTiles.Y)
+	{
+		return nullptr;
+	}
+
+	return &Tiles[FirstTiles[Tile.Level] + Tile.Y * NumTiles.X + Tile.X];
+}
+
+bool FRovrPyramidFile::ReadTile(const FRovrTileId& Tile, TArray<uint8>& OutData) const
+{
+	const FTileLocation* Location = FindTile(Tile);
+	if (!Location)
+	{
+		return false;
+	}
+
+	OutData.SetNumUninitialized(Location->Size);
+	if (MappedRegion.IsValid())
+	{
+		FMemory::Memcpy(OutData.GetData(), MappedRegion->GetMappedPtr() + Location->Offset, Location->Size);
+		return true;
+	}
+
+	FScopeLock ScopeLock(&FileLock);
+	return ReadAt(*File, Location->Offset, OutData.GetData(), Location->Size);
+}
@@ -0,0 +1,131 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RovrScaledDecode.h"
+#include "RovrDecodeScheduler.h"
+#include "RovrImageResize.h"
+#include "RovrJpegDecoder.h"
+#include "RovrPngDecoder.h"
+
+
+namespace
+{
+	/** Rows per band of the JPEG decode; the bands are copied straight into the output */
+	const int32 JpegBandHeight = 256;
+
+	FIntPoint GetTargetSize(int32 Width, int32 Height, int32 MaxWidth, int32 MaxHeight)
+	{
+		return RovrImageResize::FitSize(Width, Height, MaxWidth > 0 ? MaxWidth : Width, MaxHeight > 0 ? MaxHeight : Height);
+	}
+
+	int64 GetPixelBytes(const FIntPoint& Size)
+	{
+		return int64(Size.X) * Size.Y * 4;
+	}
+
+	bool DecodeJpeg(FRovrJpegDecoder& Decoder, int32 ScaleShift, const FThreadSafeBool* bCancelled, TArray<uint8>& OutPixels, FIntPoint& OutSize)
+	{
+		OutSize = Decoder.GetScaledSize(ScaleShift);
+		OutPixels.SetNumUninitialized(GetPixelBytes(OutSize));
+
+		const int64 RowBytes = int64(OutSize.X) * 4;
+		return Decoder.Decode(JpegBandHeight, [&OutPixels, RowBytes, bCancelled](const uint8* Pixels, int32 FirstRow, int32 NumRows)
+		{
+			FMemory::Memcpy(OutPixels.GetData() + FirstRow * RowBytes, Pixels, NumRows * RowBytes);
+			return !bCancelled || !*bCancelled;
+		}, ScaleShift);
+	}
+}
+
+int32 RovrScaledDecode::GetScaleShift(int32 Width, int32 Height, int32 MaxWidth, int32 MaxHeight)
+{
+	const FIntPoint Target = GetTargetSize(Width, Height, MaxWidth, MaxHeight);
+
+	int32 ScaleShift = 0;
+	while (ScaleShift < FRovrJpegDecoder::MaxScaleShift)
+	{
+		const int32 Next = ScaleShift + 1;
+		if (((Width + (1 << Next) - 1) >> Next) < Target.X || ((Height + (1 << Next) - 1) >> Next) < Target.Y)
+		{
+			break;
+		}
+		ScaleShift = Next;
+	}
+	return ScaleShift;
+}
+
+bool RovrScaledDecode::Decode(TArrayView<const uint8> Bytes, int32 MaxWidth, int32 MaxHeight, TArray<uint8>& OutPixels, int32& OutWidth, int32& OutHeight, const FThreadSafeBool* bCancelled)
+{
+	TArray<uint8> Pixels;
+	FIntPoint Size;
+	FIntPoint Target;
+
+	FRovrJpegDecoder JpegDecoder;
+	FRovrPngDecoder PngDecoder;
+	if (JpegDecoder.Open(Bytes))
+	{
+		Target = GetTargetSize(JpegDecoder.GetWidth(), JpegDecoder.GetHeight(), MaxWidth, MaxHeight);
+		const int32 ScaleShift = GetScaleShift(JpegDecoder.GetWidth(), JpegDecoder.GetHeight(), MaxWidth, MaxHeight);
+		if (!DecodeJpeg(JpegDecoder, ScaleShift, bCancelled, Pixels, Size))
+		{
+			return false;
+		}
+	}
+	else if (PngDecoder.Open(Bytes))
+	{
+		Target = GetTargetSize(PngDecoder.GetWidth(), PngDecoder.GetHeight(), MaxWidth, MaxHeight);
+		const int32 ScaleShift = GetScaleShift(PngDecoder.GetWidth(), PngDecoder.GetHeight(), MaxWidth, MaxHeight);
+		Size = PngDecoder.GetScaledSize(ScaleShift);
+		if (!PngDecoder.Decode(Pixels, ScaleShift))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		return false;
+	}
+
+	if (bCancelled && *bCancelled)
+	{
+		return false;
+	}
+
+	if (Size == Target)
+	{
+		OutPixels = MoveTemp(Pixels);
+	}
+	else
+	{
+		OutPixels.SetNumUninitialized(GetPixelBytes(Target));
+		RovrImageResize::ResizeArea(Pixels.GetData(), int64(Size.X) * 4, Size.X, Size.Y, OutPixels.GetData(), int64(Target.X) * 4, Target.X, Target.Y);
+	}
+
+	OutWidth = Target.X;
+	OutHeight = Target.Y;
+	return true;
+}
+
+int64 RovrScaledDecode::GetDecodeBytes(TArrayView<const uint8> Bytes, int32 MaxWidth, int32 MaxHeight)
+{
+	FIntPoint Size;
+	FIntPoint Target;
+
+	FRovrJpegDecoder JpegDecoder;
+	FRovrPngDecoder PngDecoder;
+	if (JpegDecoder.Open(Bytes))
+	{
+		Target = GetTargetSize(JpegDecoder.GetWidth(), JpegDecoder.GetHeight(), MaxWidth, MaxHeight);
+		Size = JpegDecoder.GetScaledSize(GetScaleShift(JpegDecoder.GetWidth(), JpegDecoder.GetHeight(), MaxWidth, MaxHeight));
+	}
+	else if (PngDecoder.Open(Bytes))
+	{
+		Target = GetTargetSize(PngDecoder.GetWidth(), PngDecoder.GetHeight(), MaxWidth, MaxHeight);
+		Size = PngDecoder.GetScaledSize(GetScaleShift(PngDecoder.GetWidth(), PngDecoder.GetHeight(), MaxWidth, MaxHeight));
+	}
+	else
+	{
+		return FRovrDecodeScheduler::EstimateDecodeBytes(Bytes.Num());
+	}
+
+	return Bytes.Num() + GetPixelBytes(Size) + (Size == Target ? 0 : GetPixelBytes(Target));
+}
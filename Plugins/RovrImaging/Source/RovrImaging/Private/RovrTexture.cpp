@@ -0,0 +1,677 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RovrTexture.h"
+#include "RovrImagingDefines.h"
+#include "Async/Async.h"
+#include "Engine/Texture2D.h"
+#include "HAL/IConsoleManager.h"
+#include "RenderingThread.h"
+#include "RHI.h"
+#include "TextureResource.h"
+
+
+namespace
+{
+	TAutoConsoleVariable<int32> CVarTextureMipFilter(
+		TEXT("rovr.Texture.MipFilter"),
+		0,
+		TEXT("Mip chain generated for textures created from thumbnails and photos.\n")
+		TEXT(" 0: mip 0 only\n")
+		TEXT(" 1: box filter\n")
+		TEXT(" 2: Kaiser filter"),
+		ECVF_Default);
+
+	TAutoConsoleVariable<int32> CVarTextureCompression(
+		TEXT("rovr.Texture.Compression"),
+		0,
+		TEXT("ETC2 compression of opaque textures created from thumbnails and photos, where the RHI supports it.\n")
+		TEXT(" 0: uncompressed\n")
+		TEXT(" 1: fast\n")
+		TEXT(" 2: normal\n")
+		TEXT(" 3: high quality"),
+		ECVF_Default);
+
+	/** Decodes of UpdateAsync still to be uploaded, by texture; game thread only */
+	TMap<TWeakObjectPtr<UTexture2D>, int32>& GetPendingUpdates()
+	{
+		static TMap<TWeakObjectPtr<UTexture2D>, int32> PendingUpdates;
+		return PendingUpdates;
+	}
+
+	/** BGRA8 or ETC2 levels of a texture, mip 0 first, each allocated with FMemory::Malloc */
+	typedef TArray<uint8*, TInlineAllocator<16>> FMipLevels;
+
+	/** Mips never skip levels, so a texture with more than one regenerates all of them */
+	ERovrMipFilter GetChainFilter(ERovrMipFilter MipFilter)
+	{
+		return MipFilter == ERovrMipFilter::None ? ERovrMipFilter::Box : MipFilter;
+	}
+
+	/** A texture already holding ETC2 blocks is refilled with the same, whatever was asked for */
+	ERovrCompressQuality GetBlockQuality(ERovrCompressQuality Compression)
+	{
+		return Compression == ERovrCompressQuality::None ? ERovrCompressQuality::Normal : Compression;
+	}
+
+	/** Append mips 1 and below to a transient texture holding mip 0 only */
+	void AllocateMipChain(UTexture2D* Texture)
+	{
+		TIndirectArray<FTexture2DMipMap>& Mips = Texture->PlatformData->Mips;
+		const int32 NumMips = RovrMipChain::GetNumMips(Mips[0].SizeX, Mips[0].SizeY);
+
+		for (int32 MipIndex = Mips.Num(); MipIndex < NumMips; ++MipIndex)
+		{
+			FTexture2DMipMap* Mip = new FTexture2DMipMap();
+			Mip->SizeX = FMath::Max(Mips[MipIndex - 1].SizeX / 2, 1);
+			Mip->SizeY = FMath::Max(Mips[MipIndex - 1].SizeY / 2, 1);
+
+			Mip->BulkData.Lock(LOCK_READ_WRITE);
+			Mip->BulkData.Realloc(RovrTexture::CalcMipSize(Mip->SizeX, Mip->SizeY, Texture->GetPixelFormat()));
+			Mip->BulkData.Unlock();
+
+			Mips.Add(Mip);
+		}
+	}
+
+	/** Queue an upload of every level into the resource of a texture, handing the buffers to the render thread */
+	void UploadLevels(UTexture2D* Texture, const FMipLevels& Levels)
+	{
+		const FPixelFormatInfo& Info = GPixelFormats[Texture->GetPixelFormat()];
+		int32 Width = Texture->GetSizeX();
+		int32 Height = Texture->GetSizeY();
+		for (int32 MipIndex = 0; MipIndex < Levels.Num(); ++MipIndex)
+		{
+			const uint32 Pitch = uint32(FMath::DivideAndRoundUp(Width, Info.BlockSizeX) * Info.BlockBytes);
+
+			FUpdateTextureRegion2D* Region = new FUpdateTextureRegion2D(0, 0, 0, 0, Width, Height);
+			Texture->UpdateTextureRegions(MipIndex, 1, Region, Pitch, Info.BlockBytes, Levels[MipIndex], [](uint8* Data, const FUpdateTextureRegion2D* Regions)
+			{
+				FMemory::Free(Data);
+				delete Regions;
+			});
+			Width = FMath::Max(Width / 2, 1);
+			Height = FMath::Max(Height / 2, 1);
+		}
+	}
+
+	/** Whether a rectangle lies within a mip of a texture, on block boundaries where it does not end at the edge */
+	bool IsRegionInMip(const UTexture2D* Texture, int32 MipIndex, FIntPoint Dest, int32 Width, int32 Height)
+	{
+		if (MipIndex < 0 || MipIndex >= Texture->GetNumMips() || Dest.X < 0 || Dest.Y < 0 || Width <= 0 || Height <= 0)
+		{
+			return false;
+		}
+
+		const int32 MipWidth = FMath::Max(Texture->GetSizeX() >> MipIndex, 1);
+		const int32 MipHeight = FMath::Max(Texture->GetSizeY() >> MipIndex, 1);
+		if (Dest.X + Width > MipWidth || Dest.Y + Height > MipHeight)
+		{
+			return false;
+		}
+
+		const FPixelFormatInfo& Info = GPixelFormats[Texture->GetPixelFormat()];
+		return Dest.X % Info.BlockSizeX == 0 && Dest.Y % Info.BlockSizeY == 0
+			&& (Width % Info.BlockSizeX == 0 || Dest.X + Width == MipWidth)
+			&& (Height % Info.BlockSizeY == 0 || Dest.Y + Height == MipHeight);
+	}
+
+	/**
+	 * Queue an upload of a rectangle into the resource of a texture, handing the buffer to the render thread.
+	 * Rows in any layout but BGRA8 are converted there in place, so Pitch must hold 4 bytes per pixel then
+	 */
+	void EnqueueRegionUpload(UTexture2D* Texture, int32 MipIndex, const FUpdateTextureRegion2D& Region, uint32 Pitch, TArray<uint8>&& Data, ERovrPixelLayout Layout, ERovrPixelConvertFlags Flags)
+	{
+		// The resource is released by a render command queued after this one, so it outlives the upload
+		FTextureResource* Resource = Texture->Resource;
+		ENQUEUE_RENDER_COMMAND(RovrUploadTextureRegion)(
+			[Resource, MipIndex, Region, Pitch, Data = MoveTemp(Data), Layout, Flags](FRHICommandListImmediate& RHICmdList) mutable
+			{
+				if (Layout != ERovrPixelLayout::BGRA8 || Flags != ERovrPixelConvertFlags::None)
+				{
+					RovrPixelConvert::ConvertImage(Data.GetData(), Layout, Pitch, Data.GetData(), Pitch, Region.Width, Region.Height, Flags);
+				}
+
+				// Transient textures never stream, so mip indices match the RHI texture
+				FRHITexture2D* RHITexture = Resource->TextureRHI ? Resource->TextureRHI->GetTexture2D() : nullptr;
+				if (RHITexture)
+				{
+					RHIUpdateTexture2D(RHITexture, MipIndex, Region, Pitch, Data.GetData());
+				}
+			});
+	}
+
+	/** Whether a texture has the size, format and mip count of encoded data */
+	bool MatchesData(const UTexture2D* Texture, const FRovrTextureDataView& Data)
+	{
+		return Texture->GetPixelFormat() == Data.Format && Texture->GetSizeX() == Data.Width && Texture->GetSizeY() == Data.Height && Texture->GetNumMips() == Data.NumMips;
+	}
+
+	/** Convert Image to BGRA8 and generate the levels below it */
+	void BuildLevels(const FRovrImageView& Image, ERovrPixelConvertFlags Flags, int32 NumMips, ERovrMipFilter MipFilter, FMipLevels& OutLevels)
+	{
+		OutLevels.Reset(NumMips);
+
+		OutLevels.Add(static_cast<uint8*>(FMemory::Malloc(int64(Image.Width) * Image.Height * 4)));
+		RovrPixelConvert::ConvertImage(Image.Data.GetData(), Image.Layout, Image.Stride, OutLevels[0], int64(Image.Width) * 4, Image.Width, Image.Height, Flags);
+
+		int32 Width = Image.Width;
+		int32 Height = Image.Height;
+		for (int32 MipIndex = 1; MipIndex < NumMips; ++MipIndex)
+		{
+			const int32 ChildWidth = FMath::Max(Width / 2, 1);
+			const int32 ChildHeight = FMath::Max(Height / 2, 1);
+			OutLevels.Add(static_cast<uint8*>(FMemory::Malloc(int64(ChildWidth) * ChildHeight * 4)));
+			RovrMipChain::Downsample(OutLevels[MipIndex - 1], int64(Width) * 4, Width, Height, OutLevels[MipIndex], GetChainFilter(MipFilter));
+			Width = ChildWidth;
+			Height = ChildHeight;
+		}
+	}
+
+	/** Replace every BGRA8 level with its ETC2 blocks */
+	void CompressLevels(FMipLevels& Levels, int32 Width, int32 Height, ERovrCompressQuality Quality)
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		const int32 BaseWidth = Width;
+		const int32 BaseHeight = Height;
+
+		int64 UncompressedBytes = 0;
+		int64 CompressedBytes = 0;
+		for (uint8*& Level : Levels)
+		{
+			const int64 Size = RovrTexture::CalcMipSize(Width, Height, PF_ETC2_RGB);
+			uint8* Blocks = static_cast<uint8*>(FMemory::Malloc(Size));
+			RovrBlockCompress::CompressETC2(Level, int64(Width) * 4, Width, Height, Blocks, Quality);
+
+			FMemory::Free(Level);
+			Level = Blocks;
+
+			UncompressedBytes += int64(Width) * Height * 4;
+			CompressedBytes += Size;
+			Width = FMath::Max(Width / 2, 1);
+			Height = FMath::Max(Height / 2, 1);
+		}
+
+		UE_LOG(LogRovrImaging, Verbose, TEXT("Compressed %dx%d with %d mips to ETC2 in %.1f ms, %lld KiB instead of %lld KiB"),
+			BaseWidth, BaseHeight, Levels.Num(), (FPlatformTime::Seconds() - StartTime) * 1000.0, CompressedBytes / 1024, UncompressedBytes / 1024);
+	}
+}
+
+bool FRovrTextureDataView::IsValid() const
+{
+	if ((Format != PF_B8G8R8A8 && Format != PF_ETC2_RGB) || Width <= 0 || Height <= 0)
+	{
+		return false;
+	}
+
+	if (NumMips != 1 && NumMips != RovrMipChain::GetNumMips(Width, Height))
+	{
+		return false;
+	}
+
+	// Transient compressed textures are made of whole blocks
+	if (Format == PF_ETC2_RGB && (Width % 4 != 0 || Height % 4 != 0))
+	{
+		return false;
+	}
+
+	return Data.Num() >= RovrTexture::CalcTextureSize(Width, Height, Format, NumMips);
+}
+
+UTexture2D* RovrTexture::CreateTransient(const FRovrImageView& Image, ERovrPixelConvertFlags Flags, FName Name, ERovrMipFilter MipFilter, ERovrCompressQuality Compression)
+{
+	if (!Image.IsValid())
+	{
+		UE_LOG(LogRovrImaging, Warning, TEXT("Unable to create a texture from an invalid %dx%d image (%d bytes, stride %lld)"), Image.Width, Image.Height, Image.Data.Num(), Image.Stride);
+		return nullptr;
+	}
+
+	UTexture2D* Texture = UTexture2D::CreateTransient(Image.Width, Image.Height, GetTransientFormat(Image, Flags, Compression), Name);
+	if (!Texture)
+	{
+		return nullptr;
+	}
+
+	if (MipFilter != ERovrMipFilter::None)
+	{
+		AllocateMipChain(Texture);
+	}
+
+	Fill(Texture, Image, Flags, MipFilter, Compression);
+	return Texture;
+}
+
+UTexture2D* RovrTexture::CreateTransient(TArray<uint8>&& Pixels, int32 Width, int32 Height, ERovrPixelLayout Layout, int64 Stride, ERovrPixelConvertFlags Flags, FName Name, ERovrMipFilter MipFilter, ERovrCompressQuality Compression)
+{
+	const FRovrImageView Image(Pixels, Width, Height, Layout, Stride);
+	if (!Image.IsValid())
+	{
+		UE_LOG(LogRovrImaging, Warning, TEXT("Unable to create a texture from an invalid %dx%d image (%d bytes, stride %lld)"), Width, Height, Pixels.Num(), Image.Stride);
+		return nullptr;
+	}
+
+	const EPixelFormat Format = GetTransientFormat(Image, Flags, Compression);
+	const int32 NumMips = MipFilter != ERovrMipFilter::None ? RovrMipChain::GetNumMips(Width, Height) : 1;
+	UTexture2D* Texture = CreateForUpload(FRovrUploadTextureDesc(Width, Height, Format, NumMips), Name);
+	if (!Texture)
+	{
+		return nullptr;
+	}
+
+	// A plain BGRA8 texture needs nothing but the buffer, which goes to the render thread as it is
+	if (Format == PF_B8G8R8A8 && NumMips == 1)
+	{
+		UploadRegion(Texture, 0, FIntPoint::ZeroValue, MoveTemp(Pixels), Width, Height, Layout, Stride, Flags);
+	}
+	else
+	{
+		UpdateAsync(Texture, MoveTemp(Pixels), Width, Height, Layout, Stride, Flags, MipFilter, Compression);
+	}
+	return Texture;
+}
+
+bool RovrTexture::Fill(UTexture2D* Texture, const FRovrImageView& Image, ERovrPixelConvertFlags Flags, ERovrMipFilter MipFilter, ERovrCompressQuality Compression)
+{
+	if (!RovrTexture::HasCpuCopy(Texture) || !Image.IsValid())
+	{
+		return false;
+	}
+
+	TIndirectArray<FTexture2DMipMap>& Mips = Texture->PlatformData->Mips;
+	const EPixelFormat Format = Texture->GetPixelFormat();
+	if ((Format != PF_B8G8R8A8 && Format != PF_ETC2_RGB) || Mips[0].SizeX != Image.Width || Mips[0].SizeY != Image.Height)
+	{
+		return false;
+	}
+
+	if (Format == PF_ETC2_RGB)
+	{
+		// Blocks are encoded from whole BGRA8 levels, which therefore go through temporary buffers
+		FMipLevels Levels;
+		BuildLevels(Image, Flags, Mips.Num(), MipFilter, Levels);
+		CompressLevels(Levels, Image.Width, Image.Height, GetBlockQuality(Compression));
+
+		for (int32 MipIndex = 0; MipIndex < Mips.Num(); ++MipIndex)
+		{
+			FTexture2DMipMap& Mip = Mips[MipIndex];
+			FMemory::Memcpy(Mip.BulkData.Lock(LOCK_READ_WRITE), Levels[MipIndex], CalcMipSize(Mip.SizeX, Mip.SizeY, PF_ETC2_RGB));
+			Mip.BulkData.Unlock();
+			FMemory::Free(Levels[MipIndex]);
+		}
+
+		Texture->UpdateResource();
+		return true;
+	}
+
+	uint8* MipData = static_cast<uint8*>(Mips[0].BulkData.Lock(LOCK_READ_WRITE));
+	RovrPixelConvert::ConvertImage(Image.Data.GetData(), Image.Layout, Image.Stride, MipData, int64(Image.Width) * 4, Image.Width, Image.Height, Flags);
+
+	// Every level is computed from the one above while both are locked
+	for (int32 MipIndex = 1; MipIndex < Mips.Num(); ++MipIndex)
+	{
+		const FTexture2DMipMap& Parent = Mips[MipIndex - 1];
+		uint8* ChildData = static_cast<uint8*>(Mips[MipIndex].BulkData.Lock(LOCK_READ_WRITE));
+		RovrMipChain::Downsample(MipData, int64(Parent.SizeX) * 4, Parent.SizeX, Parent.SizeY, ChildData, GetChainFilter(MipFilter));
+		Mips[MipIndex - 1].BulkData.Unlock();
+		MipData = ChildData;
+	}
+	Mips.Last().BulkData.Unlock();
+
+	Texture->UpdateResource();
+	return true;
+}
+
+bool RovrTexture::Update(UTexture2D* Texture, const FRovrImageView& Image, ERovrPixelConvertFlags Flags, ERovrMipFilter MipFilter, ERovrCompressQuality Compression)
+{
+	CancelUpdateAsync(Texture);
+	if (!Texture || !Texture->Resource)
+	{
+		return Fill(Texture, Image, Flags, MipFilter, Compression);
+	}
+
+	const EPixelFormat Format = Texture->GetPixelFormat();
+	if (!Image.IsValid() || (Format != PF_B8G8R8A8 && Format != PF_ETC2_RGB) || Texture->GetSizeX() != Image.Width || Texture->GetSizeY() != Image.Height)
+	{
+		return false;
+	}
+
+	// The render thread reads the pixels later, so they go into buffers it frees once uploaded. Every
+	// level is generated before any upload is queued, as the render thread may free a parent early
+	FMipLevels Levels;
+	BuildLevels(Image, Flags, Texture->GetNumMips(), MipFilter, Levels);
+	if (Format == PF_ETC2_RGB)
+	{
+		CompressLevels(Levels, Image.Width, Image.Height, GetBlockQuality(Compression));
+	}
+
+	UploadLevels(Texture, Levels);
+	return true;
+}
+
+bool RovrTexture::Update(UTexture2D* Texture, TArray<uint8>&& Pixels, int32 Width, int32 Height, ERovrPixelLayout Layout, int64 Stride, ERovrPixelConvertFlags Flags, ERovrMipFilter MipFilter, ERovrCompressQuality Compression)
+{
+	CancelUpdateAsync(Texture);
+
+	// A single BGRA8 level needs nothing but the buffer, which the render thread converts in place
+	if (Texture && Texture->Resource && Texture->GetPixelFormat() == PF_B8G8R8A8 && Texture->GetNumMips() == 1 && Texture->GetSizeX() == Width && Texture->GetSizeY() == Height)
+	{
+		return UploadRegion(Texture, 0, FIntPoint::ZeroValue, MoveTemp(Pixels), Width, Height, Layout, Stride, Flags);
+	}
+
+	return Update(Texture, FRovrImageView(Pixels, Width, Height, Layout, Stride), Flags, MipFilter, Compression);
+}
+
+bool RovrTexture::Encode(const FRovrImageView& Image, ERovrPixelConvertFlags Flags, ERovrMipFilter MipFilter, ERovrCompressQuality Compression, FRovrTextureData& OutData)
+{
+	if (!Image.IsValid())
+	{
+		return false;
+	}
+
+	OutData.Width = Image.Width;
+	OutData.Height = Image.Height;
+	OutData.NumMips = MipFilter != ERovrMipFilter::None ? RovrMipChain::GetNumMips(Image.Width, Image.Height) : 1;
+	OutData.Format = GetTransientFormat(Image, Flags, Compression);
+
+	FMipLevels Levels;
+	BuildLevels(Image, Flags, OutData.NumMips, MipFilter, Levels);
+	if (OutData.Format == PF_ETC2_RGB)
+	{
+		CompressLevels(Levels, Image.Width, Image.Height, GetBlockQuality(Compression));
+	}
+
+	OutData.Data.SetNumUninitialized(CalcTextureSize(OutData.Width, OutData.Height, OutData.Format, OutData.NumMips));
+
+	int64 Offset = 0;
+	for (int32 MipIndex = 0; MipIndex < Levels.Num(); ++MipIndex)
+	{
+		const int64 Size = CalcMipSize(FMath::Max(Image.Width >> MipIndex, 1), FMath::Max(Image.Height >> MipIndex, 1), OutData.Format);
+		FMemory::Memcpy(OutData.Data.GetData() + Offset, Levels[MipIndex], Size);
+		FMemory::Free(Levels[MipIndex]);
+		Offset += Size;
+	}
+	return true;
+}
+
+int32 RovrTexture::UpdateAsync(UTexture2D* Texture, TArray<uint8>&& Pixels, int32 Width, int32 Height, ERovrPixelLayout Layout, int64 Stride, ERovrPixelConvertFlags Flags, ERovrMipFilter MipFilter, ERovrCompressQuality Compression, ERovrDecodePriority Priority, FOnEncoded OnEncoded)
+{
+	check(IsInGameThread());
+
+	if (!Texture || !FRovrImageView(Pixels, Width, Height, Layout, Stride).IsValid())
+	{
+		return 0;
+	}
+
+	CancelUpdateAsync(Texture);
+
+	// The source, the BGRA8 levels and the encoded copy of them are alive at once
+	const int32 NumMips = MipFilter != ERovrMipFilter::None ? RovrMipChain::GetNumMips(Width, Height) : 1;
+	const int64 MemoryBytes = Pixels.Num() + CalcTextureSize(Width, Height, PF_B8G8R8A8, NumMips) * 2;
+
+	const TWeakObjectPtr<UTexture2D> WeakTexture(Texture);
+	const int32 Id = FRovrDecodeScheduler::Get().Enqueue(Priority, MemoryBytes, [WeakTexture, Pixels = MoveTemp(Pixels), Width, Height, Layout, Stride, Flags, MipFilter, Compression, OnEncoded = MoveTemp(OnEncoded)](const FRovrDecodeScheduler::FCancelFlag& bCancelled)
+	{
+		const FRovrImageView Image(Pixels, Width, Height, Layout, Stride);
+		FRovrTextureData Encoded;
+		if (!*bCancelled && Encode(Image, Flags, MipFilter, Compression, Encoded) && OnEncoded)
+		{
+			OnEncoded(Image, Encoded.GetView());
+		}
+
+		AsyncTask(ENamedThreads::GameThread, [WeakTexture, Encoded = MoveTemp(Encoded), bCancelled]()
+		{
+			// A cancelled update was replaced or taken out of the map by whoever cancelled it
+			if (*bCancelled)
+			{
+				return;
+			}
+
+			GetPendingUpdates().Remove(WeakTexture);
+			UTexture2D* Target = WeakTexture.Get();
+			if (Target && !Update(Target, Encoded.GetView()))
+			{
+				UE_LOG(LogRovrImaging, Warning, TEXT("Unable to upload encoded %dx%d data with format %d and %d mips into %s"), Encoded.Width, Encoded.Height, int32(Encoded.Format), Encoded.NumMips, *Target->GetName());
+			}
+		});
+	});
+
+	GetPendingUpdates().Add(WeakTexture, Id);
+	return Id;
+}
+
+void RovrTexture::CancelUpdateAsync(UTexture2D* Texture)
+{
+	int32 Id = 0;
+	if (Texture && GetPendingUpdates().RemoveAndCopyValue(Texture, Id))
+	{
+		FRovrDecodeScheduler::Get().Cancel(Id);
+	}
+}
+
+UTexture2D* RovrTexture::CreateTransient(const FRovrTextureDataView& Data, FName Name)
+{
+	if (!Data.IsValid())
+	{
+		UE_LOG(LogRovrImaging, Warning, TEXT("Unable to create a texture from invalid %dx%d texture data (%d bytes, %d mips)"), Data.Width, Data.Height, Data.Data.Num(), Data.NumMips);
+		return nullptr;
+	}
+
+	UTexture2D* Texture = UTexture2D::CreateTransient(Data.Width, Data.Height, Data.Format, Name);
+	if (!Texture)
+	{
+		return nullptr;
+	}
+
+	if (Data.NumMips > 1)
+	{
+		AllocateMipChain(Texture);
+	}
+
+	Fill(Texture, Data);
+	return Texture;
+}
+
+bool RovrTexture::Fill(UTexture2D* Texture, const FRovrTextureDataView& Data)
+{
+	if (!HasCpuCopy(Texture) || !Data.IsValid() || !MatchesData(Texture, Data))
+	{
+		return false;
+	}
+
+	int64 Offset = 0;
+	for (FTexture2DMipMap& Mip : Texture->PlatformData->Mips)
+	{
+		const int64 Size = CalcMipSize(Mip.SizeX, Mip.SizeY, Data.Format);
+		FMemory::Memcpy(Mip.BulkData.Lock(LOCK_READ_WRITE), Data.Data.GetData() + Offset, Size);
+		Mip.BulkData.Unlock();
+		Offset += Size;
+	}
+
+	Texture->UpdateResource();
+	return true;
+}
+
+bool RovrTexture::Update(UTexture2D* Texture, const FRovrTextureDataView& Data)
+{
+	CancelUpdateAsync(Texture);
+	if (!Texture || !Texture->Resource)
+	{
+		return Fill(Texture, Data);
+	}
+
+	if (!Data.IsValid() || !MatchesData(Texture, Data))
+	{
+		return false;
+	}
+
+	FMipLevels Levels;
+	int64 Offset = 0;
+	for (int32 MipIndex = 0; MipIndex < Data.NumMips; ++MipIndex)
+	{
+		const int64 Size = CalcMipSize(FMath::Max(Data.Width >> MipIndex, 1), FMath::Max(Data.Height >> MipIndex, 1), Data.Format);
+		Levels.Add(static_cast<uint8*>(FMemory::Malloc(Size)));
+		FMemory::Memcpy(Levels.Last(), Data.Data.GetData() + Offset, Size);
+		Offset += Size;
+	}
+
+	UploadLevels(Texture, Levels);
+	return true;
+}
+
+UTexture2D* RovrTexture::CreateForUpload(const FRovrUploadTextureDesc& Desc, FName Name)
+{
+	check(IsInGameThread());
+
+	if (Desc.Width <= 0 || Desc.Height <= 0 || (Desc.Format != PF_B8G8R8A8 && Desc.Format != PF_ETC2_RGB)
+		|| (Desc.NumMips != 1 && Desc.NumMips != RovrMipChain::GetNumMips(Desc.Width, Desc.Height)))
+	{
+		UE_LOG(LogRovrImaging, Warning, TEXT("Unable to create a %dx%d upload texture with format %d and %d mips"), Desc.Width, Desc.Height, int32(Desc.Format), Desc.NumMips);
+		return nullptr;
+	}
+
+	UTexture2D* Texture = UTexture2D::CreateTransient(Desc.Width, Desc.Height, Desc.Format, Name);
+	if (!Texture)
+	{
+		return nullptr;
+	}
+
+	if (Desc.NumMips > 1)
+	{
+		AllocateMipChain(Texture);
+	}
+
+	// Transient mips start out uninitialized; single use mips are discarded once the resource read them
+	for (FTexture2DMipMap& Mip : Texture->PlatformData->Mips)
+	{
+		FMemory::Memzero(Mip.BulkData.Lock(LOCK_READ_WRITE), Mip.BulkData.GetBulkDataSize());
+		Mip.BulkData.Unlock();
+
+		if (!Desc.bKeepCpuCopy)
+		{
+			Mip.BulkData.SetBulkDataFlags(BULKDATA_SingleUse);
+		}
+	}
+
+	if (Desc.bClamp)
+	{
+		Texture->AddressX = TA_Clamp;
+		Texture->AddressY = TA_Clamp;
+	}
+
+	Texture->UpdateResource();
+	return Texture;
+}
+
+bool RovrTexture::HasCpuCopy(const UTexture2D* Texture)
+{
+	if (!Texture || !Texture->PlatformData || Texture->PlatformData->Mips.Num() == 0)
+	{
+		return false;
+	}
+	return (Texture->PlatformData->Mips[0].BulkData.GetBulkDataFlags() & BULKDATA_SingleUse) == 0;
+}
+
+bool RovrTexture::UploadRegion(UTexture2D* Texture, int32 MipIndex, FIntPoint Dest, TArray<uint8>&& Pixels, int32 Width, int32 Height, ERovrPixelLayout Layout, int64 Stride, ERovrPixelConvertFlags Flags)
+{
+	check(IsInGameThread());
+
+	const FRovrImageView Image(Pixels, Width, Height, Layout, Stride);
+	if (!Texture || !Texture->Resource || Texture->GetPixelFormat() != PF_B8G8R8A8 || !Image.IsValid() || Image.Stride > MAX_uint32 || !IsRegionInMip(Texture, MipIndex, Dest, Width, Height))
+	{
+		return false;
+	}
+
+	if (HasCpuCopy(Texture))
+	{
+		FTexture2DMipMap& Mip = Texture->PlatformData->Mips[MipIndex];
+		const int64 MipStride = int64(Mip.SizeX) * 4;
+		uint8* MipData = static_cast<uint8*>(Mip.BulkData.Lock(LOCK_READ_WRITE));
+		RovrPixelConvert::ConvertImage(Image.Data.GetData(), Layout, Image.Stride, MipData + Dest.Y * MipStride + int64(Dest.X) * 4, MipStride, Width, Height, Flags);
+		Mip.BulkData.Unlock();
+	}
+
+	const FUpdateTextureRegion2D Region(Dest.X, Dest.Y, 0, 0, Width, Height);
+	EnqueueRegionUpload(Texture, MipIndex, Region, uint32(Image.Stride), MoveTemp(Pixels), Layout, Flags);
+	return true;
+}
+
+bool RovrTexture::UploadRegionData(UTexture2D* Texture, int32 MipIndex, FIntPoint Dest, TArray<uint8>&& Data, int32 Width, int32 Height)
+{
+	check(IsInGameThread());
+
+	if (!Texture || !Texture->Resource || !IsRegionInMip(Texture, MipIndex, Dest, Width, Height) || Data.Num() < CalcMipSize(Width, Height, Texture->GetPixelFormat()))
+	{
+		return false;
+	}
+
+	const FPixelFormatInfo& Info = GPixelFormats[Texture->GetPixelFormat()];
+	const uint32 Pitch = uint32(FMath::DivideAndRoundUp(Width, Info.BlockSizeX) * Info.BlockBytes);
+
+	if (HasCpuCopy(Texture))
+	{
+		FTexture2DMipMap& Mip = Texture->PlatformData->Mips[MipIndex];
+		const int64 MipPitch = int64(FMath::DivideAndRoundUp(int32(Mip.SizeX), Info.BlockSizeX)) * Info.BlockBytes;
+		uint8* MipData = static_cast<uint8*>(Mip.BulkData.Lock(LOCK_READ_WRITE));
+		uint8* DestData = MipData + (Dest.Y / Info.BlockSizeY) * MipPitch + (Dest.X / Info.BlockSizeX) * Info.BlockBytes;
+
+		const int32 NumBlockRows = FMath::DivideAndRoundUp(Height, Info.BlockSizeY);
+		for (int32 BlockRow = 0; BlockRow < NumBlockRows; ++BlockRow)
+		{
+			FMemory::Memcpy(DestData + BlockRow * MipPitch, Data.GetData() + int64(BlockRow) * Pitch, Pitch);
+		}
+		Mip.BulkData.Unlock();
+	}
+
+	const FUpdateTextureRegion2D Region(Dest.X, Dest.Y, 0, 0, Width, Height);
+	EnqueueRegionUpload(Texture, MipIndex, Region, Pitch, MoveTemp(Data), ERovrPixelLayout::BGRA8, ERovrPixelConvertFlags::None);
+	return true;
+}
+
+EPixelFormat RovrTexture::GetTransientFormat(const FRovrImageView& Image, ERovrPixelConvertFlags Flags, ERovrCompressQuality Compression)
+{
+	// Transient textures are created from whole blocks, and ETC2 RGB has no alpha to keep
+	if (Compression == ERovrCompressQuality::None || !RovrBlockCompress::IsETC2Supported() || Image.Width % 4 != 0 || Image.Height % 4 != 0)
+	{
+		return PF_B8G8R8A8;
+	}
+
+	if (!EnumHasAnyFlags(Flags, ERovrPixelConvertFlags::ForceOpaque) && !RovrPixelConvert::IsOpaque(Image.Data.GetData(), Image.Layout, Image.Stride, Image.Width, Image.Height))
+	{
+		return PF_B8G8R8A8;
+	}
+
+	return PF_ETC2_RGB;
+}
+
+int64 RovrTexture::CalcMipSize(int32 Width, int32 Height, EPixelFormat Format)
+{
+	const FPixelFormatInfo& Info = GPixelFormats[Format];
+	return int64(FMath::DivideAndRoundUp(Width, Info.BlockSizeX)) * FMath::DivideAndRoundUp(Height, Info.BlockSizeY) * Info.BlockBytes;
+}
+
+int64 RovrTexture::CalcTextureSize(int32 Width, int32 Height, EPixelFormat Format, int32 NumMips)
+{
+	int64 Size = 0;
+	for (int32 MipIndex = 0; MipIndex < NumMips; ++MipIndex)
+	{
+		Size += CalcMipSize(FMath::Max(Width >> MipIndex, 1), FMath::Max(Height >> MipIndex, 1), Format);
+	}
+	return Size;
+}
+
+ERovrMipFilter RovrTexture::GetDefaultMipFilter()
+{
+	switch (CVarTextureMipFilter.GetValueOnAnyThread())
+	{
+	case 1:
+		return ERovrMipFilter::Box;
+	case 2:
+		return ERovrMipFilter::Kaiser;
+	default:
+		return ERovrMipFilter::None;
+	}
+}
+
+ERovrCompressQuality RovrTexture::GetDefaultCompression()
+{
+	return ERovrCompressQuality(FMath::Clamp(CVarTextureCompression.GetValueOnAnyThread(), 0, int32(ERovrCompressQuality::High)));
+}
@@ -0,0 +1,186 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RovrTexturePool.h"
+#include "RovrImagingDefines.h"
+#include "Engine/Texture2D.h"
+#include "HAL/IConsoleManager.h"
+
+
+namespace
+{
+	TAutoConsoleVariable<int32> CVarTexturePoolMaxIdleMemoryMB(
+		TEXT("rovr.TexturePool.MaxIdleMemoryMB"),
+		64,
+		TEXT("Memory the texture pool may keep in idle textures, in megabytes"),
+		ECVF_Default);
+}
+
+FRovrTexturePool& FRovrTexturePool::Get()
+{
+	static FRovrTexturePool Pool;
+	return Pool;
+}
+
+FRovrTexturePool::FKey FRovrTexturePool::MakeKey(const UTexture2D* Texture)
+{
+	return FKey{ Texture->GetSizeX(), Texture->GetSizeY(), Texture->GetPixelFormat(), Texture->GetNumMips() };
+}
+
+UTexture2D* FRovrTexturePool::AcquireIdle(const FKey& Key)
+{
+	check(IsInGameThread());
+
+	++NumRequests;
+
+	TArray<UTexture2D*>* Candidates = Idle.Find(Key);
+	if (!Candidates || Candidates->Num() == 0)
+	{
+		return nullptr;
+	}
+
+	UTexture2D* Texture = Candidates->Pop(false);
+	IdleOrder.RemoveSingle(Texture);
+	IdleBytes -= RovrTexture::CalcTextureSize(Key.Width, Key.Height, Key.Format, Key.NumMips);
+	++NumHits;
+	return Texture;
+}
+
+UTexture2D* FRovrTexturePool::Acquire(int32 Width, int32 Height, EPixelFormat Format)
+{
+	if (UTexture2D* Texture = AcquireIdle(FKey{ Width, Height, Format, 1 }))
+	{
+		return Texture;
+	}
+
+	return RovrTexture::CreateForUpload(FRovrUploadTextureDesc(Width, Height, Format));
+}
+
+UTexture2D* FRovrTexturePool::AcquireFor(const FRovrImageView& Image, ERovrPixelConvertFlags Flags, ERovrMipFilter MipFilter, ERovrCompressQuality Compression)
+{
+	if (!Image.IsValid())
+	{
+		return nullptr;
+	}
+
+	const EPixelFormat Format = RovrTexture::GetTransientFormat(Image, Flags, Compression);
+	const int32 NumMips = MipFilter != ERovrMipFilter::None ? RovrMipChain::GetNumMips(Image.Width, Image.Height) : 1;
+
+	// Pooled textures are only ever written through their resource, so none keeps a CPU copy
+	if (UTexture2D* Texture = AcquireIdle(FKey{ Image.Width, Image.Height, Format, NumMips }))
+	{
+		return Texture;
+	}
+
+	return RovrTexture::CreateForUpload(FRovrUploadTextureDesc(Image.Width, Image.Height, Format, NumMips));
+}
+
+UTexture2D* FRovrTexturePool::Acquire(const FRovrImageView& Image, ERovrPixelConvertFlags Flags, ERovrMipFilter MipFilter, ERovrCompressQuality Compression)
+{
+	UTexture2D* Texture = AcquireFor(Image, Flags, MipFilter, Compression);
+	if (Texture)
+	{
+		RovrTexture::Update(Texture, Image, Flags, MipFilter, Compression);
+	}
+	return Texture;
+}
+
+UTexture2D* FRovrTexturePool::Acquire(TArray<uint8>&& Pixels, int32 Width, int32 Height, ERovrPixelLayout Layout, int64 Stride, ERovrPixelConvertFlags Flags, ERovrMipFilter MipFilter, ERovrCompressQuality Compression, RovrTexture::FOnEncoded OnEncoded)
+{
+	UTexture2D* Texture = AcquireFor(FRovrImageView(Pixels, Width, Height, Layout, Stride), Flags, MipFilter, Compression);
+	if (!Texture)
+	{
+		return nullptr;
+	}
+
+	if (Texture->GetPixelFormat() == PF_B8G8R8A8 && Texture->GetNumMips() == 1 && !OnEncoded)
+	{
+		RovrTexture::Update(Texture, MoveTemp(Pixels), Width, Height, Layout, Stride, Flags, MipFilter, Compression);
+	}
+	else
+	{
+		RovrTexture::UpdateAsync(Texture, MoveTemp(Pixels), Width, Height, Layout, Stride, Flags, MipFilter, Compression, ERovrDecodePriority::Visible, MoveTemp(OnEncoded));
+	}
+	return Texture;
+}
+
+UTexture2D* FRovrTexturePool::Acquire(const FRovrTextureDataView& Data)
+{
+	if (!Data.IsValid())
+	{
+		return nullptr;
+	}
+
+	UTexture2D* Texture = AcquireIdle(FKey{ Data.Width, Data.Height, Data.Format, Data.NumMips });
+	if (!Texture)
+	{
+		Texture = RovrTexture::CreateForUpload(FRovrUploadTextureDesc(Data.Width, Data.Height, Data.Format, Data.NumMips));
+		if (!Texture)
+		{
+			return nullptr;
+		}
+	}
+
+	RovrTexture::Update(Texture, Data);
+	return Texture;
+}
+
+void FRovrTexturePool::Release(UTexture2D* Texture)
+{
+	check(IsInGameThread());
+
+	if (!Texture || IdleOrder.Contains(Texture))
+	{
+		return;
+	}
+
+	// Pixels still being encoded for the previous owner must not land in the next one's texture
+	RovrTexture::CancelUpdateAsync(Texture);
+
+	const FKey Key = MakeKey(Texture);
+	Idle.FindOrAdd(Key).Add(Texture);
+	IdleOrder.Add(Texture);
+	IdleBytes += RovrTexture::CalcTextureSize(Key.Width, Key.Height, Key.Format, Key.NumMips);
+
+	Trim(int64(CVarTexturePoolMaxIdleMemoryMB.GetValueOnGameThread()) * 1024 * 1024);
+}
+
+void FRovrTexturePool::Trim(int64 MaxIdleBytes)
+{
+	int32 NumDropped = 0;
+	while (IdleBytes > MaxIdleBytes && NumDropped < IdleOrder.Num())
+	{
+		UTexture2D* Texture = IdleOrder[NumDropped++];
+
+		const FKey Key = MakeKey(Texture);
+		Idle.FindChecked(Key).RemoveSingle(Texture);
+		IdleBytes -= RovrTexture::CalcTextureSize(Key.Width, Key.Height, Key.Format, Key.NumMips);
+	}
+
+	// Dropped textures are no longer referenced and left to the garbage collector
+	IdleOrder.RemoveAt(0, NumDropped, false);
+
+	if (NumDropped > 0)
+	{
+		UE_LOG(LogRovrImaging, Verbose, TEXT("Texture pool dropped %d idle textures, hit rate %.1f%%"), NumDropped, GetStats().GetHitRate() * 100.0f);
+	}
+}
+
+FRovrTexturePool::FStats FRovrTexturePool::GetStats() const
+{
+	FStats Stats;
+	Stats.NumRequests = NumRequests;
+	Stats.NumHits = NumHits;
+	Stats.NumIdle = IdleOrder.Num();
+	Stats.IdleBytes = IdleBytes;
+	return Stats;
+}
+
+void FRovrTexturePool::AddReferencedObjects(FReferenceCollector& Collector)
+{
+	Collector.AddReferencedObjects(IdleOrder);
+}
+
+FString FRovrTexturePool::GetReferencerName() const
+{
+	return TEXT("FRovrTexturePool");
+}
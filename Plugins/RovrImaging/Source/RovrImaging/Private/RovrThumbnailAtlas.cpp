@@ -0,0 +1,229 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RovrThumbnailAtlas.h"
+#include "RovrImagingDefines.h"
+#include "Engine/Texture2D.h"
+
+
+namespace
+{
+	/** Slots start on block boundaries, so ETC2 thumbnails can be uploaded into a page as they are */
+	const int32 SlotAlignment = 4;
+}
+
+FRovrAtlasSlot URovrThumbnailAtlas::Add(uint64 Key, const FRovrTextureDataView& Data)
+{
+	check(IsInGameThread());
+
+	const FRovrAtlasSlot Existing = Acquire(Key);
+	if (Existing.IsValid())
+	{
+		return Existing;
+	}
+
+	if (!Data.IsValid())
+	{
+		return FRovrAtlasSlot();
+	}
+
+	const FIntPoint PaddedSize(Align(Data.Width, SlotAlignment), Align(Data.Height, SlotAlignment));
+	if (PaddedSize.X > PageSize || PaddedSize.Y > PageSize)
+	{
+		UE_LOG(LogRovrImaging, Warning, TEXT("A %dx%d thumbnail does not fit into %dx%d atlas pages"), Data.Width, Data.Height, PageSize, PageSize);
+		return FRovrAtlasSlot();
+	}
+
+	FSlot Slot;
+	Slot.Key = Key;
+	Slot.Size = FIntPoint(Data.Width, Data.Height);
+	Slot.NumUsers = 1;
+	if (!Allocate(Data.Format, PaddedSize, Slot.Page, Slot.Rect))
+	{
+		return FRovrAtlasSlot();
+	}
+
+	// Mip 0 comes first in the data; the render thread gets its own copy
+	TArray<uint8> Mip0(Data.Data.GetData(), int32(RovrTexture::CalcMipSize(Data.Width, Data.Height, Data.Format)));
+	RovrTexture::UploadRegionData(PageTextures[Slot.Page], 0, Slot.Rect.Min, MoveTemp(Mip0), Data.Width, Data.Height);
+
+	const int32 SlotId = NextSlotId++;
+	Slots.Add(SlotId, Slot);
+	KeyToSlot.Add(Key, SlotId);
+	++Pages[Slot.Page].NumSlots;
+
+	return MakeSlot(SlotId, Slot);
+}
+
+FRovrAtlasSlot URovrThumbnailAtlas::Acquire(uint64 Key)
+{
+	check(IsInGameThread());
+
+	const int32* SlotId = KeyToSlot.Find(Key);
+	if (!SlotId)
+	{
+		return FRovrAtlasSlot();
+	}
+
+	FSlot& Slot = Slots.FindChecked(*SlotId);
+	++Slot.NumUsers;
+	return MakeSlot(*SlotId, Slot);
+}
+
+FRovrAtlasSlot URovrThumbnailAtlas::Find(uint64 Key) const
+{
+	const int32* SlotId = KeyToSlot.Find(Key);
+	return SlotId ? MakeSlot(*SlotId, Slots.FindChecked(*SlotId)) : FRovrAtlasSlot();
+}
+
+void URovrThumbnailAtlas::Release(const FRovrAtlasSlot& Slot)
+{
+	check(IsInGameThread());
+
+	FSlot* Held = Slots.Find(Slot.Id);
+	if (!Held || --Held->NumUsers > 0)
+	{
+		return;
+	}
+
+	const FSlot Released = *Held;
+	Slots.Remove(Slot.Id);
+	KeyToSlot.Remove(Released.Key);
+
+	FPage& Page = Pages[Released.Page];
+	if (--Page.NumSlots > 0)
+	{
+		Page.FreeRects.Add(Released.Rect);
+		return;
+	}
+
+	// Nothing is left on the page, so it can be packed again from scratch
+	Page.Shelves.Reset();
+	Page.FreeRects.Reset();
+	Page.ShelfTop = 0;
+}
+
+void URovrThumbnailAtlas::Reset()
+{
+	Slots.Reset();
+	KeyToSlot.Reset();
+	for (FPage& Page : Pages)
+	{
+		Page.Shelves.Reset();
+		Page.FreeRects.Reset();
+		Page.ShelfTop = 0;
+		Page.NumSlots = 0;
+	}
+}
+
+FSlateBrush URovrThumbnailAtlas::MakeBrush(const FRovrAtlasSlot& Slot)
+{
+	FSlateBrush Brush;
+	if (Slot.IsValid())
+	{
+		Brush.SetResourceObject(Slot.Page);
+		Brush.ImageSize = Slot.Size;
+		Brush.SetUVRegion(FBox2D(Slot.UVMin, Slot.UVMax));
+	}
+	return Brush;
+}
+
+bool URovrThumbnailAtlas::Allocate(EPixelFormat Format, FIntPoint PaddedSize, int32& OutPage, FIntRect& OutRect)
+{
+	for (int32 PageIndex = 0; PageIndex < Pages.Num(); ++PageIndex)
+	{
+		if (Pages[PageIndex].Format == Format && AllocateInPage(PageIndex, PaddedSize, OutRect))
+		{
+			OutPage = PageIndex;
+			return true;
+		}
+	}
+
+	// Slots are sampled right up to their edges, which must not wrap to the other side of the page
+	const int32 Size = Align(FMath::Max(PageSize, SlotAlignment), SlotAlignment);
+	FRovrUploadTextureDesc Desc(Size, Size, Format);
+	Desc.bClamp = true;
+
+	UTexture2D* Texture = RovrTexture::CreateForUpload(Desc);
+	if (!Texture)
+	{
+		return false;
+	}
+
+	PageTextures.Add(Texture);
+	FPage& Page = Pages.AddDefaulted_GetRef();
+	Page.Format = Format;
+	Page.Size = Size;
+
+	OutPage = Pages.Num() - 1;
+	return AllocateInPage(OutPage, PaddedSize, OutRect);
+}
+
+bool URovrThumbnailAtlas::AllocateInPage(int32 PageIndex, FIntPoint PaddedSize, FIntRect& OutRect)
+{
+	FPage& Page = Pages[PageIndex];
+
+	// Lobby thumbnails mostly share a size, so a released slot usually fits the next thumbnail exactly
+	int32 BestFree = INDEX_NONE;
+	int64 BestWaste = MAX_int64;
+	for (int32 Index = 0; Index < Page.FreeRects.Num(); ++Index)
+	{
+		const FIntRect& Free = Page.FreeRects[Index];
+		if (Free.Width() >= PaddedSize.X && Free.Height() >= PaddedSize.Y)
+		{
+			const int64 Waste = int64(Free.Area()) - int64(PaddedSize.X) * PaddedSize.Y;
+			if (Waste < BestWaste)
+			{
+				BestFree = Index;
+				BestWaste = Waste;
+			}
+		}
+	}
+
+	if (BestFree != INDEX_NONE)
+	{
+		OutRect = Page.FreeRects[BestFree];
+		Page.FreeRects.RemoveAtSwap(BestFree);
+		return true;
+	}
+
+	// The lowest shelf the thumbnail fits on wastes the least height
+	FShelf* BestShelf = nullptr;
+	for (FShelf& Shelf : Page.Shelves)
+	{
+		if (Shelf.Height >= PaddedSize.Y && Shelf.X + PaddedSize.X <= Page.Size && (!BestShelf || Shelf.Height < BestShelf->Height))
+		{
+			BestShelf = &Shelf;
+		}
+	}
+
+	if (!BestShelf)
+	{
+		if (Page.ShelfTop + PaddedSize.Y > Page.Size || PaddedSize.X > Page.Size)
+		{
+			return false;
+		}
+
+		BestShelf = &Page.Shelves.AddDefaulted_GetRef();
+		BestShelf->Y = Page.ShelfTop;
+		BestShelf->Height = PaddedSize.Y;
+		Page.ShelfTop += PaddedSize.Y;
+	}
+
+	// A slot keeps the shelf's full height, so it can later take any thumbnail that fits the shelf
+	OutRect = FIntRect(BestShelf->X, BestShelf->Y, BestShelf->X + PaddedSize.X, BestShelf->Y + BestShelf->Height);
+	BestShelf->X += PaddedSize.X;
+	return true;
+}
+
+FRovrAtlasSlot URovrThumbnailAtlas::MakeSlot(int32 SlotId, const FSlot& Slot) const
+{
+	const float Scale = 1.0f / Pages[Slot.Page].Size;
+
+	FRovrAtlasSlot Result;
+	Result.Id = SlotId;
+	Result.Page = PageTextures[Slot.Page];
+	Result.UVMin = FVector2D(Slot.Rect.Min.X + 0.5f, Slot.Rect.Min.Y + 0.5f) * Scale;
+	Result.UVMax = FVector2D(Slot.Rect.Min.X + Slot.Size.X - 0.5f, Slot.Rect.Min.Y + Slot.Size.Y - 0.5f) * Scale;
+	Result.Size = FVector2D(Slot.Size);
+	return Result;
+}
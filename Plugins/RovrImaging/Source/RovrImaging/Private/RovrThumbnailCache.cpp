@@ -0,0 +1,532 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RovrThumbnailCache.h"
+#include "RovrImagingDefines.h"
+#include "RovrTexturePool.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Hash/CityHash.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+
+
+namespace
+{
+	TAutoConsoleVariable<int32> CVarThumbnailCacheMaxSizeMB(
+		TEXT("rovr.ThumbnailCache.MaxSizeMB"),
+		64,
+		TEXT("Size the thumbnail cache may take on disk, in megabytes"),
+		ECVF_Default);
+
+	const uint32 CacheMagic = 0x43545652;
+	const uint32 CacheVersion = 1;
+
+	/** Entry data starts on this boundary, so mapped mips are aligned for copying */
+	const int64 DataAlignment = 16;
+
+	/**
+	 * Container layout: header, one record per entry, then the entry data. Written in native byte order,
+	 * which is little endian on every target
+	 */
+	struct FFileHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint32 NumEntries;
+		uint32 Reserved;
+		uint64 UseCounter;
+	};
+
+	struct FFileRecord
+	{
+		uint64 Key;
+		uint64 FileId;
+		uint64 Stamp;
+		uint64 LastUsed;
+		int64 Offset;
+		int64 Size;
+		int32 Width;
+		int32 Height;
+		uint8 Format;
+		uint8 NumMips;
+		uint8 Padding[6];
+	};
+	static_assert(sizeof(FFileHeader) == 24, "The thumbnail cache header must not change size");
+	static_assert(sizeof(FFileRecord) == 64, "Thumbnail cache records must not change size");
+
+	/** Pixel formats as stored in the container, independent of the engine's enum */
+	uint8 ToFileFormat(EPixelFormat Format)
+	{
+		return Format == PF_ETC2_RGB ? 1 : 0;
+	}
+
+	EPixelFormat FromFileFormat(uint8 Format)
+	{
+		switch (Format)
+		{
+		case 0:
+			return PF_B8G8R8A8;
+		case 1:
+			return PF_ETC2_RGB;
+		default:
+			return PF_Unknown;
+		}
+	}
+}
+
+FRovrThumbnailCache& FRovrThumbnailCache::Get()
+{
+	static FRovrThumbnailCache Cache;
+	return Cache;
+}
+
+uint64 FRovrThumbnailCache::MakeFileId(const FString& Path)
+{
+	return CityHash64(reinterpret_cast<const char*>(*Path), Path.Len() * sizeof(TCHAR));
+}
+
+uint64 FRovrThumbnailCache::MakeStamp(int64 Size, const FDateTime& ModificationTime)
+{
+	const int64 Values[2] = { Size, ModificationTime.GetTicks() };
+	return CityHash64(reinterpret_cast<const char*>(Values), sizeof(Values));
+}
+
+FRovrThumbnailCache::FRovrThumbnailCache()
+	: Filename(FPaths::ProjectSavedDir() / TEXT("RovrThumbnails.cache"))
+{
+	Open();
+}
+
+FRovrThumbnailCache::~FRovrThumbnailCache()
+{
+	Close();
+}
+
+void FRovrThumbnailCache::Open()
+{
+	Entries.Reset();
+	TotalBytes = 0;
+
+	if (!MapFile())
+	{
+		return;
+	}
+
+	FFileHeader Header;
+	if (FileSize < int64(sizeof(Header)))
+	{
+		Close();
+		return;
+	}
+	FMemory::Memcpy(&Header, FileData, sizeof(Header));
+
+	const int64 TableEnd = int64(sizeof(FFileHeader)) + int64(Header.NumEntries) * sizeof(FFileRecord);
+	if (Header.Magic != CacheMagic || Header.Version != CacheVersion || TableEnd > FileSize)
+	{
+		UE_LOG(LogRovrImaging, Warning, TEXT("Ignoring thumbnail cache %s: unknown version or truncated"), *Filename);
+		Close();
+		bDirty = true;
+		return;
+	}
+
+	UseCounter = Header.UseCounter;
+	Entries.Reserve(Header.NumEntries);
+
+	for (uint32 Index = 0; Index < Header.NumEntries; ++Index)
+	{
+		FFileRecord Record;
+		FMemory::Memcpy(&Record, FileData + sizeof(FFileHeader) + Index * sizeof(FFileRecord), sizeof(Record));
+
+		FEntry Entry;
+		Entry.FileId = Record.FileId;
+		Entry.Stamp = Record.Stamp;
+		Entry.LastUsed = Record.LastUsed;
+		Entry.Width = Record.Width;
+		Entry.Height = Record.Height;
+		Entry.NumMips = Record.NumMips;
+		Entry.Format = FromFileFormat(Record.Format);
+		Entry.FileOffset = Record.Offset;
+		Entry.Size = Record.Size;
+
+		// A damaged record loses its entry, not the whole cache
+		const bool bInFile = Record.Offset >= TableEnd && Record.Size > 0 && Record.Offset + Record.Size <= FileSize;
+		if (!bInFile || !GetData(Entry).IsValid() || Record.Size != RovrTexture::CalcTextureSize(Entry.Width, Entry.Height, Entry.Format, Entry.NumMips))
+		{
+			bDirty = true;
+			continue;
+		}
+
+		TotalBytes += Entry.Size;
+		Entries.Add(Record.Key, MoveTemp(Entry));
+	}
+
+	UE_LOG(LogRovrImaging, Log, TEXT("Thumbnail cache %s holds %d entries (%lld KiB), %s"), *Filename, Entries.Num(), TotalBytes / 1024, MappedRegion.IsValid() ? TEXT("mapped") : TEXT("loaded"));
+}
+
+bool FRovrThumbnailCache::MapFile()
+{
+	Close();
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	if (!PlatformFile.FileExists(*Filename))
+	{
+		return false;
+	}
+
+	MappedFile.Reset(PlatformFile.OpenMapped(*Filename));
+	if (MappedFile.IsValid() && MappedFile->GetFileSize() > 0)
+	{
+		MappedRegion.Reset(MappedFile->MapRegion(0, MappedFile->GetFileSize()));
+	}
+
+	if (MappedRegion.IsValid())
+	{
+		FileData = MappedRegion->GetMappedPtr();
+		FileSize = MappedRegion->GetMappedSize();
+		return true;
+	}
+
+	// Not every platform file can map; a plain read still saves the platform decodes
+	MappedFile.Reset();
+	if (!FFileHelper::LoadFileToArray(LoadedFile, *Filename))
+	{
+		return false;
+	}
+	FileData = LoadedFile.GetData();
+	FileSize = LoadedFile.Num();
+	return true;
+}
+
+void FRovrThumbnailCache::Close()
+{
+	// The region points into the handle, so it goes first
+	MappedRegion.Reset();
+	MappedFile.Reset();
+	LoadedFile.Empty();
+	FileData = nullptr;
+	FileSize = 0;
+}
+
+FRovrTextureDataView FRovrThumbnailCache::GetData(const FEntry& Entry) const
+{
+	FRovrTextureDataView View;
+	View.Data = Entry.FileOffset != INDEX_NONE ? TArrayView<const uint8>(FileData + Entry.FileOffset, Entry.Size) : TArrayView<const uint8>(*Entry.Pending);
+	View.Width = Entry.Width;
+	View.Height = Entry.Height;
+	View.NumMips = Entry.NumMips;
+	View.Format = Entry.Format;
+	return View;
+}
+
+bool FRovrThumbnailCache::Find(uint64 Key, uint64 Stamp, TFunctionRef<void(const FRovrTextureDataView&)> Visitor)
+{
+	FScopeLock ScopeLock(&Lock);
+
+	++NumLookups;
+
+	FEntry* Entry = Entries.Find(Key);
+	if (!Entry)
+	{
+		return false;
+	}
+
+	if (Entry->Stamp != Stamp)
+	{
+		// The file changed since the thumbnail was made
+		RemoveEntry(Key);
+		return false;
+	}
+
+	// Use order alone does not make the container worth rewriting, so it is saved with the next change
+	Entry->LastUsed = ++UseCounter;
+	++NumHits;
+
+	Visitor(GetData(*Entry));
+	return true;
+}
+
+UTexture2D* FRovrThumbnailCache::Acquire(uint64 Key, uint64 Stamp)
+{
+	check(IsInGameThread());
+
+	UTexture2D* Texture = nullptr;
+	Find(Key, Stamp, [&Texture](const FRovrTextureDataView& Data)
+	{
+		Texture = FRovrTexturePool::Get().Acquire(Data);
+	});
+	return Texture;
+}
+
+void FRovrThumbnailCache::Add(uint64 Key, uint64 FileId, uint64 Stamp, const FRovrTextureDataView& Data)
+{
+	if (!Data.IsValid())
+	{
+		return;
+	}
+
+	const int64 Size = RovrTexture::CalcTextureSize(Data.Width, Data.Height, Data.Format, Data.NumMips);
+
+	FScopeLock ScopeLock(&Lock);
+
+	RemoveEntry(Key);
+
+	FEntry Entry;
+	Entry.FileId = FileId;
+	Entry.Stamp = Stamp;
+	Entry.LastUsed = ++UseCounter;
+	Entry.Width = Data.Width;
+	Entry.Height = Data.Height;
+	Entry.NumMips = Data.NumMips;
+	Entry.Format = Data.Format;
+	Entry.Size = Size;
+	Entry.Pending = MakeShared<TArray<uint8>, ESPMode::ThreadSafe>(Data.Data.GetData(), int32(Size));
+
+	TotalBytes += Size;
+	Entries.Add(Key, MoveTemp(Entry));
+	bDirty = true;
+
+	EvictToFit(int64(CVarThumbnailCacheMaxSizeMB.GetValueOnAnyThread()) * 1024 * 1024);
+}
+
+void FRovrThumbnailCache::RemoveFile(uint64 FileId)
+{
+	FScopeLock ScopeLock(&Lock);
+
+	TArray<uint64> Keys;
+	for (const TPair<uint64, FEntry>& Pair : Entries)
+	{
+		if (Pair.Value.FileId == FileId)
+		{
+			Keys.Add(Pair.Key);
+		}
+	}
+
+	for (const uint64 Key : Keys)
+	{
+		RemoveEntry(Key);
+	}
+
+	ContentIds.Remove(FileId);
+}
+
+void FRovrThumbnailCache::SetContentId(uint64 FileId, uint64 Stamp, uint64 ContentId)
+{
+	FScopeLock ScopeLock(&Lock);
+
+	ContentIds.Add(FileId, TPair<uint64, uint64>(Stamp, ContentId));
+}
+
+void FRovrThumbnailCache::ResolveContent(uint64& InOutFileId, uint64& InOutStamp) const
+{
+	FScopeLock ScopeLock(&Lock);
+
+	// Content ids of rewritten files no longer apply
+	const TPair<uint64, uint64>* Content = ContentIds.Find(InOutFileId);
+	if (Content && Content->Key == InOutStamp)
+	{
+		InOutFileId = Content->Value;
+		InOutStamp = Content->Value;
+	}
+}
+
+void FRovrThumbnailCache::RemoveEntry(uint64 Key)
+{
+	FEntry Entry;
+	if (Entries.RemoveAndCopyValue(Key, Entry))
+	{
+		TotalBytes -= Entry.Size;
+		bDirty = true;
+	}
+}
+
+void FRovrThumbnailCache::EvictToFit(int64 MaxBytes)
+{
+	if (TotalBytes <= MaxBytes)
+	{
+		return;
+	}
+
+	TArray<TPair<uint64, uint64>> ByUse;
+	ByUse.Reserve(Entries.Num());
+	for (const TPair<uint64, FEntry>& Pair : Entries)
+	{
+		ByUse.Emplace(Pair.Value.LastUsed, Pair.Key);
+	}
+	ByUse.Sort([](const TPair<uint64, uint64>& A, const TPair<uint64, uint64>& B) { return A.Key < B.Key; });
+
+	int32 NumEvicted = 0;
+	for (const TPair<uint64, uint64>& Used : ByUse)
+	{
+		if (TotalBytes <= MaxBytes)
+		{
+			break;
+		}
+		RemoveEntry(Used.Value);
+		++NumEvicted;
+	}
+
+	UE_LOG(LogRovrImaging, Verbose, TEXT("Thumbnail cache evicted %d entries, %lld KiB left"), NumEvicted, TotalBytes / 1024);
+}
+
+void FRovrThumbnailCache::Save()
+{
+	FScopeLock SaveScopeLock(&SaveLock);
+
+	/** Where the data of a record comes from, to find the entries that still hold it once the file is written */
+	struct FSource
+	{
+		uint64 Key;
+		int64 FileOffset;
+		TSharedPtr<TArray<uint8>, ESPMode::ThreadSafe> Pending;
+	};
+
+	FFileHeader Header = {};
+	TArray<FFileRecord> Records;
+	TArray<FSource> Sources;
+	{
+		FScopeLock ScopeLock(&Lock);
+
+		if (!bDirty)
+		{
+			return;
+		}
+
+		EvictToFit(int64(CVarThumbnailCacheMaxSizeMB.GetValueOnAnyThread()) * 1024 * 1024);
+
+		Header.Magic = CacheMagic;
+		Header.Version = CacheVersion;
+		Header.NumEntries = uint32(Entries.Num());
+		Header.UseCounter = UseCounter;
+
+		Records.Reserve(Entries.Num());
+		Sources.Reserve(Entries.Num());
+
+		int64 Offset = Align(int64(sizeof(FFileHeader)) + int64(Entries.Num()) * sizeof(FFileRecord), DataAlignment);
+		for (const TPair<uint64, FEntry>& Pair : Entries)
+		{
+			const FEntry& Entry = Pair.Value;
+
+			FFileRecord& Record = Records.AddZeroed_GetRef();
+			Record.Key = Pair.Key;
+			Record.FileId = Entry.FileId;
+			Record.Stamp = Entry.Stamp;
+			Record.LastUsed = Entry.LastUsed;
+			Record.Offset = Offset;
+			Record.Size = Entry.Size;
+			Record.Width = Entry.Width;
+			Record.Height = Entry.Height;
+			Record.Format = ToFileFormat(Entry.Format);
+			Record.NumMips = uint8(Entry.NumMips);
+
+			Sources.Add(FSource{ Pair.Key, Entry.FileOffset, Entry.Pending });
+
+			Offset = Align(Offset + Entry.Size, DataAlignment);
+		}
+
+		// Changes made while the container is written mark it dirty again
+		bDirty = false;
+	}
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+	// The new container is written next to the mapped one, which still provides the data of older entries
+	const FString TempFilename = Filename + TEXT(".tmp");
+	bool bWritten = false;
+	{
+		TUniquePtr<IFileHandle> File(PlatformFile.OpenWrite(*TempFilename));
+		if (File.IsValid())
+		{
+			const uint8 Padding[DataAlignment] = {};
+			bWritten = File->Write(reinterpret_cast<const uint8*>(&Header), sizeof(Header))
+				&& File->Write(reinterpret_cast<const uint8*>(Records.GetData()), Records.Num() * sizeof(FFileRecord));
+
+			for (int32 Index = 0; Index < Records.Num() && bWritten; ++Index)
+			{
+				const FSource& Source = Sources[Index];
+				const uint8* Data = Source.Pending.IsValid() ? Source.Pending->GetData() : FileData + Source.FileOffset;
+
+				const int64 Position = File->Tell();
+				bWritten = File->Write(Padding, Records[Index].Offset - Position) && File->Write(Data, Records[Index].Size);
+			}
+		}
+	}
+
+	FScopeLock ScopeLock(&Lock);
+
+	if (!bWritten)
+	{
+		UE_LOG(LogRovrImaging, Warning, TEXT("Unable to write thumbnail cache %s"), *TempFilename);
+		PlatformFile.DeleteFile(*TempFilename);
+		bDirty = true;
+		return;
+	}
+
+	// The mapping has to go before the file it maps is replaced, and the old file is only deleted once
+	// the new one took its place
+	Close();
+	const FString BackupFilename = Filename + TEXT(".old");
+	const bool bHadFile = PlatformFile.FileExists(*Filename);
+	PlatformFile.DeleteFile(*BackupFilename);
+
+	const bool bMovedAside = !bHadFile || PlatformFile.MoveFile(*BackupFilename, *Filename);
+	if (!bMovedAside || !PlatformFile.MoveFile(*Filename, *TempFilename))
+	{
+		UE_LOG(LogRovrImaging, Warning, TEXT("Unable to replace thumbnail cache %s"), *Filename);
+		if (bHadFile && bMovedAside)
+		{
+			PlatformFile.MoveFile(*Filename, *BackupFilename);
+		}
+		PlatformFile.DeleteFile(*TempFilename);
+
+		// Entries keep their data in the old container
+		MapFile();
+		bDirty = true;
+		return;
+	}
+	PlatformFile.DeleteFile(*BackupFilename);
+
+	const bool bMapped = MapFile();
+
+	// Entries replaced or added while the file was written keep their own data
+	for (int32 Index = 0; Index < Sources.Num(); ++Index)
+	{
+		const FSource& Source = Sources[Index];
+		FEntry* Entry = Entries.Find(Source.Key);
+		if (Entry && Entry->Pending == Source.Pending && (Source.Pending.IsValid() || Entry->FileOffset == Source.FileOffset))
+		{
+			Entry->FileOffset = Records[Index].Offset;
+			Entry->Pending.Reset();
+		}
+	}
+
+	if (!bMapped)
+	{
+		UE_LOG(LogRovrImaging, Warning, TEXT("Unable to read back thumbnail cache %s"), *Filename);
+		TArray<uint64> Unreadable;
+		for (const TPair<uint64, FEntry>& Pair : Entries)
+		{
+			if (Pair.Value.FileOffset != INDEX_NONE)
+			{
+				Unreadable.Add(Pair.Key);
+			}
+		}
+		for (const uint64 Key : Unreadable)
+		{
+			RemoveEntry(Key);
+		}
+	}
+}
+
+FRovrThumbnailCache::FStats FRovrThumbnailCache::GetStats() const
+{
+	FScopeLock ScopeLock(&Lock);
+
+	FStats Stats;
+	Stats.NumEntries = Entries.Num();
+	Stats.TotalBytes = TotalBytes;
+	Stats.NumLookups = NumLookups;
+	Stats.NumHits = NumHits;
+	return Stats;
+}
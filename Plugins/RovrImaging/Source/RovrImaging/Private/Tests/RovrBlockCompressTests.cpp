@@ -0,0 +1,361 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "Math/RandomStream.h"
+#include "HAL/PlatformTime.h"
+#include "IImageWrapper.h"
+#include "IImageWrapperModule.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Modules/ModuleManager.h"
+#include "RovrBlockCompress.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	const int32 ModifierTable[8][4] =
+	{
+		{ 2, 8, -2, -8 }, { 5, 17, -5, -17 }, { 9, 29, -9, -29 }, { 13, 42, -13, -42 },
+		{ 18, 60, -18, -60 }, { 24, 80, -24, -80 }, { 33, 106, -33, -106 }, { 47, 183, -47, -183 }
+	};
+
+	int32 SignExtend3(int32 Value)
+	{
+		return Value >= 4 ? Value - 8 : Value;
+	}
+
+	/**
+	 * Decode an ETC2 RGB block in the individual, differential or planar mode, as the specification
+	 * describes them, into RGB texels indexed by X * 4 + Y
+	 *
+	 * @return False for the T and H modes, which the encoder never writes
+	 */
+	bool DecodeBlock(const uint8* Block, int32 (&OutTexels)[16][3])
+	{
+		const bool bDifferential = (Block[3] & 2) != 0;
+		int32 Bases[2][3];
+
+		if (bDifferential)
+		{
+			for (int32 Channel = 0; Channel < 3; ++Channel)
+			{
+				const int32 Base = Block[Channel] >> 3;
+				const int32 Second = Base + SignExtend3(Block[Channel] & 7);
+				if (Second < 0 || Second > 31)
+				{
+					// Red or green out of range select T or H; blue out of range selects planar
+					if (Channel < 2)
+					{
+						return false;
+					}
+
+					int32 RO = (Block[0] >> 1) & 0x3F;
+					int32 GO = ((Block[0] & 1) << 6) | ((Block[1] >> 1) & 0x3F);
+					int32 BO = ((Block[1] & 1) << 5) | (Block[2] & 0x18) | ((Block[2] & 3) << 1) | (Block[3] >> 7);
+					int32 RH = ((Block[3] & 0x7C) >> 1) | (Block[3] & 1);
+					int32 GH = Block[4] >> 1;
+					int32 BH = ((Block[4] & 1) << 5) | (Block[5] >> 3);
+					int32 RV = ((Block[5] & 7) << 3) | (Block[6] >> 5);
+					int32 GV = ((Block[6] & 0x1F) << 2) | (Block[7] >> 6);
+					int32 BV = Block[7] & 0x3F;
+
+					// 6 bit red and blue, 7 bit green, widened by repeating their top bits
+					RO = (RO << 2) | (RO >> 4); RH = (RH << 2) | (RH >> 4); RV = (RV << 2) | (RV >> 4);
+					GO = (GO << 1) | (GO >> 6); GH = (GH << 1) | (GH >> 6); GV = (GV << 1) | (GV >> 6);
+					BO = (BO << 2) | (BO >> 4); BH = (BH << 2) | (BH >> 4); BV = (BV << 2) | (BV >> 4);
+
+					const int32 Origin[3] = { RO, GO, BO };
+					const int32 Horizontal[3] = { RH, GH, BH };
+					const int32 Vertical[3] = { RV, GV, BV };
+					for (int32 X = 0; X < 4; ++X)
+					{
+						for (int32 Y = 0; Y < 4; ++Y)
+						{
+							for (int32 Plane = 0; Plane < 3; ++Plane)
+							{
+								OutTexels[X * 4 + Y][Plane] = FMath::Clamp((X * (Horizontal[Plane] - Origin[Plane]) + Y * (Vertical[Plane] - Origin[Plane]) + 4 * Origin[Plane] + 2) >> 2, 0, 255);
+							}
+						}
+					}
+					return true;
+				}
+
+				Bases[0][Channel] = (Base << 3) | (Base >> 2);
+				Bases[1][Channel] = (Second << 3) | (Second >> 2);
+			}
+		}
+		else
+		{
+			for (int32 Channel = 0; Channel < 3; ++Channel)
+			{
+				Bases[0][Channel] = (Block[Channel] >> 4) * 17;
+				Bases[1][Channel] = (Block[Channel] & 15) * 17;
+			}
+		}
+
+		const int32 Tables[2] = { Block[3] >> 5, (Block[3] >> 2) & 7 };
+		const bool bFlip = (Block[3] & 1) != 0;
+		const uint32 Indices = (uint32(Block[4]) << 24) | (uint32(Block[5]) << 16) | (uint32(Block[6]) << 8) | Block[7];
+
+		for (int32 X = 0; X < 4; ++X)
+		{
+			for (int32 Y = 0; Y < 4; ++Y)
+			{
+				const int32 Bit = X * 4 + Y;
+				const int32 Index = ((Indices >> (15 + Bit)) & 2) | ((Indices >> Bit) & 1);
+				const int32 Subblock = bFlip ? (Y >= 2) : (X >= 2);
+				for (int32 Channel = 0; Channel < 3; ++Channel)
+				{
+					OutTexels[Bit][Channel] = FMath::Clamp(Bases[Subblock][Channel] + ModifierTable[Tables[Subblock]][Index], 0, 255);
+				}
+			}
+		}
+		return true;
+	}
+
+	struct FRoundTrip
+	{
+		bool bDecoded = true;
+		double Psnr = 0.0;
+		int32 MaxError = 0;
+	};
+
+	/** Encode a BGRA8 image, decode it again and measure the error over the pixels inside the image */
+	FRoundTrip RoundTrip(const TArray<uint8>& Image, int32 Width, int32 Height, ERovrCompressQuality Quality)
+	{
+		const int32 BlocksX = FMath::DivideAndRoundUp(Width, 4);
+		const int32 BlocksY = FMath::DivideAndRoundUp(Height, 4);
+		TArray<uint8> Blocks;
+		Blocks.SetNumUninitialized(BlocksX * BlocksY * 8);
+		RovrBlockCompress::CompressETC2(Image.GetData(), Width * 4, Width, Height, Blocks.GetData(), Quality);
+
+		FRoundTrip Result;
+		double SquaredError = 0.0;
+		for (int32 BlockY = 0; BlockY < BlocksY; ++BlockY)
+		{
+			for (int32 BlockX = 0; BlockX < BlocksX; ++BlockX)
+			{
+				int32 Texels[16][3];
+				if (!DecodeBlock(&Blocks[(BlockY * BlocksX + BlockX) * 8], Texels))
+				{
+					Result.bDecoded = false;
+					continue;
+				}
+
+				for (int32 X = 0; X < 4; ++X)
+				{
+					for (int32 Y = 0; Y < 4; ++Y)
+					{
+						const int32 PixelX = BlockX * 4 + X;
+						const int32 PixelY = BlockY * 4 + Y;
+						if (PixelX >= Width || PixelY >= Height)
+						{
+							continue;
+						}
+
+						const uint8* Pixel = &Image[(PixelY * Width + PixelX) * 4];
+						const int32 Rgb[3] = { Pixel[2], Pixel[1], Pixel[0] };
+						for (int32 Channel = 0; Channel < 3; ++Channel)
+						{
+							const int32 Error = FMath::Abs(Rgb[Channel] - Texels[X * 4 + Y][Channel]);
+							SquaredError += double(Error) * Error;
+							Result.MaxError = FMath::Max(Result.MaxError, Error);
+						}
+					}
+				}
+			}
+		}
+
+		const double MeanSquaredError = SquaredError / (double(Width) * Height * 3);
+		Result.Psnr = MeanSquaredError > 0.0 ? 10.0 * FMath::LogX(10.0, 255.0 * 255.0 / MeanSquaredError) : 100.0;
+		return Result;
+	}
+
+	TArray<uint8> MakeImage(int32 Width, int32 Height, TFunctionRef<void(int32 X, int32 Y, uint8* Pixel)> Fill)
+	{
+		TArray<uint8> Image;
+		Image.SetNumUninitialized(Width * Height * 4);
+		for (int32 Y = 0; Y < Height; ++Y)
+		{
+			for (int32 X = 0; X < Width; ++X)
+			{
+				uint8* Pixel = &Image[(Y * Width + X) * 4];
+				Fill(X, Y, Pixel);
+				Pixel[3] = 255;
+			}
+		}
+		return Image;
+	}
+
+	const ERovrCompressQuality Qualities[] = { ERovrCompressQuality::Fast, ERovrCompressQuality::Normal, ERovrCompressQuality::High };
+
+	/** Load an image of the project's content as BGRA8; packaged builds only have it cooked, so this fails there */
+	bool LoadContentImage(const FString& RelativePath, TArray<uint8>& OutPixels, int32& OutWidth, int32& OutHeight)
+	{
+		TArray<uint8> Compressed;
+		if (!FFileHelper::LoadFileToArray(Compressed, *(FPaths::ProjectContentDir() / RelativePath), FILEREAD_Silent))
+		{
+			return false;
+		}
+
+		IImageWrapperModule& ImageWrapperModule = FModuleManager::LoadModuleChecked<IImageWrapperModule>(TEXT("ImageWrapper"));
+		const TSharedPtr<IImageWrapper> ImageWrapper = ImageWrapperModule.CreateImageWrapper(ImageWrapperModule.DetectImageFormat(Compressed.GetData(), Compressed.Num()));
+		if (!ImageWrapper.IsValid() || !ImageWrapper->SetCompressed(Compressed.GetData(), Compressed.Num()) || !ImageWrapper->GetRaw(ERGBFormat::BGRA, 8, OutPixels))
+		{
+			return false;
+		}
+
+		OutWidth = ImageWrapper->GetWidth();
+		OutHeight = ImageWrapper->GetHeight();
+		return true;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrBlockCompressRoundTripTest, "Rovr.Imaging.BlockCompress.RoundTrip", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FRovrBlockCompressRoundTripTest::RunTest(const FString& Parameters)
+{
+	// A sky-like gradient, the case planar blocks are for; 66x38 leaves partial blocks at the right and bottom
+	const int32 Width = 66;
+	const int32 Height = 38;
+	const TArray<uint8> Gradient = MakeImage(Width, Height, [](int32 X, int32 Y, uint8* Pixel)
+	{
+		Pixel[0] = uint8(200 - X * 2);
+		Pixel[1] = uint8(20 + Y * 5);
+		Pixel[2] = uint8(X * 3);
+	});
+
+	FRandomStream Random(1);
+	const TArray<uint8> Photo = MakeImage(Width, Height, [&Random](int32 X, int32 Y, uint8* Pixel)
+	{
+		const int32 Value = 128 + int32(60.0f * FMath::Sin(X * 0.3f) + 40.0f * FMath::Cos(Y * 0.2f));
+		Pixel[0] = uint8(FMath::Clamp(255 - Value, 0, 255));
+		Pixel[1] = uint8(FMath::Clamp(Value / 2 + Random.RandRange(0, 9), 0, 255));
+		Pixel[2] = uint8(FMath::Clamp(Value + Random.RandRange(0, 9), 0, 255));
+	});
+
+	// PSNR floors a little below what each preset reaches on these images
+	const double GradientFloor[] = { 35.0, 44.0, 44.0 };
+	const double PhotoFloor[] = { 28.0, 36.0, 36.0 };
+
+	for (int32 Preset = 0; Preset < int32(UE_ARRAY_COUNT(Qualities)); ++Preset)
+	{
+		const FRoundTrip GradientResult = RoundTrip(Gradient, Width, Height, Qualities[Preset]);
+		TestTrue(TEXT("Gradient blocks only use the individual, differential and planar modes"), GradientResult.bDecoded);
+		if (GradientResult.Psnr < GradientFloor[Preset])
+		{
+			AddError(FString::Printf(TEXT("Gradient at preset %d: PSNR %.2f dB, expected at least %.2f dB"), int32(Qualities[Preset]), GradientResult.Psnr, GradientFloor[Preset]));
+		}
+
+		const FRoundTrip PhotoResult = RoundTrip(Photo, Width, Height, Qualities[Preset]);
+		TestTrue(TEXT("Photo blocks only use the individual, differential and planar modes"), PhotoResult.bDecoded);
+		if (PhotoResult.Psnr < PhotoFloor[Preset])
+		{
+			AddError(FString::Printf(TEXT("Photo at preset %d: PSNR %.2f dB, expected at least %.2f dB"), int32(Qualities[Preset]), PhotoResult.Psnr, PhotoFloor[Preset]));
+		}
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrBlockCompressFlatTest, "Rovr.Imaging.BlockCompress.Flat", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FRovrBlockCompressFlatTest::RunTest(const FString& Parameters)
+{
+	// The three channels share one modifier, so a flat color cannot always be hit exactly. Fast keeps the
+	// differential base nearest the average; the other presets also try the 4 bit bases of individual blocks
+	const int32 MaxError[] = { 6, 3, 3 };
+	const uint8 Colors[][3] = { { 0, 0, 0 }, { 255, 255, 255 }, { 13, 200, 97 }, { 129, 130, 131 }, { 4, 251, 3 } };
+	for (const uint8 (&Color)[3] : Colors)
+	{
+		const TArray<uint8> Flat = MakeImage(7, 5, [&Color](int32 X, int32 Y, uint8* Pixel)
+		{
+			Pixel[0] = Color[0];
+			Pixel[1] = Color[1];
+			Pixel[2] = Color[2];
+		});
+
+		for (int32 Preset = 0; Preset < int32(UE_ARRAY_COUNT(Qualities)); ++Preset)
+		{
+			const FRoundTrip Result = RoundTrip(Flat, 7, 5, Qualities[Preset]);
+			TestTrue(TEXT("Flat blocks decode"), Result.bDecoded);
+			if (Result.MaxError > MaxError[Preset])
+			{
+				AddError(FString::Printf(TEXT("Flat color %d,%d,%d at preset %d is off by %d"), Color[2], Color[1], Color[0], int32(Qualities[Preset]), Result.MaxError));
+			}
+		}
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrBlockCompressBenchmarkTest, "Rovr.Imaging.BlockCompress.Benchmark", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FRovrBlockCompressBenchmarkTest::RunTest(const FString& Parameters)
+{
+	struct FBenchmarkImage
+	{
+		FString Name;
+		TArray<uint8> Pixels;
+		int32 Width = 0;
+		int32 Height = 0;
+	};
+	TArray<FBenchmarkImage> Images;
+
+	// Noisy gradient standing in for a photo, kept so results stay comparable without the content folder
+	{
+		FBenchmarkImage& Synthetic = Images.AddDefaulted_GetRef();
+		Synthetic.Name = TEXT("synthetic");
+		Synthetic.Width = 2048;
+		Synthetic.Height = 1024;
+		FRandomStream Random(2);
+		Synthetic.Pixels = MakeImage(Synthetic.Width, Synthetic.Height, [&Random](int32 X, int32 Y, uint8* Pixel)
+		{
+			const int32 Value = 128 + int32(90.0f * FMath::Sin(X * 0.01f) * FMath::Cos(Y * 0.013f));
+			Pixel[0] = uint8(FMath::Clamp(255 - Value + Random.RandRange(-6, 6), 0, 255));
+			Pixel[1] = uint8(FMath::Clamp(Value / 2 + Random.RandRange(-6, 6), 0, 255));
+			Pixel[2] = uint8(FMath::Clamp(Value + Random.RandRange(-6, 6), 0, 255));
+		});
+	}
+
+	// The images the app ships: a 360 photo, lobby backgrounds and a logo with flat areas
+	const TCHAR* ContentImages[] = { TEXT("Images-Resources/360_Image.jpeg"), TEXT("Images-Resources/SunsetPine.png"), TEXT("Images-Resources/ZenGarden.PNG"), TEXT("Images-Resources/ROVR_BOX_IMAGE.png") };
+	for (const TCHAR* RelativePath : ContentImages)
+	{
+		FBenchmarkImage Image;
+		Image.Name = FPaths::GetCleanFilename(RelativePath);
+		if (LoadContentImage(RelativePath, Image.Pixels, Image.Width, Image.Height))
+		{
+			Images.Add(MoveTemp(Image));
+		}
+		else
+		{
+			AddInfo(FString::Printf(TEXT("%s is not on disk as a source image, skipped"), RelativePath));
+		}
+	}
+
+	for (const FBenchmarkImage& Image : Images)
+	{
+		const int64 UncompressedBytes = int64(Image.Width) * Image.Height * 4;
+		const int64 CompressedBytes = int64(FMath::DivideAndRoundUp(Image.Width, 4)) * FMath::DivideAndRoundUp(Image.Height, 4) * 8;
+
+		TArray<uint8> Blocks;
+		Blocks.SetNumUninitialized(int32(CompressedBytes));
+
+		for (ERovrCompressQuality Quality : Qualities)
+		{
+			const double Start = FPlatformTime::Seconds();
+			RovrBlockCompress::CompressETC2(Image.Pixels.GetData(), int64(Image.Width) * 4, Image.Width, Image.Height, Blocks.GetData(), Quality);
+			const double Seconds = FPlatformTime::Seconds() - Start;
+
+			AddInfo(FString::Printf(TEXT("%s %dx%d at preset %d: %.2f ms, PSNR %.2f dB, %lld KiB instead of %lld KiB"),
+				*Image.Name, Image.Width, Image.Height, int32(Quality), Seconds * 1000.0, RoundTrip(Image.Pixels, Image.Width, Image.Height, Quality).Psnr, CompressedBytes / 1024, UncompressedBytes / 1024));
+		}
+	}
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,220 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "HAL/Event.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/ScopeLock.h"
+#include "RovrDecodeScheduler.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	/** Longest a test waits for the worker threads before it gives up */
+	const double IdleTimeout = 10.0;
+
+	/**
+	 * Scheduler of the tests, apart from the shared one so other decodes do not interleave. It is never
+	 * destroyed: a worker may still be leaving Dispatch after the last decode finished
+	 */
+	FRovrDecodeScheduler& GetTestScheduler()
+	{
+		static FRovrDecodeScheduler Scheduler;
+		return Scheduler;
+	}
+
+	bool WaitUntilIdle(const FRovrDecodeScheduler& Scheduler)
+	{
+		const double Deadline = FPlatformTime::Seconds() + IdleTimeout;
+		while (FPlatformTime::Seconds() < Deadline)
+		{
+			const FRovrDecodeScheduler::FStats Stats = Scheduler.GetStats();
+			if (Stats.NumRunning == 0 && Stats.NumQueued[0] + Stats.NumQueued[1] + Stats.NumQueued[2] == 0)
+			{
+				return true;
+			}
+			FPlatformProcess::Sleep(0.001f);
+		}
+		return false;
+	}
+
+	/** Sets rovr.DecodeScheduler.MaxConcurrent for the scope of a test */
+	class FScopedMaxConcurrent
+	{
+	public:
+		explicit FScopedMaxConcurrent(int32 Value)
+			: Variable(IConsoleManager::Get().FindConsoleVariable(TEXT("rovr.DecodeScheduler.MaxConcurrent")))
+		{
+			if (Variable)
+			{
+				Previous = Variable->GetInt();
+				Variable->Set(Value, ECVF_SetByCode);
+			}
+		}
+
+		~FScopedMaxConcurrent()
+		{
+			if (Variable)
+			{
+				Variable->Set(Previous, ECVF_SetByCode);
+			}
+		}
+
+	private:
+		IConsoleVariable* Variable;
+		int32 Previous = 0;
+	};
+
+	/** Names of the decodes in the order they ran; shared with the work so a timed out test leaves nothing dangling */
+	struct FRunLog
+	{
+		FCriticalSection Lock;
+		TArray<FString> Names;
+	};
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrDecodeSchedulerOrderTest, "Rovr.Imaging.DecodeScheduler.Order", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FRovrDecodeSchedulerOrderTest::RunTest(const FString& Parameters)
+{
+	// One decode at a time, so the order they start in is the order they run in
+	FScopedMaxConcurrent MaxConcurrent(1);
+	FRovrDecodeScheduler& Scheduler = GetTestScheduler();
+	const FRovrDecodeScheduler::FStats Before = Scheduler.GetStats();
+
+	const TSharedRef<FRunLog, ESPMode::ThreadSafe> Log = MakeShared<FRunLog, ESPMode::ThreadSafe>();
+	auto Enqueue = [&Scheduler, &Log](ERovrDecodePriority Priority, const TCHAR* Name)
+	{
+		return Scheduler.Enqueue(Priority, 0, [Log, Label = FString(Name)](const FRovrDecodeScheduler::FCancelFlag& bCancelled)
+		{
+			FScopeLock ScopeLock(&Log->Lock);
+			Log->Names.Add(Label);
+		});
+	};
+
+	// Holds the only slot while the rest queue up
+	FEvent* Release = FPlatformProcess::GetSynchEventFromPool(true);
+	Scheduler.Enqueue(ERovrDecodePriority::Visible, 0, [Release](const FRovrDecodeScheduler::FCancelFlag& bCancelled)
+	{
+		Release->Wait(FTimespan::FromSeconds(IdleTimeout));
+	});
+
+	Enqueue(ERovrDecodePriority::Background, TEXT("B1"));
+	Enqueue(ERovrDecodePriority::Prefetch, TEXT("P1"));
+	Enqueue(ERovrDecodePriority::Visible, TEXT("V1"));
+	Enqueue(ERovrDecodePriority::Visible, TEXT("V2"));
+	Scheduler.Cancel(Enqueue(ERovrDecodePriority::Prefetch, TEXT("P2")));
+	Scheduler.SetPriority(Enqueue(ERovrDecodePriority::Background, TEXT("B2")), ERovrDecodePriority::Visible);
+
+	const FRovrDecodeScheduler::FStats Queued = Scheduler.GetStats();
+	TestEqual(TEXT("Only the blocking decode runs"), Queued.NumRunning, 1);
+	TestEqual(TEXT("Visible decodes queued"), Queued.NumQueued[int32(ERovrDecodePriority::Visible)], 3);
+	TestEqual(TEXT("Prefetch decodes queued"), Queued.NumQueued[int32(ERovrDecodePriority::Prefetch)], 1);
+	TestEqual(TEXT("Background decodes queued"), Queued.NumQueued[int32(ERovrDecodePriority::Background)], 1);
+
+	Release->Trigger();
+	if (!TestTrue(TEXT("Every decode finished"), WaitUntilIdle(Scheduler)))
+	{
+		return false;
+	}
+	FPlatformProcess::ReturnSynchEventToPool(Release);
+
+	// Newest first within a class, and a promoted decode goes first in its new class
+	const TArray<FString> Expected = { TEXT("B2"), TEXT("V2"), TEXT("V1"), TEXT("P1"), TEXT("B1") };
+	{
+		FScopeLock ScopeLock(&Log->Lock);
+		if (Log->Names != Expected)
+		{
+			AddError(FString::Printf(TEXT("Decodes ran as %s, expected %s"), *FString::Join(Log->Names, TEXT(" ")), *FString::Join(Expected, TEXT(" "))));
+		}
+	}
+
+	const FRovrDecodeScheduler::FStats After = Scheduler.GetStats();
+	TestEqual(TEXT("Decodes started"), After.NumStarted - Before.NumStarted, 6);
+	TestEqual(TEXT("Decodes cancelled"), After.NumCancelled - Before.NumCancelled, 1);
+	TestEqual(TEXT("No memory held once idle"), After.RunningBytes, int64(0));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrDecodeSchedulerCancelTest, "Rovr.Imaging.DecodeScheduler.Cancel", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FRovrDecodeSchedulerCancelTest::RunTest(const FString& Parameters)
+{
+	FRovrDecodeScheduler& Scheduler = GetTestScheduler();
+	const FRovrDecodeScheduler::FStats Before = Scheduler.GetStats();
+
+	// A running decode polls its flag until the cancellation reaches it
+	FEvent* Started = FPlatformProcess::GetSynchEventFromPool(true);
+	const TSharedRef<FThreadSafeBool, ESPMode::ThreadSafe> bSawCancel = MakeShared<FThreadSafeBool, ESPMode::ThreadSafe>(false);
+	const int32 Id = Scheduler.Enqueue(ERovrDecodePriority::Visible, 1024, [Started, bSawCancel](const FRovrDecodeScheduler::FCancelFlag& bCancelled)
+	{
+		Started->Trigger();
+		const double Deadline = FPlatformTime::Seconds() + IdleTimeout;
+		while (!*bCancelled && FPlatformTime::Seconds() < Deadline)
+		{
+			FPlatformProcess::Sleep(0.001f);
+		}
+		*bSawCancel = *bCancelled;
+	});
+
+	if (!TestTrue(TEXT("The decode started"), Started->Wait(FTimespan::FromSeconds(IdleTimeout))))
+	{
+		Scheduler.Cancel(Id);
+		return false;
+	}
+	TestEqual(TEXT("A running decode holds its memory"), Scheduler.GetStats().RunningBytes, int64(1024));
+
+	Scheduler.Cancel(Id);
+	if (!TestTrue(TEXT("The cancelled decode finished"), WaitUntilIdle(Scheduler)))
+	{
+		return false;
+	}
+	FPlatformProcess::ReturnSynchEventToPool(Started);
+	TestTrue(TEXT("The work saw its cancellation flag set"), *bSawCancel);
+
+	// Cancelling a finished or unknown decode changes nothing
+	Scheduler.Cancel(Id);
+	Scheduler.Cancel(0);
+
+	const FRovrDecodeScheduler::FStats After = Scheduler.GetStats();
+	TestEqual(TEXT("The running decode counts as cancelled once"), After.NumCancelled - Before.NumCancelled, 1);
+	TestEqual(TEXT("No memory held once idle"), After.RunningBytes, int64(0));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrDecodeSchedulerCancelFinishedTest, "Rovr.Imaging.DecodeScheduler.CancelFinished", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FRovrDecodeSchedulerCancelFinishedTest::RunTest(const FString& Parameters)
+{
+	FRovrDecodeScheduler& Scheduler = GetTestScheduler();
+	const FRovrDecodeScheduler::FStats Before = Scheduler.GetStats();
+
+	// The work hands its flag on, standing in for the callback it queues for the game thread
+	typedef TSharedPtr<FThreadSafeBool, ESPMode::ThreadSafe> FHeldFlag;
+	const TSharedRef<FHeldFlag, ESPMode::ThreadSafe> Callback = MakeShared<FHeldFlag, ESPMode::ThreadSafe>();
+	const int32 Id = Scheduler.Enqueue(ERovrDecodePriority::Visible, 0, [Callback](const FRovrDecodeScheduler::FCancelFlag& bCancelled)
+	{
+		*Callback = bCancelled;
+	});
+
+	if (!TestTrue(TEXT("The decode finished"), WaitUntilIdle(Scheduler)) || !TestTrue(TEXT("The work handed its flag on"), Callback->IsValid()))
+	{
+		return false;
+	}
+
+	// Finished, but the result has not been delivered yet
+	Scheduler.Cancel(Id);
+	TestTrue(TEXT("The pending callback sees the cancellation"), **Callback);
+	TestEqual(TEXT("The finished decode counts as cancelled"), Scheduler.GetStats().NumCancelled - Before.NumCancelled, 1);
+
+	// Once the callback has run and released the flag, the decode is forgotten
+	Callback->Reset();
+	Scheduler.Cancel(Id);
+	TestEqual(TEXT("A delivered decode is not cancelled again"), Scheduler.GetStats().NumCancelled - Before.NumCancelled, 1);
+	return true;
+}
+
+#endif
@@ -0,0 +1,176 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "Math/RandomStream.h"
+#include "RovrImageResize.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	TArray<uint8> MakeFlat(int32 Width, int32 Height, const uint8 (&Color)[4])
+	{
+		TArray<uint8> Image;
+		Image.SetNumUninitialized(Width * Height * 4);
+		for (int32 Pixel = 0; Pixel < Width * Height; ++Pixel)
+		{
+			FMemory::Memcpy(&Image[Pixel * 4], Color, 4);
+		}
+		return Image;
+	}
+
+	TArray<uint8> MakeNoise(int32 Width, int32 Height, int32 Seed)
+	{
+		FRandomStream Random(Seed);
+		TArray<uint8> Image;
+		Image.SetNumUninitialized(Width * Height * 4);
+		for (int32 Index = 0; Index < Image.Num(); ++Index)
+		{
+			Image[Index] = uint8(Random.GetUnsignedInt());
+		}
+		return Image;
+	}
+
+	/** Resize into a buffer with a guard pixel past the end, which must stay untouched */
+	TArray<uint8> Resize(const TArray<uint8>& Source, int32 SourceWidth, int32 SourceHeight, int32 DestWidth, int32 DestHeight, bool& bOutGuardIntact)
+	{
+		TArray<uint8> Dest;
+		Dest.Init(0xCD, DestWidth * DestHeight * 4 + 4);
+		RovrImageResize::ResizeArea(Source.GetData(), SourceWidth * 4, SourceWidth, SourceHeight, Dest.GetData(), DestWidth * 4, DestWidth, DestHeight);
+
+		bOutGuardIntact = Dest[Dest.Num() - 4] == 0xCD && Dest[Dest.Num() - 1] == 0xCD;
+		Dest.SetNum(DestWidth * DestHeight * 4);
+		return Dest;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrImageResizeFitSizeTest, "Rovr.Imaging.ImageResize.FitSize", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FRovrImageResizeFitSizeTest::RunTest(const FString& Parameters)
+{
+	TestTrue(TEXT("Landscape into a square"), RovrImageResize::FitSize(1920, 1080, 256, 256) == FIntPoint(256, 144));
+	TestTrue(TEXT("Portrait into a square"), RovrImageResize::FitSize(1080, 1920, 256, 256) == FIntPoint(144, 256));
+	TestTrue(TEXT("Never enlarged"), RovrImageResize::FitSize(100, 50, 256, 256) == FIntPoint(100, 50));
+	TestTrue(TEXT("Thin images keep a pixel"), RovrImageResize::FitSize(10000, 1, 100, 100) == FIntPoint(100, 1));
+	TestTrue(TEXT("Empty bounds"), RovrImageResize::FitSize(100, 100, 0, 100) == FIntPoint::ZeroValue);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrImageResizeFlatTest, "Rovr.Imaging.ImageResize.Flat", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FRovrImageResizeFlatTest::RunTest(const FString& Parameters)
+{
+	// Fractional scales leave weights that do not sum to one after rounding; flat areas have to keep their exact value anyway
+	const uint8 Color[4] = { 0, 255, 93, 200 };
+	const FIntPoint Sizes[][2] =
+	{
+		{ FIntPoint(640, 480), FIntPoint(97, 73) },
+		{ FIntPoint(1920, 1080), FIntPoint(256, 144) },
+		{ FIntPoint(7, 3), FIntPoint(3, 2) },
+		{ FIntPoint(1000, 7), FIntPoint(3, 3) },
+		{ FIntPoint(5, 5), FIntPoint(13, 11) },
+		{ FIntPoint(300, 300), FIntPoint(300, 300) }
+	};
+
+	for (const FIntPoint (&Pair)[2] : Sizes)
+	{
+		const FIntPoint Source = Pair[0];
+		const FIntPoint Dest = Pair[1];
+
+		bool bGuardIntact = false;
+		const TArray<uint8> Resized = Resize(MakeFlat(Source.X, Source.Y, Color), Source.X, Source.Y, Dest.X, Dest.Y, bGuardIntact);
+		TestTrue(TEXT("Nothing written past the destination"), bGuardIntact);
+
+		for (int32 Pixel = 0; Pixel < Dest.X * Dest.Y; ++Pixel)
+		{
+			if (FMemory::Memcmp(&Resized[Pixel * 4], Color, 4) != 0)
+			{
+				AddError(FString::Printf(TEXT("Flat %dx%d resized to %dx%d changed at pixel %d"), Source.X, Source.Y, Dest.X, Dest.Y, Pixel));
+				break;
+			}
+		}
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrImageResizeThinTest, "Rovr.Imaging.ImageResize.Thin", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FRovrImageResizeThinTest::RunTest(const FString& Parameters)
+{
+	// 1xN and Nx1 images have a single tap along one axis; everything they hold has to end up in the average
+	for (int32 Length : { 1, 2, 3, 17, 1000 })
+	{
+		const TArray<uint8> Line = MakeNoise(1, Length, Length);
+
+		int32 Expected[4] = { 0, 0, 0, 0 };
+		for (int32 Pixel = 0; Pixel < Length; ++Pixel)
+		{
+			for (int32 Channel = 0; Channel < 4; ++Channel)
+			{
+				Expected[Channel] += Line[Pixel * 4 + Channel];
+			}
+		}
+
+		bool bGuardIntact = false;
+		const TArray<uint8> Column = Resize(Line, 1, Length, 1, 1, bGuardIntact);
+		TestTrue(TEXT("1xN: nothing written past the destination"), bGuardIntact);
+		const TArray<uint8> Row = Resize(Line, Length, 1, 1, 1, bGuardIntact);
+		TestTrue(TEXT("Nx1: nothing written past the destination"), bGuardIntact);
+
+		for (int32 Channel = 0; Channel < 4; ++Channel)
+		{
+			const float Average = float(Expected[Channel]) / Length;
+			if (FMath::Abs(Column[Channel] - Average) > 1.0f || FMath::Abs(Row[Channel] - Average) > 1.0f)
+			{
+				AddError(FString::Printf(TEXT("A line of %d pixels averaged to %d and %d in channel %d, expected %.2f"), Length, Column[Channel], Row[Channel], Channel, Average));
+			}
+		}
+
+		// Thin to thin, e.g. a 1x1000 strip to 1x3, keeps the single column
+		if (Length >= 3)
+		{
+			const TArray<uint8> Strip = Resize(Line, 1, Length, 1, 3, bGuardIntact);
+			TestTrue(TEXT("1xN to 1x3: nothing written past the destination"), bGuardIntact);
+			TestEqual(TEXT("1xN to 1x3 size"), Strip.Num(), 3 * 4);
+		}
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrImageResizeHalveTest, "Rovr.Imaging.ImageResize.Halve", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FRovrImageResizeHalveTest::RunTest(const FString& Parameters)
+{
+	// At exactly half the size every destination pixel covers a 2x2 block, so the result is the rounded box average
+	const int32 Width = 258;
+	const int32 Height = 260;
+	const TArray<uint8> Source = MakeNoise(Width, Height, 7);
+
+	bool bGuardIntact = false;
+	const TArray<uint8> Halved = Resize(Source, Width, Height, Width / 2, Height / 2, bGuardIntact);
+	TestTrue(TEXT("Nothing written past the destination"), bGuardIntact);
+
+	for (int32 Y = 0; Y < Height / 2; ++Y)
+	{
+		for (int32 X = 0; X < Width / 2; ++X)
+		{
+			for (int32 Channel = 0; Channel < 4; ++Channel)
+			{
+				const int32 Sum = Source[((Y * 2) * Width + X * 2) * 4 + Channel] + Source[((Y * 2) * Width + X * 2 + 1) * 4 + Channel]
+					+ Source[((Y * 2 + 1) * Width + X * 2) * 4 + Channel] + Source[((Y * 2 + 1) * Width + X * 2 + 1) * 4 + Channel];
+				if (Halved[(Y * (Width / 2) + X) * 4 + Channel] != (Sum + 2) >> 2)
+				{
+					AddError(FString::Printf(TEXT("Halved pixel %d,%d channel %d is %d, expected %d"), X, Y, Channel, Halved[(Y * (Width / 2) + X) * 4 + Channel], (Sum + 2) >> 2));
+					return true;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+#endif
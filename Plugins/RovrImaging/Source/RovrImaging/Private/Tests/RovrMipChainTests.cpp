@@ -0,0 +1,166 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "Math/RandomStream.h"
+#include "HAL/PlatformTime.h"
+#include "RovrMipChain.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	/** Rounded 2x2 average with the last row and column repeated, one texel at a time */
+	void BoxReference(const uint8* Source, int64 SourceStride, int32 Width, int32 Height, uint8* Dest)
+	{
+		const int32 DestWidth = FMath::Max(Width / 2, 1);
+		const int32 DestHeight = FMath::Max(Height / 2, 1);
+		for (int32 Y = 0; Y < DestHeight; ++Y)
+		{
+			const uint8* Row0 = Source + FMath::Min(Y * 2, Height - 1) * SourceStride;
+			const uint8* Row1 = Source + FMath::Min(Y * 2 + 1, Height - 1) * SourceStride;
+			for (int32 X = 0; X < DestWidth; ++X)
+			{
+				const int32 X0 = FMath::Min(X * 2, Width - 1) * 4;
+				const int32 X1 = FMath::Min(X * 2 + 1, Width - 1) * 4;
+				for (int32 Channel = 0; Channel < 4; ++Channel)
+				{
+					Dest[(Y * DestWidth + X) * 4 + Channel] = uint8((Row0[X0 + Channel] + Row0[X1 + Channel] + Row1[X0 + Channel] + Row1[X1 + Channel] + 2) >> 2);
+				}
+			}
+		}
+	}
+
+	TArray<uint8> MakeNoise(int64 NumBytes, int32 Seed)
+	{
+		FRandomStream Random(Seed);
+		TArray<uint8> Bytes;
+		Bytes.SetNumUninitialized(NumBytes);
+		for (int64 Index = 0; Index < NumBytes; ++Index)
+		{
+			Bytes[Index] = uint8(Random.GetUnsignedInt());
+		}
+		return Bytes;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrMipChainNumMipsTest, "Rovr.Imaging.MipChain.NumMips", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FRovrMipChainNumMipsTest::RunTest(const FString& Parameters)
+{
+	TestEqual(TEXT("1x1"), RovrMipChain::GetNumMips(1, 1), 1);
+	TestEqual(TEXT("2x1"), RovrMipChain::GetNumMips(2, 1), 2);
+	TestEqual(TEXT("256x256"), RovrMipChain::GetNumMips(256, 256), 9);
+	TestEqual(TEXT("300x20"), RovrMipChain::GetNumMips(300, 20), 9);
+	TestEqual(TEXT("4096x2048"), RovrMipChain::GetNumMips(4096, 2048), 13);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrMipChainBoxTest, "Rovr.Imaging.MipChain.Box", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FRovrMipChainBoxTest::RunTest(const FString& Parameters)
+{
+	// Odd sizes, single rows and columns, and a level large enough for the worker threads, against the scalar reference
+	for (const FIntPoint Size : { FIntPoint(2, 2), FIntPoint(7, 5), FIntPoint(1, 9), FIntPoint(9, 1), FIntPoint(33, 18), FIntPoint(517, 301) })
+	{
+		const int64 Stride = Size.X * 4 + 4;
+		const TArray<uint8> Source = MakeNoise(Stride * Size.Y, Size.X);
+		const int32 DestWidth = FMath::Max(Size.X / 2, 1);
+		const int32 DestHeight = FMath::Max(Size.Y / 2, 1);
+
+		TArray<uint8> Expected;
+		Expected.SetNumUninitialized(DestWidth * DestHeight * 4);
+		BoxReference(Source.GetData(), Stride, Size.X, Size.Y, Expected.GetData());
+
+		TArray<uint8> Actual;
+		Actual.SetNumUninitialized(DestWidth * DestHeight * 4);
+		RovrMipChain::Downsample(Source.GetData(), Stride, Size.X, Size.Y, Actual.GetData(), ERovrMipFilter::Box);
+
+		if (Actual != Expected)
+		{
+			AddError(FString::Printf(TEXT("Box downsample of %dx%d differs from the scalar reference"), Size.X, Size.Y));
+		}
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrMipChainGenerateTest, "Rovr.Imaging.MipChain.Generate", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FRovrMipChainGenerateTest::RunTest(const FString& Parameters)
+{
+	const int32 Width = 40;
+	const int32 Height = 12;
+	TArray<uint8> Flat;
+	Flat.SetNumUninitialized(Width * Height * 4);
+	for (int32 Pixel = 0; Pixel < Width * Height; ++Pixel)
+	{
+		Flat[Pixel * 4 + 0] = 10;
+		Flat[Pixel * 4 + 1] = 128;
+		Flat[Pixel * 4 + 2] = 250;
+		Flat[Pixel * 4 + 3] = 77;
+	}
+
+	TArray<TArray<uint8>> Mips;
+	RovrMipChain::Generate(Flat.GetData(), Width * 4, Width, Height, ERovrMipFilter::None, Mips);
+	TestEqual(TEXT("No mips without a filter"), Mips.Num(), 0);
+
+	for (ERovrMipFilter Filter : { ERovrMipFilter::Box, ERovrMipFilter::Kaiser })
+	{
+		RovrMipChain::Generate(Flat.GetData(), Width * 4, Width, Height, Filter, Mips);
+		if (!TestEqual(TEXT("Every mip down to 1x1"), Mips.Num(), RovrMipChain::GetNumMips(Width, Height) - 1))
+		{
+			continue;
+		}
+
+		// 20x6, 10x3, 5x1, 2x1, 1x1; a flat image stays flat through both filters, whose weights sum to one
+		int32 MipWidth = Width;
+		int32 MipHeight = Height;
+		for (const TArray<uint8>& Mip : Mips)
+		{
+			MipWidth = FMath::Max(MipWidth / 2, 1);
+			MipHeight = FMath::Max(MipHeight / 2, 1);
+			TestEqual(TEXT("Mip size"), Mip.Num(), MipWidth * MipHeight * 4);
+
+			for (int32 Index = 0; Index < Mip.Num(); ++Index)
+			{
+				if (Mip[Index] != Flat[Index % 4])
+				{
+					AddError(FString::Printf(TEXT("Filter %d changed a flat %dx%d mip at byte %d to %d"), int32(Filter), MipWidth, MipHeight, Index, Mip[Index]));
+					break;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrMipChainBenchmarkTest, "Rovr.Imaging.MipChain.Benchmark", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FRovrMipChainBenchmarkTest::RunTest(const FString& Parameters)
+{
+	const int32 Width = 4096;
+	const int32 Height = 2048;
+	const TArray<uint8> Source = MakeNoise(int64(Width) * Height * 4, 1);
+
+	TArray<uint8> Dest;
+	Dest.SetNumUninitialized((Width / 2) * (Height / 2) * 4);
+	double Start = FPlatformTime::Seconds();
+	BoxReference(Source.GetData(), Width * 4, Width, Height, Dest.GetData());
+	const double ReferenceSeconds = FPlatformTime::Seconds() - Start;
+
+	TArray<TArray<uint8>> Mips;
+	Start = FPlatformTime::Seconds();
+	RovrMipChain::Generate(Source.GetData(), Width * 4, Width, Height, ERovrMipFilter::Box, Mips);
+	const double BoxSeconds = FPlatformTime::Seconds() - Start;
+
+	Start = FPlatformTime::Seconds();
+	RovrMipChain::Generate(Source.GetData(), Width * 4, Width, Height, ERovrMipFilter::Kaiser, Mips);
+	const double KaiserSeconds = FPlatformTime::Seconds() - Start;
+
+	AddInfo(FString::Printf(TEXT("%dx%d: scalar mip 1 %.2f ms, box chain %.2f ms, Kaiser chain %.2f ms"), Width, Height, ReferenceSeconds * 1000.0, BoxSeconds * 1000.0, KaiserSeconds * 1000.0));
+	return true;
+}
+
+#endif
@@ -0,0 +1,192 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "Math/RandomStream.h"
+#include "HAL/PlatformTime.h"
+#include "RovrPixelConvert.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	const ERovrPixelLayout Layouts[] = { ERovrPixelLayout::BGRA8, ERovrPixelLayout::RGBA8, ERovrPixelLayout::ARGB32 };
+
+	/** One pixel at a time, the way the loops RovrPixelConvert replaced did it */
+	void ConvertReference(const uint8* Source, ERovrPixelLayout Layout, uint8* Dest, int64 NumPixels, bool bForceOpaque)
+	{
+		for (int64 Index = 0; Index < NumPixels; ++Index)
+		{
+			const uint8* Pixel = Source + Index * 4;
+			uint8 B, G, R, A;
+			if (Layout == ERovrPixelLayout::BGRA8)
+			{
+				B = Pixel[0]; G = Pixel[1]; R = Pixel[2]; A = Pixel[3];
+			}
+			else if (Layout == ERovrPixelLayout::RGBA8)
+			{
+				R = Pixel[0]; G = Pixel[1]; B = Pixel[2]; A = Pixel[3];
+			}
+			else
+			{
+				uint32 Argb;
+				FMemory::Memcpy(&Argb, Pixel, sizeof(Argb));
+				A = uint8(Argb >> 24); R = uint8(Argb >> 16); G = uint8(Argb >> 8); B = uint8(Argb);
+			}
+
+			Dest[Index * 4 + 0] = B;
+			Dest[Index * 4 + 1] = G;
+			Dest[Index * 4 + 2] = R;
+			Dest[Index * 4 + 3] = bForceOpaque ? 255 : A;
+		}
+	}
+
+	TArray<uint8> MakeNoise(int64 NumBytes, int32 Seed)
+	{
+		FRandomStream Random(Seed);
+		TArray<uint8> Bytes;
+		Bytes.SetNumUninitialized(NumBytes);
+		for (int64 Index = 0; Index < NumBytes; ++Index)
+		{
+			Bytes[Index] = uint8(Random.GetUnsignedInt());
+		}
+		return Bytes;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrPixelConvertRowTest, "Rovr.Imaging.PixelConvert.Row", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FRovrPixelConvertRowTest::RunTest(const FString& Parameters)
+{
+	// Lengths around the 4 and 16 pixel vector widths, from every alignment, so both the vector loops and their tails run
+	const TArray<uint8> Source = MakeNoise(1024 * 4 + 16, 1);
+	TArray<uint8> Expected;
+	TArray<uint8> Actual;
+
+	for (ERovrPixelLayout Layout : Layouts)
+	{
+		for (int32 bForceOpaque = 0; bForceOpaque < 2; ++bForceOpaque)
+		{
+			for (int32 NumPixels : { 0, 1, 3, 4, 5, 15, 16, 17, 31, 33, 1000 })
+			{
+				for (int32 Offset = 0; Offset < 4; ++Offset)
+				{
+					Expected.SetNumZeroed(NumPixels * 4 + 1);
+					Actual.SetNumZeroed(NumPixels * 4 + 1);
+					ConvertReference(Source.GetData() + Offset, Layout, Expected.GetData(), NumPixels, bForceOpaque != 0);
+					RovrPixelConvert::ConvertRow(Source.GetData() + Offset, Layout, Actual.GetData() + 1, NumPixels, bForceOpaque != 0);
+
+					if (FMemory::Memcmp(Expected.GetData(), Actual.GetData() + 1, NumPixels * 4) != 0 || Actual[0] != 0)
+					{
+						AddError(FString::Printf(TEXT("Layout %d, %d pixels at offset %d, force opaque %d differ from the scalar reference"), int32(Layout), NumPixels, Offset, bForceOpaque));
+					}
+				}
+			}
+		}
+	}
+
+	// Converting in place is allowed
+	TArray<uint8> InPlace = Source;
+	Expected.SetNumUninitialized(1000 * 4);
+	ConvertReference(Source.GetData(), ERovrPixelLayout::RGBA8, Expected.GetData(), 1000, false);
+	RovrPixelConvert::ConvertRow(InPlace.GetData(), ERovrPixelLayout::RGBA8, InPlace.GetData(), 1000, false);
+	TestTrue(TEXT("In place conversion matches"), FMemory::Memcmp(Expected.GetData(), InPlace.GetData(), 1000 * 4) == 0);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrPixelConvertImageTest, "Rovr.Imaging.PixelConvert.Image", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FRovrPixelConvertImageTest::RunTest(const FString& Parameters)
+{
+	// The large image is split over worker threads; padded strides check that rows are addressed through them
+	for (const FIntPoint Size : { FIntPoint(37, 11), FIntPoint(1031, 517) })
+	{
+		const int64 SourceStride = Size.X * 4 + 12;
+		const int64 DestStride = Size.X * 4 + 8;
+		const TArray<uint8> Source = MakeNoise(SourceStride * Size.Y, 2);
+
+		for (ERovrPixelLayout Layout : Layouts)
+		{
+			for (ERovrPixelConvertFlags Flags : { ERovrPixelConvertFlags::None, ERovrPixelConvertFlags::ForceOpaque | ERovrPixelConvertFlags::FlipVertically })
+			{
+				const bool bFlip = EnumHasAnyFlags(Flags, ERovrPixelConvertFlags::FlipVertically);
+
+				TArray<uint8> Expected;
+				Expected.SetNumZeroed(DestStride * Size.Y);
+				for (int32 Row = 0; Row < Size.Y; ++Row)
+				{
+					const int32 DestRow = bFlip ? Size.Y - 1 - Row : Row;
+					ConvertReference(Source.GetData() + Row * SourceStride, Layout, Expected.GetData() + DestRow * DestStride, Size.X, EnumHasAnyFlags(Flags, ERovrPixelConvertFlags::ForceOpaque));
+				}
+
+				TArray<uint8> Actual;
+				Actual.SetNumZeroed(DestStride * Size.Y);
+				RovrPixelConvert::ConvertImage(Source.GetData(), Layout, SourceStride, Actual.GetData(), DestStride, Size.X, Size.Y, Flags);
+
+				if (Actual != Expected)
+				{
+					AddError(FString::Printf(TEXT("%dx%d image in layout %d with flags %d differs from the scalar reference"), Size.X, Size.Y, int32(Layout), int32(Flags)));
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrPixelConvertAlphaTest, "Rovr.Imaging.PixelConvert.Alpha", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FRovrPixelConvertAlphaTest::RunTest(const FString& Parameters)
+{
+	const int32 Width = 67;
+	const int32 Height = 5;
+	TArray<uint8> Pixels = MakeNoise(Width * Height * 4, 3);
+
+	RovrPixelConvert::SetOpaque(Pixels.GetData(), Width * Height);
+	TestTrue(TEXT("SetOpaque makes the image opaque"), RovrPixelConvert::IsOpaque(Pixels.GetData(), ERovrPixelLayout::BGRA8, Width * 4, Width, Height));
+
+	// A single translucent pixel, in the scalar tail of the last row, has to be found in every layout
+	Pixels[(Width * Height - 1) * 4 + 3] = 254;
+	TestFalse(TEXT("BGRA8 translucent pixel"), RovrPixelConvert::IsOpaque(Pixels.GetData(), ERovrPixelLayout::BGRA8, Width * 4, Width, Height));
+	TestFalse(TEXT("RGBA8 translucent pixel"), RovrPixelConvert::IsOpaque(Pixels.GetData(), ERovrPixelLayout::RGBA8, Width * 4, Width, Height));
+	TestFalse(TEXT("ARGB32 translucent pixel"), RovrPixelConvert::IsOpaque(Pixels.GetData(), ERovrPixelLayout::ARGB32, Width * 4, Width, Height));
+
+	// Rows past Height are not part of the image
+	TestTrue(TEXT("Rows outside the image are ignored"), RovrPixelConvert::IsOpaque(Pixels.GetData(), ERovrPixelLayout::BGRA8, Width * 4, Width, Height - 1));
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrPixelConvertBenchmarkTest, "Rovr.Imaging.PixelConvert.Benchmark", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FRovrPixelConvertBenchmarkTest::RunTest(const FString& Parameters)
+{
+	// A 4K equirect panorama, the largest image the app converts
+	const int32 Width = 4096;
+	const int32 Height = 2048;
+	const TArray<uint8> Source = MakeNoise(int64(Width) * Height * 4, 4);
+	TArray<uint8> Dest;
+	Dest.SetNumUninitialized(Source.Num());
+
+	for (ERovrPixelLayout Layout : Layouts)
+	{
+		double Start = FPlatformTime::Seconds();
+		ConvertReference(Source.GetData(), Layout, Dest.GetData(), int64(Width) * Height, true);
+		const double ReferenceSeconds = FPlatformTime::Seconds() - Start;
+
+		Start = FPlatformTime::Seconds();
+		RovrPixelConvert::ConvertRow(Source.GetData(), Layout, Dest.GetData(), int64(Width) * Height, true);
+		const double RowSeconds = FPlatformTime::Seconds() - Start;
+
+		Start = FPlatformTime::Seconds();
+		RovrPixelConvert::ConvertImage(Source.GetData(), Layout, Width * 4, Dest.GetData(), Width * 4, Width, Height, ERovrPixelConvertFlags::ForceOpaque);
+		const double ImageSeconds = FPlatformTime::Seconds() - Start;
+
+		AddInfo(FString::Printf(TEXT("%dx%d, layout %d: per pixel %.2f ms, ConvertRow %.2f ms, ConvertImage %.2f ms"), Width, Height, int32(Layout), ReferenceSeconds * 1000.0, RowSeconds * 1000.0, ImageSeconds * 1000.0));
+	}
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,488 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "IImageWrapper.h"
+#include "IImageWrapperModule.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/ThreadSafeCounter64.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Modules/ModuleManager.h"
+#include "RovrImageResize.h"
+#include "RovrJpegDecoder.h"
+#include "RovrPngDecoder.h"
+#include "RovrScaledDecode.h"
+
+#include "zlib.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	/** Sizes that are not multiples of the 16 pixel MCUs of 4:2:0 JPEG or of the 8 pixel Adam7 grid */
+	const int32 ImageWidth = 323;
+	const int32 ImageHeight = 211;
+
+	/** Smooth BGRA8 test image, photo-like enough for a JPEG encoder to keep close */
+	TArray<uint8> MakeImage(bool bAlpha)
+	{
+		TArray<uint8> Image;
+		Image.SetNumUninitialized(ImageWidth * ImageHeight * 4);
+		for (int32 Y = 0; Y < ImageHeight; ++Y)
+		{
+			for (int32 X = 0; X < ImageWidth; ++X)
+			{
+				uint8* Pixel = &Image[(Y * ImageWidth + X) * 4];
+				Pixel[0] = uint8(128.0f + 100.0f * FMath::Sin(X * 0.02f + Y * 0.01f));
+				Pixel[1] = uint8(Y * 255 / (ImageHeight - 1));
+				Pixel[2] = uint8(128.0f + 90.0f * FMath::Cos(Y * 0.03f) * FMath::Sin(X * 0.015f));
+				Pixel[3] = bAlpha ? uint8((X * 7 + Y * 3) & 0xFF) : 255;
+			}
+		}
+		return Image;
+	}
+
+	IImageWrapperModule& GetImageWrapperModule()
+	{
+		return FModuleManager::LoadModuleChecked<IImageWrapperModule>(TEXT("ImageWrapper"));
+	}
+
+	bool DecodeWithImageWrapper(EImageFormat Format, const TArray<uint8>& Compressed, TArray<uint8>& OutPixels)
+	{
+		const TSharedPtr<IImageWrapper> ImageWrapper = GetImageWrapperModule().CreateImageWrapper(Format);
+		return ImageWrapper.IsValid() && ImageWrapper->SetCompressed(Compressed.GetData(), Compressed.Num()) && ImageWrapper->GetRaw(ERGBFormat::BGRA, 8, OutPixels);
+	}
+
+	/** Average of the Factor x Factor block of a full size image each pixel of a reduced decode stands for */
+	void BoxAverage(const TArray<uint8>& Full, int32 Factor, int32 X, int32 Y, float (&OutColor)[4])
+	{
+		float Sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		int32 Count = 0;
+		for (int32 SourceY = Y * Factor; SourceY < FMath::Min((Y + 1) * Factor, ImageHeight); ++SourceY)
+		{
+			for (int32 SourceX = X * Factor; SourceX < FMath::Min((X + 1) * Factor, ImageWidth); ++SourceX)
+			{
+				for (int32 Channel = 0; Channel < 4; ++Channel)
+				{
+					Sum[Channel] += Full[(SourceY * ImageWidth + SourceX) * 4 + Channel];
+				}
+				++Count;
+			}
+		}
+		for (int32 Channel = 0; Channel < 4; ++Channel)
+		{
+			OutColor[Channel] = Sum[Channel] / Count;
+		}
+	}
+
+	void AppendBigEndian(TArray<uint8>& Out, uint32 Value)
+	{
+		Out.Add(uint8(Value >> 24));
+		Out.Add(uint8(Value >> 16));
+		Out.Add(uint8(Value >> 8));
+		Out.Add(uint8(Value));
+	}
+
+	void AppendChunk(TArray<uint8>& Out, const char* Type, const TArray<uint8>& Data)
+	{
+		AppendBigEndian(Out, Data.Num());
+		const int32 TypeOffset = Out.Num();
+		Out.Append(reinterpret_cast<const uint8*>(Type), 4);
+		Out.Append(Data);
+		AppendBigEndian(Out, crc32(0, Out.GetData() + TypeOffset, Out.Num() - TypeOffset));
+	}
+
+	uint8 Paeth(int32 Left, int32 Up, int32 UpLeft)
+	{
+		const int32 Estimate = Left + Up - UpLeft;
+		const int32 DistanceLeft = FMath::Abs(Estimate - Left);
+		const int32 DistanceUp = FMath::Abs(Estimate - Up);
+		const int32 DistanceUpLeft = FMath::Abs(Estimate - UpLeft);
+		return uint8(DistanceLeft <= DistanceUp && DistanceLeft <= DistanceUpLeft ? Left : (DistanceUp <= DistanceUpLeft ? Up : UpLeft));
+	}
+
+	/**
+	 * Encode a BGRA8 image as an Adam7 interlaced PNG, RGBA or RGB with 8 bit samples. ImageWrapper only
+	 * writes progressive PNGs, so the test makes its own; rows cycle through the five filter types
+	 */
+	TArray<uint8> EncodeInterlacedPng(const TArray<uint8>& Image, int32 Width, int32 Height, bool bAlpha)
+	{
+		struct FPass { int32 StartX, StartY, StepX, StepY; };
+		const FPass Passes[] = { { 0, 0, 8, 8 }, { 4, 0, 8, 8 }, { 0, 4, 4, 8 }, { 2, 0, 4, 4 }, { 0, 2, 2, 4 }, { 1, 0, 2, 2 }, { 0, 1, 1, 2 } };
+		const int32 BytesPerPixel = bAlpha ? 4 : 3;
+
+		TArray<uint8> Filtered;
+		int32 RowIndex = 0;
+		for (const FPass& Pass : Passes)
+		{
+			const int32 Columns = FMath::DivideAndRoundUp(FMath::Max(Width - Pass.StartX, 0), Pass.StepX);
+			const int32 Rows = FMath::DivideAndRoundUp(FMath::Max(Height - Pass.StartY, 0), Pass.StepY);
+			if (Columns == 0 || Rows == 0)
+			{
+				continue;
+			}
+
+			TArray<uint8> Previous;
+			Previous.SetNumZeroed(Columns * BytesPerPixel);
+			TArray<uint8> Row;
+			Row.SetNumUninitialized(Columns * BytesPerPixel);
+
+			for (int32 PassRow = 0; PassRow < Rows; ++PassRow, ++RowIndex)
+			{
+				for (int32 Column = 0; Column < Columns; ++Column)
+				{
+					const uint8* Pixel = &Image[((Pass.StartY + PassRow * Pass.StepY) * Width + Pass.StartX + Column * Pass.StepX) * 4];
+					const uint8 Rgba[4] = { Pixel[2], Pixel[1], Pixel[0], Pixel[3] };
+					FMemory::Memcpy(&Row[Column * BytesPerPixel], Rgba, BytesPerPixel);
+				}
+
+				const uint8 Filter = uint8(RowIndex % 5);
+				Filtered.Add(Filter);
+				for (int32 Byte = 0; Byte < Row.Num(); ++Byte)
+				{
+					const int32 Left = Byte >= BytesPerPixel ? Row[Byte - BytesPerPixel] : 0;
+					const int32 Up = Previous[Byte];
+					const int32 UpLeft = Byte >= BytesPerPixel ? Previous[Byte - BytesPerPixel] : 0;
+					const int32 Predicted = Filter == 1 ? Left : Filter == 2 ? Up : Filter == 3 ? (Left + Up) / 2 : Filter == 4 ? Paeth(Left, Up, UpLeft) : 0;
+					Filtered.Add(uint8(Row[Byte] - Predicted));
+				}
+				Previous = Row;
+			}
+		}
+
+		uLongf CompressedSize = compressBound(Filtered.Num());
+		TArray<uint8> Compressed;
+		Compressed.SetNumUninitialized(CompressedSize);
+		compress2(Compressed.GetData(), &CompressedSize, Filtered.GetData(), Filtered.Num(), Z_BEST_SPEED);
+		Compressed.SetNum(CompressedSize);
+
+		TArray<uint8> Header;
+		AppendBigEndian(Header, Width);
+		AppendBigEndian(Header, Height);
+		const uint8 HeaderTail[] = { 8, uint8(bAlpha ? 6 : 2), 0, 0, 1 };
+		Header.Append(HeaderTail, int32(UE_ARRAY_COUNT(HeaderTail)));
+
+		const uint8 Signature[] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+		TArray<uint8> File;
+		File.Append(Signature, int32(UE_ARRAY_COUNT(Signature)));
+		AppendChunk(File, "IHDR", Header);
+		AppendChunk(File, "IDAT", Compressed);
+		AppendChunk(File, "IEND", TArray<uint8>());
+		return File;
+	}
+
+	/**
+	 * Forwards to the allocator it stands in for and counts what is allocated meanwhile. Every thread is
+	 * counted, since the JPEG decoder spreads its bands over task threads; it is never destroyed, as other
+	 * threads may still be inside it after GMalloc was restored
+	 */
+	class FCountingMalloc final : public FMalloc
+	{
+	public:
+		explicit FCountingMalloc(FMalloc* InInner)
+			: Inner(InInner)
+		{
+		}
+
+		virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+		{
+			NumBytes.Add(int64(Count));
+			return Inner->Malloc(Count, Alignment);
+		}
+
+		virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			NumBytes.Add(int64(Count));
+			return Inner->Realloc(Original, Count, Alignment);
+		}
+
+		virtual void Free(void* Original) override
+		{
+			Inner->Free(Original);
+		}
+
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override
+		{
+			return Inner->GetAllocationSize(Original, SizeOut);
+		}
+
+		virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override
+		{
+			return Inner->QuantizeSize(Count, Alignment);
+		}
+
+		virtual bool IsInternallyThreadSafe() const override
+		{
+			return Inner->IsInternallyThreadSafe();
+		}
+
+		virtual void Trim(bool bTrimThreadCaches) override
+		{
+			Inner->Trim(bTrimThreadCaches);
+		}
+
+		virtual const TCHAR* GetDescriptiveName() override
+		{
+			return TEXT("RovrCountingMalloc");
+		}
+
+		FMalloc* const Inner;
+		FThreadSafeCounter64 NumBytes;
+	};
+
+	/** Bytes allocated on every thread while Work runs, e.g. by the decode and its task threads */
+	int64 CountAllocatedBytes(TFunctionRef<void()> Work)
+	{
+		static FCountingMalloc* Counter = new FCountingMalloc(GMalloc);
+		Counter->NumBytes.Reset();
+
+		GMalloc = Counter;
+		Work();
+		GMalloc = Counter->Inner;
+		return Counter->NumBytes.GetValue();
+	}
+
+	/** Full decode with ImageWrapper, reduced with the area filter the way images were before RovrScaledDecode */
+	bool DecodeFullAndReduce(const TArray<uint8>& Compressed, int32 MaxWidth, int32 MaxHeight, TArray<uint8>& OutPixels)
+	{
+		IImageWrapperModule& ImageWrapperModule = GetImageWrapperModule();
+		const TSharedPtr<IImageWrapper> ImageWrapper = ImageWrapperModule.CreateImageWrapper(ImageWrapperModule.DetectImageFormat(Compressed.GetData(), Compressed.Num()));
+		TArray<uint8> Full;
+		if (!ImageWrapper.IsValid() || !ImageWrapper->SetCompressed(Compressed.GetData(), Compressed.Num()) || !ImageWrapper->GetRaw(ERGBFormat::BGRA, 8, Full))
+		{
+			return false;
+		}
+
+		const int32 Width = ImageWrapper->GetWidth();
+		const int32 Height = ImageWrapper->GetHeight();
+		const FIntPoint Size = RovrImageResize::FitSize(Width, Height, MaxWidth, MaxHeight);
+		if (Size == FIntPoint(Width, Height))
+		{
+			OutPixels = MoveTemp(Full);
+			return true;
+		}
+
+		OutPixels.SetNumUninitialized(int64(Size.X) * Size.Y * 4);
+		RovrImageResize::ResizeArea(Full.GetData(), int64(Width) * 4, Width, Height, OutPixels.GetData(), int64(Size.X) * 4, Size.X, Size.Y);
+		return true;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrScaledDecodeJpegTest, "Rovr.Imaging.ScaledDecode.Jpeg", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FRovrScaledDecodeJpegTest::RunTest(const FString& Parameters)
+{
+	const TArray<uint8> Image = MakeImage(false);
+	const TSharedPtr<IImageWrapper> Encoder = GetImageWrapperModule().CreateImageWrapper(EImageFormat::JPEG);
+	if (!TestTrue(TEXT("ImageWrapper encodes the JPEG"), Encoder.IsValid() && Encoder->SetRaw(Image.GetData(), Image.Num(), ImageWidth, ImageHeight, ERGBFormat::BGRA, 8)))
+	{
+		return false;
+	}
+	const TArray<uint8> Jpeg(Encoder->GetCompressed(95));
+
+	TArray<uint8> Reference;
+	if (!TestTrue(TEXT("ImageWrapper decodes the JPEG"), DecodeWithImageWrapper(EImageFormat::JPEG, Jpeg, Reference)))
+	{
+		return false;
+	}
+
+	FRovrJpegDecoder Decoder;
+	if (!TestTrue(TEXT("The JPEG ImageWrapper writes is baseline"), Decoder.Open(Jpeg)))
+	{
+		return false;
+	}
+
+	// The two decoders differ in their inverse DCT and chroma upsampling; reduced sizes are compared with the
+	// average of the full size pixels they stand for, which the DCT scaling approximates. Subsampled chroma is
+	// repeated rather than interpolated at reduced sizes, so the bounds grow with the scale
+	const float MaxMeanError[] = { 1.0f, 1.75f, 3.0f, 5.5f };
+	const int32 MaxError[] = { 8, 10, 18, 24 };
+
+	for (int32 ScaleShift = 0; ScaleShift <= FRovrJpegDecoder::MaxScaleShift; ++ScaleShift)
+	{
+		const FIntPoint Size = Decoder.GetScaledSize(ScaleShift);
+		TArray<uint8> Pixels;
+		Pixels.SetNumUninitialized(Size.X * Size.Y * 4);
+		const bool bDecoded = Decoder.Decode(64, [&Pixels, &Size](const uint8* Band, int32 FirstRow, int32 NumRows)
+		{
+			FMemory::Memcpy(&Pixels[FirstRow * Size.X * 4], Band, NumRows * Size.X * 4);
+			return true;
+		}, ScaleShift);
+
+		if (!TestTrue(TEXT("Scaled JPEG decode"), bDecoded) || !TestTrue(TEXT("Scaled size"), Size == FIntPoint(FMath::DivideAndRoundUp(ImageWidth, 1 << ScaleShift), FMath::DivideAndRoundUp(ImageHeight, 1 << ScaleShift))))
+		{
+			continue;
+		}
+
+		double TotalError = 0.0;
+		int32 WorstError = 0;
+		for (int32 Y = 0; Y < Size.Y; ++Y)
+		{
+			for (int32 X = 0; X < Size.X; ++X)
+			{
+				float Expected[4];
+				BoxAverage(Reference, 1 << ScaleShift, X, Y, Expected);
+				for (int32 Channel = 0; Channel < 3; ++Channel)
+				{
+					const int32 Error = FMath::RoundToInt(FMath::Abs(Pixels[(Y * Size.X + X) * 4 + Channel] - Expected[Channel]));
+					TotalError += Error;
+					WorstError = FMath::Max(WorstError, Error);
+				}
+				TestTrue(TEXT("JPEG pixels are opaque"), Pixels[(Y * Size.X + X) * 4 + 3] == 255);
+			}
+		}
+
+		const double MeanError = TotalError / (double(Size.X) * Size.Y * 3);
+		if (MeanError > MaxMeanError[ScaleShift] || WorstError > MaxError[ScaleShift])
+		{
+			AddError(FString::Printf(TEXT("JPEG at 1/%d differs from ImageWrapper by %.2f on average and %d at most"), 1 << ScaleShift, MeanError, WorstError));
+		}
+	}
+
+	// RovrScaledDecode picks 1/2 for a 150 pixel bound and takes the rest with the area filter
+	TArray<uint8> Fitted;
+	int32 FittedWidth = 0;
+	int32 FittedHeight = 0;
+	TestTrue(TEXT("Fitted JPEG decode"), RovrScaledDecode::Decode(Jpeg, 150, 150, Fitted, FittedWidth, FittedHeight));
+	TestEqual(TEXT("Scale for a 150 pixel bound"), RovrScaledDecode::GetScaleShift(ImageWidth, ImageHeight, 150, 150), 1);
+	TestTrue(TEXT("Fitted size"), FittedWidth == 150 && FittedHeight == 98 && Fitted.Num() == 150 * 98 * 4);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrScaledDecodePngTest, "Rovr.Imaging.ScaledDecode.Png", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FRovrScaledDecodePngTest::RunTest(const FString& Parameters)
+{
+	// PNG is lossless, so both decoders have to reproduce the image exactly
+	for (const bool bAlpha : { true, false })
+	{
+		const TArray<uint8> Image = MakeImage(bAlpha);
+
+		const TSharedPtr<IImageWrapper> Encoder = GetImageWrapperModule().CreateImageWrapper(EImageFormat::PNG);
+		if (!TestTrue(TEXT("ImageWrapper encodes the PNG"), Encoder.IsValid() && Encoder->SetRaw(Image.GetData(), Image.Num(), ImageWidth, ImageHeight, ERGBFormat::BGRA, 8)))
+		{
+			return false;
+		}
+		const TArray<uint8> Progressive(Encoder->GetCompressed());
+
+		TArray<uint8> Reference;
+		FRovrPngDecoder Decoder;
+		TArray<uint8> Pixels;
+		TestTrue(TEXT("ImageWrapper decodes its own PNG"), DecodeWithImageWrapper(EImageFormat::PNG, Progressive, Reference) && Reference == Image);
+		TestTrue(TEXT("Progressive PNG opens"), Decoder.Open(Progressive) && !Decoder.IsInterlaced() && Decoder.GetMaxScaleShift() == 0);
+		TestTrue(TEXT("Progressive PNG matches ImageWrapper"), Decoder.Decode(Pixels) && Pixels == Reference);
+
+		const TArray<uint8> Interlaced = EncodeInterlacedPng(Image, ImageWidth, ImageHeight, bAlpha);
+		if (!TestTrue(TEXT("Adam7 PNG opens"), Decoder.Open(Interlaced) && Decoder.IsInterlaced()))
+		{
+			continue;
+		}
+
+		// A reduced decode holds the pixel at the top left of each square, where the first passes sample the image
+		for (int32 ScaleShift = 0; ScaleShift <= Decoder.GetMaxScaleShift(); ++ScaleShift)
+		{
+			const FIntPoint Size = Decoder.GetScaledSize(ScaleShift);
+			if (!TestTrue(TEXT("Adam7 decode"), Decoder.Decode(Pixels, ScaleShift)) || !TestEqual(TEXT("Adam7 decode size"), Pixels.Num(), Size.X * Size.Y * 4))
+			{
+				continue;
+			}
+
+			int32 NumWrong = 0;
+			for (int32 Y = 0; Y < Size.Y; ++Y)
+			{
+				for (int32 X = 0; X < Size.X; ++X)
+				{
+					NumWrong += FMemory::Memcmp(&Pixels[(Y * Size.X + X) * 4], &Image[((Y << ScaleShift) * ImageWidth + (X << ScaleShift)) * 4], 4) != 0 ? 1 : 0;
+				}
+			}
+			if (NumWrong > 0)
+			{
+				AddError(FString::Printf(TEXT("Adam7 %s PNG at 1/%d has %d wrong pixels"), bAlpha ? TEXT("RGBA") : TEXT("RGB"), 1 << ScaleShift, NumWrong));
+			}
+		}
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrScaledDecodeBenchmarkTest, "Rovr.Imaging.ScaledDecode.Benchmark", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FRovrScaledDecodeBenchmarkTest::RunTest(const FString& Parameters)
+{
+	// The 360 photo of the project is the kind of image the scaled decode is for; packaged builds only have
+	// it cooked, so they fall back to the synthetic image
+	const FString PhotoPath = FPaths::ProjectContentDir() / TEXT("Images-Resources/360_Image.jpeg");
+	TArray<uint8> Jpeg;
+	if (!FFileHelper::LoadFileToArray(Jpeg, *PhotoPath, FILEREAD_Silent))
+	{
+		AddInfo(FString::Printf(TEXT("%s not found, timing the synthetic %dx%d image"), *PhotoPath, ImageWidth, ImageHeight));
+		const TArray<uint8> Image = MakeImage(false);
+		const TSharedPtr<IImageWrapper> Encoder = GetImageWrapperModule().CreateImageWrapper(EImageFormat::JPEG);
+		if (!TestTrue(TEXT("ImageWrapper encodes the JPEG"), Encoder.IsValid() && Encoder->SetRaw(Image.GetData(), Image.Num(), ImageWidth, ImageHeight, ERGBFormat::BGRA, 8)))
+		{
+			return false;
+		}
+		Jpeg = TArray<uint8>(Encoder->GetCompressed(95));
+	}
+
+	// An Adam7 PNG of the photo at a quarter of its size, which keeps encoding it in the test short
+	TArray<uint8> Quarter;
+	FRovrJpegDecoder Header;
+	if (!TestTrue(TEXT("The photo is a baseline JPEG"), Header.Open(Jpeg)) || !TestTrue(TEXT("The photo decodes at a quarter"), DecodeFullAndReduce(Jpeg, Header.GetScaledSize(2).X, Header.GetScaledSize(2).Y, Quarter)))
+	{
+		return false;
+	}
+	const FIntPoint QuarterSize = RovrImageResize::FitSize(Header.GetScaledSize(0).X, Header.GetScaledSize(0).Y, Header.GetScaledSize(2).X, Header.GetScaledSize(2).Y);
+	const TArray<uint8> Png = EncodeInterlacedPng(Quarter, QuarterSize.X, QuarterSize.Y, false);
+
+	struct FSource
+	{
+		const TCHAR* Name;
+		const TArray<uint8>& Bytes;
+		FIntPoint Size;
+	};
+	const FSource Sources[] = { { TEXT("JPEG"), Jpeg, Header.GetScaledSize(0) }, { TEXT("Adam7 PNG"), Png, QuarterSize } };
+
+	for (const FSource& Source : Sources)
+	{
+		for (int32 ScaleShift = 0; ScaleShift <= 3; ++ScaleShift)
+		{
+			const int32 MaxWidth = FMath::DivideAndRoundUp(Source.Size.X, 1 << ScaleShift);
+			const int32 MaxHeight = FMath::DivideAndRoundUp(Source.Size.Y, 1 << ScaleShift);
+
+			TArray<uint8> Reference;
+			bool bReferenceDecoded = false;
+			double Start = FPlatformTime::Seconds();
+			const int64 ReferenceBytes = CountAllocatedBytes([&bReferenceDecoded, &Source, MaxWidth, MaxHeight, &Reference]()
+			{
+				bReferenceDecoded = DecodeFullAndReduce(Source.Bytes, MaxWidth, MaxHeight, Reference);
+			});
+			const double ReferenceSeconds = FPlatformTime::Seconds() - Start;
+
+			TArray<uint8> Pixels;
+			int32 Width = 0;
+			int32 Height = 0;
+			bool bScaledDecoded = false;
+			Start = FPlatformTime::Seconds();
+			const int64 ScaledBytes = CountAllocatedBytes([&bScaledDecoded, &Source, MaxWidth, MaxHeight, &Pixels, &Width, &Height]()
+			{
+				bScaledDecoded = RovrScaledDecode::Decode(Source.Bytes, MaxWidth, MaxHeight, Pixels, Width, Height);
+			});
+			const double ScaledSeconds = FPlatformTime::Seconds() - Start;
+
+			if (!TestTrue(TEXT("Both decoders decode the image"), bReferenceDecoded && bScaledDecoded) || !TestEqual(TEXT("Both decoders give the same size"), Pixels.Num(), Reference.Num()))
+			{
+				continue;
+			}
+
+			AddInfo(FString::Printf(TEXT("%s %dx%d at 1/%d: ImageWrapper %.2f ms, %.1f MB allocated; scaled decode %.2f ms, %.1f MB allocated"),
+				Source.Name, Source.Size.X, Source.Size.Y, 1 << ScaleShift, ReferenceSeconds * 1000.0, ReferenceBytes / (1024.0 * 1024.0), ScaledSeconds * 1000.0, ScaledBytes / (1024.0 * 1024.0)));
+		}
+	}
+
+	return true;
+}
+
+#endif
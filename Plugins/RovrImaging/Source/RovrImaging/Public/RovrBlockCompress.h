@@ -0,0 +1,47 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+/**
+ * Block compression presets for textures created at runtime, trading encode time for quality
+ */
+enum class ERovrCompressQuality : uint8
+{
+	/** Keep the texture uncompressed */
+	None,
+	/** Differential blocks from subblock averages */
+	Fast,
+	/** Also tries individual and planar blocks; planar keeps sky gradients smooth */
+	Normal,
+	/** Also searches the colors around each subblock average */
+	High
+};
+
+/**
+ * CPU encoder for ETC2 RGB, the compressed format every OpenGL ES 3 and Vulkan headset samples natively.
+ * A block takes 8 bytes for 4x4 texels, an eighth of BGRA8. Rows of blocks are split with ParallelFor while
+ * the calling thread waits.
+ *
+ * Blocks are encoded in the individual, differential and planar modes; the T and H modes, which only
+ * help blocks holding a few unrelated colors, are not used. Alpha is discarded.
+ */
+namespace RovrBlockCompress
+{
+	/** Whether the RHI can sample PF_ETC2_RGB textures */
+	ROVRIMAGING_API bool IsETC2Supported();
+
+	/**
+	 * Encode a BGRA8 image as ETC2 RGB blocks. Blocks crossing the right or bottom edge repeat the last column or row
+	 *
+	 * @param Source First row of the source image
+	 * @param SourceStride Distance between source rows in bytes
+	 * @param Width Width of the image in pixels
+	 * @param Height Height of the image in rows
+	 * @param Dest Receives DivideAndRoundUp(Width, 4) x DivideAndRoundUp(Height, 4) blocks, row by row
+	 * @param Quality Fast, Normal or High
+	 */
+	ROVRIMAGING_API void CompressETC2(const uint8* Source, int64 SourceStride, int32 Width, int32 Height, uint8* Dest, ERovrCompressQuality Quality);
+}
@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RovrTexture.h"
+
+class UTextureCube;
+
+
+/**
+ * How the faces of a cube divide the sphere
+ */
+enum class ERovrCubeProjection : uint8
+{
+	/** Perspective faces, as the GPU samples cubemaps; texels near the face edges cover a third of the angle of central ones */
+	Cubemap,
+	/** Equi-angular faces: every texel covers the same angle, which EAC packs 3x2 into a 2D texture */
+	EquiAngular
+};
+
+/**
+ * Filters for resampling an image at arbitrary positions
+ */
+enum class ERovrResampleFilter : uint8
+{
+	/** 2x2 texels */
+	Bilinear,
+	/** Catmull-Rom over 4x4 texels; sharper, with slight overshoot at hard edges */
+	Bicubic
+};
+
+/**
+ * Conversion of equirect 360 images to cube faces. An equirect image spends as many texels on the rows
+ * next to a pole as on the horizon, and pinches at the poles when mapped onto a sphere; cube faces
+ * spread the texels far more evenly, so the same sharpness takes about a quarter less memory.
+ *
+ * Faces come in UE's cube face order and orientation, that of its own long-lat cubemap import: +X, -X,
+ * +Z, -Z, +Y, -Y in world terms. The equirect image's centre faces +X, its top edge +Z, as on
+ * ARovrTiledSkySphere. Rows of all faces are split over worker threads; the filters are vectorized
+ * with SSE2 and NEON.
+ */
+namespace RovrCubemap
+{
+	const int32 NumFaces = 6;
+
+	/** Largest face size; six faces of it take 1.5 GB as BGRA8 */
+	const int32 MaxFaceSize = 8192;
+
+	/** Face size that keeps the equirect image's sharpness at the horizon: a quarter of its width, rounded to a multiple of 4, at most MaxFaceSize */
+	ROVRIMAGING_API int32 GetFaceSize(int32 EquirectWidth);
+
+	/**
+	 * Resample an equirect image to the six faces of a cube. Texels keep the image's layout
+	 *
+	 * @param Dest Receives the faces one after another, each FaceSize x FaceSize tightly packed texels
+	 * @return False if the image is invalid or narrower than 4 texels, or FaceSize is above MaxFaceSize
+	 */
+	ROVRIMAGING_API bool FromEquirect(const FRovrImageView& Equirect, int32 FaceSize, ERovrCubeProjection Projection, ERovrResampleFilter Filter, uint8* Dest);
+
+	/**
+	 * Arrange six faces made by FromEquirect in a 3x2 grid: +X, -X, +Z in the top row, -Z, +Y, -Y below,
+	 * each face as it is. The layout of EAC textures
+	 *
+	 * @param Dest Receives 3 * FaceSize x 2 * FaceSize texels
+	 */
+	ROVRIMAGING_API void PackFaces3x2(const uint8* Faces, int32 FaceSize, uint8* Dest);
+
+	/**
+	 * Create a transient cube texture from six BGRA8 faces made by FromEquirect with ERovrCubeProjection::Cubemap
+	 *
+	 * @return The texture, or nullptr if Faces does not hold six faces
+	 */
+	ROVRIMAGING_API UTextureCube* CreateTextureCube(const TArray<uint8>& Faces, int32 FaceSize, FName Name = NAME_None);
+}
@@ -0,0 +1,150 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Kismet/BlueprintFunctionLibrary.h"
+
+#include "RovrDecodeScheduler.generated.h"
+
+
+/**
+ * How urgently an image decode is needed
+ */
+UENUM(BlueprintType, Category = "ROVR Imaging")
+enum class ERovrDecodePriority : uint8
+{
+	/** Shown right now, e.g. lobby tiles in view or the scene being opened */
+	Visible,
+	/** Likely to be shown soon, e.g. tiles just past the edge of the view */
+	Prefetch,
+	/** Nobody waits for it, e.g. warming caches */
+	Background
+};
+
+/**
+ * Queue that runs image decodes on worker threads in order of priority. Visible decodes start before
+ * prefetches and prefetches before background work; within a class the newest request goes first, since
+ * in a scrolling list the tiles requested last are the ones still in view. At most
+ * rovr.DecodeScheduler.MaxConcurrent decodes run at once, and prefetch and background decodes leave one of
+ * those slots free, so a tile scrolling into view never waits for a batch of prefetches to finish.
+ *
+ * Each decode states the memory it takes at its peak; decodes only start while the running ones and the new
+ * one fit into rovr.DecodeScheduler.MemoryBudgetMB, and into half of the physical memory the system has
+ * left. A decode larger than the budget runs alone. When the most urgent decode does not fit, nothing
+ * behind it starts either, so a large image in view is not starved by a stream of small ones.
+ *
+ * Cancelled decodes that have not started are dropped; running ones see their cancellation flag set and
+ * may stop early. A decode can also be cancelled after its work finished and queued its result for the game
+ * thread: the scheduler keeps reaching the flag for as long as anything holds it, so callbacks that must not
+ * run once cancelled keep the flag and check it before delivering.
+ * Every function can be called from any thread.
+ */
+class ROVRIMAGING_API FRovrDecodeScheduler
+{
+public:
+	/** Cancellation flag of a decode, which stays valid for the callbacks its work queues */
+	typedef TSharedRef<FThreadSafeBool, ESPMode::ThreadSafe> FCancelFlag;
+
+	/** Work of a decode, run on a worker thread. Long decodes poll bCancelled and stop early once it is set */
+	typedef TUniqueFunction<void(const FCancelFlag& bCancelled)> FWork;
+
+	static const int32 NumPriorities = 3;
+
+	struct FStats
+	{
+		int32 NumQueued[NumPriorities] = {};
+		int32 NumRunning = 0;
+		int64 RunningBytes = 0;
+		int32 NumStarted = 0;
+		int32 NumCancelled = 0;
+	};
+
+	/** Scheduler shared by every module */
+	static FRovrDecodeScheduler& Get();
+
+	/**
+	 * Rough peak memory of decoding an image to BGRA8 at full size when only its compressed size is known:
+	 * photos compress to about a tenth of their pixels, and the compressed data stays alive while decoding
+	 */
+	static int64 EstimateDecodeBytes(int64 CompressedBytes) { return CompressedBytes * 11; }
+
+	/**
+	 * Queue a decode
+	 *
+	 * @param MemoryBytes Memory the decode takes at its peak, held against the budget while it runs
+	 * @param Work Run on a worker thread unless cancelled first
+	 * @return Id of the decode for Cancel and SetPriority, never 0
+	 */
+	int32 Enqueue(ERovrDecodePriority Priority, int64 MemoryBytes, FWork&& Work);
+
+	/**
+	 * Cancel a decode, e.g. when its tile scrolled away. A queued decode never starts; a started one has its
+	 * cancellation flag set while its work or a callback it queued still holds the flag. Unknown decodes, and
+	 * finished ones whose flag nobody holds any more, are ignored
+	 */
+	void Cancel(int32 Id);
+
+	/** Move a queued decode to another class, e.g. when a prefetched tile scrolls into view; it goes first in its new class */
+	void SetPriority(int32 Id, ERovrDecodePriority Priority);
+
+	FStats GetStats() const;
+
+private:
+	struct FJob
+	{
+		int32 Id;
+		int64 MemoryBytes;
+		FWork Work;
+		FCancelFlag bCancelled;
+	};
+
+	/** Start the queued decodes that fit, most urgent first */
+	void Dispatch();
+
+	void Finish(int32 Id, int64 MemoryBytes);
+
+	/** Budget for running decodes, with the platform's free memory read at most every few seconds. Called with Lock held */
+	int64 GetMemoryBudget();
+
+	mutable FCriticalSection Lock;
+
+	/** Queued decodes of each class, newest last */
+	TArray<FJob> Queues[NumPriorities];
+
+	/** Ids of the running decodes */
+	TSet<int32> Running;
+
+	/** Cancellation flags of the started decodes, kept until their last holder releases them */
+	TMap<int32, TWeakPtr<FThreadSafeBool, ESPMode::ThreadSafe>> StartedFlags;
+
+	int64 RunningBytes = 0;
+	int32 NextId = 1;
+	int32 NumStarted = 0;
+	int32 NumCancelled = 0;
+
+	uint64 AvailablePhysical = MAX_uint64;
+	double LastMemoryCheck = -1.0;
+};
+
+/**
+ * Blueprint access to the decode scheduler, for the ids that asynchronous image requests return
+ */
+UCLASS()
+class ROVRIMAGING_API URovrDecodeLibrary : public UBlueprintFunctionLibrary
+{
+	GENERATED_BODY()
+
+public:
+	/**
+	 * Cancel an image decode, e.g. when the widget showing it scrolled away or closed. The requests that
+	 * hand out decode ids check for cancellation on the game thread, so once this returns they never call back
+	 */
+	UFUNCTION(BlueprintCallable, Category = "ROVR Imaging")
+	static void CancelImageDecode(int32 DecodeId);
+
+	/** Change how urgently a queued image decode is needed, e.g. when a prefetched tile scrolls into view */
+	UFUNCTION(BlueprintCallable, Category = "ROVR Imaging")
+	static void SetImageDecodePriority(int32 DecodeId, ERovrDecodePriority Priority);
+};
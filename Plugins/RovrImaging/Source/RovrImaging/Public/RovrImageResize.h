@@ -0,0 +1,28 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+/**
+ * Resampling of BGRA8 images to arbitrary sizes, e.g. video frames scaled down to thumbnails. The filter
+ * averages every source pixel a destination pixel covers, weighted by the covered area, so large
+ * reductions do not alias; rows are split over worker threads.
+ */
+namespace RovrImageResize
+{
+	/** Largest size with the aspect ratio of Width x Height that fits into MaxWidth x MaxHeight, never larger than the image itself */
+	ROVRIMAGING_API FIntPoint FitSize(int32 Width, int32 Height, int32 MaxWidth, int32 MaxHeight);
+
+	/**
+	 * Resample a BGRA8 image with the area filter. Meant for reductions; enlarging interpolates linearly
+	 * between neighbouring pixels at best
+	 *
+	 * @param Source First row of the source image
+	 * @param SourceStride Distance between source rows in bytes
+	 * @param Dest First row of the destination image
+	 * @param DestStride Distance between destination rows in bytes
+	 */
+	ROVRIMAGING_API void ResizeArea(const uint8* Source, int64 SourceStride, int32 SourceWidth, int32 SourceHeight, uint8* Dest, int64 DestStride, int32 DestWidth, int32 DestHeight);
+}
@@ -0,0 +1,115 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PixelFormat.h"
+#include "RovrTexture.h"
+
+
+/**
+ * Tile of an image pyramid. Level 0 is the full image; every level halves the one above, down to a level that fits a single tile
+ */
+struct ROVRIMAGING_API FRovrTileId
+{
+	int32 Level = 0;
+	int32 X = 0;
+	int32 Y = 0;
+
+	FRovrTileId() = default;
+
+	FRovrTileId(int32 InLevel, int32 InX, int32 InY)
+		: Level(InLevel)
+		, X(InX)
+		, Y(InY)
+	{
+	}
+
+	bool operator==(const FRovrTileId& Other) const
+	{
+		return Level == Other.Level && X == Other.X && Y == Other.Y;
+	}
+
+	friend uint32 GetTypeHash(const FRovrTileId& Tile)
+	{
+		return HashCombine(HashCombine(::GetTypeHash(Tile.Level), ::GetTypeHash(Tile.X)), ::GetTypeHash(Tile.Y));
+	}
+};
+
+/**
+ * Source of the tiles of an image pyramid, for viewers that keep only the tiles in sight at full resolution.
+ *
+ * Every tile is GetTileSize() + 2 * Border texels square: the tile's own area, then a border copied from
+ * its neighbours, so bilinear filtering does not seam where tiles meet. Tiles on the right and bottom edge
+ * of a level cover less than a full tile; their unused texels continue the way the border does. ReadTile
+ * may be called from any thread.
+ */
+class ROVRIMAGING_API IRovrTileSource
+{
+public:
+	/** Texels each tile repeats from its neighbours on every side; a whole ETC2 block, so tiles stay block aligned */
+	static const int32 Border = 4;
+
+	virtual ~IRovrTileSource() = default;
+
+	/** Texels of a level a tile covers along each axis, without its border */
+	virtual int32 GetTileSize() const = 0;
+
+	virtual int32 GetNumLevels() const = 0;
+
+	virtual FIntPoint GetLevelSize(int32 Level) const = 0;
+
+	/** PF_B8G8R8A8 or PF_ETC2_RGB */
+	virtual EPixelFormat GetFormat() const = 0;
+
+	/**
+	 * Read the texels of a tile, border included, in the source's format
+	 *
+	 * @return Whether the tile exists and could be read
+	 */
+	virtual bool ReadTile(const FRovrTileId& Tile, TArray<uint8>& OutData) const = 0;
+
+	/** Side of the square tile textures, border included */
+	int32 GetTileTextureSize() const { return GetTileSize() + 2 * Border; }
+
+	FIntPoint GetNumTiles(int32 Level) const;
+};
+
+/**
+ * Tile pyramid of an image held in memory, cut once from the decoded image. Encoded as ETC2 where the
+ * RHI samples it, all levels together take about a sixth of the decoded image
+ */
+class ROVRIMAGING_API FRovrMemoryTileSource : public IRovrTileSource
+{
+public:
+	/**
+	 * Cut an image into a tile pyramid. Takes a while for large images; meant for worker threads
+	 *
+	 * @param TileSize Tile size without borders, a multiple of 4
+	 * @param Compression ETC2 preset, ERovrCompressQuality::None to keep BGRA8
+	 * @param bWrapX Take the borders on the left and right edge from the opposite edge, as equirect panoramas need
+	 * @param bIgnoreRHISupport Compress even where this RHI cannot sample ETC2, e.g. for pyramid files built for headsets
+	 * @return The tiles, or nullptr if Image is invalid
+	 */
+	static TSharedPtr<FRovrMemoryTileSource, ESPMode::ThreadSafe> Build(const FRovrImageView& Image, int32 TileSize, ERovrCompressQuality Compression, bool bWrapX, bool bIgnoreRHISupport = false);
+
+	//~ Begin IRovrTileSource Interface
+	virtual int32 GetTileSize() const override { return TileSize; }
+	virtual int32 GetNumLevels() const override { return LevelSizes.Num(); }
+	virtual FIntPoint GetLevelSize(int32 Level) const override { return LevelSizes[Level]; }
+	virtual EPixelFormat GetFormat() const override { return Format; }
+	virtual bool ReadTile(const FRovrTileId& Tile, TArray<uint8>& OutData) const override;
+	//~ End IRovrTileSource Interface
+
+	/** Bytes the tiles of every level take */
+	int64 GetAllocatedSize() const;
+
+private:
+	int32 TileSize = 0;
+	EPixelFormat Format = PF_Unknown;
+	TArray<FIntPoint> LevelSizes;
+
+	/** Tiles of every level, row by row, level 0 first */
+	TArray<TArray<uint8>> Tiles;
+	TArray<int32> FirstTiles;
+};
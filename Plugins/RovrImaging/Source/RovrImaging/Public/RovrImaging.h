@@ -0,0 +1,18 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Modules/ModuleManager.h"
+
+class FRovrImagingModule : public IModuleInterface
+{
+public:
+	virtual void StartupModule() override;
+	virtual void ShutdownModule() override;
+
+private:
+	static void SaveCaches();
+
+	FDelegateHandle BackgroundHandle;
+	FDelegateHandle PreExitHandle;
+};
@@ -0,0 +1,139 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+/**
+ * Decoder for baseline JPEG files, the kind cameras and stitchers write for 360 panoramas, that can hand
+ * out an image before all of it is decoded: a preview built from the DC coefficients alone, at an
+ * eighth of the size, and the full image in bands of rows from the top. The image can also be decoded at
+ * a half, quarter or eighth of its size straight from the DCT coefficients, for thumbnails that never need
+ * the full resolution. Entropy decoding is sequential; the inverse DCT and colour conversion of each band
+ * are split over worker threads.
+ *
+ * Progressive, arithmetic coded, lossless and 12 bit files are not handled; Open fails for them and
+ * callers decode such files with ImageWrapper instead
+ */
+class ROVRIMAGING_API FRovrJpegDecoder
+{
+public:
+	/** Largest reduction Decode makes, an eighth of the size */
+	static const int32 MaxScaleShift = 3;
+
+	/**
+	 * Parse the headers of a JPEG file up to its scan. The data has to stay alive and unchanged while the decoder is used
+	 *
+	 * @return Whether the file is a baseline JPEG this decoder can decode
+	 */
+	bool Open(TArrayView<const uint8> InData);
+
+	int32 GetWidth() const { return Width; }
+	int32 GetHeight() const { return Height; }
+
+	/** Size of the preview DecodePreview makes: one pixel per 8x8 block of the image */
+	FIntPoint GetPreviewSize() const { return FIntPoint((Width + 7) / 8, (Height + 7) / 8); }
+
+	/** Size of the image Decode makes with a ScaleShift: the image's size divided by 2^ScaleShift, rounded up */
+	FIntPoint GetScaledSize(int32 ScaleShift) const
+	{
+		return FIntPoint((Width + (1 << ScaleShift) - 1) >> ScaleShift, (Height + (1 << ScaleShift) - 1) >> ScaleShift);
+	}
+
+	/**
+	 * Decode the DC coefficient of every block, the block's average colour, into a BGRA8 image of
+	 * GetPreviewSize(). The whole scan is read, but no inverse DCT runs
+	 *
+	 * @return Whether the scan was decoded; a truncated scan leaves the remaining blocks grey
+	 */
+	bool DecodePreview(TArray<uint8>& OutPixels);
+
+	/**
+	 * Decode the image from the top in bands of whole MCU rows
+	 *
+	 * @param BandHeight Rows per band, rounded up to whole MCU rows; the last band may be shorter
+	 * @param OnBand Receives each band as tightly packed BGRA8 rows and the image row it starts at. The
+	 *               pixels are only valid during the call; returning false stops decoding
+	 * @param ScaleShift Decode at GetScaledSize(ScaleShift), 0 to MaxScaleShift. Reduced sizes run an inverse
+	 *                   DCT of only the lowest 4x4 or 2x2 coefficients of each block, or at an eighth none
+	 *                   at all; rows and bands count rows of the reduced image
+	 * @return Whether every band was decoded and taken
+	 */
+	bool Decode(int32 BandHeight, TFunctionRef<bool(const uint8* Pixels, int32 FirstRow, int32 NumRows)> OnBand, int32 ScaleShift = 0);
+
+private:
+	struct FHuffmanTable
+	{
+		/** Symbol and code length of every code up to FastBits long, indexed by the next FastBits bits; zero length for longer codes */
+		uint8 FastSymbol[1 << 9];
+		uint8 FastLength[1 << 9];
+
+		/** Largest code of each length, shifted to 16 bits, and where the codes of each length start in Symbols */
+		uint32 MaxCode[18];
+		int32 ValueOffset[17];
+		uint8 Symbols[256];
+		bool bValid = false;
+	};
+
+	struct FComponent
+	{
+		int32 Id = 0;
+		int32 H = 1;
+		int32 V = 1;
+		int32 QuantTable = 0;
+		int32 DCTable = 0;
+		int32 ACTable = 0;
+		int32 DCPrediction = 0;
+
+		/** Blocks per MCU row and per MCU column of the image */
+		int32 BlocksX = 0;
+		int32 BlocksY = 0;
+	};
+
+	/** Reads the entropy coded scan; stops at the next marker and feeds zeros past it */
+	struct FBitReader
+	{
+		const uint8* Data = nullptr;
+		int64 Size = 0;
+		int64 Position = 0;
+		uint64 Bits = 0;
+		int32 NumBits = 0;
+		bool bMarker = false;
+
+		void Fill();
+		uint32 Peek(int32 Count);
+		void Skip(int32 Count);
+		int32 Receive(int32 Count);
+		void Restart();
+	};
+
+	bool ParseScanHeader(const uint8* Segment, int32 Length);
+	void BeginScan();
+
+	/** Decode the next MCU's blocks into Blocks, 64 coefficients each in natural order, or with bDCOnly one DC coefficient per block */
+	bool DecodeMcu(int16* Blocks, bool bDCOnly);
+	bool DecodeBlock(FComponent& Component, int16* Block, bool bDCOnly);
+	int32 DecodeSymbol(const FHuffmanTable& Table);
+
+	TArrayView<const uint8> Data;
+	int64 ScanStart = 0;
+
+	int32 Width = 0;
+	int32 Height = 0;
+	int32 MaxH = 1;
+	int32 MaxV = 1;
+	int32 McusX = 0;
+	int32 McusY = 0;
+	int32 BlocksPerMcu = 0;
+	int32 RestartInterval = 0;
+
+	TArray<FComponent, TInlineAllocator<3>> Components;
+	uint16 QuantTables[4][64];
+	FHuffmanTable DCTables[4];
+	FHuffmanTable ACTables[4];
+
+	FBitReader Reader;
+	int32 McusToRestart = 0;
+	int32 NextRestartMarker = 0;
+};
@@ -0,0 +1,53 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+/**
+ * Filters for generating the lower mips of a texture
+ */
+enum class ERovrMipFilter : uint8
+{
+	/** Mip 0 only */
+	None,
+	/** 2x2 average; fast, slightly blurry */
+	Box,
+	/** Kaiser windowed sinc over 8x8 texels; sharper, for large photos and 360 images */
+	Kaiser
+};
+
+/**
+ * CPU generation of mip chains for BGRA8 images created at runtime. Every level is computed from the
+ * previous one, its rows split with ParallelFor while the calling thread waits; the box filter is vectorized
+ * with SSE2 and NEON. Downloaded images, photos and thumbnails get their chains on decode scheduler workers,
+ * through RovrTexture::Encode and UpdateAsync; only textures created or filled from an image view generate
+ * them on the game thread.
+ */
+namespace RovrMipChain
+{
+	/** Number of mips down to 1x1, including mip 0 */
+	ROVRIMAGING_API int32 GetNumMips(int32 Width, int32 Height);
+
+	/**
+	 * Halve a BGRA8 image. An odd last row or column only contributes through the Kaiser filter's wider footprint
+	 *
+	 * @param Source First row of the source image
+	 * @param SourceStride Distance between source rows in bytes
+	 * @param Width Width of the source in pixels
+	 * @param Height Height of the source in rows
+	 * @param Dest Receives the tightly packed Max(Width / 2, 1) x Max(Height / 2, 1) image
+	 * @param Filter Box or Kaiser
+	 */
+	ROVRIMAGING_API void Downsample(const uint8* Source, int64 SourceStride, int32 Width, int32 Height, uint8* Dest, ERovrMipFilter Filter);
+
+	/**
+	 * Generate every mip below a BGRA8 image
+	 *
+	 * @param Base First row of mip 0
+	 * @param Stride Distance between rows of mip 0 in bytes
+	 * @param OutMips Receives mip 1 and below, tightly packed; empty for ERovrMipFilter::None
+	 */
+	ROVRIMAGING_API void Generate(const uint8* Base, int64 Stride, int32 Width, int32 Height, ERovrMipFilter Filter, TArray<TArray<uint8>>& OutMips);
+}
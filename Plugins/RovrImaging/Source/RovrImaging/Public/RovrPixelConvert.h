@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+/**
+ * Memory layouts of 32 bit source pixels
+ */
+enum class ERovrPixelLayout : uint8
+{
+	/** B, G, R, A bytes; the layout of FColor and PF_B8G8R8A8 */
+	BGRA8,
+	/** R, G, B, A bytes; the layout of PF_R8G8B8A8 and most decoders */
+	RGBA8,
+	/** 0xAARRGGBB integers in native byte order, as handed out by android.graphics.Bitmap.getPixels */
+	ARGB32
+};
+
+/**
+ * Options of a pixel conversion
+ */
+enum class ERovrPixelConvertFlags : uint8
+{
+	None = 0,
+	/** Set every alpha to 255 */
+	ForceOpaque = 1 << 0,
+	/** Write the rows bottom up */
+	FlipVertically = 1 << 1
+};
+ENUM_CLASS_FLAGS(ERovrPixelConvertFlags);
+
+/**
+ * Conversion kernels from common 32 bit pixel layouts to BGRA8, vectorized with SSE2 on x86 and NEON
+ * on ARM, with a scalar fallback for everything else. All kernels accept unaligned pointers and produce
+ * the same bytes whichever path runs.
+ */
+namespace RovrPixelConvert
+{
+	/**
+	 * Convert a run of pixels to BGRA8. Source and destination may be the same buffer, but must not partially overlap
+	 *
+	 * @param Source Pixels in SourceLayout
+	 * @param SourceLayout Layout of Source
+	 * @param Dest Receives NumPixels BGRA8 pixels
+	 * @param NumPixels Number of pixels to convert
+	 * @param bForceOpaque Set every alpha to 255
+	 */
+	ROVRIMAGING_API void ConvertRow(const void* Source, ERovrPixelLayout SourceLayout, uint8* Dest, int64 NumPixels, bool bForceOpaque);
+
+	/**
+	 * Convert an image to BGRA8, splitting large images over worker threads
+	 *
+	 * @param Source First row of the source image
+	 * @param SourceLayout Layout of Source
+	 * @param SourceStride Distance between source rows in bytes
+	 * @param Dest First row of the destination image
+	 * @param DestStride Distance between destination rows in bytes
+	 * @param Width Width of the image in pixels
+	 * @param Height Height of the image in rows
+	 * @param Flags Conversion options
+	 */
+	ROVRIMAGING_API void ConvertImage(const void* Source, ERovrPixelLayout SourceLayout, int64 SourceStride, uint8* Dest, int64 DestStride, int32 Width, int32 Height, ERovrPixelConvertFlags Flags = ERovrPixelConvertFlags::None);
+
+	/** Whether every pixel of an image in any of the layouts has an alpha of 255 */
+	ROVRIMAGING_API bool IsOpaque(const void* Source, ERovrPixelLayout SourceLayout, int64 SourceStride, int32 Width, int32 Height);
+
+	/** Set the alpha of a run of BGRA8 or RGBA8 pixels to 255 in place */
+	ROVRIMAGING_API void SetOpaque(uint8* Pixels, int64 NumPixels);
+
+	/** Mirror an image vertically in place */
+	ROVRIMAGING_API void FlipVertically(uint8* Pixels, int64 Stride, int32 Height);
+}
@@ -0,0 +1,83 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+/**
+ * Decoder for PNG files that stops early on interlaced images. An Adam7 interlaced PNG stores its pixels
+ * in seven passes, each filling in a finer grid of the image: the first pass holds every eighth pixel of
+ * every eighth row, the first three passes every fourth, the first five every second. Decoding such an
+ * image at a reduced size inflates and unfilters only those passes and leaves the rest of the data alone,
+ * so a thumbnail costs a fraction of the full decode. Images without interlacing decode at full size only.
+ *
+ * Every colour type and bit depth is handled; 16 bit samples are cut to 8 bits, and gamma and colour
+ * profile chunks are ignored, as ImageWrapper does. Checksums are not verified.
+ */
+class ROVRIMAGING_API FRovrPngDecoder
+{
+public:
+	/**
+	 * Parse the chunks of a PNG file. The data has to stay alive and unchanged while the decoder is used
+	 *
+	 * @return Whether the file is a PNG this decoder can decode
+	 */
+	bool Open(TArrayView<const uint8> InData);
+
+	int32 GetWidth() const { return Width; }
+	int32 GetHeight() const { return Height; }
+
+	bool IsInterlaced() const { return bInterlaced; }
+
+	/** Largest ScaleShift Decode honours: 3, an eighth of the size, for interlaced images and 0 for others */
+	int32 GetMaxScaleShift() const { return bInterlaced ? 3 : 0; }
+
+	/** Size of the image Decode makes with a ScaleShift: the image's size divided by 2^ScaleShift, rounded up */
+	FIntPoint GetScaledSize(int32 ScaleShift) const
+	{
+		ScaleShift = FMath::Clamp(ScaleShift, 0, GetMaxScaleShift());
+		return FIntPoint((Width + (1 << ScaleShift) - 1) >> ScaleShift, (Height + (1 << ScaleShift) - 1) >> ScaleShift);
+	}
+
+	/**
+	 * Decode the image into BGRA8 at GetScaledSize(ScaleShift). At a reduced size, each pixel is the image's
+	 * pixel at the top left of the square it stands for, as the interlace passes store them
+	 *
+	 * @param ScaleShift 0 to GetMaxScaleShift(); larger values are clamped
+	 * @return Whether the image was decoded; fails on damaged or truncated data
+	 */
+	bool Decode(TArray<uint8>& OutPixels, int32 ScaleShift = 0);
+
+private:
+	/** Grid of image pixels one interlace pass holds */
+	struct FPass
+	{
+		int32 StartX;
+		int32 StartY;
+		int32 StepX;
+		int32 StepY;
+	};
+
+	/** Convert one unfiltered row of a pass to BGRA8, writing every pixel OutStep bytes apart */
+	void ConvertRow(const uint8* Row, int32 NumPixels, uint8* Out, int32 OutStep) const;
+
+	TArrayView<const uint8> Data;
+
+	/** The IDAT chunks, whose data joined together is the zlib stream */
+	TArray<TArrayView<const uint8>> ImageData;
+
+	int32 Width = 0;
+	int32 Height = 0;
+	int32 BitDepth = 0;
+	int32 ColorType = 0;
+	int32 NumChannels = 0;
+	bool bInterlaced = false;
+
+	/** BGRA8 palette, alpha from the tRNS chunk */
+	TArray<uint8> Palette;
+
+	/** Sample values that are transparent in grey and RGB images, from the tRNS chunk */
+	bool bHasColorKey = false;
+	uint16 ColorKey[3];
+};
@@ -0,0 +1,36 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RovrDecodeScheduler.h"
+
+class UTexture2D;
+
+
+/**
+ * Streams large JPEG images, 360 panoramas above all, into a texture while worker threads decode them.
+ * The texture exists straight away and fills band by band from the top. A preview made from the DC
+ * coefficients, every 8x8 block in its average colour, can be decoded first into a texture an eighth of
+ * the size on each side; drawn with bilinear filtering it stands in for the image until it is decoded.
+ * The decode waits its turn in FRovrDecodeScheduler like every other image
+ */
+namespace RovrProgressiveImage
+{
+	/** Called on the game thread once the last band is in the texture, or decoding stopped early; never once the decode was cancelled */
+	typedef TFunction<void(UTexture2D* Texture, bool bSuccess)> FOnDecoded;
+
+	/**
+	 * Start decoding a baseline JPEG into a new texture without blocking the game thread
+	 *
+	 * @param Compressed The JPEG file; decoding keeps it until it is done
+	 * @param Priority How urgently the image is needed
+	 * @param OnDecoded Optional completion callback
+	 * @param OutPreview Optional; receives the preview texture, which is filled before the first band of the image
+	 * @param OutDecodeId Optional; receives the id of the decode for FRovrDecodeScheduler::Cancel and SetPriority.
+	 *        A cancelled decode leaves the rest of the texture black
+	 * @return The texture, which fills in over the following frames; nullptr if the data is not a JPEG
+	 *         FRovrJpegDecoder handles, e.g. a progressive one, which callers then decode another way
+	 */
+	ROVRIMAGING_API UTexture2D* DecodeJpeg(TArray<uint8>&& Compressed, ERovrDecodePriority Priority, FOnDecoded OnDecoded = nullptr, UTexture2D** OutPreview = nullptr, int32* OutDecodeId = nullptr);
+}
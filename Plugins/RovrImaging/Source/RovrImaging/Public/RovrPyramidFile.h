@@ -0,0 +1,87 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RovrImageTiles.h"
+
+class IFileHandle;
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+
+/**
+ * Tile pyramid stored in a .rovrpyr file, so a scene shown before opens without decoding its image again.
+ *
+ * The file starts with a header and an index holding the size of every level and the offset of every
+ * tile; the tiles follow, texture ready in the pyramid's format, the lowest level first. Opening a file
+ * reads only the header and index; every tile is then a single ranged read, or a copy out of the mapping
+ * where the platform can map files. Because the lowest level leads the data, the single tile showing the
+ * whole image is the first to arrive, even from a file still being copied or downloaded.
+ *
+ * Written in native byte order, which is little endian on every target.
+ */
+class ROVRIMAGING_API FRovrPyramidFile : public IRovrTileSource
+{
+public:
+	/** Extension of pyramid files, without the dot */
+	static const TCHAR* const Extension;
+
+	/**
+	 * Write the tiles of a source into a pyramid file, through a temporary file so readers never see half a pyramid
+	 *
+	 * @param SourceStamp Identity of the image the tiles were cut from, handed back by GetSourceStamp
+	 * @return Whether the file was written
+	 */
+	static bool Write(const IRovrTileSource& Source, uint64 SourceStamp, const FString& Filename);
+
+	/**
+	 * Open a pyramid file and read its index
+	 *
+	 * @return The pyramid, or nullptr if the file is missing, damaged, or holds a format this RHI cannot sample
+	 */
+	static TSharedPtr<FRovrPyramidFile, ESPMode::ThreadSafe> Open(const FString& Filename);
+
+	virtual ~FRovrPyramidFile();
+
+	//~ Begin IRovrTileSource Interface
+	virtual int32 GetTileSize() const override { return TileSize; }
+	virtual int32 GetNumLevels() const override { return LevelSizes.Num(); }
+	virtual FIntPoint GetLevelSize(int32 Level) const override { return LevelSizes[Level]; }
+	virtual EPixelFormat GetFormat() const override { return Format; }
+	virtual bool ReadTile(const FRovrTileId& Tile, TArray<uint8>& OutData) const override;
+	//~ End IRovrTileSource Interface
+
+	uint64 GetSourceStamp() const { return SourceStamp; }
+
+	const FString& GetFilename() const { return Filename; }
+
+private:
+	struct FTileLocation
+	{
+		int64 Offset = 0;
+		int64 Size = 0;
+	};
+
+	FRovrPyramidFile() = default;
+
+	const FTileLocation* FindTile(const FRovrTileId& Tile) const;
+
+	FString Filename;
+	uint64 SourceStamp = 0;
+	int32 TileSize = 0;
+	EPixelFormat Format = PF_Unknown;
+	TArray<FIntPoint> LevelSizes;
+
+	/** Tiles of every level, row by row, level 0 first */
+	TArray<FTileLocation> Tiles;
+	TArray<int32> FirstTiles;
+
+	/** The mapped file, or a handle for ranged reads where the platform cannot map files */
+	TUniquePtr<IMappedFileHandle> MappedFile;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+	TUniquePtr<IFileHandle> File;
+
+	/** Serializes the reads through File, whose position is shared */
+	mutable FCriticalSection FileLock;
+};
@@ -0,0 +1,41 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeBool.h"
+
+
+/**
+ * Decoding of images for thumbnails and profile pictures, skipping the work a full size decode spends on
+ * detail the result throws away. Baseline JPEG images decode straight from their DCT coefficients at a
+ * half, quarter or eighth of their size and interlaced PNG images from their first interlace passes, at
+ * the smallest of these sizes that still covers the size asked for; the area filter then takes the image
+ * the rest of the way. Decoding blocks, so callers run it on a worker thread.
+ */
+namespace RovrScaledDecode
+{
+	/**
+	 * Largest power of two reduction, up to an eighth, that keeps an image at least as large as its fit into
+	 * MaxWidth x MaxHeight. A MaxWidth or MaxHeight of 0 leaves that side unbounded
+	 */
+	ROVRIMAGING_API int32 GetScaleShift(int32 Width, int32 Height, int32 MaxWidth, int32 MaxHeight);
+
+	/**
+	 * Decode a JPEG or PNG image to BGRA8 at the largest size with its aspect ratio that fits into
+	 * MaxWidth x MaxHeight, never enlarging it
+	 *
+	 * @param MaxWidth Largest width of the result, or 0 for no bound
+	 * @param MaxHeight Largest height of the result, or 0 for no bound
+	 * @param bCancelled Optional flag, e.g. from FRovrDecodeScheduler, that stops the decode between bands once set
+	 * @return False if the image is damaged, the decode was cancelled, or the image is neither a JPEG
+	 *         FRovrJpegDecoder handles nor a PNG; callers then decode it another way, e.g. with ImageWrapper
+	 */
+	ROVRIMAGING_API bool Decode(TArrayView<const uint8> Bytes, int32 MaxWidth, int32 MaxHeight, TArray<uint8>& OutPixels, int32& OutWidth, int32& OutHeight, const FThreadSafeBool* bCancelled = nullptr);
+
+	/**
+	 * Peak memory of Decode for an image, from the headers alone: the compressed data and the pixels at the
+	 * reduced and the final size. Other formats are estimated from their compressed size as a full decode
+	 */
+	ROVRIMAGING_API int64 GetDecodeBytes(TArrayView<const uint8> Bytes, int32 MaxWidth, int32 MaxHeight);
+}
@@ -0,0 +1,290 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PixelFormat.h"
+#include "RovrBlockCompress.h"
+#include "RovrDecodeScheduler.h"
+#include "RovrMipChain.h"
+#include "RovrPixelConvert.h"
+
+class UTexture2D;
+
+
+/**
+ * Non-owning view of a 32 bit image in memory
+ */
+struct ROVRIMAGING_API FRovrImageView
+{
+	TArrayView<const uint8> Data;
+	int32 Width = 0;
+	int32 Height = 0;
+
+	/** Distance between rows in bytes */
+	int64 Stride = 0;
+
+	ERovrPixelLayout Layout = ERovrPixelLayout::BGRA8;
+
+	FRovrImageView() = default;
+
+	/**
+	 * @param InData Pixel bytes, starting with the first row
+	 * @param InStride Distance between rows in bytes, zero for tightly packed rows
+	 */
+	FRovrImageView(TArrayView<const uint8> InData, int32 InWidth, int32 InHeight, ERovrPixelLayout InLayout, int64 InStride = 0)
+		: Data(InData)
+		, Width(InWidth)
+		, Height(InHeight)
+		, Stride(InStride > 0 ? InStride : int64(InWidth) * 4)
+		, Layout(InLayout)
+	{
+	}
+
+	/** Whether the size is positive and Data covers every row */
+	bool IsValid() const
+	{
+		return Width > 0 && Height > 0 && Stride >= int64(Width) * 4 && Data.Num() >= Stride * (Height - 1) + int64(Width) * 4;
+	}
+};
+
+/**
+ * Pixels of a whole texture ready for upload: every mip in its final format, tightly packed, mip 0 first
+ */
+struct ROVRIMAGING_API FRovrTextureDataView
+{
+	TArrayView<const uint8> Data;
+	int32 Width = 0;
+	int32 Height = 0;
+
+	/** Mip 0 only, or the full chain down to 1x1 */
+	int32 NumMips = 0;
+
+	/** PF_B8G8R8A8 or PF_ETC2_RGB */
+	EPixelFormat Format = PF_Unknown;
+
+	/** Whether the format and mip count are supported and Data holds every mip */
+	bool IsValid() const;
+};
+
+/**
+ * Owning counterpart of FRovrTextureDataView, e.g. for keeping encoded textures in a cache
+ */
+struct ROVRIMAGING_API FRovrTextureData
+{
+	TArray<uint8> Data;
+	int32 Width = 0;
+	int32 Height = 0;
+	int32 NumMips = 0;
+	EPixelFormat Format = PF_Unknown;
+
+	FRovrTextureDataView GetView() const
+	{
+		FRovrTextureDataView View;
+		View.Data = Data;
+		View.Width = Width;
+		View.Height = Height;
+		View.NumMips = NumMips;
+		View.Format = Format;
+		return View;
+	}
+};
+
+/**
+ * Settings of a texture created by RovrTexture::CreateForUpload
+ */
+struct ROVRIMAGING_API FRovrUploadTextureDesc
+{
+	int32 Width = 0;
+	int32 Height = 0;
+	EPixelFormat Format = PF_B8G8R8A8;
+
+	/** 1 for mip 0 only, or the full chain down to 1x1 */
+	int32 NumMips = 1;
+
+	/**
+	 * Keep the mips in memory, so Fill works and a recreated resource keeps its pixels. Uploads then
+	 * write every region into them too, on the game thread
+	 */
+	bool bKeepCpuCopy = false;
+
+	/** Clamp sampling at the edges instead of wrapping, e.g. for atlas pages */
+	bool bClamp = false;
+
+	FRovrUploadTextureDesc() = default;
+
+	FRovrUploadTextureDesc(int32 InWidth, int32 InHeight, EPixelFormat InFormat = PF_B8G8R8A8, int32 InNumMips = 1)
+		: Width(InWidth)
+		, Height(InHeight)
+		, Format(InFormat)
+		, NumMips(InNumMips)
+	{
+	}
+};
+
+/**
+ * Creation of transient textures from images in memory. Pixels are converted straight into the locked
+ * mip, so creating a texture costs one pass over the image and no intermediate copies; when the source
+ * already is BGRA8 the pass is a plain copy. A full mip chain can be generated on the CPU, so images
+ * drawn small do not alias, and opaque images can be compressed to ETC2, taking an eighth of the memory.
+ * Creating from an image view does both on the calling thread, which only spreads the rows over task threads
+ * with ParallelFor and waits for them; buffers handed over are encoded on a worker thread by UpdateAsync
+ * instead. Textures that keep changing are better created once with CreateForUpload and written with render
+ * thread uploads, which never recreate their resource.
+ */
+namespace RovrTexture
+{
+	/**
+	 * Create a transient texture from an image, in the format chosen by GetTransientFormat
+	 *
+	 * @param Image Source pixels
+	 * @param Flags Conversion options applied while filling the mip
+	 * @param Name Optional object name
+	 * @param MipFilter Filter generating the full mip chain, ERovrMipFilter::None for mip 0 only
+	 * @param Compression ETC2 preset, ERovrCompressQuality::None for BGRA8
+	 * @return The texture, or nullptr if Image is invalid
+	 */
+	ROVRIMAGING_API UTexture2D* CreateTransient(const FRovrImageView& Image, ERovrPixelConvertFlags Flags = ERovrPixelConvertFlags::None, FName Name = NAME_None, ERovrMipFilter MipFilter = ERovrMipFilter::None, ERovrCompressQuality Compression = ERovrCompressQuality::None);
+
+	/**
+	 * Create a transient texture from a buffer the caller hands over, e.g. decoder output, through
+	 * CreateForUpload; the texture keeps no CPU copy. Without mips and compression the buffer goes to the
+	 * render thread through UploadRegion; otherwise UpdateAsync encodes it on a worker thread, and the
+	 * texture stays black until the encoded mips are uploaded
+	 *
+	 * @param Stride Distance between rows in bytes, zero for tightly packed rows
+	 */
+	ROVRIMAGING_API UTexture2D* CreateTransient(TArray<uint8>&& Pixels, int32 Width, int32 Height, ERovrPixelLayout Layout, int64 Stride = 0, ERovrPixelConvertFlags Flags = ERovrPixelConvertFlags::None, FName Name = NAME_None, ERovrMipFilter MipFilter = ERovrMipFilter::None, ERovrCompressQuality Compression = ERovrCompressQuality::None);
+
+	/**
+	 * Fill an existing PF_B8G8R8A8 or PF_ETC2_RGB texture of the same size that keeps a CPU copy, and
+	 * recreate its resource. Textures with a mip chain get every mip regenerated with MipFilter
+	 *
+	 * @param Compression ETC2 preset, used by PF_ETC2_RGB textures only
+	 * @return Whether the texture matched the image and was filled
+	 */
+	ROVRIMAGING_API bool Fill(UTexture2D* Texture, const FRovrImageView& Image, ERovrPixelConvertFlags Flags = ERovrPixelConvertFlags::None, ERovrMipFilter MipFilter = ERovrMipFilter::Box, ERovrCompressQuality Compression = ERovrCompressQuality::Normal);
+
+	/**
+	 * Replace the pixels of a PF_B8G8R8A8 or PF_ETC2_RGB texture of the same size whose resource already
+	 * exists, uploading them into the existing RHI texture instead of recreating it. Falls back to Fill
+	 * without a resource. Textures with a mip chain get every mip regenerated with MipFilter
+	 *
+	 * @param Compression ETC2 preset, used by PF_ETC2_RGB textures only
+	 * @return Whether the texture matched the image and the upload was queued
+	 */
+	ROVRIMAGING_API bool Update(UTexture2D* Texture, const FRovrImageView& Image, ERovrPixelConvertFlags Flags = ERovrPixelConvertFlags::None, ERovrMipFilter MipFilter = ERovrMipFilter::Box, ERovrCompressQuality Compression = ERovrCompressQuality::Normal);
+
+	/**
+	 * Replace the pixels of a texture from a buffer the caller hands over. A PF_B8G8R8A8 texture with mip 0
+	 * only takes the buffer through UploadRegion, so the render thread converts it and the game thread does
+	 * no pixel work; other textures are updated like Update with a view of the buffer
+	 *
+	 * @param Stride Distance between rows in bytes, zero for tightly packed rows
+	 * @return Whether the texture matched the image and the upload was queued
+	 */
+	ROVRIMAGING_API bool Update(UTexture2D* Texture, TArray<uint8>&& Pixels, int32 Width, int32 Height, ERovrPixelLayout Layout, int64 Stride = 0, ERovrPixelConvertFlags Flags = ERovrPixelConvertFlags::None, ERovrMipFilter MipFilter = ERovrMipFilter::Box, ERovrCompressQuality Compression = ERovrCompressQuality::Normal);
+
+	/**
+	 * Convert, mip and compress an image the way CreateTransient would, without creating a texture
+	 *
+	 * @return Whether Image was valid and OutData filled
+	 */
+	ROVRIMAGING_API bool Encode(const FRovrImageView& Image, ERovrPixelConvertFlags Flags, ERovrMipFilter MipFilter, ERovrCompressQuality Compression, FRovrTextureData& OutData);
+
+	/** Called on a worker thread with an image and the texture data it was encoded to, e.g. to cache the data */
+	typedef TFunction<void(const FRovrImageView& Image, const FRovrTextureDataView& Data)> FOnEncoded;
+
+	/**
+	 * Encode a buffer the caller hands over on a worker thread of the decode scheduler and upload the result
+	 * into a texture on the game thread, so neither the mips nor the ETC2 blocks are made on the game thread.
+	 * The texture keeps its pixels until then; it must have the format GetTransientFormat gives and the mip
+	 * count MipFilter asks for, as textures from CreateForUpload and the texture pool do. A later update of
+	 * the same texture cancels this one
+	 *
+	 * @param Stride Distance between rows in bytes, zero for tightly packed rows
+	 * @param OnEncoded Optional, called on the worker thread once the data is ready
+	 * @return Id of the decode, to cancel it or change its priority; 0 if the image is invalid
+	 */
+	ROVRIMAGING_API int32 UpdateAsync(UTexture2D* Texture, TArray<uint8>&& Pixels, int32 Width, int32 Height, ERovrPixelLayout Layout, int64 Stride = 0, ERovrPixelConvertFlags Flags = ERovrPixelConvertFlags::None, ERovrMipFilter MipFilter = ERovrMipFilter::Box, ERovrCompressQuality Compression = ERovrCompressQuality::Normal, ERovrDecodePriority Priority = ERovrDecodePriority::Visible, FOnEncoded OnEncoded = nullptr);
+
+	/** Cancel the UpdateAsync of a texture that has not been uploaded yet, if there is one */
+	ROVRIMAGING_API void CancelUpdateAsync(UTexture2D* Texture);
+
+	/**
+	 * Create a transient texture from encoded texture data, copying every mip as is
+	 *
+	 * @return The texture, or nullptr if Data is invalid
+	 */
+	ROVRIMAGING_API UTexture2D* CreateTransient(const FRovrTextureDataView& Data, FName Name = NAME_None);
+
+	/**
+	 * Copy encoded texture data into a texture of the same size, format and mip count that keeps a CPU copy,
+	 * and recreate its resource
+	 *
+	 * @return Whether the texture matched the data and was filled
+	 */
+	ROVRIMAGING_API bool Fill(UTexture2D* Texture, const FRovrTextureDataView& Data);
+
+	/**
+	 * Upload encoded texture data into the existing resource of a texture of the same size, format and mip
+	 * count. Falls back to Fill without a resource
+	 *
+	 * @return Whether the texture matched the data and the upload was queued
+	 */
+	ROVRIMAGING_API bool Update(UTexture2D* Texture, const FRovrTextureDataView& Data);
+
+	/**
+	 * Create a transient texture meant to be written by uploads only: its resource is created once, black,
+	 * and later pixels go straight into it through UploadRegion, Update or the texture pool, without
+	 * recreating it. Unless Desc.bKeepCpuCopy is set the mips are single use, freed by the render thread
+	 * once the resource holds them
+	 *
+	 * @return The texture, or nullptr if the size, format or mip count is unsupported
+	 */
+	ROVRIMAGING_API UTexture2D* CreateForUpload(const FRovrUploadTextureDesc& Desc, FName Name = NAME_None);
+
+	/** Whether a texture keeps its mips in memory, which Fill needs */
+	ROVRIMAGING_API bool HasCpuCopy(const UTexture2D* Texture);
+
+	/**
+	 * Upload a rectangle of pixels into a mip of a PF_B8G8R8A8 texture whose resource exists. The buffer
+	 * is handed to the render thread, which converts it to BGRA8 in place when Layout or Flags ask for it,
+	 * so the game thread neither copies nor converts pixels unless the texture keeps a CPU copy. Partial
+	 * rectangles suit progressive images
+	 *
+	 * @param Dest Position of the rectangle in the mip
+	 * @param Pixels First row of the rectangle, in Layout
+	 * @param Stride Distance between rows in bytes, zero for tightly packed rows
+	 * @return Whether the rectangle fits into the mip and the upload was queued
+	 */
+	ROVRIMAGING_API bool UploadRegion(UTexture2D* Texture, int32 MipIndex, FIntPoint Dest, TArray<uint8>&& Pixels, int32 Width, int32 Height, ERovrPixelLayout Layout = ERovrPixelLayout::BGRA8, int64 Stride = 0, ERovrPixelConvertFlags Flags = ERovrPixelConvertFlags::None);
+
+	/**
+	 * Upload a rectangle of data already in the texture's format, e.g. ETC2 blocks, into a mip of a
+	 * texture whose resource exists. Dest and the size must fall on block boundaries, except where the
+	 * rectangle ends at the edge of the mip
+	 *
+	 * @param Data Tightly packed rows of blocks
+	 * @return Whether the rectangle fits into the mip and the upload was queued
+	 */
+	ROVRIMAGING_API bool UploadRegionData(UTexture2D* Texture, int32 MipIndex, FIntPoint Dest, TArray<uint8>&& Data, int32 Width, int32 Height);
+
+	/**
+	 * Format of a texture created from Image: PF_ETC2_RGB when compression is asked for, the RHI samples
+	 * ETC2, the size is a multiple of the 4x4 blocks and the image is opaque, PF_B8G8R8A8 otherwise
+	 */
+	ROVRIMAGING_API EPixelFormat GetTransientFormat(const FRovrImageView& Image, ERovrPixelConvertFlags Flags, ERovrCompressQuality Compression);
+
+	/** Memory taken by mip 0 of a texture with the given size and format */
+	ROVRIMAGING_API int64 CalcMipSize(int32 Width, int32 Height, EPixelFormat Format);
+
+	/** Memory taken by the first NumMips mips of a texture with the given size and format */
+	ROVRIMAGING_API int64 CalcTextureSize(int32 Width, int32 Height, EPixelFormat Format, int32 NumMips);
+
+	/** Mip filter for textures created from thumbnails and photos, set by rovr.Texture.MipFilter */
+	ROVRIMAGING_API ERovrMipFilter GetDefaultMipFilter();
+
+	/** Compression preset for textures created from thumbnails and photos, set by rovr.Texture.Compression */
+	ROVRIMAGING_API ERovrCompressQuality GetDefaultCompression();
+}
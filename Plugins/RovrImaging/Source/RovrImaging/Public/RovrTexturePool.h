@@ -0,0 +1,124 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PixelFormat.h"
+#include "UObject/GCObject.h"
+#include "RovrTexture.h"
+
+class UTexture2D;
+
+
+/**
+ * Pool of transient textures keyed by size, format and mip count, for UI that keeps replacing images of the same
+ * size such as the lobby thumbnails. Released textures are kept alive and handed out again, refilled
+ * through their existing RHI resource, so scrolling neither allocates textures nor feeds the garbage
+ * collector. Idle textures beyond rovr.TexturePool.MaxIdleMemoryMB are dropped, oldest first.
+ *
+ * Game thread only.
+ */
+class ROVRIMAGING_API FRovrTexturePool : public FGCObject
+{
+public:
+	struct FStats
+	{
+		int32 NumRequests = 0;
+		int32 NumHits = 0;
+		int32 NumIdle = 0;
+		int64 IdleBytes = 0;
+
+		/** Share of requests served from the pool */
+		float GetHitRate() const { return NumRequests > 0 ? float(NumHits) / NumRequests : 0.0f; }
+	};
+
+	/** Pool shared by every module */
+	static FRovrTexturePool& Get();
+
+	/**
+	 * Take a texture of the given size and format. Its pixels are undefined when it comes from the pool
+	 */
+	UTexture2D* Acquire(int32 Width, int32 Height, EPixelFormat Format = PF_B8G8R8A8);
+
+	/**
+	 * Take a texture holding Image, refilling a pooled one in place when available. The format is chosen
+	 * by RovrTexture::GetTransientFormat
+	 *
+	 * @param MipFilter Filter generating the full mip chain, ERovrMipFilter::None for mip 0 only
+	 * @param Compression ETC2 preset, ERovrCompressQuality::None for BGRA8
+	 * @return The texture, or nullptr if Image is invalid
+	 */
+	UTexture2D* Acquire(const FRovrImageView& Image, ERovrPixelConvertFlags Flags = ERovrPixelConvertFlags::None, ERovrMipFilter MipFilter = ERovrMipFilter::None, ERovrCompressQuality Compression = ERovrCompressQuality::None);
+
+	/**
+	 * Take a texture holding pixels the caller hands over, refilling a pooled one in place when available.
+	 * Without mips, compression and OnEncoded the buffer goes to the render thread, which converts it there;
+	 * otherwise RovrTexture::UpdateAsync encodes it on a worker thread and the texture keeps its previous
+	 * pixels, or black, until the upload
+	 *
+	 * @param Stride Distance between rows in bytes, zero for tightly packed rows
+	 * @param OnEncoded Optional, called on the worker thread with the encoded data, e.g. to cache it
+	 * @return The texture, or nullptr if the pixels do not cover the image
+	 */
+	UTexture2D* Acquire(TArray<uint8>&& Pixels, int32 Width, int32 Height, ERovrPixelLayout Layout, int64 Stride = 0, ERovrPixelConvertFlags Flags = ERovrPixelConvertFlags::None, ERovrMipFilter MipFilter = ERovrMipFilter::None, ERovrCompressQuality Compression = ERovrCompressQuality::None, RovrTexture::FOnEncoded OnEncoded = nullptr);
+
+	/**
+	 * Take a texture holding encoded texture data, e.g. a cached thumbnail, refilling a pooled one in place when available
+	 *
+	 * @return The texture, or nullptr if Data is invalid
+	 */
+	UTexture2D* Acquire(const FRovrTextureDataView& Data);
+
+	/**
+	 * Hand a texture back for reuse. The caller must not use it anymore
+	 */
+	void Release(UTexture2D* Texture);
+
+	/** Drop idle textures, oldest first, until they take at most MaxIdleBytes */
+	void Trim(int64 MaxIdleBytes);
+
+	FStats GetStats() const;
+
+	//~ Begin FGCObject Interface
+	virtual void AddReferencedObjects(FReferenceCollector& Collector) override;
+	virtual FString GetReferencerName() const override;
+	//~ End FGCObject Interface
+
+private:
+	struct FKey
+	{
+		int32 Width;
+		int32 Height;
+		EPixelFormat Format;
+		int32 NumMips;
+
+		bool operator==(const FKey& Other) const
+		{
+			return Width == Other.Width && Height == Other.Height && Format == Other.Format && NumMips == Other.NumMips;
+		}
+
+		friend uint32 GetTypeHash(const FKey& Key)
+		{
+			const uint32 Hash = HashCombine(HashCombine(::GetTypeHash(Key.Width), ::GetTypeHash(Key.Height)), ::GetTypeHash(uint8(Key.Format)));
+			return HashCombine(Hash, ::GetTypeHash(Key.NumMips));
+		}
+	};
+
+	static FKey MakeKey(const UTexture2D* Texture);
+
+	/** Take an idle texture matching Key, or nullptr */
+	UTexture2D* AcquireIdle(const FKey& Key);
+
+	/** Take an idle texture in the format and mip count Image would be created with, or create one; its pixels are undefined */
+	UTexture2D* AcquireFor(const FRovrImageView& Image, ERovrPixelConvertFlags Flags, ERovrMipFilter MipFilter, ERovrCompressQuality Compression);
+
+	/** Idle textures by key, most recently released last */
+	TMap<FKey, TArray<UTexture2D*>> Idle;
+
+	/** Every idle texture, least recently released first */
+	TArray<UTexture2D*> IdleOrder;
+
+	int64 IdleBytes = 0;
+	int32 NumRequests = 0;
+	int32 NumHits = 0;
+};
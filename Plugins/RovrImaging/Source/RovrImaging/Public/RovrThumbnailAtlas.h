@@ -0,0 +1,172 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/NoExportTypes.h"
+#include "Styling/SlateBrush.h"
+#include "RovrTexture.h"
+
+#include "RovrThumbnailAtlas.generated.h"
+
+class UTexture2D;
+
+
+/**
+ * Place of a thumbnail in an atlas page
+ */
+USTRUCT(BlueprintType)
+struct ROVRIMAGING_API FRovrAtlasSlot
+{
+	GENERATED_BODY()
+
+	/** Handle for Release, -1 for an empty slot */
+	UPROPERTY(BlueprintReadOnly, Category = "ROVR Imaging")
+	int32 Id = INDEX_NONE;
+
+	/** Page texture holding the thumbnail */
+	UPROPERTY(BlueprintReadOnly, Category = "ROVR Imaging")
+	UTexture2D* Page = nullptr;
+
+	/** Corners of the thumbnail in the page, inset by half a texel so bilinear filtering stays inside */
+	UPROPERTY(BlueprintReadOnly, Category = "ROVR Imaging")
+	FVector2D UVMin = FVector2D::ZeroVector;
+
+	UPROPERTY(BlueprintReadOnly, Category = "ROVR Imaging")
+	FVector2D UVMax = FVector2D::ZeroVector;
+
+	/** Size of the thumbnail in pixels */
+	UPROPERTY(BlueprintReadOnly, Category = "ROVR Imaging")
+	FVector2D Size = FVector2D::ZeroVector;
+
+	bool IsValid() const { return Id != INDEX_NONE && Page != nullptr; }
+};
+
+/**
+ * Packs the lobby thumbnails into a few large page textures, so the grid draws from a handful of
+ * textures instead of one per tile and Slate can batch the tiles of a page into one draw. Thumbnails
+ * go onto shelves, rows as high as their tallest thumbnail; released slots are reused by thumbnails that
+ * fit in them, and a page whose thumbnails were all released starts over empty. Widgets showing the same
+ * thumbnail share its slot, which stays until each of them released it.
+ *
+ * Pages are BGRA8 or ETC2 without mips, following the format of the thumbnails put into them; slots
+ * start on 4 pixel boundaries so compressed blocks can be uploaded in place. Game thread only.
+ */
+UCLASS(BlueprintType)
+class ROVRIMAGING_API URovrThumbnailAtlas : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	/** Width and height of pages in pixels. Pages keep the size they were created with; changing it only affects later pages */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ROVR Imaging")
+	int32 PageSize = 2048;
+
+	/**
+	 * Put a thumbnail into the atlas, or share the slot it already has. Either way the caller holds the
+	 * slot until it releases it
+	 *
+	 * @param Key Identity of the thumbnail, e.g. its thumbnail cache key
+	 * @param Data Encoded thumbnail; only mip 0 is used
+	 * @return The slot, empty if Data is invalid or larger than a page
+	 */
+	FRovrAtlasSlot Add(uint64 Key, const FRovrTextureDataView& Data);
+
+	/**
+	 * Share the slot of a thumbnail added with Key, e.g. for a second widget showing it; the caller holds
+	 * the slot until it releases it
+	 *
+	 * @return The slot, empty if there is none
+	 */
+	FRovrAtlasSlot Acquire(uint64 Key);
+
+	/** @return The slot of a thumbnail added with Key, without holding it; empty if there is none */
+	FRovrAtlasSlot Find(uint64 Key) const;
+
+	/**
+	 * Give up a slot returned by Add or Acquire, e.g. when its lobby entry scrolls out of view. The slot is
+	 * freed once every Add and Acquire that returned it was matched by a Release
+	 */
+	UFUNCTION(BlueprintCallable, Category = "ROVR Imaging")
+	void Release(const FRovrAtlasSlot& Slot);
+
+	/** Free every slot, keeping the pages for reuse */
+	UFUNCTION(BlueprintCallable, Category = "ROVR Imaging")
+	void Reset();
+
+	/** Number of page textures */
+	UFUNCTION(BlueprintPure, Category = "ROVR Imaging")
+	int32 GetNumPages() const { return PageTextures.Num(); }
+
+	/**
+	 * Brush drawing a slot, for an Image widget's Set Brush
+	 */
+	UFUNCTION(BlueprintPure, Category = "ROVR Imaging")
+	static FSlateBrush MakeBrush(const FRovrAtlasSlot& Slot);
+
+private:
+	/** A row of slots across a page */
+	struct FShelf
+	{
+		int32 Y = 0;
+		int32 Height = 0;
+
+		/** Where the next slot on this shelf starts */
+		int32 X = 0;
+	};
+
+	struct FPage
+	{
+		EPixelFormat Format = PF_Unknown;
+
+		/** Width and height in pixels, PageSize when the page was created */
+		int32 Size = 0;
+
+		TArray<FShelf> Shelves;
+
+		/** Rectangles of released slots */
+		TArray<FIntRect> FreeRects;
+
+		/** Top of the unused part below the shelves */
+		int32 ShelfTop = 0;
+
+		int32 NumSlots = 0;
+	};
+
+	struct FSlot
+	{
+		uint64 Key = 0;
+		int32 Page = INDEX_NONE;
+
+		/** Area taken in the page, padded to 4 pixel boundaries */
+		FIntRect Rect;
+
+		/** Size of the thumbnail itself */
+		FIntPoint Size;
+
+		/** Adds and Acquires not yet matched by a Release */
+		int32 NumUsers = 0;
+	};
+
+	/**
+	 * Find room for a padded thumbnail in a page of the given format
+	 *
+	 * @return Whether OutPage and OutRect were set
+	 */
+	bool Allocate(EPixelFormat Format, FIntPoint PaddedSize, int32& OutPage, FIntRect& OutRect);
+
+	bool AllocateInPage(int32 PageIndex, FIntPoint PaddedSize, FIntRect& OutRect);
+
+	FRovrAtlasSlot MakeSlot(int32 SlotId, const FSlot& Slot) const;
+
+	/** Page textures, indexed like Pages */
+	UPROPERTY(Transient)
+	TArray<UTexture2D*> PageTextures;
+
+	TArray<FPage> Pages;
+
+	TMap<int32, FSlot> Slots;
+	TMap<uint64, int32> KeyToSlot;
+
+	int32 NextSlotId = 0;
+};
@@ -0,0 +1,169 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/DateTime.h"
+#include "Templates/Function.h"
+#include "RovrTexture.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+class UTexture2D;
+
+
+/**
+ * Persistent cache of encoded thumbnails, so lobby visits stop asking the platform to decode every
+ * video's thumbnail again. Entries hold texture data exactly as uploaded, BGRA8 or ETC2 with or without
+ * mips, and live in one container file, Saved/RovrThumbnails.cache, which is memory-mapped when the cache
+ * is first used; a hit is a copy from the mapping into the texture.
+ *
+ * Entries are keyed by the identity of the thumbnail and belong to a file id, e.g. the media list id of
+ * the video, through which the media index invalidates them. Each carries a stamp of the file's size and
+ * modification time, and an entry whose stamp no longer matches is dropped on lookup. The least recently
+ * used entries are evicted beyond rovr.ThumbnailCache.MaxSizeMB.
+ *
+ * Copies of one video under several paths share their thumbnails once the media index fingerprinted
+ * them: it registers each file's content id, and ResolveContent swaps the file id and stamp of a
+ * fingerprinted file for that content id before the key is made.
+ *
+ * Thread safe. The container is rewritten by Save, called when the application is backgrounded or exits;
+ * lookups and additions only wait for it while the entry table is copied and the new file is swapped in.
+ */
+class ROVRIMAGING_API FRovrThumbnailCache
+{
+public:
+	struct FStats
+	{
+		int32 NumEntries = 0;
+		int64 TotalBytes = 0;
+		int32 NumLookups = 0;
+		int32 NumHits = 0;
+
+		/** Share of lookups served from the cache */
+		float GetHitRate() const { return NumLookups > 0 ? float(NumHits) / NumLookups : 0.0f; }
+	};
+
+	/** Cache shared by every module, opened on first use */
+	static FRovrThumbnailCache& Get();
+
+	/** Id of a file from its path, equal to the id media lists give it */
+	static uint64 MakeFileId(const FString& Path);
+
+	/** Stamp of a file's identity from its size and modification time */
+	static uint64 MakeStamp(int64 Size, const FDateTime& ModificationTime);
+
+	/**
+	 * Visit the data of an entry whose stamp matches. The view is only valid inside Visitor, which runs
+	 * under the cache lock and must not call back into the cache
+	 *
+	 * @return Whether the entry was found and visited
+	 */
+	bool Find(uint64 Key, uint64 Stamp, TFunctionRef<void(const FRovrTextureDataView&)> Visitor);
+
+	/**
+	 * Take a pooled texture holding an entry whose stamp matches. Game thread only
+	 *
+	 * @return The texture, or nullptr on a miss
+	 */
+	UTexture2D* Acquire(uint64 Key, uint64 Stamp);
+
+	/**
+	 * Add or replace an entry
+	 *
+	 * @param Key Identity of the thumbnail, e.g. the file id combined with the thumbnail size
+	 * @param FileId Id of the file the thumbnail shows, for RemoveFile
+	 * @param Stamp Stamp of the file when the thumbnail was made
+	 */
+	void Add(uint64 Key, uint64 FileId, uint64 Stamp, const FRovrTextureDataView& Data);
+
+	/** Drop every entry of a file, e.g. when the media index reports it removed or rewritten */
+	void RemoveFile(uint64 FileId);
+
+	/**
+	 * Register the content of a file, e.g. its fingerprint from the media index, so its copies share entries
+	 *
+	 * @param FileId Id of the file from MakeFileId
+	 * @param Stamp Stamp of the file when the content id was computed
+	 * @param ContentId Id of the content, never 0
+	 */
+	void SetContentId(uint64 FileId, uint64 Stamp, uint64 ContentId);
+
+	/**
+	 * Replace the file id and stamp of a file by its content id, if one was registered for the same stamp.
+	 * Entries added under the content id are not removed by RemoveFile with the file id, since other
+	 * copies still show them; they leave the cache by eviction
+	 */
+	void ResolveContent(uint64& InOutFileId, uint64& InOutStamp) const;
+
+	/** Write the entries to the container file, if anything changed, and map the result */
+	void Save();
+
+	FStats GetStats() const;
+
+private:
+	/** Location of an entry's data: in the mapped container, or in memory until the next Save */
+	struct FEntry
+	{
+		uint64 FileId = 0;
+		uint64 Stamp = 0;
+		uint64 LastUsed = 0;
+		int32 Width = 0;
+		int32 Height = 0;
+		int32 NumMips = 0;
+		EPixelFormat Format = PF_Unknown;
+		int64 FileOffset = INDEX_NONE;
+		int64 Size = 0;
+
+		/** Data added since the last Save; shared, so a running Save can write it without holding the lock */
+		TSharedPtr<TArray<uint8>, ESPMode::ThreadSafe> Pending;
+	};
+
+	FRovrThumbnailCache();
+	~FRovrThumbnailCache();
+
+	/** Map the container file and read its table; a missing or corrupt file leaves the cache empty */
+	void Open();
+
+	/** Map the container file, or read it where the platform cannot map files */
+	bool MapFile();
+
+	/** Release the mapping of the container file */
+	void Close();
+
+	FRovrTextureDataView GetData(const FEntry& Entry) const;
+
+	/** Drop least recently used entries until they take at most MaxBytes */
+	void EvictToFit(int64 MaxBytes);
+
+	void RemoveEntry(uint64 Key);
+
+	FString Filename;
+
+	TMap<uint64, FEntry> Entries;
+
+	/** Registered content ids by file id, with the stamp they were computed for. Kept in memory only */
+	TMap<uint64, TPair<uint64, uint64>> ContentIds;
+
+	/** Container file contents: a mapping, or a plain copy where the platform cannot map files */
+	TUniquePtr<IMappedFileHandle> MappedFile;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+	TArray<uint8> LoadedFile;
+	const uint8* FileData = nullptr;
+	int64 FileSize = 0;
+
+	/** Incremented on every use, ordering entries for eviction */
+	uint64 UseCounter = 0;
+
+	int64 TotalBytes = 0;
+	int32 NumLookups = 0;
+	int32 NumHits = 0;
+
+	/** Whether the entries differ from the container file */
+	bool bDirty = false;
+
+	mutable FCriticalSection Lock;
+
+	/** Serializes saves; only a save replaces the mapping, so a save may read mapped data without Lock. Taken before Lock */
+	FCriticalSection SaveLock;
+};
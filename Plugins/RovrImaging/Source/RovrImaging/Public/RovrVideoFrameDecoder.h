@@ -0,0 +1,55 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Features/IModularFeature.h"
+
+
+/**
+ * A coded video frame read from an MP4 file, with what a decoder needs to decode it on its own
+ */
+struct FRovrMp4Keyframe
+{
+	/** Sample entry type of the video track, e.g. avc1, hvc1 or jpeg */
+	uint32 Codec = 0;
+
+	int32 Width = 0;
+	int32 Height = 0;
+
+	/** Payload of the decoder configuration box of the sample entry, e.g. avcC or hvcC; empty without one */
+	TArray<uint8> CodecConfig;
+
+	/** The sample as stored in the file, e.g. length prefixed NAL units */
+	TArray<uint8> Sample;
+
+	/** Decode time of the sample in seconds */
+	double Time = 0.0;
+};
+
+/**
+ * Decoder of single keyframes of a video codec, e.g. the RovrVideoDecoder plugin wrapping the platform's
+ * H.264 and HEVC decoders. Decoders register as modular features under GetModularFeatureName and are
+ * called on worker threads, outside the modular feature lock, so DecodeKeyframe must be thread safe and
+ * a decoder must stay alive until its module shuts down
+ */
+class IRovrVideoFrameDecoder : public IModularFeature
+{
+public:
+	static FName GetModularFeatureName()
+	{
+		static const FName FeatureName(TEXT("RovrVideoFrameDecoder"));
+		return FeatureName;
+	}
+
+	/** Whether keyframes of a sample entry type, e.g. avc1 as a big-endian four character code, can be decoded */
+	virtual bool CanDecode(uint32 Codec) const = 0;
+
+	/**
+	 * Decode a keyframe on its own
+	 *
+	 * @param OutPixels Receives the frame as tightly packed BGRA8
+	 * @return Whether the frame was decoded
+	 */
+	virtual bool DecodeKeyframe(const FRovrMp4Keyframe& Keyframe, TArray<uint8>& OutPixels, int32& OutWidth, int32& OutHeight) = 0;
+};
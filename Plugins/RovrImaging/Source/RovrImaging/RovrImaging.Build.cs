@@ -0,0 +1,35 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+using UnrealBuildTool;
+
+public class RovrImaging : ModuleRules
+{
+	public RovrImaging(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = ModuleRules.PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		PublicDependencyModuleNames.AddRange(
+			new string[]
+			{
+				"Core",
+				"CoreUObject",
+				"Engine",
+				"SlateCore"
+			}
+		);
+
+		PrivateDependencyModuleNames.AddRange(
+			new string[]
+			{
+				"RHI",
+				"RenderCore"
+			}
+		);
+
+		// The automation tests decode their reference images with the engine's codecs
+		PrivateDependencyModuleNames.Add("ImageWrapper");
+
+		// Inflating the image data of PNG files
+		AddEngineThirdPartyPrivateStaticDependencies(Target, "zlib");
+	}
+}
@@ -0,0 +1,226 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Android/RovrMediaCodecDecoder.h"
+
+#if PLATFORM_ANDROID
+
+#include "RovrNalUnits.h"
+#include "RovrVideoDecoderDefines.h"
+#include "RovrYuvConvert.h"
+#include "Misc/ScopeExit.h"
+
+#include <media/NdkMediaCodec.h>
+#include <media/NdkMediaFormat.h>
+
+
+namespace
+{
+	/** Timeout of a single dequeue call in microseconds */
+	const int64_t DequeueTimeoutUs = 10000;
+
+	/** How long a keyframe may take to come out of the decoder before the decode is given up */
+	const double DecodeTimeoutSeconds = 2.0;
+
+	/** MediaCodecInfo.CodecCapabilities color formats that can be read back from byte buffers */
+	const int32_t ColorFormatYUV420Planar = 19;
+	const int32_t ColorFormatYUV420SemiPlanar = 21;
+
+	/** MediaFormat.COLOR_STANDARD_BT709 */
+	const int32_t ColorStandardBt709 = 1;
+
+	int32_t GetInt32(AMediaFormat* Format, const char* Key, int32_t Default)
+	{
+		int32_t Value = 0;
+		return AMediaFormat_getInt32(Format, Key, &Value) ? Value : Default;
+	}
+
+	/** Queue a buffer of input, waiting for the decoder to free one until the deadline */
+	bool QueueInput(AMediaCodec* Codec, const TArray<uint8>& Data, uint32_t Flags, double Deadline)
+	{
+		while (FPlatformTime::Seconds() < Deadline)
+		{
+			const ssize_t Index = AMediaCodec_dequeueInputBuffer(Codec, DequeueTimeoutUs);
+			if (Index < 0)
+			{
+				continue;
+			}
+
+			size_t Capacity = 0;
+			uint8_t* Buffer = AMediaCodec_getInputBuffer(Codec, Index, &Capacity);
+			if (Buffer == nullptr || Capacity < size_t(Data.Num()))
+			{
+				AMediaCodec_queueInputBuffer(Codec, Index, 0, 0, 0, AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM);
+				return false;
+			}
+
+			if (Data.Num() > 0)
+			{
+				FMemory::Memcpy(Buffer, Data.GetData(), Data.Num());
+			}
+			return AMediaCodec_queueInputBuffer(Codec, Index, 0, Data.Num(), 0, Flags) == AMEDIA_OK;
+		}
+		return false;
+	}
+
+	/** Convert the 4:2:0 frame of an output buffer to BGRA8, cropped to the picture */
+	bool ConvertFrame(AMediaFormat* Format, const uint8* Buffer, size_t Size, TArray<uint8>& OutPixels, int32& OutWidth, int32& OutHeight)
+	{
+		const int32_t ColorFormat = GetInt32(Format, AMEDIAFORMAT_KEY_COLOR_FORMAT, 0);
+		if (ColorFormat != ColorFormatYUV420Planar && ColorFormat != ColorFormatYUV420SemiPlanar)
+		{
+			UE_LOG(LogRovrVideoDecoder, Verbose, TEXT("Decoder outputs color format %d, which cannot be read back"), ColorFormat);
+			return false;
+		}
+
+		const int32_t Width = GetInt32(Format, AMEDIAFORMAT_KEY_WIDTH, 0);
+		const int32_t Height = GetInt32(Format, AMEDIAFORMAT_KEY_HEIGHT, 0);
+		const int32_t Stride = FMath::Max(GetInt32(Format, AMEDIAFORMAT_KEY_STRIDE, Width), Width);
+		const int32_t SliceHeight = FMath::Max(GetInt32(Format, "slice-height", Height), Height);
+		if (Width <= 0 || Height <= 0)
+		{
+			return false;
+		}
+
+		// The crop keys are inclusive and only present when the picture is smaller than the coded frame
+		const int32_t Left = FMath::Clamp(GetInt32(Format, "crop-left", 0), 0, Width - 1);
+		const int32_t Top = FMath::Clamp(GetInt32(Format, "crop-top", 0), 0, Height - 1);
+		const int32_t Right = FMath::Clamp(GetInt32(Format, "crop-right", Width - 1), Left, Width - 1);
+		const int32_t Bottom = FMath::Clamp(GetInt32(Format, "crop-bottom", Height - 1), Top, Height - 1);
+
+		const bool bPlanar = ColorFormat == ColorFormatYUV420Planar;
+		const int64 LumaSize = int64(Stride) * SliceHeight;
+		const int64 ChromaStride = bPlanar ? Stride / 2 : Stride;
+		const int64 ChromaPlaneSize = ChromaStride * ((SliceHeight + 1) / 2);
+		if (int64(Size) < LumaSize + (bPlanar ? 2 * ChromaPlaneSize : ChromaPlaneSize))
+		{
+			return false;
+		}
+
+		// Crops start on even coordinates in 4:2:0, so the chroma of the first row and column is at Left / 2, Top / 2
+		const int64 ChromaOffset = (Top / 2) * ChromaStride + (bPlanar ? Left / 2 : Left & ~1);
+		const uint8* Y = Buffer + int64(Top) * Stride + Left;
+		const uint8* U = Buffer + LumaSize + ChromaOffset;
+		const uint8* V = bPlanar ? U + ChromaPlaneSize : U + 1;
+
+		OutWidth = Right - Left + 1;
+		OutHeight = Bottom - Top + 1;
+		OutPixels.SetNumUninitialized(OutWidth * OutHeight * 4);
+
+		const bool bBt709 = GetInt32(Format, "color-standard", 0) == ColorStandardBt709;
+		RovrYuvConvert::ToBGRA8(Y, Stride, U, V, ChromaStride, bPlanar ? 1 : 2, OutWidth, OutHeight, bBt709, OutPixels.GetData());
+		return true;
+	}
+}
+
+bool FRovrMediaCodecDecoder::CanDecode(uint32 Codec) const
+{
+	bool bHevc = false;
+	return RovrNalUnits::IsNalCodec(Codec, bHevc);
+}
+
+bool FRovrMediaCodecDecoder::DecodeKeyframe(const FRovrMp4Keyframe& Keyframe, TArray<uint8>& OutPixels, int32& OutWidth, int32& OutHeight)
+{
+	bool bHevc = false;
+	if (!RovrNalUnits::IsNalCodec(Keyframe.Codec, bHevc) || Keyframe.Width <= 0 || Keyframe.Height <= 0)
+	{
+		return false;
+	}
+
+	TArray<TArrayView<const uint8>> ParameterSets;
+	int32 LengthSize = 4;
+	if (!RovrNalUnits::ParseCodecConfig(bHevc, Keyframe.CodecConfig, ParameterSets, LengthSize))
+	{
+		return false;
+	}
+
+	// Decoders accept all parameter sets in csd-0 as an Annex B stream, for H.264 as well as HEVC
+	TArray<uint8> CodecSpecificData;
+	for (const TArrayView<const uint8>& ParameterSet : ParameterSets)
+	{
+		RovrNalUnits::AppendAnnexB(ParameterSet, CodecSpecificData);
+	}
+
+	TArray<uint8> Stream;
+	if (!RovrNalUnits::AppendSample(Keyframe.Sample, LengthSize, Stream))
+	{
+		return false;
+	}
+
+	// Devices without a decoder for the codec, e.g. older ones and HEVC, fail here
+	AMediaCodec* Codec = AMediaCodec_createDecoderByType(bHevc ? "video/hevc" : "video/avc");
+	if (Codec == nullptr)
+	{
+		return false;
+	}
+	ON_SCOPE_EXIT
+	{
+		AMediaCodec_delete(Codec);
+	};
+
+	AMediaFormat* Format = AMediaFormat_new();
+	ON_SCOPE_EXIT
+	{
+		AMediaFormat_delete(Format);
+	};
+	AMediaFormat_setString(Format, AMEDIAFORMAT_KEY_MIME, bHevc ? "video/hevc" : "video/avc");
+	AMediaFormat_setInt32(Format, AMEDIAFORMAT_KEY_WIDTH, Keyframe.Width);
+	AMediaFormat_setInt32(Format, AMEDIAFORMAT_KEY_HEIGHT, Keyframe.Height);
+	AMediaFormat_setBuffer(Format, "csd-0", CodecSpecificData.GetData(), CodecSpecificData.Num());
+
+	if (AMediaCodec_configure(Codec, Format, nullptr, nullptr, 0) != AMEDIA_OK || AMediaCodec_start(Codec) != AMEDIA_OK)
+	{
+		return false;
+	}
+	ON_SCOPE_EXIT
+	{
+		AMediaCodec_stop(Codec);
+	};
+
+	// End of stream right behind the keyframe makes the decoder output it without waiting for more frames
+	const double Deadline = FPlatformTime::Seconds() + DecodeTimeoutSeconds;
+	if (!QueueInput(Codec, Stream, 0, Deadline) || !QueueInput(Codec, TArray<uint8>(), AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM, Deadline))
+	{
+		return false;
+	}
+
+	AMediaFormat* OutputFormat = AMediaCodec_getOutputFormat(Codec);
+	ON_SCOPE_EXIT
+	{
+		AMediaFormat_delete(OutputFormat);
+	};
+
+	while (FPlatformTime::Seconds() < Deadline)
+	{
+		AMediaCodecBufferInfo Info;
+		const ssize_t Index = AMediaCodec_dequeueOutputBuffer(Codec, &Info, DequeueTimeoutUs);
+		if (Index == AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED)
+		{
+			AMediaFormat_delete(OutputFormat);
+			OutputFormat = AMediaCodec_getOutputFormat(Codec);
+			continue;
+		}
+		if (Index < 0)
+		{
+			continue;
+		}
+
+		bool bDecoded = false;
+		size_t Capacity = 0;
+		const uint8_t* Buffer = AMediaCodec_getOutputBuffer(Codec, Index, &Capacity);
+		if (Buffer != nullptr && Info.size > 0 && size_t(Info.offset) + Info.size <= Capacity)
+		{
+			bDecoded = ConvertFrame(OutputFormat, Buffer + Info.offset, Info.size, OutPixels, OutWidth, OutHeight);
+		}
+		AMediaCodec_releaseOutputBuffer(Codec, Index, false);
+
+		if (bDecoded || (Info.flags & AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM) != 0)
+		{
+			return bDecoded;
+		}
+	}
+
+	UE_LOG(LogRovrVideoDecoder, Warning, TEXT("Decoding a keyframe at %.2fs timed out"), Keyframe.Time);
+	return false;
+}
+
+#endif
@@ -0,0 +1,24 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RovrVideoFrameDecoder.h"
+
+#if PLATFORM_ANDROID
+
+/**
+ * Decodes H.264 and HEVC keyframes with the device's decoders through the NDK MediaCodec API. Frames are
+ * read back from the decoder's byte buffers, so only decoders that output planar or semi-planar 4:2:0 are
+ * used; vendor specific tiled layouts fail, and the thumbnail falls back to the cover art
+ */
+class FRovrMediaCodecDecoder : public IRovrVideoFrameDecoder
+{
+public:
+	//~ Begin IRovrVideoFrameDecoder Interface
+	virtual bool CanDecode(uint32 Codec) const override;
+	virtual bool DecodeKeyframe(const FRovrMp4Keyframe& Keyframe, TArray<uint8>& OutPixels, int32& OutWidth, int32& OutHeight) override;
+	//~ End IRovrVideoFrameDecoder Interface
+};
+
+#endif
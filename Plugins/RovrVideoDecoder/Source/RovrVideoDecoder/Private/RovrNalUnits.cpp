@@ -0,0 +1,153 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RovrNalUnits.h"
+
+
+namespace
+{
+	constexpr uint32 MakeFourCC(const char (&Code)[5])
+	{
+		return (uint32(uint8(Code[0])) << 24) | (uint32(uint8(Code[1])) << 16) | (uint32(uint8(Code[2])) << 8) | uint32(uint8(Code[3]));
+	}
+
+	uint32 ReadBigEndian(const uint8* Data, int32 Size)
+	{
+		uint32 Value = 0;
+		for (int32 Index = 0; Index < Size; ++Index)
+		{
+			Value = (Value << 8) | Data[Index];
+		}
+		return Value;
+	}
+
+	/** Read NumUnits NAL units, each behind a 16 bit length, as the parameter set arrays of both boxes store them */
+	bool ReadParameterSets(TArrayView<const uint8> Config, int32 NumUnits, int32& InOutOffset, TArray<TArrayView<const uint8>>& OutParameterSets)
+	{
+		for (int32 Unit = 0; Unit < NumUnits; ++Unit)
+		{
+			if (InOutOffset + 2 > Config.Num())
+			{
+				return false;
+			}
+
+			const int32 Size = int32(ReadBigEndian(&Config[InOutOffset], 2));
+			InOutOffset += 2;
+			if (InOutOffset + Size > Config.Num())
+			{
+				return false;
+			}
+
+			if (Size > 0)
+			{
+				OutParameterSets.Add(Config.Slice(InOutOffset, Size));
+			}
+			InOutOffset += Size;
+		}
+		return true;
+	}
+}
+
+bool RovrNalUnits::IsNalCodec(uint32 Codec, bool& bOutHevc)
+{
+	bOutHevc = Codec == MakeFourCC("hvc1") || Codec == MakeFourCC("hev1");
+	return bOutHevc || Codec == MakeFourCC("avc1") || Codec == MakeFourCC("avc3");
+}
+
+bool RovrNalUnits::ParseCodecConfig(bool bHevc, TArrayView<const uint8> Config, TArray<TArrayView<const uint8>>& OutParameterSets, int32& OutLengthSize)
+{
+	OutParameterSets.Reset();
+
+	int32 Offset = 0;
+	if (bHevc)
+	{
+		// 22 bytes of profile, level and format fields, the length size in the last, then the arrays of VPS, SPS, PPS and SEI units
+		if (Config.Num() < 23 || Config[0] != 1)
+		{
+			return false;
+		}
+
+		OutLengthSize = (Config[21] & 3) + 1;
+		const int32 NumArrays = Config[22];
+		Offset = 23;
+		for (int32 Array = 0; Array < NumArrays; ++Array)
+		{
+			if (Offset + 3 > Config.Num())
+			{
+				return false;
+			}
+
+			const int32 NumUnits = int32(ReadBigEndian(&Config[Offset + 1], 2));
+			Offset += 3;
+			if (!ReadParameterSets(Config, NumUnits, Offset, OutParameterSets))
+			{
+				return false;
+			}
+		}
+	}
+	else
+	{
+		// Version, profile, compatibility and level, the length size, then the SPS and PPS units, each behind their count
+		if (Config.Num() < 7 || Config[0] != 1)
+		{
+			return false;
+		}
+
+		OutLengthSize = (Config[4] & 3) + 1;
+		Offset = 6;
+		if (!ReadParameterSets(Config, Config[5] & 0x1f, Offset, OutParameterSets) || Offset >= Config.Num())
+		{
+			return false;
+		}
+
+		const int32 NumPictureParameterSets = Config[Offset++];
+		if (!ReadParameterSets(Config, NumPictureParameterSets, Offset, OutParameterSets))
+		{
+			return false;
+		}
+	}
+
+	// Lengths of three bytes are not allowed by either format
+	return OutLengthSize != 3 && OutParameterSets.Num() > 0;
+}
+
+int32 RovrNalUnits::GetType(bool bHevc, TArrayView<const uint8> NalUnit)
+{
+	if (NalUnit.Num() == 0)
+	{
+		return -1;
+	}
+	return bHevc ? (NalUnit[0] >> 1) & 0x3f : NalUnit[0] & 0x1f;
+}
+
+void RovrNalUnits::AppendAnnexB(TArrayView<const uint8> NalUnit, TArray<uint8>& Out)
+{
+	static const uint8 StartCode[] = { 0, 0, 0, 1 };
+	Out.Append(StartCode, UE_ARRAY_COUNT(StartCode));
+	Out.Append(NalUnit.GetData(), NalUnit.Num());
+}
+
+bool RovrNalUnits::AppendSample(TArrayView<const uint8> Sample, int32 LengthSize, TArray<uint8>& Out)
+{
+	int32 Offset = 0;
+	while (Offset < Sample.Num())
+	{
+		if (Offset + LengthSize > Sample.Num())
+		{
+			return false;
+		}
+
+		const uint32 Size = ReadBigEndian(&Sample[Offset], LengthSize);
+		Offset += LengthSize;
+		if (Size > uint32(Sample.Num() - Offset))
+		{
+			return false;
+		}
+
+		if (Size > 0)
+		{
+			AppendAnnexB(Sample.Slice(Offset, int32(Size)), Out);
+		}
+		Offset += int32(Size);
+	}
+	return true;
+}
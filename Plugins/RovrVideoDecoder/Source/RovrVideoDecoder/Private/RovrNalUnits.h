@@ -0,0 +1,40 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+/**
+ * Conversion of H.264 and HEVC video as MP4 stores it, length prefixed NAL units with the parameter sets
+ * kept apart in the avcC or hvcC box, to the Annex B byte stream platform decoders take, where a start
+ * code precedes every NAL unit
+ */
+namespace RovrNalUnits
+{
+	/** Whether a sample entry type holds H.264 (avc1, avc3) or HEVC (hvc1, hev1) NAL units; tells which through bOutHevc */
+	bool IsNalCodec(uint32 Codec, bool& bOutHevc);
+
+	/**
+	 * Read the parameter sets of an avcC or hvcC box
+	 *
+	 * @param bHevc Whether Config is the payload of an hvcC box rather than an avcC one
+	 * @param OutParameterSets Receives the parameter set NAL units in the order they are stored, pointing into Config
+	 * @param OutLengthSize Receives the size in bytes of the length before each NAL unit of the samples
+	 * @return False if the box is truncated or holds no parameter sets
+	 */
+	bool ParseCodecConfig(bool bHevc, TArrayView<const uint8> Config, TArray<TArrayView<const uint8>>& OutParameterSets, int32& OutLengthSize);
+
+	/** Type of a NAL unit from its header, -1 for an empty unit */
+	int32 GetType(bool bHevc, TArrayView<const uint8> NalUnit);
+
+	/** Append a NAL unit behind a four byte start code */
+	void AppendAnnexB(TArrayView<const uint8> NalUnit, TArray<uint8>& Out);
+
+	/**
+	 * Append the NAL units of a sample, each behind a start code instead of its length
+	 *
+	 * @return False if a length runs past the end of the sample
+	 */
+	bool AppendSample(TArrayView<const uint8> Sample, int32 LengthSize, TArray<uint8>& Out);
+}
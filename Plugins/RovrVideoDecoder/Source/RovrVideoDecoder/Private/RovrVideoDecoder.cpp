@@ -0,0 +1,45 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RovrVideoDecoder.h"
+#include "RovrVideoDecoderDefines.h"
+#include "RovrVideoFrameDecoder.h"
+#include "Features/IModularFeatures.h"
+
+#if PLATFORM_WINDOWS
+#include "Windows/RovrMediaFoundationDecoder.h"
+#elif PLATFORM_ANDROID
+#include "Android/RovrMediaCodecDecoder.h"
+#endif
+
+#define LOCTEXT_NAMESPACE "FRovrVideoDecoderModule"
+
+void FRovrVideoDecoderModule::StartupModule()
+{
+#if PLATFORM_WINDOWS
+	Decoder = MakeUnique<FRovrMediaFoundationDecoder>();
+#elif PLATFORM_ANDROID
+	Decoder = MakeUnique<FRovrMediaCodecDecoder>();
+#endif
+
+	if (Decoder.IsValid())
+	{
+		IModularFeatures::Get().RegisterModularFeature(IRovrVideoFrameDecoder::GetModularFeatureName(), Decoder.Get());
+	}
+}
+
+void FRovrVideoDecoderModule::ShutdownModule()
+{
+	// Decodes run outside the modular feature lock; the plugin loads in PreDefault ahead of the game module,
+	// so it is shut down after the game module that requests thumbnails
+	if (Decoder.IsValid())
+	{
+		IModularFeatures::Get().UnregisterModularFeature(IRovrVideoFrameDecoder::GetModularFeatureName(), Decoder.Get());
+		Decoder.Reset();
+	}
+}
+
+#undef LOCTEXT_NAMESPACE
+
+IMPLEMENT_MODULE(FRovrVideoDecoderModule, RovrVideoDecoder)
+
+DEFINE_LOG_CATEGORY(LogRovrVideoDecoder);
@@ -0,0 +1,51 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RovrYuvConvert.h"
+
+
+namespace
+{
+	/** Matrix from limited range Y'CbCr to R'G'B', in 16.16 fixed point */
+	struct FYuvMatrix
+	{
+		int32 Y;
+		int32 RV;
+		int32 GU;
+		int32 GV;
+		int32 BU;
+	};
+
+	const FYuvMatrix Bt601 = { 76309, 104597, 25675, 53279, 132201 };
+	const FYuvMatrix Bt709 = { 76309, 117489, 13975, 34925, 138438 };
+
+	FORCEINLINE uint8 ClampToByte(int32 Value)
+	{
+		return uint8(FMath::Clamp(Value >> 16, 0, 255));
+	}
+}
+
+void RovrYuvConvert::ToBGRA8(const uint8* Y, int64 YStride, const uint8* U, const uint8* V, int64 ChromaStride, int32 ChromaStep, int32 Width, int32 Height, bool bBt709, uint8* Dest)
+{
+	const FYuvMatrix& Matrix = bBt709 ? Bt709 : Bt601;
+
+	for (int32 Row = 0; Row < Height; ++Row)
+	{
+		const uint8* YRow = Y + Row * YStride;
+		const uint8* URow = U + (Row / 2) * ChromaStride;
+		const uint8* VRow = V + (Row / 2) * ChromaStride;
+		uint8* DestRow = Dest + int64(Row) * Width * 4;
+
+		for (int32 X = 0; X < Width; ++X)
+		{
+			const int32 Chroma = (X / 2) * ChromaStep;
+			const int32 Cb = int32(URow[Chroma]) - 128;
+			const int32 Cr = int32(VRow[Chroma]) - 128;
+			const int32 Luma = (int32(YRow[X]) - 16) * Matrix.Y + 32768;
+
+			DestRow[X * 4 + 0] = ClampToByte(Luma + Matrix.BU * Cb);
+			DestRow[X * 4 + 1] = ClampToByte(Luma - Matrix.GU * Cb - Matrix.GV * Cr);
+			DestRow[X * 4 + 2] = ClampToByte(Luma + Matrix.RV * Cr);
+			DestRow[X * 4 + 3] = 255;
+		}
+	}
+}
@@ -0,0 +1,23 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+/**
+ * Conversion of the 4:2:0 frames video decoders output to BGRA8
+ */
+namespace RovrYuvConvert
+{
+	/**
+	 * Convert a 4:2:0 frame with limited range samples, as 8 bit video stores them, to tightly packed BGRA8
+	 *
+	 * @param U First sample of the U plane, or of the interleaved chroma plane of NV12
+	 * @param V First sample of the V plane, U + 1 for NV12
+	 * @param ChromaStride Distance between rows of chroma samples in bytes
+	 * @param ChromaStep Distance between the chroma samples of a row: 1 for planar I420, 2 for NV12
+	 * @param bBt709 Whether the frame uses the BT.709 matrix of HD video rather than the BT.601 one of SD video
+	 */
+	void ToBGRA8(const uint8* Y, int64 YStride, const uint8* U, const uint8* V, int64 ChromaStride, int32 ChromaStep, int32 Width, int32 Height, bool bBt709, uint8* Dest);
+}
@@ -0,0 +1,326 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Windows/RovrMediaFoundationDecoder.h"
+
+#if PLATFORM_WINDOWS
+
+#include "RovrNalUnits.h"
+#include "RovrVideoDecoderDefines.h"
+#include "RovrYuvConvert.h"
+#include "Microsoft/COMPointer.h"
+#include "Misc/ScopeExit.h"
+
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <mfapi.h>
+#include <mferror.h>
+#include <mftransform.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+
+
+namespace
+{
+	/** MFVideoFormat_HEVC, which the SDK headers only declare for Windows 8 and later targets */
+	const GUID HevcSubtype = { MAKEFOURCC('H', 'E', 'V', 'C'), 0x0000, 0x0010, { 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71 } };
+
+	/** A stream change is reported once before the frame; anything beyond that means the decoder is stuck */
+	const int32 MaxOutputAttempts = 4;
+
+	/** Create the first software decoder transform for a compressed video format, nullptr if Windows has none */
+	TComPtr<IMFTransform> CreateDecoder(const GUID& Subtype)
+	{
+		MFT_REGISTER_TYPE_INFO InputType = { MFMediaType_Video, Subtype };
+		IMFActivate** Activates = nullptr;
+		UINT32 NumActivates = 0;
+
+		TComPtr<IMFTransform> Decoder;
+		if (SUCCEEDED(MFTEnumEx(MFT_CATEGORY_VIDEO_DECODER, MFT_ENUM_FLAG_SYNCMFT | MFT_ENUM_FLAG_LOCALMFT | MFT_ENUM_FLAG_SORTANDFILTER, &InputType, nullptr, &Activates, &NumActivates)))
+		{
+			for (UINT32 Index = 0; Index < NumActivates; ++Index)
+			{
+				if (!Decoder.IsValid())
+				{
+					Activates[Index]->ActivateObject(IID_PPV_ARGS(Decoder.GetInitReference()));
+				}
+				Activates[Index]->Release();
+			}
+			CoTaskMemFree(Activates);
+		}
+		return Decoder;
+	}
+
+	/** Pick NV12 among the output types the decoder offers for its current input */
+	bool SetNv12Output(IMFTransform* Decoder)
+	{
+		for (DWORD Index = 0;; ++Index)
+		{
+			TComPtr<IMFMediaType> Type;
+			if (FAILED(Decoder->GetOutputAvailableType(0, Index, Type.GetInitReference())))
+			{
+				return false;
+			}
+
+			GUID Subtype;
+			if (SUCCEEDED(Type->GetGUID(MF_MT_SUBTYPE, &Subtype)) && Subtype == MFVideoFormat_NV12)
+			{
+				return SUCCEEDED(Decoder->SetOutputType(0, Type.Get(), 0));
+			}
+		}
+	}
+
+	/** Convert the NV12 frame of an output sample to BGRA8, cropped to the picture */
+	bool ConvertFrame(IMFMediaType* OutputType, IMFSample* Sample, TArray<uint8>& OutPixels, int32& OutWidth, int32& OutHeight)
+	{
+		UINT32 CodedWidth = 0;
+		UINT32 CodedHeight = 0;
+		if (FAILED(MFGetAttributeSize(OutputType, MF_MT_FRAME_SIZE, &CodedWidth, &CodedHeight)) || CodedWidth == 0 || CodedHeight == 0)
+		{
+			return false;
+		}
+
+		// The coded size is rounded up to whole macroblocks or coding units; the aperture is the picture within
+		int32 Left = 0;
+		int32 Top = 0;
+		int32 Width = int32(CodedWidth);
+		int32 Height = int32(CodedHeight);
+		MFVideoArea Aperture;
+		if (SUCCEEDED(OutputType->GetBlob(MF_MT_MINIMUM_DISPLAY_APERTURE, reinterpret_cast<UINT8*>(&Aperture), sizeof(Aperture), nullptr))
+			&& Aperture.OffsetX.value >= 0 && Aperture.OffsetY.value >= 0 && Aperture.Area.cx > 0 && Aperture.Area.cy > 0
+			&& Aperture.OffsetX.value + Aperture.Area.cx <= int32(CodedWidth) && Aperture.OffsetY.value + Aperture.Area.cy <= int32(CodedHeight))
+		{
+			// Chroma covers pairs of pixels, so the crop starts on an even one
+			Left = Aperture.OffsetX.value & ~1;
+			Top = Aperture.OffsetY.value & ~1;
+			Width = Aperture.Area.cx;
+			Height = Aperture.Area.cy;
+		}
+
+		UINT32 Matrix = MFVideoTransferMatrix_Unknown;
+		OutputType->GetUINT32(MF_MT_YUV_MATRIX, &Matrix);
+		const bool bBt709 = Matrix != MFVideoTransferMatrix_Unknown ? Matrix == MFVideoTransferMatrix_BT709 : Height >= 720;
+
+		TComPtr<IMFMediaBuffer> Buffer;
+		if (FAILED(Sample->ConvertToContiguousBuffer(Buffer.GetInitReference())))
+		{
+			return false;
+		}
+
+		// 2D buffers tell their pitch, which may exceed the width; plain buffers are packed at the default stride
+		BYTE* Data = nullptr;
+		LONG Pitch = 0;
+		TComPtr<IMF2DBuffer> Buffer2D;
+		const bool bLocked2D = SUCCEEDED(Buffer->QueryInterface(IID_PPV_ARGS(Buffer2D.GetInitReference()))) && SUCCEEDED(Buffer2D->Lock2D(&Data, &Pitch));
+		if (!bLocked2D)
+		{
+			DWORD Length = 0;
+			if (FAILED(Buffer->Lock(&Data, nullptr, &Length)))
+			{
+				return false;
+			}
+
+			Pitch = LONG(MFGetAttributeUINT32(OutputType, MF_MT_DEFAULT_STRIDE, CodedWidth));
+			if (Pitch < LONG(CodedWidth) || int64(Pitch) * CodedHeight * 3 / 2 > Length)
+			{
+				Buffer->Unlock();
+				return false;
+			}
+		}
+
+		ON_SCOPE_EXIT
+		{
+			if (bLocked2D)
+			{
+				Buffer2D->Unlock2D();
+			}
+			else
+			{
+				Buffer->Unlock();
+			}
+		};
+
+		// Bottom up frames are not produced by video decoders
+		if (Pitch < LONG(CodedWidth))
+		{
+			return false;
+		}
+
+		const uint8* Luma = Data + int64(Top) * Pitch + Left;
+		const uint8* Chroma = Data + int64(Pitch) * CodedHeight + int64(Top / 2) * Pitch + Left;
+
+		OutPixels.SetNumUninitialized(int64(Width) * Height * 4);
+		RovrYuvConvert::ToBGRA8(Luma, Pitch, Chroma, Chroma + 1, Pitch, 2, Width, Height, bBt709, OutPixels.GetData());
+		OutWidth = Width;
+		OutHeight = Height;
+		return true;
+	}
+
+	/** Decode an Annex B stream holding one keyframe and its parameter sets */
+	bool DecodeStream(const GUID& Subtype, const FRovrMp4Keyframe& Keyframe, const TArray<uint8>& Stream, TArray<uint8>& OutPixels, int32& OutWidth, int32& OutHeight)
+	{
+		TComPtr<IMFTransform> Decoder = CreateDecoder(Subtype);
+		if (!Decoder.IsValid())
+		{
+			return false;
+		}
+
+		TComPtr<IMFMediaType> InputType;
+		if (FAILED(MFCreateMediaType(InputType.GetInitReference()))
+			|| FAILED(InputType->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video))
+			|| FAILED(InputType->SetGUID(MF_MT_SUBTYPE, Subtype))
+			|| FAILED(MFSetAttributeSize(InputType.Get(), MF_MT_FRAME_SIZE, UINT32(Keyframe.Width), UINT32(Keyframe.Height)))
+			|| FAILED(InputType->SetUINT32(MF_MT_INTERLACE_MODE, MFVideoInterlace_MixedInterlaceOrProgressive))
+			|| FAILED(Decoder->SetInputType(0, InputType.Get(), 0))
+			|| !SetNv12Output(Decoder.Get()))
+		{
+			return false;
+		}
+
+		TComPtr<IMFMediaBuffer> InputBuffer;
+		TComPtr<IMFSample> InputSample;
+		BYTE* InputData = nullptr;
+		if (FAILED(MFCreateMemoryBuffer(DWORD(Stream.Num()), InputBuffer.GetInitReference())) || FAILED(InputBuffer->Lock(&InputData, nullptr, nullptr)))
+		{
+			return false;
+		}
+		FMemory::Memcpy(InputData, Stream.GetData(), Stream.Num());
+		InputBuffer->Unlock();
+		InputBuffer->SetCurrentLength(DWORD(Stream.Num()));
+
+		if (FAILED(MFCreateSample(InputSample.GetInitReference())) || FAILED(InputSample->AddBuffer(InputBuffer.Get())))
+		{
+			return false;
+		}
+		InputSample->SetSampleTime(0);
+		InputSample->SetUINT32(MFSampleExtension_CleanPoint, TRUE);
+
+		// Draining makes the decoder give up the frame it would otherwise hold back for reordering
+		Decoder->ProcessMessage(MFT_MESSAGE_NOTIFY_BEGIN_STREAMING, 0);
+		Decoder->ProcessMessage(MFT_MESSAGE_NOTIFY_START_OF_STREAM, 0);
+		if (FAILED(Decoder->ProcessInput(0, InputSample.Get(), 0))
+			|| FAILED(Decoder->ProcessMessage(MFT_MESSAGE_NOTIFY_END_OF_STREAM, 0))
+			|| FAILED(Decoder->ProcessMessage(MFT_MESSAGE_COMMAND_DRAIN, 0)))
+		{
+			return false;
+		}
+
+		for (int32 Attempt = 0; Attempt < MaxOutputAttempts; ++Attempt)
+		{
+			MFT_OUTPUT_STREAM_INFO StreamInfo = {};
+			if (FAILED(Decoder->GetOutputStreamInfo(0, &StreamInfo)))
+			{
+				return false;
+			}
+
+			TComPtr<IMFSample> OwnSample;
+			if (!(StreamInfo.dwFlags & (MFT_OUTPUT_STREAM_PROVIDES_SAMPLES | MFT_OUTPUT_STREAM_CAN_PROVIDE_SAMPLES)))
+			{
+				TComPtr<IMFMediaBuffer> OwnBuffer;
+				if (FAILED(MFCreateMemoryBuffer(StreamInfo.cbSize, OwnBuffer.GetInitReference())) || FAILED(MFCreateSample(OwnSample.GetInitReference())) || FAILED(OwnSample->AddBuffer(OwnBuffer.Get())))
+				{
+					return false;
+				}
+			}
+
+			MFT_OUTPUT_DATA_BUFFER Output = {};
+			Output.pSample = OwnSample.Get();
+			DWORD Status = 0;
+			const HRESULT Result = Decoder->ProcessOutput(0, 1, &Output, &Status);
+
+			// Samples the decoder allocated and events come with a reference for the caller
+			ON_SCOPE_EXIT
+			{
+				if (Output.pSample && Output.pSample != OwnSample.Get())
+				{
+					Output.pSample->Release();
+				}
+				if (Output.pEvents)
+				{
+					Output.pEvents->Release();
+				}
+			};
+
+			if (Result == MF_E_TRANSFORM_STREAM_CHANGE)
+			{
+				if (!SetNv12Output(Decoder.Get()))
+				{
+					return false;
+				}
+				continue;
+			}
+
+			if (FAILED(Result) || !Output.pSample)
+			{
+				return false;
+			}
+
+			TComPtr<IMFMediaType> OutputType;
+			return SUCCEEDED(Decoder->GetOutputCurrentType(0, OutputType.GetInitReference())) && ConvertFrame(OutputType.Get(), Output.pSample, OutPixels, OutWidth, OutHeight);
+		}
+
+		return false;
+	}
+}
+
+FRovrMediaFoundationDecoder::FRovrMediaFoundationDecoder()
+{
+	bStarted = SUCCEEDED(MFStartup(MF_VERSION, MFSTARTUP_LITE));
+	if (bStarted)
+	{
+		bHasH264 = CreateDecoder(MFVideoFormat_H264).IsValid();
+		bHasHevc = CreateDecoder(HevcSubtype).IsValid();
+	}
+
+	UE_LOG(LogRovrVideoDecoder, Log, TEXT("Media Foundation keyframe decoding: H.264 %s, HEVC %s"), bHasH264 ? TEXT("available") : TEXT("unavailable"), bHasHevc ? TEXT("available") : TEXT("unavailable"));
+}
+
+FRovrMediaFoundationDecoder::~FRovrMediaFoundationDecoder()
+{
+	if (bStarted)
+	{
+		MFShutdown();
+	}
+}
+
+bool FRovrMediaFoundationDecoder::CanDecode(uint32 Codec) const
+{
+	bool bHevc = false;
+	return RovrNalUnits::IsNalCodec(Codec, bHevc) && (bHevc ? bHasHevc : bHasH264);
+}
+
+bool FRovrMediaFoundationDecoder::DecodeKeyframe(const FRovrMp4Keyframe& Keyframe, TArray<uint8>& OutPixels, int32& OutWidth, int32& OutHeight)
+{
+	bool bHevc = false;
+	if (!RovrNalUnits::IsNalCodec(Keyframe.Codec, bHevc) || !(bHevc ? bHasHevc : bHasH264))
+	{
+		return false;
+	}
+
+	// avc3 and hev1 may repeat the parameter sets in the sample; the ones of the box go first either way
+	TArray<TArrayView<const uint8>> ParameterSets;
+	int32 LengthSize = 4;
+	if (!RovrNalUnits::ParseCodecConfig(bHevc, Keyframe.CodecConfig, ParameterSets, LengthSize))
+	{
+		return false;
+	}
+
+	TArray<uint8> Stream;
+	for (const TArrayView<const uint8>& ParameterSet : ParameterSets)
+	{
+		RovrNalUnits::AppendAnnexB(ParameterSet, Stream);
+	}
+	if (!RovrNalUnits::AppendSample(Keyframe.Sample, LengthSize, Stream))
+	{
+		return false;
+	}
+
+	// Worker threads have not initialized COM, which Media Foundation runs on
+	const HRESULT ComResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+	const bool bDecoded = DecodeStream(bHevc ? HevcSubtype : MFVideoFormat_H264, Keyframe, Stream, OutPixels, OutWidth, OutHeight);
+	if (SUCCEEDED(ComResult))
+	{
+		CoUninitialize();
+	}
+
+	return bDecoded;
+}
+
+#endif
@@ -0,0 +1,32 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RovrVideoFrameDecoder.h"
+
+#if PLATFORM_WINDOWS
+
+/**
+ * Decodes H.264 and HEVC keyframes with the Media Foundation decoders of Windows. H.264 is always
+ * available; HEVC needs the HEVC Video Extensions, so whether it can be decoded is checked once at
+ * startup. Every keyframe gets a decoder transform of its own, which keeps decodes independent
+ */
+class FRovrMediaFoundationDecoder : public IRovrVideoFrameDecoder
+{
+public:
+	FRovrMediaFoundationDecoder();
+	virtual ~FRovrMediaFoundationDecoder();
+
+	//~ Begin IRovrVideoFrameDecoder Interface
+	virtual bool CanDecode(uint32 Codec) const override;
+	virtual bool DecodeKeyframe(const FRovrMp4Keyframe& Keyframe, TArray<uint8>& OutPixels, int32& OutWidth, int32& OutHeight) override;
+	//~ End IRovrVideoFrameDecoder Interface
+
+private:
+	bool bStarted = false;
+	bool bHasH264 = false;
+	bool bHasHevc = false;
+};
+
+#endif
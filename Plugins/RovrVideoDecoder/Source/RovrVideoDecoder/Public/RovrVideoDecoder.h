@@ -0,0 +1,18 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Modules/ModuleManager.h"
+
+class IRovrVideoFrameDecoder;
+
+class FRovrVideoDecoderModule : public IModuleInterface
+{
+public:
+	virtual void StartupModule() override;
+	virtual void ShutdownModule() override;
+
+private:
+	/** The platform's keyframe decoder, registered as a modular feature while the module is loaded */
+	TUniquePtr<IRovrVideoFrameDecoder> Decoder;
+};
@@ -0,0 +1,11 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "Logging/LogCategory.h"
+#include "Logging/LogMacros.h"
+#include "Logging/LogVerbosity.h"
+
+ROVRVIDEODECODER_API DECLARE_LOG_CATEGORY_EXTERN(LogRovrVideoDecoder, Log, All);
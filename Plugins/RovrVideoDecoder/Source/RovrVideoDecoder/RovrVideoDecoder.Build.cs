@@ -0,0 +1,30 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+using UnrealBuildTool;
+
+public class RovrVideoDecoder : ModuleRules
+{
+	public RovrVideoDecoder(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = ModuleRules.PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		PublicDependencyModuleNames.AddRange(
+			new string[]
+			{
+				"Core",
+				"RovrImaging"
+			}
+		);
+
+		if (Target.Platform == UnrealTargetPlatform.Win64)
+		{
+			// Media Foundation decoder transforms
+			PublicSystemLibraries.AddRange(new string[] { "mfplat.lib", "mfuuid.lib" });
+		}
+		else if (Target.Platform == UnrealTargetPlatform.Android)
+		{
+			// NDK MediaCodec
+			PublicSystemLibraries.Add("mediandk");
+		}
+	}
+}
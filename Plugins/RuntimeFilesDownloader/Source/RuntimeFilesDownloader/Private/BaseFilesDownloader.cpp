@@ -3,9 +3,16 @@
 #include "BaseFilesDownloader.h"
 #include "RuntimeFilesDownloaderDefines.h"
 
+#include "Async/Async.h"
 #include "Containers/UnrealString.h"
-#include "ImageUtils.h"
+#include "IImageWrapper.h"
+#include "IImageWrapperModule.h"
 #include "Misc/FileHelper.h"
+#include "Modules/ModuleManager.h"
+#include "RovrImageResize.h"
+#include "RovrProgressiveImage.h"
+#include "RovrScaledDecode.h"
+#include "RovrTexture.h"
 
 bool UBaseFilesDownloader::CancelDownload()
 {
@@ -48,7 +55,110 @@ FString UBaseFilesDownloader::BytesToString(const TArray<uint8>& Bytes)
 
 UTexture2D* UBaseFilesDownloader::BytesToTexture(const TArray<uint8>& Bytes)
 {
-	return FImageUtils::ImportBufferAsTexture2D(Bytes);
+	const ERovrMipFilter MipFilter{RovrTexture::GetDefaultMipFilter()};
+	const ERovrCompressQuality Compression{RovrTexture::GetDefaultCompression()};
+
+	IImageWrapperModule& ImageWrapperModule{FModuleManager::LoadModuleChecked<IImageWrapperModule>(FName("ImageWrapper"))};
+	const EImageFormat ImageFormat{ImageWrapperModule.DetectImageFormat(Bytes.GetData(), Bytes.Num())};
+	const TSharedPtr<IImageWrapper> ImageWrapper{ImageFormat != EImageFormat::Invalid ? ImageWrapperModule.CreateImageWrapper(ImageFormat) : nullptr};
+
+	TArray<uint8> RawData;
+	if (!ImageWrapper.IsValid() || !ImageWrapper->SetCompressed(Bytes.GetData(), Bytes.Num()) || !ImageWrapper->GetRaw(ERGBFormat::BGRA, 8, RawData))
+	{
+		UE_LOG(LogRuntimeFilesDownloader, Error, TEXT("Unable to convert bytes to texture because the image could not be decoded"));
+		return nullptr;
+	}
+
+	return RovrTexture::CreateTransient(MoveTemp(RawData), ImageWrapper->GetWidth(), ImageWrapper->GetHeight(), ERovrPixelLayout::BGRA8, 0, ERovrPixelConvertFlags::None, NAME_None, MipFilter, Compression);
+}
+
+UTexture2D* UBaseFilesDownloader::BytesToTextureProgressive(const TArray<uint8>& Bytes, ERovrDecodePriority Priority, UTexture2D*& Preview, int32& DecodeId)
+{
+	Preview = nullptr;
+	DecodeId = 0;
+	if (UTexture2D* Texture{RovrProgressiveImage::DecodeJpeg(TArray<uint8>(Bytes), Priority, nullptr, &Preview, &DecodeId)})
+	{
+		return Texture;
+	}
+
+	return BytesToTexture(Bytes);
+}
+
+int32 UBaseFilesDownloader::BP_BytesToTextureScaled(const TArray<uint8>& Bytes, int32 MaxWidth, int32 MaxHeight, ERovrDecodePriority Priority, const FOnBytesToTexture& OnConverted)
+{
+	return BytesToTextureScaled(TArray<uint8>(Bytes), MaxWidth, MaxHeight, Priority, FOnBytesToTextureNative::CreateLambda([OnConverted](UTexture2D* Texture)
+	{
+		OnConverted.ExecuteIfBound(Texture);
+	}));
+}
+
+int32 UBaseFilesDownloader::BytesToTextureScaled(TArray<uint8>&& Bytes, int32 MaxWidth, int32 MaxHeight, ERovrDecodePriority Priority, const FOnBytesToTextureNative& OnConverted)
+{
+	const ERovrMipFilter MipFilter{RovrTexture::GetDefaultMipFilter()};
+	const ERovrCompressQuality Compression{RovrTexture::GetDefaultCompression()};
+
+	// Modules can only be loaded on the game thread, the decoding happens on a worker
+	IImageWrapperModule& ImageWrapperModule{FModuleManager::LoadModuleChecked<IImageWrapperModule>(FName("ImageWrapper"))};
+
+	const int64 MemoryBytes{RovrScaledDecode::GetDecodeBytes(Bytes, MaxWidth, MaxHeight)};
+	return FRovrDecodeScheduler::Get().Enqueue(Priority, MemoryBytes, [Bytes = MoveTemp(Bytes), MaxWidth, MaxHeight, MipFilter, Compression, &ImageWrapperModule, OnConverted](const FRovrDecodeScheduler::FCancelFlag& bCancelled)
+	{
+		TArray<uint8> Pixels;
+		int32 Width{0};
+		int32 Height{0};
+		if (!RovrScaledDecode::Decode(Bytes, MaxWidth, MaxHeight, Pixels, Width, Height, &bCancelled.Get()) && !*bCancelled)
+		{
+			// Progressive JPEG and other formats only decode in full
+			const EImageFormat ImageFormat{ImageWrapperModule.DetectImageFormat(Bytes.GetData(), Bytes.Num())};
+			const TSharedPtr<IImageWrapper> ImageWrapper{ImageFormat != EImageFormat::Invalid ? ImageWrapperModule.CreateImageWrapper(ImageFormat) : nullptr};
+
+			TArray<uint8> RawData;
+			if (ImageWrapper.IsValid() && ImageWrapper->SetCompressed(Bytes.GetData(), Bytes.Num()) && ImageWrapper->GetRaw(ERGBFormat::BGRA, 8, RawData))
+			{
+				const int32 FullWidth{ImageWrapper->GetWidth()};
+				const int32 FullHeight{ImageWrapper->GetHeight()};
+				const FIntPoint Size{RovrImageResize::FitSize(FullWidth, FullHeight, MaxWidth > 0 ? MaxWidth : FullWidth, MaxHeight > 0 ? MaxHeight : FullHeight)};
+				if (Size == FIntPoint(FullWidth, FullHeight))
+				{
+					Pixels = MoveTemp(RawData);
+				}
+				else
+				{
+					Pixels.SetNumUninitialized(int64(Size.X) * Size.Y * 4);
+					RovrImageResize::ResizeArea(RawData.GetData(), int64(FullWidth) * 4, FullWidth, FullHeight, Pixels.GetData(), int64(Size.X) * 4, Size.X, Size.Y);
+				}
+				Width = Size.X;
+				Height = Size.Y;
+			}
+		}
+
+		if (*bCancelled)
+		{
+			return;
+		}
+
+		FRovrTextureData Encoded;
+		if (Pixels.Num() > 0)
+		{
+			RovrTexture::Encode(FRovrImageView(Pixels, Width, Height, ERovrPixelLayout::BGRA8), ERovrPixelConvertFlags::None, MipFilter, Compression, Encoded);
+		}
+
+		AsyncTask(ENamedThreads::GameThread, [OnConverted, Encoded = MoveTemp(Encoded), bCancelled]()
+		{
+			if (*bCancelled)
+			{
+				return;
+			}
+
+			UTexture2D* Texture{Encoded.GetView().IsValid() ? RovrTexture::CreateTransient(Encoded.GetView()) : nullptr};
+			if (!Texture)
+			{
+				UE_LOG(LogRuntimeFilesDownloader, Error, TEXT("Unable to convert bytes to texture because the image could not be decoded"));
+			}
+
+			OnConverted.ExecuteIfBound(Texture);
+		});
+	});
 }
 
 bool UBaseFilesDownloader::LoadFileToArray(const FString& Filename, TArray<uint8>& Result)
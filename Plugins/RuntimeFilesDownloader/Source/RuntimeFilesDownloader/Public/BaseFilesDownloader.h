@@ -3,6 +3,7 @@
 #pragma once
 
 #include "Http.h"
+#include "RovrDecodeScheduler.h"
 #include "BaseFilesDownloader.generated.h"
 
 /** Dynamic delegate to track download progress */
@@ -13,6 +14,12 @@ DECLARE_DELEGATE_TwoParams(FOnDownloadProgressNative, int32, int32);
 
 class UTexture2D;
 
+/** Dynamic delegate to receive the result of an asynchronous texture conversion */
+DECLARE_DYNAMIC_DELEGATE_OneParam(FOnBytesToTexture, UTexture2D*, Texture);
+
+/** Static delegate to receive the result of an asynchronous texture conversion */
+DECLARE_DELEGATE_OneParam(FOnBytesToTextureNative, UTexture2D*);
+
 /**
  * Base class for downloading files. It also contains some helper functions
  */
@@ -53,7 +60,9 @@ public:
 	static FString BytesToString(const TArray<uint8>& Bytes);
 
 	/**
-	 * Convert bytes to texture. This is fully engine-based functionality and may not be well optimized
+	 * Convert bytes to texture at full size on the calling thread; for textures shown small BytesToTextureScaled is cheaper.
+	 * When rovr.Texture.MipFilter or rovr.Texture.Compression are set, the image is given a mip chain and opaque
+	 * images are compressed to ETC2 on a worker thread; the texture is returned straight away and stays black until then
 	 *
 	 * @param Bytes Byte array to convert to texture
 	 * @return Converted texture or nullptr on failure
@@ -61,6 +70,38 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Runtime Files Downloader|Utilities")
 	static UTexture2D* BytesToTexture(const TArray<uint8>& Bytes);
 
+	/**
+	 * Convert bytes to texture without waiting for the whole image. Baseline JPEG images, such as 360 panoramas,
+	 * give a texture straight away that fills band by band from the top as worker threads decode it, and a small
+	 * blocky preview to show until then. The decode waits its turn in the decode scheduler. Other images are
+	 * converted by BytesToTexture on the calling thread and have no preview
+	 *
+	 * @param Bytes Byte array to convert to texture
+	 * @param Priority How urgently the texture is needed
+	 * @param Preview Texture an eighth of the size on each side, filled before the first band of the image; nullptr if there is none
+	 * @param DecodeId Id of the decode, to cancel it or change its priority; 0 if the image was converted straight away
+	 * @return Converted texture or nullptr on failure
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Runtime Files Downloader|Utilities")
+	static UTexture2D* BytesToTextureProgressive(const TArray<uint8>& Bytes, ERovrDecodePriority Priority, UTexture2D*& Preview, int32& DecodeId);
+
+	/**
+	 * Convert bytes to a texture no larger than MaxWidth x MaxHeight, e.g. a thumbnail or profile picture, on a
+	 * worker thread. JPEG and interlaced PNG images are decoded at a reduced size straight away, so a small
+	 * texture of a large photo costs a fraction of the full decode; other images are decoded in full and then
+	 * reduced. The decode waits its turn in the decode scheduler. Recommended for Blueprints only
+	 *
+	 * @param Bytes Byte array to convert to texture
+	 * @param MaxWidth Largest width of the texture, 0 for no limit
+	 * @param MaxHeight Largest height of the texture, 0 for no limit
+	 * @param Priority How urgently the texture is needed
+	 * @param OnConverted Delegate called on the game thread with the converted texture, or nullptr on failure
+	 * @return Id of the decode, to cancel it or change its priority; once cancelled on the game thread, the decode never calls back
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Runtime Files Downloader|Utilities", meta = (DisplayName = "Bytes To Texture Scaled"))
+	static int32 BP_BytesToTextureScaled(const TArray<uint8>& Bytes, int32 MaxWidth, int32 MaxHeight, ERovrDecodePriority Priority, const FOnBytesToTexture& OnConverted);
+	static int32 BytesToTextureScaled(TArray<uint8>&& Bytes, int32 MaxWidth, int32 MaxHeight, ERovrDecodePriority Priority, const FOnBytesToTextureNative& OnConverted);
+
 	/**
 	 * Load a binary file to a dynamic array with two uninitialized bytes at end as padding
 	 *
@@ -14,9 +14,16 @@ public class RuntimeFilesDownloader : ModuleRules
 				"CoreUObject",
 				"Engine",
 				"Core",
-				"HTTP"
+				"HTTP",
+				"RovrImaging"
+			}
+		);
+
+		PrivateDependencyModuleNames.AddRange(
+			new string[]
+			{
+				"ImageWrapper"
 			}
 		);
-		
 	}
 }
\ No newline at end of file
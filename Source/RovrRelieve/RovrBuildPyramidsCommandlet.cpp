@@ -0,0 +1,188 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RovrBuildPyramidsCommandlet.h"
+#include "RovrRelieve.h"
+#include "RovrImageDecode.h"
+#include "RovrPyramidFile.h"
+#include "Engine/Texture2D.h"
+#include "EngineUtils.h"
+#include "HAL/FileManager.h"
+#include "Hash/CityHash.h"
+#include "IImageWrapperModule.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Modules/ModuleManager.h"
+
+
+namespace
+{
+	const TCHAR* const ImageExtensions[] = { TEXT("jpg"), TEXT("jpeg"), TEXT("png") };
+
+	/** Pyramid settings shared by every source */
+	struct FBuildSettings
+	{
+		FString OutDirectory;
+		int32 TileSize = 1024;
+		ERovrCompressQuality Compression = ERovrCompressQuality::Normal;
+	};
+
+	bool BuildPyramid(const FRovrImageView& Image, uint64 SourceStamp, const FString& Name, const FBuildSettings& Settings)
+	{
+		// The pyramid is built for the headsets, whatever RHI the editor runs on
+		const TSharedPtr<FRovrMemoryTileSource, ESPMode::ThreadSafe> Tiles = FRovrMemoryTileSource::Build(Image, Settings.TileSize, Settings.Compression, true, true);
+		const FString OutPath = Settings.OutDirectory / Name + TEXT(".") + FRovrPyramidFile::Extension;
+		if (!Tiles.IsValid() || !FRovrPyramidFile::Write(*Tiles, SourceStamp, OutPath))
+		{
+			UE_LOG(LogRovrRelieve, Error, TEXT("Unable to build %s"), *OutPath);
+			return false;
+		}
+
+		UE_LOG(LogRovrRelieve, Display, TEXT("Wrote %s, %d levels, %lld KiB"), *OutPath, Tiles->GetNumLevels(), IFileManager::Get().FileSize(*OutPath) / 1024);
+		return true;
+	}
+
+	bool BuildFromFile(const FString& Path, const FBuildSettings& Settings)
+	{
+		TArray<uint8> Bytes;
+		TArray<uint8> Pixels;
+		int32 Width = 0;
+		int32 Height = 0;
+		if (!FFileHelper::LoadFileToArray(Bytes, *Path) || !RovrImageDecode::Decode(Bytes, Pixels, Width, Height))
+		{
+			UE_LOG(LogRovrRelieve, Error, TEXT("Unable to decode %s"), *Path);
+			return false;
+		}
+
+		const uint64 SourceStamp = CityHash64(reinterpret_cast<const char*>(Bytes.GetData()), Bytes.Num());
+		return BuildPyramid(FRovrImageView(Pixels, Width, Height, ERovrPixelLayout::BGRA8), SourceStamp, FPaths::GetBaseFilename(Path), Settings);
+	}
+
+	bool BuildFromTexture(UTexture2D* Texture, const FBuildSettings& Settings)
+	{
+#if WITH_EDITORONLY_DATA
+		if (Texture->Source.GetFormat() != TSF_BGRA8)
+		{
+			UE_LOG(LogRovrRelieve, Warning, TEXT("Skipping %s: its source art is not 8-bit BGRA"), *Texture->GetPathName());
+			return false;
+		}
+
+		TArray64<uint8> Pixels;
+		if (!Texture->Source.GetMipData(Pixels, 0))
+		{
+			UE_LOG(LogRovrRelieve, Error, TEXT("Unable to read the source art of %s"), *Texture->GetPathName());
+			return false;
+		}
+
+		const int32 Width = Texture->Source.GetSizeX();
+		const int32 Height = Texture->Source.GetSizeY();
+		const uint64 SourceStamp = CityHash64(reinterpret_cast<const char*>(Pixels.GetData()), Pixels.Num());
+		return BuildPyramid(FRovrImageView(TArrayView<const uint8>(Pixels.GetData(), int32(Pixels.Num())), Width, Height, ERovrPixelLayout::BGRA8), SourceStamp, Texture->GetName(), Settings);
+#else
+		return false;
+#endif
+	}
+}
+
+URovrBuildPyramidsCommandlet::URovrBuildPyramidsCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+
+	HelpDescription = TEXT("Builds .rovrpyr pyramid files of 360 scene images for the tiled sky sphere");
+	HelpUsage = TEXT("-run=RovrBuildPyramids [-Source=<image or directory>] [-Assets=<content path>] [-Out=<directory>] [-TileSize=<texels>] [-Compression=None|Fast|Normal|High]");
+}
+
+int32 URovrBuildPyramidsCommandlet::Main(const FString& Params)
+{
+	FString Source;
+	FString Assets;
+	FParse::Value(*Params, TEXT("Source="), Source);
+	FParse::Value(*Params, TEXT("Assets="), Assets);
+	if (Source.IsEmpty() && Assets.IsEmpty())
+	{
+		UE_LOG(LogRovrRelieve, Error, TEXT("Usage: %s"), *HelpUsage);
+		return 1;
+	}
+
+	FBuildSettings Settings;
+	Settings.OutDirectory = FPaths::ProjectContentDir() / TEXT("Pyramids");
+	FParse::Value(*Params, TEXT("Out="), Settings.OutDirectory);
+	FParse::Value(*Params, TEXT("TileSize="), Settings.TileSize);
+	Settings.TileSize = Align(FMath::Clamp(Settings.TileSize, 128, 4096), 4);
+
+	FString Compression;
+	if (FParse::Value(*Params, TEXT("Compression="), Compression))
+	{
+		Settings.Compression = Compression == TEXT("None") ? ERovrCompressQuality::None
+			: Compression == TEXT("Fast") ? ERovrCompressQuality::Fast
+			: Compression == TEXT("High") ? ERovrCompressQuality::High
+			: ERovrCompressQuality::Normal;
+	}
+
+	FModuleManager::LoadModuleChecked<IImageWrapperModule>(TEXT("ImageWrapper"));
+
+	int32 NumBuilt = 0;
+	int32 NumFailed = 0;
+
+	// A directory builds every image directly inside it
+	if (!Source.IsEmpty())
+	{
+		TArray<FString> Paths;
+		if (IFileManager::Get().DirectoryExists(*Source))
+		{
+			for (const TCHAR* Extension : ImageExtensions)
+			{
+				TArray<FString> Names;
+				IFileManager::Get().FindFiles(Names, *(Source / FString::Printf(TEXT("*.%s"), Extension)), true, false);
+				for (const FString& Name : Names)
+				{
+					Paths.Add(Source / Name);
+				}
+			}
+		}
+		else
+		{
+			Paths.Add(Source);
+		}
+
+		for (const FString& Path : Paths)
+		{
+			if (BuildFromFile(Path, Settings))
+			{
+				++NumBuilt;
+			}
+			else
+			{
+				++NumFailed;
+			}
+		}
+	}
+
+	if (!Assets.IsEmpty())
+	{
+		TArray<UObject*> Objects;
+		EngineUtils::FindOrLoadAssetsByPath(Assets, Objects, EngineUtils::ATL_Regular);
+		for (UObject* Object : Objects)
+		{
+			UTexture2D* Texture = Cast<UTexture2D>(Object);
+			if (!Texture)
+			{
+				continue;
+			}
+
+			if (BuildFromTexture(Texture, Settings))
+			{
+				++NumBuilt;
+			}
+			else
+			{
+				++NumFailed;
+			}
+		}
+	}
+
+	UE_LOG(LogRovrRelieve, Display, TEXT("Built %d pyramids, %d failed"), NumBuilt, NumFailed);
+	return NumFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,30 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "RovrBuildPyramidsCommandlet.generated.h"
+
+
+/**
+ * Builds .rovrpyr pyramid files of 360 scene images ahead of time, for ARovrTiledSkySphere::LoadPyramidFile.
+ *
+ * Sources are image files, or the source art of texture assets, e.g. those in /Game/Images-Resources.
+ * Pyramids go to Content/Pyramids by default, which is staged as loose files so they can be mapped on
+ * device. Tiles are ETC2 compressed for the headsets unless -Compression=None is given. Run with
+ *
+ *   UE4Editor-Cmd RovrRelieve.uproject -run=RovrBuildPyramids [-Source=<image or directory>] [-Assets=<content path>] [-Out=<directory>] [-TileSize=<texels>] [-Compression=None|Fast|Normal|High]
+ */
+UCLASS()
+class URovrBuildPyramidsCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	URovrBuildPyramidsCommandlet();
+
+	//~ Begin UCommandlet Interface
+	virtual int32 Main(const FString& Params) override;
+	//~ End UCommandlet Interface
+};
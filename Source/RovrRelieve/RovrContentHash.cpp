@@ -0,0 +1,51 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "RovrContentHash.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Hash/CityHash.h"
+
+
+int64 FRovrContentHash::Compute(const FString& Path, int64 Size)
+{
+	TUniquePtr<IFileHandle> Handle(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*Path));
+	if (!Handle || Handle->Size() != Size)
+	{
+		return 0;
+	}
+
+	TArray<uint8> Buffer;
+	uint64 Hash = static_cast<uint64>(Size);
+
+	auto HashRange = [&](int64 Offset, int64 Length)
+	{
+		Buffer.SetNumUninitialized(int32(Length), false);
+		if (!Handle->Seek(Offset) || !Handle->Read(Buffer.GetData(), Length))
+		{
+			return false;
+		}
+
+		Hash = CityHash64WithSeed(reinterpret_cast<const char*>(Buffer.GetData()), uint32(Length), Hash);
+		return true;
+	};
+
+	bool bRead;
+	if (Size <= 3 * BlockSize)
+	{
+		bRead = HashRange(0, Size);
+	}
+	else
+	{
+		bRead = HashRange(0, BlockSize)
+			&& HashRange(Size / 2 - BlockSize / 2, BlockSize)
+			&& HashRange(Size - BlockSize, BlockSize);
+	}
+
+	if (!bRead)
+	{
+		return 0;
+	}
+
+	// Zero marks a file that was not fingerprinted yet
+	return Hash != 0 ? static_cast<int64>(Hash) : 1;
+}
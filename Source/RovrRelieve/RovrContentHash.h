@@ -0,0 +1,27 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+/**
+ * Cheap content fingerprint used to recognise the same file stored under different paths, e.g. a video
+ * copied to both internal storage and the SD card. Combines the file size with a hash of a few sampled
+ * blocks (head, middle, tail), so fingerprinting a multi-GB file costs three small reads.
+ */
+class FRovrContentHash
+{
+public:
+	/** Size of each sampled block; files up to three blocks long are hashed completely */
+	static const int64 BlockSize = 64 * 1024;
+
+	/**
+	 * Fingerprint a file
+	 *
+	 * @param Path File to read
+	 * @param Size Size of the file, as indexed
+	 * @return The fingerprint, never zero; zero if the file could not be read
+	 */
+	static int64 Compute(const FString& Path, int64 Size);
+};
@@ -0,0 +1,138 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "RovrDirectoryEnumerator.h"
+#include "Async/ParallelFor.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/Paths.h"
+
+#if PLATFORM_UNIX || PLATFORM_ANDROID || PLATFORM_MAC || PLATFORM_IOS
+#define ROVR_POSIX_DIRECTORY_ENUMERATION 1
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define ROVR_POSIX_DIRECTORY_ENUMERATION 0
+#endif
+
+
+namespace
+{
+	/** Below this many wanted files, spreading the stats over tasks costs more than it saves */
+	const int32 MinFilesForParallelStat = 32;
+
+#if ROVR_POSIX_DIRECTORY_ENUMERATION
+	FDateTime FromUnixTime(time_t Seconds)
+	{
+		return FDateTime(1970, 1, 1) + FTimespan::FromSeconds(static_cast<double>(Seconds));
+	}
+
+	FFileStatData ToFileStatData(const struct stat& StatBuffer)
+	{
+		return FFileStatData(
+			FromUnixTime(StatBuffer.st_ctime),
+			FromUnixTime(StatBuffer.st_atime),
+			FromUnixTime(StatBuffer.st_mtime),
+			S_ISDIR(StatBuffer.st_mode) ? -1 : static_cast<int64>(StatBuffer.st_size),
+			S_ISDIR(StatBuffer.st_mode),
+			!(StatBuffer.st_mode & S_IWUSR));
+	}
+
+	bool ListPosix(const FString& Directory, FRovrDirectoryEnumerator::FShouldStatFile ShouldStatFile, FRovrDirectoryEnumerator::FListing& OutListing, bool bParallelStat)
+	{
+		DIR* DirHandle = opendir(TCHAR_TO_UTF8(*Directory));
+		if (!DirHandle)
+		{
+			return false;
+		}
+
+		const int32 DirFd = dirfd(DirHandle);
+
+		TArray<FString> WantedNames;
+
+		while (const dirent* Entry = readdir(DirHandle))
+		{
+			const char* Name = Entry->d_name;
+			if (Name[0] == '.' && (Name[1] == '\0' || (Name[1] == '.' && Name[2] == '\0')))
+			{
+				continue;
+			}
+
+			bool bIsDirectory = Entry->d_type == DT_DIR;
+			bool bIsFile = Entry->d_type == DT_REG;
+
+			// Symbolic links and file systems without d_type need a stat to tell files from directories
+			if (!bIsDirectory && !bIsFile)
+			{
+				struct stat StatBuffer;
+				if (fstatat(DirFd, Name, &StatBuffer, 0) != 0)
+				{
+					continue;
+				}
+				bIsDirectory = S_ISDIR(StatBuffer.st_mode);
+				bIsFile = S_ISREG(StatBuffer.st_mode);
+			}
+
+			const FString FileName = UTF8_TO_TCHAR(Name);
+			if (bIsDirectory)
+			{
+				OutListing.Directories.Add(Directory / FileName);
+			}
+			else if (bIsFile && ShouldStatFile(*FileName))
+			{
+				WantedNames.Add(FileName);
+			}
+		}
+
+		OutListing.Files.SetNum(WantedNames.Num());
+
+		auto StatFile = [&](int32 Index)
+		{
+			TPair<FString, FFileStatData>& File = OutListing.Files[Index];
+			File.Key = Directory / WantedNames[Index];
+
+			struct stat StatBuffer;
+			if (fstatat(DirFd, TCHAR_TO_UTF8(*WantedNames[Index]), &StatBuffer, 0) == 0)
+			{
+				File.Value = ToFileStatData(StatBuffer);
+			}
+		};
+
+		ParallelFor(WantedNames.Num(), StatFile, !bParallelStat || WantedNames.Num() < MinFilesForParallelStat);
+
+		closedir(DirHandle);
+
+		// Files that vanished between readdir and stat are dropped
+		OutListing.Files.RemoveAll([](const TPair<FString, FFileStatData>& File) { return !File.Value.bIsValid; });
+
+		return true;
+	}
+#endif
+}
+
+bool FRovrDirectoryEnumerator::List(const FString& Directory, FShouldStatFile ShouldStatFile, FListing& OutListing, bool bParallelStat)
+{
+#if ROVR_POSIX_DIRECTORY_ENUMERATION
+	// Relative paths are resolved by the engine's platform file layer, which raw POSIX calls know nothing about
+	if (!FPaths::IsRelative(Directory))
+	{
+		return ListPosix(Directory, ShouldStatFile, OutListing, bParallelStat);
+	}
+#endif
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+	return PlatformFile.IterateDirectoryStat(*Directory, [&](const TCHAR* FilenameOrDirectory, const FFileStatData& StatData)
+	{
+		if (StatData.bIsDirectory)
+		{
+			OutListing.Directories.Add(FilenameOrDirectory);
+		}
+		else if (ShouldStatFile(*FPaths::GetCleanFilename(FilenameOrDirectory)))
+		{
+			OutListing.Files.Emplace(FilenameOrDirectory, StatData);
+		}
+		return true;
+	});
+}
@@ -0,0 +1,41 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+
+
+/**
+ * Lightweight, non-recursive directory listing for the media scan.
+ *
+ * On POSIX platforms names and entry types come straight from readdir (d_type), so only the files
+ * that pass the caller's name filter are stat'ed, relative to the open directory handle. Other
+ * platforms already get stat data for free from their directory APIs and use IterateDirectoryStat.
+ */
+class FRovrDirectoryEnumerator
+{
+public:
+	/** Called with a bare file name to decide whether the file is wanted and needs its stat data */
+	using FShouldStatFile = TFunctionRef<bool(const TCHAR*)>;
+
+	struct FListing
+	{
+		/** Full paths of the sub directories */
+		TArray<FString> Directories;
+
+		/** Full paths and stat data of the files that passed the filter */
+		TArray<TPair<FString, FFileStatData>> Files;
+	};
+
+	/**
+	 * List a single directory
+	 *
+	 * @param Directory Directory to list
+	 * @param ShouldStatFile Name filter; files it rejects are neither stat'ed nor returned
+	 * @param OutListing Receives the sub directories and the wanted files
+	 * @param bParallelStat Stat the wanted files from several threads, worthwhile on high latency storage such as SD cards
+	 * @return Whether the directory could be opened
+	 */
+	static bool List(const FString& Directory, FShouldStatFile ShouldStatFile, FListing& OutListing, bool bParallelStat = false);
+};
@@ -0,0 +1,164 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RovrEquirectToCubeCommandlet.h"
+#include "RovrRelieve.h"
+#include "RovrCubemap.h"
+#include "RovrImageDecode.h"
+#include "HAL/FileManager.h"
+#include "IImageWrapper.h"
+#include "IImageWrapperModule.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Modules/ModuleManager.h"
+
+
+namespace
+{
+	const TCHAR* const ImageExtensions[] = { TEXT("jpg"), TEXT("jpeg"), TEXT("png") };
+
+	/** Uncompressed BGRA8 DDS cubemap with a single mip, faces in UE's order, which is the order of DDS as well */
+	void WriteDdsCubemap(const TArray<uint8>& Faces, int32 FaceSize, TArray<uint8>& OutFile)
+	{
+		// DDS_HEADER with its magic, in 32-bit words
+		uint32 Header[32] = {};
+		Header[0] = 0x20534444;						// "DDS "
+		Header[1] = 124;							// Header size
+		Header[2] = 0x1 | 0x2 | 0x4 | 0x8 | 0x1000;	// Caps, height, width, pitch and pixel format are set
+		Header[3] = FaceSize;
+		Header[4] = FaceSize;
+		Header[5] = FaceSize * 4;
+		Header[7] = 1;								// Mips
+		Header[19] = 32;							// Pixel format size
+		Header[20] = 0x1 | 0x40;					// Alpha and RGB masks are set
+		Header[22] = 32;
+		Header[23] = 0x00FF0000;
+		Header[24] = 0x0000FF00;
+		Header[25] = 0x000000FF;
+		Header[26] = 0xFF000000;
+		Header[27] = 0x8 | 0x1000;					// Complex texture
+		Header[28] = 0x200 | 0xFC00;				// Cubemap with all six faces
+
+		OutFile.Reset(sizeof(Header) + Faces.Num());
+		OutFile.Append(reinterpret_cast<const uint8*>(Header), sizeof(Header));
+		OutFile.Append(Faces);
+	}
+
+	bool ConvertImage(const FString& Path, const FString& OutDirectory, int32 FaceSize, ERovrCubeProjection Projection, ERovrResampleFilter Filter)
+	{
+		TArray<uint8> Bytes;
+		TArray<uint8> Pixels;
+		int32 Width = 0;
+		int32 Height = 0;
+		if (!FFileHelper::LoadFileToArray(Bytes, *Path) || !RovrImageDecode::Decode(Bytes, Pixels, Width, Height))
+		{
+			UE_LOG(LogRovrRelieve, Error, TEXT("Unable to decode %s"), *Path);
+			return false;
+		}
+
+		const int32 Size = FaceSize > 0 ? FaceSize : RovrCubemap::GetFaceSize(Width);
+		TArray<uint8> Faces;
+		Faces.SetNumUninitialized(int64(Size) * Size * 4 * RovrCubemap::NumFaces);
+		if (!RovrCubemap::FromEquirect(FRovrImageView(Pixels, Width, Height, ERovrPixelLayout::BGRA8), Size, Projection, Filter, Faces.GetData()))
+		{
+			UE_LOG(LogRovrRelieve, Error, TEXT("%s is too small to convert"), *Path);
+			return false;
+		}
+
+		TArray<uint8> File;
+		FString OutPath = OutDirectory / FPaths::GetBaseFilename(Path);
+		if (Projection == ERovrCubeProjection::EquiAngular)
+		{
+			TArray<uint8> Packed;
+			Packed.SetNumUninitialized(Faces.Num());
+			RovrCubemap::PackFaces3x2(Faces.GetData(), Size, Packed.GetData());
+
+			IImageWrapperModule& ImageWrapperModule = FModuleManager::GetModuleChecked<IImageWrapperModule>(TEXT("ImageWrapper"));
+			const TSharedPtr<IImageWrapper> ImageWrapper = ImageWrapperModule.CreateImageWrapper(EImageFormat::PNG);
+			if (!ImageWrapper.IsValid() || !ImageWrapper->SetRaw(Packed.GetData(), Packed.Num(), Size * 3, Size * 2, ERGBFormat::BGRA, 8))
+			{
+				return false;
+			}
+			File = ImageWrapper->GetCompressed();
+			OutPath += TEXT("_eac.png");
+		}
+		else
+		{
+			WriteDdsCubemap(Faces, Size, File);
+			OutPath += TEXT("_cube.dds");
+		}
+
+		if (!FFileHelper::SaveArrayToFile(File, *OutPath))
+		{
+			UE_LOG(LogRovrRelieve, Error, TEXT("Unable to write %s"), *OutPath);
+			return false;
+		}
+
+		UE_LOG(LogRovrRelieve, Display, TEXT("Wrote %s, %dx%d faces"), *OutPath, Size, Size);
+		return true;
+	}
+}
+
+URovrEquirectToCubeCommandlet::URovrEquirectToCubeCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	LogToConsole = true;
+
+	HelpDescription = TEXT("Converts equirect 360 images to cubemaps or equi-angular cubemaps");
+	HelpUsage = TEXT("-run=RovrEquirectToCube -Source=<image or directory> [-Out=<directory>] [-FaceSize=<texels>] [-EAC] [-Bilinear]");
+}
+
+int32 URovrEquirectToCubeCommandlet::Main(const FString& Params)
+{
+	FString Source;
+	if (!FParse::Value(*Params, TEXT("Source="), Source))
+	{
+		UE_LOG(LogRovrRelieve, Error, TEXT("Usage: %s"), *HelpUsage);
+		return 1;
+	}
+
+	// A directory converts every image directly inside it
+	TArray<FString> Paths;
+	FString SourceDirectory = FPaths::GetPath(Source);
+	if (IFileManager::Get().DirectoryExists(*Source))
+	{
+		SourceDirectory = Source;
+		for (const TCHAR* Extension : ImageExtensions)
+		{
+			TArray<FString> Names;
+			IFileManager::Get().FindFiles(Names, *(Source / FString::Printf(TEXT("*.%s"), Extension)), true, false);
+			for (const FString& Name : Names)
+			{
+				Paths.Add(Source / Name);
+			}
+		}
+	}
+	else
+	{
+		Paths.Add(Source);
+	}
+
+	FString OutDirectory = SourceDirectory;
+	FParse::Value(*Params, TEXT("Out="), OutDirectory);
+
+	int32 FaceSize = 0;
+	FParse::Value(*Params, TEXT("FaceSize="), FaceSize);
+
+	// Offline there is time for the sharper filter
+	const ERovrCubeProjection Projection = FParse::Param(*Params, TEXT("EAC")) ? ERovrCubeProjection::EquiAngular : ERovrCubeProjection::Cubemap;
+	const ERovrResampleFilter Filter = FParse::Param(*Params, TEXT("Bilinear")) ? ERovrResampleFilter::Bilinear : ERovrResampleFilter::Bicubic;
+
+	FModuleManager::LoadModuleChecked<IImageWrapperModule>(TEXT("ImageWrapper"));
+
+	int32 NumFailed = 0;
+	for (const FString& Path : Paths)
+	{
+		if (!ConvertImage(Path, OutDirectory, FaceSize, Projection, Filter))
+		{
+			++NumFailed;
+		}
+	}
+
+	UE_LOG(LogRovrRelieve, Display, TEXT("Converted %d of %d images"), Paths.Num() - NumFailed, Paths.Num());
+	return NumFailed > 0 ? 1 : 0;
+}
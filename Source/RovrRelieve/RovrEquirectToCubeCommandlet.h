@@ -0,0 +1,29 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "RovrEquirectToCubeCommandlet.generated.h"
+
+
+/**
+ * Converts equirect 360 images to cube faces ahead of time, with the same resampling the app uses at runtime.
+ *
+ * Cubemaps are written as uncompressed DDS cubemaps, which the editor imports as cube textures; EAC faces
+ * are written as a 3x2 PNG. Run with
+ *
+ *   UE4Editor-Cmd RovrRelieve.uproject -run=RovrEquirectToCube -Source=<image or directory> [-Out=<directory>] [-FaceSize=<texels>] [-EAC] [-Bilinear]
+ */
+UCLASS()
+class URovrEquirectToCubeCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	URovrEquirectToCubeCommandlet();
+
+	//~ Begin UCommandlet Interface
+	virtual int32 Main(const FString& Params) override;
+	//~ End UCommandlet Interface
+};
@@ -0,0 +1,44 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RovrImageDecode.h"
+#include "RovrJpegDecoder.h"
+#include "IImageWrapper.h"
+#include "IImageWrapperModule.h"
+#include "Modules/ModuleManager.h"
+
+
+namespace
+{
+	/** Rows a baseline JPEG is decoded in at a time */
+	const int32 DecodeBandHeight = 256;
+}
+
+bool RovrImageDecode::Decode(const TArray<uint8>& Bytes, TArray<uint8>& OutPixels, int32& OutWidth, int32& OutHeight)
+{
+	FRovrJpegDecoder Jpeg;
+	if (Jpeg.Open(Bytes))
+	{
+		OutWidth = Jpeg.GetWidth();
+		OutHeight = Jpeg.GetHeight();
+		OutPixels.SetNumUninitialized(int64(OutWidth) * OutHeight * 4);
+
+		const int32 Width = OutWidth;
+		return Jpeg.Decode(DecodeBandHeight, [&OutPixels, Width](const uint8* Pixels, int32 FirstRow, int32 NumRows)
+		{
+			FMemory::Memcpy(OutPixels.GetData() + int64(FirstRow) * Width * 4, Pixels, int64(NumRows) * Width * 4);
+			return true;
+		});
+	}
+
+	IImageWrapperModule& ImageWrapperModule = FModuleManager::GetModuleChecked<IImageWrapperModule>(TEXT("ImageWrapper"));
+	const EImageFormat ImageFormat = ImageWrapperModule.DetectImageFormat(Bytes.GetData(), Bytes.Num());
+	const TSharedPtr<IImageWrapper> ImageWrapper = ImageFormat != EImageFormat::Invalid ? ImageWrapperModule.CreateImageWrapper(ImageFormat) : nullptr;
+	if (!ImageWrapper.IsValid() || !ImageWrapper->SetCompressed(Bytes.GetData(), Bytes.Num()) || !ImageWrapper->GetRaw(ERGBFormat::BGRA, 8, OutPixels))
+	{
+		return false;
+	}
+
+	OutWidth = ImageWrapper->GetWidth();
+	OutHeight = ImageWrapper->GetHeight();
+	return true;
+}
@@ -0,0 +1,20 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+/**
+ * Decoding of local and downloaded images on worker threads, for the stages that work on their pixels
+ */
+namespace RovrImageDecode
+{
+	/**
+	 * Decode a JPEG or PNG to BGRA8. Baseline JPEGs go through FRovrJpegDecoder, which splits its work over
+	 * worker threads; anything else goes through ImageWrapper, whose module must have been loaded on the game thread
+	 *
+	 * @return Whether the image could be decoded
+	 */
+	bool Decode(const TArray<uint8>& Bytes, TArray<uint8>& OutPixels, int32& OutWidth, int32& OutHeight);
+}
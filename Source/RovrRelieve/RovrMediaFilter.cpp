@@ -0,0 +1,129 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "RovrMediaFilter.h"
+
+
+namespace
+{
+	const TCHAR* GetFileNamePointer(const FString& Path)
+	{
+		const TCHAR* Start = *Path;
+		for (const TCHAR* Char = Start + Path.Len(); Char > Start; --Char)
+		{
+			if (Char[-1] == TEXT('/') || Char[-1] == TEXT('\\'))
+			{
+				return Char;
+			}
+		}
+		return Start;
+	}
+}
+
+FRovrMediaFilter::FRovrMediaFilter(const FRovrMediaFilterSpec& Spec)
+	: Prefixes(Spec.Prefixes)
+	, MinSize(Spec.MinSize)
+	, MaxSize(Spec.MaxSize)
+{
+	for (const FString& Extension : Spec.Extensions)
+	{
+		FString Compiled = Extension.StartsWith(TEXT(".")) ? Extension.RightChop(1) : Extension;
+		if (!Compiled.IsEmpty())
+		{
+			Extensions.AddUnique(Compiled.ToLower());
+		}
+	}
+
+	Prefixes.RemoveAll([](const FString& Prefix) { return Prefix.IsEmpty(); });
+
+	for (const FString& Pattern : Spec.Patterns)
+	{
+		if (Pattern.IsEmpty())
+		{
+			continue;
+		}
+
+		FString Compiled = Pattern.Replace(TEXT("\\"), TEXT("/"));
+		(Compiled.Contains(TEXT("/")) ? PathPatterns : NamePatterns).Add(MoveTemp(Compiled));
+	}
+}
+
+bool FRovrMediaFilter::WildcardMatch(const TCHAR* String, const TCHAR* Pattern)
+{
+	const TCHAR* StarPattern = nullptr;
+	const TCHAR* StarString = nullptr;
+
+	while (*String)
+	{
+		if (*Pattern == TEXT('*'))
+		{
+			StarPattern = ++Pattern;
+			StarString = String;
+		}
+		else if (*Pattern == TEXT('?') || (*Pattern && FChar::ToLower(*Pattern) == FChar::ToLower(*String)))
+		{
+			++Pattern;
+			++String;
+		}
+		else if (StarPattern)
+		{
+			// Let the last * swallow one more character and retry
+			Pattern = StarPattern;
+			String = ++StarString;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	while (*Pattern == TEXT('*'))
+	{
+		++Pattern;
+	}
+	return *Pattern == TEXT('\0');
+}
+
+bool FRovrMediaFilter::MatchesFileName(const TCHAR* FileName) const
+{
+	if (Extensions.Num() > 0)
+	{
+		const TCHAR* Dot = FCString::Strrchr(FileName, TEXT('.'));
+		if (!Dot || !Extensions.ContainsByPredicate([Dot](const FString& Extension) { return FCString::Stricmp(Dot + 1, *Extension) == 0; }))
+		{
+			return false;
+		}
+	}
+
+	if (Prefixes.Num() > 0 && !Prefixes.ContainsByPredicate([FileName](const FString& Prefix) { return FCString::Strncmp(FileName, *Prefix, Prefix.Len()) == 0; }))
+	{
+		return false;
+	}
+
+	if (NamePatterns.Num() > 0 && !NamePatterns.ContainsByPredicate([FileName](const FString& Pattern) { return WildcardMatch(FileName, *Pattern); }))
+	{
+		return false;
+	}
+
+	return true;
+}
+
+bool FRovrMediaFilter::Matches(const FRovrMediaEntry& Entry) const
+{
+	if (Entry.Size < MinSize || (MaxSize > 0 && Entry.Size > MaxSize))
+	{
+		return false;
+	}
+
+	if (!MatchesFileName(GetFileNamePointer(Entry.Path)))
+	{
+		return false;
+	}
+
+	if (PathPatterns.Num() > 0 && !PathPatterns.ContainsByPredicate([&Entry](const FString& Pattern) { return WildcardMatch(*Entry.Path, *Pattern); }))
+	{
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,38 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RovrMediaTypes.h"
+
+
+/**
+ * File filter compiled once per query from an FRovrMediaFilterSpec. Matching works on pointers into
+ * the entry's path and never allocates, so it can run for every file of a large media folder.
+ */
+class FRovrMediaFilter
+{
+public:
+	FRovrMediaFilter() = default;
+	explicit FRovrMediaFilter(const FRovrMediaFilterSpec& Spec);
+
+	/** Whether the entry passes every part of the filter */
+	bool Matches(const FRovrMediaEntry& Entry) const;
+
+	/** Whether a bare file name passes the name based parts of the filter, ignoring size and full path patterns */
+	bool MatchesFileName(const TCHAR* FileName) const;
+
+	/** Extensions without the leading dot; empty when any extension is accepted */
+	const TArray<FString>& GetExtensions() const { return Extensions; }
+
+	/** Case insensitive glob match supporting * and ? */
+	static bool WildcardMatch(const TCHAR* String, const TCHAR* Pattern);
+
+private:
+	TArray<FString> Extensions;
+	TArray<FString> Prefixes;
+	TArray<FString> NamePatterns;
+	TArray<FString> PathPatterns;
+	int64 MinSize = 0;
+	int64 MaxSize = 0;
+};
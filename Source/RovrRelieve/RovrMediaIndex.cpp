@@ -0,0 +1,598 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "RovrMediaIndex.h"
+#include "RovrRelieve.h"
+#include "RovrContentHash.h"
+#include "RovrDirectoryEnumerator.h"
+#include "RovrMp4Probe.h"
+#include "Async/Async.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/QueuedThreadPool.h"
+#include "Serialization/Archive.h"
+#include "Serialization/MemoryWriter.h"
+
+
+namespace
+{
+	/** Identifies the index file and its layout; bump the version whenever the serialized data changes */
+	const uint32 MediaIndexMagic = 0x58444952; // "RIDX"
+	const int32 MediaIndexVersion = 6;
+
+	/** FAT/exFAT SD cards store modification times with a two second resolution */
+	const FTimespan TimestampGranularity = FTimespan::FromSeconds(2.0);
+
+	/** Below this many files to read, spreading the reads over the file read pool costs more than it saves */
+	const int32 MinFilesForParallelRead = 4;
+
+	/** Threads reading file headers and samples; storage gains little from more reads in flight */
+	const int32 NumFileReadThreads = 4;
+
+	/** Files probed or fingerprinted between two write-backs, bounding the work lost to a cancellation */
+	const int32 FileBatchSize = 64;
+
+	bool HasIndexedExtension(const TCHAR* FileName, const TArray<FString>& Extensions)
+	{
+		const TCHAR* Dot = FCString::Strrchr(FileName, TEXT('.'));
+		if (!Dot)
+		{
+			return false;
+		}
+
+		for (const FString& Extension : Extensions)
+		{
+			if (FCString::Stricmp(Dot + 1, *Extension) == 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+FRovrMediaIndex::FRovrMediaIndex(const FString& InIndexFilePath)
+	: IndexFilePath(InIndexFilePath)
+{
+}
+
+FRovrMediaIndex::~FRovrMediaIndex()
+{
+}
+
+FString FRovrMediaIndex::NormalizeDirectory(const FString& Directory)
+{
+	FString Normalized = Directory;
+	FPaths::NormalizeDirectoryName(Normalized);
+	return Normalized;
+}
+
+bool FRovrMediaIndex::Load()
+{
+	FScopeLock ScopeLock(&Lock);
+
+	Directories.Reset();
+	bDirty = false;
+
+	TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*IndexFilePath, FILEREAD_Silent));
+	if (!Reader)
+	{
+		return false;
+	}
+
+	uint32 Magic = 0;
+	int32 Version = 0;
+	*Reader << Magic;
+	*Reader << Version;
+
+	if (Magic != MediaIndexMagic || Version != MediaIndexVersion)
+	{
+		UE_LOG(LogRovrRelieve, Log, TEXT("Discarding outdated media index '%s'"), *IndexFilePath);
+		return false;
+	}
+
+	*Reader << IndexedExtensions;
+	*Reader << bIndexAllExtensions;
+	*Reader << Directories;
+
+	if (Reader->IsError())
+	{
+		UE_LOG(LogRovrRelieve, Warning, TEXT("Media index '%s' is corrupt, it will be rebuilt"), *IndexFilePath);
+		Directories.Reset();
+		IndexedExtensions.Reset();
+		bIndexAllExtensions = false;
+		return false;
+	}
+
+	return true;
+}
+
+bool FRovrMediaIndex::Save()
+{
+	// Only one save writes the file at a time; queries only wait for the copy below
+	FScopeLock SaveScopeLock(&SaveLock);
+
+	TArray<uint8> Data;
+	{
+		FScopeLock ScopeLock(&Lock);
+
+		if (!bDirty)
+		{
+			return true;
+		}
+
+		FMemoryWriter Writer(Data);
+		uint32 Magic = MediaIndexMagic;
+		int32 Version = MediaIndexVersion;
+		Writer << Magic;
+		Writer << Version;
+		Writer << IndexedExtensions;
+		Writer << bIndexAllExtensions;
+		Writer << Directories;
+
+		// Changes made while the file is written mark the index dirty again
+		bDirty = false;
+	}
+
+	// Write next to the real file and swap it in, so an interrupted save never leaves a truncated index behind
+	const FString TempFilePath = IndexFilePath + TEXT(".tmp");
+	bool bSaved = FFileHelper::SaveArrayToFile(Data, *TempFilePath);
+	if (!bSaved)
+	{
+		UE_LOG(LogRovrRelieve, Warning, TEXT("Unable to write media index '%s'"), *TempFilePath);
+	}
+	else if (!IFileManager::Get().Move(*IndexFilePath, *TempFilePath, true, true))
+	{
+		UE_LOG(LogRovrRelieve, Warning, TEXT("Unable to replace media index '%s'"), *IndexFilePath);
+		bSaved = false;
+	}
+
+	if (!bSaved)
+	{
+		FScopeLock ScopeLock(&Lock);
+		bDirty = true;
+	}
+	return bSaved;
+}
+
+bool FRovrMediaIndex::NeedsRelisting(const FIndexedDirectory& Cached, const FDateTime& ModificationTime)
+{
+	if (Cached.ModificationTime != ModificationTime)
+	{
+		return true;
+	}
+
+	// A change landing in the same timestamp tick as the last listing would not move the modification time again
+	return Cached.ListedTime <= ModificationTime + TimestampGranularity;
+}
+
+void FRovrMediaIndex::RequireExtensions(const TArray<FString>& Extensions)
+{
+	FScopeLock ScopeLock(&Lock);
+
+	bool bWidened = false;
+	if (Extensions.Num() == 0)
+	{
+		bWidened = !bIndexAllExtensions;
+		bIndexAllExtensions = true;
+	}
+	else if (!bIndexAllExtensions)
+	{
+		for (const FString& Extension : Extensions)
+		{
+			if (!Extension.IsEmpty() && !IndexedExtensions.Contains(Extension.ToLower()))
+			{
+				IndexedExtensions.Add(Extension.ToLower());
+				bWidened = true;
+			}
+		}
+	}
+
+	if (bWidened)
+	{
+		for (TPair<FString, FIndexedDirectory>& Directory : Directories)
+		{
+			Directory.Value.ModificationTime = FDateTime();
+		}
+		bDirty = true;
+	}
+}
+
+FRovrMediaIndex::FIndexedDirectory FRovrMediaIndex::ListDirectory(const FString& Directory, const FDateTime& ModificationTime, const TArray<FString>& Extensions, bool bAllExtensions, const TArray<FRovrMediaEntry>& PreviousFiles)
+{
+	FIndexedDirectory Listed;
+	Listed.ModificationTime = ModificationTime;
+	Listed.ListedTime = FDateTime::UtcNow();
+
+	FRovrDirectoryEnumerator::FListing Listing;
+	FRovrDirectoryEnumerator::List(Directory, [&](const TCHAR* FileName)
+	{
+		return bAllExtensions || HasIndexedExtension(FileName, Extensions);
+	}, Listing, true);
+
+	Listed.SubDirectories.Reserve(Listing.Directories.Num());
+	for (const FString& SubDirectory : Listing.Directories)
+	{
+		Listed.SubDirectories.Add(NormalizeDirectory(SubDirectory));
+	}
+
+	Listed.Files.Reserve(Listing.Files.Num());
+	for (TPair<FString, FFileStatData>& File : Listing.Files)
+	{
+		FRovrMediaEntry& Entry = Listed.Files.AddDefaulted_GetRef();
+		Entry.Path = MoveTemp(File.Key);
+		Entry.Extension = FPaths::GetExtension(Entry.Path).ToLower();
+		Entry.Size = File.Value.FileSize;
+		Entry.ModificationTime = File.Value.ModificationTime;
+	}
+
+	KeepProbedFields(Listed.Files, PreviousFiles);
+
+	return Listed;
+}
+
+void FRovrMediaIndex::KeepProbedFields(TArray<FRovrMediaEntry>& Files, const TArray<FRovrMediaEntry>& PreviousFiles)
+{
+	TMap<FString, const FRovrMediaEntry*> Previous;
+	Previous.Reserve(PreviousFiles.Num());
+	for (const FRovrMediaEntry& Entry : PreviousFiles)
+	{
+		Previous.Add(Entry.Path, &Entry);
+	}
+
+	// Files that changed since they were last seen are left to ComputeFingerprints and ProbeHeaders. Unchanged
+	// ones keep their fingerprint, or its failure, whether or not their header was probed yet
+	for (FRovrMediaEntry& Entry : Files)
+	{
+		const FRovrMediaEntry* const* Cached = Previous.Find(Entry.Path);
+		if (Cached && (*Cached)->Size == Entry.Size && (*Cached)->ModificationTime == Entry.ModificationTime)
+		{
+			Entry.Fingerprint = (*Cached)->Fingerprint;
+			Entry.bFingerprintFailed = (*Cached)->bFingerprintFailed;
+			if ((*Cached)->bProbed)
+			{
+				Entry.CopyHeaderFields(**Cached);
+			}
+		}
+	}
+}
+
+void FRovrMediaIndex::ForEachFileRead(int32 Num, TFunctionRef<void(int32)> Body)
+{
+	if (Num < MinFilesForParallelRead)
+	{
+		for (int32 Index = 0; Index < Num; ++Index)
+		{
+			Body(Index);
+		}
+		return;
+	}
+
+	// Blocking reads stay off the task graph, whose workers the frame needs
+	{
+		FScopeLock ScopeLock(&Lock);
+		if (!FileReadPool)
+		{
+			FileReadPool.Reset(FQueuedThreadPool::Allocate());
+			FileReadPool->Create(NumFileReadThreads, 64 * 1024, TPri_BelowNormal, TEXT("RovrMediaFileReads"));
+		}
+	}
+
+	TArray<TFuture<void>> Reads;
+	Reads.Reserve(Num);
+	for (int32 Index = 0; Index < Num; ++Index)
+	{
+		Reads.Add(AsyncPool(*FileReadPool, [&Body, Index]()
+		{
+			Body(Index);
+		}));
+	}
+
+	for (TFuture<void>& Read : Reads)
+	{
+		Read.Wait();
+	}
+}
+
+int32 FRovrMediaIndex::Refresh(const FString& Root)
+{
+	return Refresh(Root, [](const TArray<FRovrMediaEntry>&) {});
+}
+
+int32 FRovrMediaIndex::Refresh(const FString& Root, FOnDirectoryRefreshed OnDirectoryRefreshed, const FThreadSafeBool* bCancelled)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+	const FString NormalizedRoot = NormalizeDirectory(Root);
+	if (NormalizedRoot.IsEmpty())
+	{
+		return 0;
+	}
+
+	TArray<FString> Extensions;
+	bool bAllExtensions;
+	{
+		FScopeLock ScopeLock(&Lock);
+		Extensions = IndexedExtensions;
+		bAllExtensions = bIndexAllExtensions;
+	}
+
+	int32 NumListed = 0;
+	TSet<FString> Visited;
+	TArray<FString> Pending;
+	Pending.Add(NormalizedRoot);
+
+	TArray<FRovrMediaEntry> Files;
+	while (Pending.Num() > 0)
+	{
+		if (bCancelled && *bCancelled)
+		{
+			// Only part of the tree was visited, so nothing may be pruned
+			return NumListed;
+		}
+
+		const FString Directory = Pending.Pop(false);
+
+		const FFileStatData StatData = PlatformFile.GetStatData(*Directory);
+		if (!StatData.bIsValid || !StatData.bIsDirectory)
+		{
+			continue;
+		}
+
+		Visited.Add(Directory);
+
+		bool bIsCurrent = false;
+		{
+			FScopeLock ScopeLock(&Lock);
+
+			const FIndexedDirectory* Cached = Directories.Find(Directory);
+			if (Cached)
+			{
+				// Relisting keeps the probed metadata of the files that did not change
+				Files = Cached->Files;
+
+				if (!NeedsRelisting(*Cached, StatData.ModificationTime))
+				{
+					Pending.Append(Cached->SubDirectories);
+					bIsCurrent = true;
+				}
+			}
+			else
+			{
+				Files.Reset();
+			}
+		}
+
+		if (!bIsCurrent)
+		{
+			FIndexedDirectory Listed = ListDirectory(Directory, StatData.ModificationTime, Extensions, bAllExtensions, Files);
+			Files = Listed.Files;
+			Pending.Append(Listed.SubDirectories);
+			++NumListed;
+
+			FScopeLock ScopeLock(&Lock);
+			Directories.Add(Directory, MoveTemp(Listed));
+			bDirty = true;
+		}
+
+		if (Files.Num() > 0)
+		{
+			OnDirectoryRefreshed(Files);
+		}
+	}
+
+	// Forget directories below this root that no longer exist
+	const FString RootPrefix = NormalizedRoot + TEXT("/");
+
+	FScopeLock ScopeLock(&Lock);
+	for (auto It = Directories.CreateIterator(); It; ++It)
+	{
+		if ((It.Key() == NormalizedRoot || It.Key().StartsWith(RootPrefix)) && !Visited.Contains(It.Key()))
+		{
+			It.RemoveCurrent();
+			bDirty = true;
+		}
+	}
+
+	return NumListed;
+}
+
+void FRovrMediaIndex::Query(const FString& Root, TArray<FRovrMediaEntry>& OutEntries) const
+{
+	FScopeLock ScopeLock(&Lock);
+
+	TArray<FString> Pending;
+	Pending.Add(NormalizeDirectory(Root));
+
+	while (Pending.Num() > 0)
+	{
+		const FString Directory = Pending.Pop(false);
+
+		if (const FIndexedDirectory* Cached = Directories.Find(Directory))
+		{
+			OutEntries.Append(Cached->Files);
+			Pending.Append(Cached->SubDirectories);
+		}
+	}
+}
+
+bool FRovrMediaIndex::FindEntry(const FString& Path, FRovrMediaEntry& OutEntry) const
+{
+	FScopeLock ScopeLock(&Lock);
+
+	if (const FIndexedDirectory* Cached = Directories.Find(NormalizeDirectory(FPaths::GetPath(Path))))
+	{
+		if (const FRovrMediaEntry* Entry = Cached->Files.FindByPredicate([&Path](const FRovrMediaEntry& Candidate) { return Candidate.Path == Path; }))
+		{
+			OutEntry = *Entry;
+			return true;
+		}
+	}
+	return false;
+}
+
+void FRovrMediaIndex::ApplyChanges(const TArray<FRovrMediaChange>& Changes)
+{
+	TSet<FString> DirectoriesToRefresh;
+	{
+		FScopeLock ScopeLock(&Lock);
+
+		auto AddDirectoryOf = [&](const FString& Path)
+		{
+			FString Directory = NormalizeDirectory(FPaths::GetPath(Path));
+
+			// Rewriting a file does not touch its directory's modification time, so force the listing
+			if (FIndexedDirectory* Cached = Directories.Find(Directory))
+			{
+				Cached->ModificationTime = FDateTime();
+			}
+
+			// A new sub directory is only linked into the index once its closest indexed ancestor is listed again
+			while (!Directories.Contains(Directory))
+			{
+				const FString Parent = NormalizeDirectory(FPaths::GetPath(Directory));
+				if (Parent.IsEmpty() || Parent == Directory)
+				{
+					// Not below any indexed directory
+					return;
+				}
+				Directory = Parent;
+			}
+			DirectoriesToRefresh.Add(Directory);
+		};
+
+		for (const FRovrMediaChange& Change : Changes)
+		{
+			AddDirectoryOf(Change.Path);
+			if (!Change.OldPath.IsEmpty())
+			{
+				AddDirectoryOf(Change.OldPath);
+			}
+		}
+	}
+
+	for (const FString& Directory : DirectoriesToRefresh)
+	{
+		Refresh(Directory);
+	}
+}
+
+int32 FRovrMediaIndex::ProbeHeaders(const FString& Root, const FThreadSafeBool* bCancelled)
+{
+	// Only the files that changed since they were last probed
+	TArray<FRovrMediaEntry> Pending;
+	Query(Root, Pending);
+	Pending.RemoveAll([](const FRovrMediaEntry& Entry) { return Entry.bProbed || !FRovrMp4Probe::CanProbe(Entry.Extension); });
+
+	// Copies of a file already probed under another path take its header fields and are stored below without reading
+	if (Pending.Num() > 0)
+	{
+		FScopeLock ScopeLock(&Lock);
+
+		TMap<int64, const FRovrMediaEntry*> ProbedContent;
+		for (const TPair<FString, FIndexedDirectory>& Directory : Directories)
+		{
+			for (const FRovrMediaEntry& Entry : Directory.Value.Files)
+			{
+				if (Entry.bProbed && Entry.Fingerprint != 0)
+				{
+					ProbedContent.Add(Entry.Fingerprint, &Entry);
+				}
+			}
+		}
+
+		for (FRovrMediaEntry& Entry : Pending)
+		{
+			const FRovrMediaEntry* const* Probed = Entry.Fingerprint != 0 ? ProbedContent.Find(Entry.Fingerprint) : nullptr;
+			if (Probed)
+			{
+				Entry.CopyHeaderFields(**Probed);
+			}
+		}
+	}
+
+	int32 NumProbed = 0;
+	for (int32 BatchStart = 0; BatchStart < Pending.Num(); BatchStart += FileBatchSize)
+	{
+		if (bCancelled && *bCancelled)
+		{
+			break;
+		}
+
+		const int32 BatchNum = FMath::Min(FileBatchSize, Pending.Num() - BatchStart);
+		ForEachFileRead(BatchNum, [&](int32 Index)
+		{
+			FRovrMediaEntry& Entry = Pending[BatchStart + Index];
+			if (!Entry.bProbed)
+			{
+				FRovrMp4Probe::Probe(Entry.Path, Entry);
+			}
+		});
+
+		FScopeLock ScopeLock(&Lock);
+		for (int32 Index = BatchStart; Index < BatchStart + BatchNum; ++Index)
+		{
+			const FRovrMediaEntry& Probed = Pending[Index];
+
+			FIndexedDirectory* Cached = Directories.Find(NormalizeDirectory(FPaths::GetPath(Probed.Path)));
+			FRovrMediaEntry* Entry = Cached ? Cached->Files.FindByPredicate([&Probed](const FRovrMediaEntry& Candidate) { return Candidate.Path == Probed.Path; }) : nullptr;
+
+			// The file may have changed while it was being read
+			if (Entry && Entry->Size == Probed.Size && Entry->ModificationTime == Probed.ModificationTime)
+			{
+				Entry->CopyHeaderFields(Probed);
+				bDirty = true;
+				++NumProbed;
+			}
+		}
+	}
+
+	return NumProbed;
+}
+
+int32 FRovrMediaIndex::ComputeFingerprints(const FString& Root, const FThreadSafeBool* bCancelled)
+{
+	// Only the files that are still missing a fingerprint and did not fail to read since they last changed
+	TArray<FRovrMediaEntry> Pending;
+	Query(Root, Pending);
+	Pending.RemoveAll([](const FRovrMediaEntry& Entry) { return Entry.Fingerprint != 0 || Entry.bFingerprintFailed; });
+
+	int32 NumComputed = 0;
+	for (int32 BatchStart = 0; BatchStart < Pending.Num(); BatchStart += FileBatchSize)
+	{
+		if (bCancelled && *bCancelled)
+		{
+			break;
+		}
+
+		const int32 BatchNum = FMath::Min(FileBatchSize, Pending.Num() - BatchStart);
+		ForEachFileRead(BatchNum, [&](int32 Index)
+		{
+			FRovrMediaEntry& Entry = Pending[BatchStart + Index];
+			Entry.Fingerprint = FRovrContentHash::Compute(Entry.Path, Entry.Size);
+		});
+
+		FScopeLock ScopeLock(&Lock);
+		for (int32 Index = BatchStart; Index < BatchStart + BatchNum; ++Index)
+		{
+			const FRovrMediaEntry& Hashed = Pending[Index];
+
+			FIndexedDirectory* Cached = Directories.Find(NormalizeDirectory(FPaths::GetPath(Hashed.Path)));
+			FRovrMediaEntry* Entry = Cached ? Cached->Files.FindByPredicate([&Hashed](const FRovrMediaEntry& Candidate) { return Candidate.Path == Hashed.Path; }) : nullptr;
+
+			// The file may have changed while it was being read
+			if (Entry && Entry->Size == Hashed.Size && Entry->ModificationTime == Hashed.ModificationTime)
+			{
+				// Unreadable files are tried again once their size or modification time changes
+				Entry->Fingerprint = Hashed.Fingerprint;
+				Entry->bFingerprintFailed = Hashed.Fingerprint == 0;
+				bDirty = true;
+				NumComputed += Hashed.Fingerprint != 0 ? 1 : 0;
+			}
+		}
+	}
+
+	return NumComputed;
+}
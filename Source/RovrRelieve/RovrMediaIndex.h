@@ -0,0 +1,177 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "HAL/ThreadSafeBool.h"
+#include "RovrMediaTypes.h"
+
+class FQueuedThreadPool;
+
+
+/**
+ * Persistent, incrementally revalidated index of the files below one or more media roots.
+ *
+ * Every directory is stored with the modification time it had when it was last listed. A refresh
+ * only stats the directories themselves and re-lists the ones whose modification time changed, so
+ * an unchanged tree costs one stat per directory instead of one per file. Only files with one of the
+ * indexed extensions are stat'ed and stored. Listing never reads the files themselves; the headers of
+ * new or changed video files are probed afterwards by ProbeHeaders on a worker, and their duration and
+ * video information are cached alongside the file.
+ *
+ * The index is thread safe: refreshes may run on worker threads while the game thread queries.
+ */
+class FRovrMediaIndex
+{
+public:
+	/** Called with the files of each directory as soon as it has been revalidated */
+	using FOnDirectoryRefreshed = TFunctionRef<void(const TArray<FRovrMediaEntry>&)>;
+
+	explicit FRovrMediaIndex(const FString& InIndexFilePath);
+	~FRovrMediaIndex();
+
+	/**
+	 * Load the index from disk. A missing or outdated file simply leaves the index empty
+	 *
+	 * @return Whether a valid index file was loaded
+	 */
+	bool Load();
+
+	/**
+	 * Write the index to disk if it changed since the last load or save. The index is only locked while
+	 * it is serialized to memory, not while the file is written; still, call it from a worker thread
+	 * unless the app is shutting down
+	 *
+	 * @return Whether the index is now persisted
+	 */
+	bool Save();
+
+	/**
+	 * Make sure files with the given extensions are indexed. Widening the set invalidates every
+	 * directory, so the next refresh lists them again
+	 *
+	 * @param Extensions Extensions without the leading dot; an empty array requests every file
+	 */
+	void RequireExtensions(const TArray<FString>& Extensions);
+
+	/**
+	 * Bring the cached view of Root up to date
+	 *
+	 * @param Root Directory to revalidate, recursively
+	 * @return Number of directories that had to be listed again
+	 */
+	int32 Refresh(const FString& Root);
+
+	/**
+	 * Bring the cached view of Root up to date, reporting files directory by directory
+	 *
+	 * @param Root Directory to revalidate, recursively
+	 * @param OnDirectoryRefreshed Receives the files of every directory below Root, cached or freshly listed
+	 * @param bCancelled Optional flag polled between directories; a cancelled refresh keeps what it listed so far
+	 * @return Number of directories that had to be listed again
+	 */
+	int32 Refresh(const FString& Root, FOnDirectoryRefreshed OnDirectoryRefreshed, const FThreadSafeBool* bCancelled = nullptr);
+
+	/**
+	 * Append every indexed file below Root to OutEntries. Does not touch the disk
+	 */
+	void Query(const FString& Root, TArray<FRovrMediaEntry>& OutEntries) const;
+
+	/**
+	 * Look up a single indexed file. Does not touch the disk
+	 *
+	 * @return Whether the file is in the index
+	 */
+	bool FindEntry(const FString& Path, FRovrMediaEntry& OutEntry) const;
+
+	/**
+	 * Bring the directories touched by a set of changes up to date. Directories the index does not know
+	 * yet are reached through their closest indexed ancestor
+	 */
+	void ApplyChanges(const TArray<FRovrMediaChange>& Changes);
+
+	/**
+	 * Probe the headers of the indexed video files below Root that are new or changed since they were last
+	 * probed. Copies of a file probed under another path, as told by their fingerprints, take its results
+	 * without being read. Stores the results in batches, so a cancelled pass keeps its progress. Call from a
+	 * worker thread after ComputeFingerprints
+	 *
+	 * @param Root Directory whose files to probe, recursively
+	 * @param bCancelled Optional flag polled between batches
+	 * @return Number of files probed
+	 */
+	int32 ProbeHeaders(const FString& Root, const FThreadSafeBool* bCancelled = nullptr);
+
+	/**
+	 * Fingerprint the indexed files below Root that do not have one yet. Files that cannot be read are
+	 * marked and only tried again once their size or modification time changed. Runs the reads in parallel and
+	 * stores the results in batches, so a cancelled pass keeps its progress. Call from a worker thread
+	 *
+	 * @param Root Directory whose files to fingerprint, recursively
+	 * @param bCancelled Optional flag polled between batches
+	 * @return Number of files fingerprinted
+	 */
+	int32 ComputeFingerprints(const FString& Root, const FThreadSafeBool* bCancelled = nullptr);
+
+	/** Normalize a root or directory path the way the index keys it */
+	static FString NormalizeDirectory(const FString& Directory);
+
+private:
+	struct FIndexedDirectory
+	{
+		/** Modification time of the directory when it was listed */
+		FDateTime ModificationTime;
+
+		/** When the directory was listed; used to guard against coarse file system timestamps */
+		FDateTime ListedTime;
+
+		TArray<FString> SubDirectories;
+		TArray<FRovrMediaEntry> Files;
+
+		friend FArchive& operator<<(FArchive& Ar, FIndexedDirectory& Directory)
+		{
+			Ar << Directory.ModificationTime;
+			Ar << Directory.ListedTime;
+			Ar << Directory.SubDirectories;
+			Ar << Directory.Files;
+			return Ar;
+		}
+	};
+
+	/**
+	 * List a single directory from disk, keeping files with one of Extensions (or all of them when bAllExtensions)
+	 * and the probed fields of the files that did not change compared to PreviousFiles
+	 */
+	static FIndexedDirectory ListDirectory(const FString& Directory, const FDateTime& ModificationTime, const TArray<FString>& Extensions, bool bAllExtensions, const TArray<FRovrMediaEntry>& PreviousFiles);
+
+	/** Copy the fingerprints and probed headers of PreviousFiles whose size and modification time still match into Files */
+	static void KeepProbedFields(TArray<FRovrMediaEntry>& Files, const TArray<FRovrMediaEntry>& PreviousFiles);
+
+	/** Run Body for 0 to Num - 1 on the file read pool and wait for all of them */
+	void ForEachFileRead(int32 Num, TFunctionRef<void(int32)> Body);
+
+	/** Whether a cached directory must be listed again given its current modification time */
+	static bool NeedsRelisting(const FIndexedDirectory& Cached, const FDateTime& ModificationTime);
+
+	FString IndexFilePath;
+
+	/** Guards Directories and bDirty; never held while touching the disk */
+	mutable FCriticalSection Lock;
+
+	/** Serializes saves, so two of them never write the temporary file at once. Taken before Lock */
+	FCriticalSection SaveLock;
+
+	TMap<FString, FIndexedDirectory> Directories;
+
+	/** Lower-case extensions of the files kept in the index */
+	TArray<FString> IndexedExtensions;
+
+	/** Whether every file is indexed regardless of its extension */
+	bool bIndexAllExtensions = false;
+
+	bool bDirty = false;
+
+	/** Threads for the blocking reads of ProbeHeaders and ComputeFingerprints, created under Lock on first use */
+	TUniquePtr<FQueuedThreadPool> FileReadPool;
+};
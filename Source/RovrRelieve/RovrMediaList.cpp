@@ -0,0 +1,221 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "RovrMediaList.h"
+#include "RovrMediaFilter.h"
+#include "RovrMediaIndex.h"
+#include "RovrMediaSort.h"
+#include "Hash/CityHash.h"
+
+
+int64 URovrMediaList::ComputeId(const FString& Path)
+{
+	return static_cast<int64>(CityHash64(reinterpret_cast<const char*>(*Path), Path.Len() * sizeof(TCHAR)));
+}
+
+void URovrMediaList::Initialize(const TArray<FString>& InRoots, const TSharedRef<FRovrMediaFilter>& InFilter, ERovrMediaSortMode InSortBy, bool bInDescending, bool bInMergeDuplicates, TArray<FRovrMediaEntry>&& InEntries)
+{
+	Roots = InRoots;
+	Filter = InFilter;
+	SortBy = InSortBy;
+	bDescending = bInDescending;
+	bMergeDuplicates = bInMergeDuplicates;
+	AllEntries = MoveTemp(InEntries);
+
+	Rebuild();
+}
+
+TArray<FRovrMediaEntry> URovrMediaList::GetPage(int32 Start, int32 Count) const
+{
+	Start = FMath::Clamp(Start, 0, Visible.Num());
+	Count = FMath::Clamp(Count, 0, Visible.Num() - Start);
+
+	TArray<FRovrMediaEntry> Page;
+	Page.Reserve(Count);
+	for (int32 Index = Start; Index < Start + Count; ++Index)
+	{
+		Page.Add(AllEntries[Visible[Index]]);
+	}
+	return Page;
+}
+
+bool URovrMediaList::GetAt(int32 Index, FRovrMediaEntry& OutEntry) const
+{
+	if (!Visible.IsValidIndex(Index))
+	{
+		return false;
+	}
+
+	OutEntry = AllEntries[Visible[Index]];
+	return true;
+}
+
+int64 URovrMediaList::GetIdAt(int32 Index) const
+{
+	return Visible.IsValidIndex(Index) ? ComputeId(AllEntries[Visible[Index]].Path) : 0;
+}
+
+int32 URovrMediaList::IndexOfId(int64 Id) const
+{
+	const int32* Index = IdToIndex.Find(Id);
+	return Index ? *Index : INDEX_NONE;
+}
+
+bool URovrMediaList::FindById(int64 Id, FRovrMediaEntry& OutEntry) const
+{
+	return GetAt(IndexOfId(Id), OutEntry);
+}
+
+TArray<FString> URovrMediaList::GetDuplicatePaths(int64 Id) const
+{
+	const TArray<FString>* Paths = DuplicatePaths.Find(Id);
+	return Paths ? *Paths : TArray<FString>();
+}
+
+int32 URovrMediaList::FindRoot(const FString& Path) const
+{
+	for (int32 RootIndex = 0; RootIndex < Roots.Num(); ++RootIndex)
+	{
+		const FString& Root = Roots[RootIndex];
+		if (Path.Len() > Root.Len() && Path.StartsWith(Root, ESearchCase::CaseSensitive) && Path[Root.Len()] == TEXT('/'))
+		{
+			return RootIndex;
+		}
+	}
+	return INDEX_NONE;
+}
+
+bool URovrMediaList::ApplyChanges(const TArray<FRovrMediaChange>& Changes, const FRovrMediaIndex& Index)
+{
+	if (!Filter.IsValid())
+	{
+		return false;
+	}
+
+	// Drop every path a change touches, then add back the ones that still exist and match
+	TSet<FString> Stale;
+	TArray<FRovrMediaEntry> Fresh;
+	TSet<FString> FreshPaths;
+	for (const FRovrMediaChange& Change : Changes)
+	{
+		Stale.Add(Change.Path);
+		if (!Change.OldPath.IsEmpty())
+		{
+			Stale.Add(Change.OldPath);
+		}
+
+		FRovrMediaEntry Entry;
+		if (Change.Type != ERovrMediaChangeType::Removed && !FreshPaths.Contains(Change.Path) && FindRoot(Change.Path) != INDEX_NONE && Index.FindEntry(Change.Path, Entry) && Filter->Matches(Entry))
+		{
+			FreshPaths.Add(Change.Path);
+			Fresh.Add(MoveTemp(Entry));
+		}
+	}
+
+	const int32 NumRemoved = AllEntries.RemoveAll([&Stale](const FRovrMediaEntry& Entry) { return Stale.Contains(Entry.Path); });
+	if (NumRemoved == 0 && Fresh.Num() == 0)
+	{
+		return false;
+	}
+
+	AllEntries.Append(MoveTemp(Fresh));
+
+	Rebuild();
+
+	OnChanged.Broadcast();
+	return true;
+}
+
+bool URovrMediaList::UpdateProbedFields(const FRovrMediaIndex& Index)
+{
+	bool bChanged = false;
+	for (FRovrMediaEntry& Entry : AllEntries)
+	{
+		if (Entry.bProbed && Entry.Fingerprint != 0)
+		{
+			continue;
+		}
+
+		FRovrMediaEntry Indexed;
+		if (Index.FindEntry(Entry.Path, Indexed) && Indexed.Size == Entry.Size && Indexed.ModificationTime == Entry.ModificationTime
+			&& (Indexed.bProbed != Entry.bProbed || Indexed.Fingerprint != Entry.Fingerprint))
+		{
+			Entry.CopyProbedFields(Indexed);
+			bChanged = true;
+		}
+	}
+
+	if (!bChanged)
+	{
+		return false;
+	}
+
+	// Durations may change the order; without merging the fingerprints are still handed out with the entries
+	Rebuild();
+
+	OnChanged.Broadcast();
+	return true;
+}
+
+void URovrMediaList::Rebuild()
+{
+	RovrMediaSort::Sort(AllEntries, SortBy, bDescending);
+
+	Visible.Reset(AllEntries.Num());
+	DuplicatePaths.Reset();
+
+	if (bMergeDuplicates)
+	{
+		TArray<int32> RootIndices;
+		RootIndices.Reserve(AllEntries.Num());
+		for (const FRovrMediaEntry& Entry : AllEntries)
+		{
+			RootIndices.Add(FindRoot(Entry.Path));
+		}
+
+		// The copy below the earliest root wins, ties go to the earliest copy in the list order
+		TMap<int64, int32> Preferred;
+		for (int32 Index = 0; Index < AllEntries.Num(); ++Index)
+		{
+			if (AllEntries[Index].Fingerprint == 0)
+			{
+				continue;
+			}
+
+			const int32* Existing = Preferred.Find(AllEntries[Index].Fingerprint);
+			if (!Existing || RootIndices[Index] < RootIndices[*Existing])
+			{
+				Preferred.Add(AllEntries[Index].Fingerprint, Index);
+			}
+		}
+
+		for (int32 Index = 0; Index < AllEntries.Num(); ++Index)
+		{
+			const FRovrMediaEntry& Entry = AllEntries[Index];
+			const int32* Kept = Entry.Fingerprint != 0 ? Preferred.Find(Entry.Fingerprint) : nullptr;
+
+			if (Kept && *Kept != Index)
+			{
+				DuplicatePaths.FindOrAdd(ComputeId(AllEntries[*Kept].Path)).Add(Entry.Path);
+			}
+			else
+			{
+				Visible.Add(Index);
+			}
+		}
+	}
+	else
+	{
+		for (int32 Index = 0; Index < AllEntries.Num(); ++Index)
+		{
+			Visible.Add(Index);
+		}
+	}
+
+	IdToIndex.Reset();
+	IdToIndex.Reserve(Visible.Num());
+	for (int32 Index = 0; Index < Visible.Num(); ++Index)
+	{
+		IdToIndex.Add(ComputeId(AllEntries[Visible[Index]].Path), Index);
+	}
+}
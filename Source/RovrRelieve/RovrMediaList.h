@@ -0,0 +1,131 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/NoExportTypes.h"
+#include "RovrMediaTypes.h"
+
+#include "RovrMediaList.generated.h"
+
+class FRovrMediaFilter;
+class FRovrMediaIndex;
+
+/** Multicast delegate broadcast after the list was patched with changes from the media watcher */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FOnMediaListChanged);
+
+
+/**
+ * Handle to the sorted result of a media query. The entries stay in native memory; Blueprint UI fetches
+ * only the rows it shows through GetPage or GetAt, instead of copying the whole list between nodes.
+ *
+ * Every entry has a stable ID derived from its path, so a selection survives re-sorting and updates.
+ * Copies of the same file found under several roots can be merged into one entry, the copy below the
+ * earliest root being shown.
+ */
+UCLASS(BlueprintType)
+class ROVRRELIEVE_API URovrMediaList : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	/** Number of entries in the list */
+	UFUNCTION(BlueprintPure, Category = FileManager)
+		int32 Num() const { return Visible.Num(); }
+
+	/**
+	 * Copy out a range of entries
+	 *
+	 * @param Start Index of the first entry
+	 * @param Count Maximum number of entries; the page is clamped to the end of the list
+	 */
+	UFUNCTION(BlueprintPure, Category = FileManager)
+		TArray<FRovrMediaEntry> GetPage(int32 Start, int32 Count) const;
+
+	/**
+	 * @return Whether Index is valid
+	 */
+	UFUNCTION(BlueprintPure, Category = FileManager)
+		bool GetAt(int32 Index, FRovrMediaEntry& OutEntry) const;
+
+	/**
+	 * @return Stable ID of the entry at Index, zero if Index is invalid
+	 */
+	UFUNCTION(BlueprintPure, Category = FileManager)
+		int64 GetIdAt(int32 Index) const;
+
+	/**
+	 * @return Current index of the entry with the given ID, -1 if it is not in the list
+	 */
+	UFUNCTION(BlueprintPure, Category = FileManager)
+		int32 IndexOfId(int64 Id) const;
+
+	/**
+	 * @return Whether an entry with the given ID is in the list
+	 */
+	UFUNCTION(BlueprintPure, Category = FileManager)
+		bool FindById(int64 Id, FRovrMediaEntry& OutEntry) const;
+
+	/**
+	 * @return Paths of the other copies of the entry with the given ID that were merged into it
+	 */
+	UFUNCTION(BlueprintPure, Category = FileManager)
+		TArray<FString> GetDuplicatePaths(int64 Id) const;
+
+	/** Broadcast after entries were added, removed or updated by the media watcher, or duplicates were merged */
+	UPROPERTY(BlueprintAssignable, Category = FileManager)
+		FOnMediaListChanged OnChanged;
+
+	/** Stable ID of a path */
+	static int64 ComputeId(const FString& Path);
+
+	/**
+	 * Fill the list with the result of a query
+	 *
+	 * @param InRoots Roots as returned by FRovrMediaScanner::ResolveRoots
+	 * @param InFilter Filter the entries passed
+	 * @param bInMergeDuplicates Whether to show files with the same fingerprint once
+	 * @param InEntries Entries, already filtered
+	 */
+	void Initialize(const TArray<FString>& InRoots, const TSharedRef<FRovrMediaFilter>& InFilter, ERovrMediaSortMode InSortBy, bool bInDescending, bool bInMergeDuplicates, TArray<FRovrMediaEntry>&& InEntries);
+
+	/**
+	 * Patch the list with changes reported by the media watcher, re-reading the changed files from the index
+	 *
+	 * @return Whether the list changed; OnChanged has been broadcast if so
+	 */
+	bool ApplyChanges(const TArray<FRovrMediaChange>& Changes, const FRovrMediaIndex& Index);
+
+	/**
+	 * Pick up headers probed and fingerprints computed since the list was created, re-sort and merge the
+	 * duplicates the fingerprints reveal
+	 *
+	 * @return Whether the list changed; OnChanged has been broadcast if so
+	 */
+	bool UpdateProbedFields(const FRovrMediaIndex& Index);
+
+private:
+	/** Index of the root Path lies below, INDEX_NONE if it is not below any */
+	int32 FindRoot(const FString& Path) const;
+
+	/** Sort every entry and derive the visible entries, duplicates and IDs from them */
+	void Rebuild();
+
+	TArray<FString> Roots;
+	TSharedPtr<FRovrMediaFilter> Filter;
+	ERovrMediaSortMode SortBy = ERovrMediaSortMode::NaturalName;
+	bool bDescending = false;
+	bool bMergeDuplicates = false;
+
+	/** Every matching file, including merged duplicates */
+	TArray<FRovrMediaEntry> AllEntries;
+
+	/** Indices into AllEntries of the visible entries, in order */
+	TArray<int32> Visible;
+
+	/** Stable ID to current index */
+	TMap<int64, int32> IdToIndex;
+
+	/** Stable ID of a visible entry to the paths of the copies merged into it */
+	TMap<int64, TArray<FString>> DuplicatePaths;
+};
@@ -0,0 +1,106 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "RovrMediaScanner.h"
+#include "Async/ParallelFor.h"
+#include "HAL/PlatformFilemanager.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "Misc/Paths.h"
+
+#if PLATFORM_UNIX || PLATFORM_ANDROID || PLATFORM_MAC || PLATFORM_IOS
+#include <limits.h>
+#include <stdlib.h>
+#endif
+
+
+FString FRovrMediaScanner::CanonicalizeDirectory(const FString& Directory)
+{
+	FString Canonical = FPaths::ConvertRelativePathToFull(Directory);
+
+#if PLATFORM_UNIX || PLATFORM_ANDROID || PLATFORM_MAC || PLATFORM_IOS
+	char Resolved[PATH_MAX];
+	if (realpath(TCHAR_TO_UTF8(*Canonical), Resolved))
+	{
+		Canonical = UTF8_TO_TCHAR(Resolved);
+	}
+#endif
+
+	return FRovrMediaIndex::NormalizeDirectory(Canonical);
+}
+
+TArray<FString> FRovrMediaScanner::ResolveRoots(const TArray<FString>& Roots)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+#if PLATFORM_WINDOWS
+	const ESearchCase::Type PathCase = ESearchCase::IgnoreCase;
+#else
+	const ESearchCase::Type PathCase = ESearchCase::CaseSensitive;
+#endif
+
+	auto IsSameOrInside = [PathCase](const FString& Inner, const FString& Outer)
+	{
+		return Inner.Equals(Outer, PathCase) || Inner.StartsWith(Outer + TEXT("/"), PathCase);
+	};
+
+	TArray<FString> Resolved;
+	TArray<FString> Canonical;
+
+	for (const FString& Root : Roots)
+	{
+		if (Root.IsEmpty() || !PlatformFile.DirectoryExists(*Root))
+		{
+			continue;
+		}
+
+		const FString CanonicalRoot = CanonicalizeDirectory(Root);
+
+		bool bCovered = false;
+		for (int32 Index = Canonical.Num() - 1; Index >= 0; --Index)
+		{
+			if (IsSameOrInside(CanonicalRoot, Canonical[Index]))
+			{
+				bCovered = true;
+				break;
+			}
+
+			// The new root contains an earlier one, which would otherwise be reported twice
+			if (IsSameOrInside(Canonical[Index], CanonicalRoot))
+			{
+				Canonical.RemoveAt(Index);
+				Resolved.RemoveAt(Index);
+			}
+		}
+
+		if (!bCovered)
+		{
+			Resolved.Add(FRovrMediaIndex::NormalizeDirectory(Root));
+			Canonical.Add(CanonicalRoot);
+		}
+	}
+
+	return Resolved;
+}
+
+int32 FRovrMediaScanner::Refresh(FRovrMediaIndex& Index, const TArray<FString>& Roots, FRovrMediaIndex::FOnDirectoryRefreshed OnDirectoryRefreshed, const FThreadSafeBool* bCancelled)
+{
+	if (Roots.Num() == 1)
+	{
+		return Index.Refresh(Roots[0], OnDirectoryRefreshed, bCancelled);
+	}
+
+	FCriticalSection CallbackLock;
+	FThreadSafeCounter NumListed;
+
+	// Listing is I/O bound, one task per root lets a slow SD card overlap with internal storage
+	ParallelFor(Roots.Num(), [&](int32 RootIndex)
+	{
+		NumListed.Add(Index.Refresh(Roots[RootIndex], [&](const TArray<FRovrMediaEntry>& Files)
+		{
+			FScopeLock ScopeLock(&CallbackLock);
+			OnDirectoryRefreshed(Files);
+		}, bCancelled));
+	});
+
+	return NumListed.GetValue();
+}
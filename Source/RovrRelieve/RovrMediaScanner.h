@@ -0,0 +1,41 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RovrMediaIndex.h"
+
+
+/**
+ * Revalidates several media roots concurrently, one task per root, so a slow SD card only bounds
+ * the total latency instead of adding to it.
+ */
+class FRovrMediaScanner
+{
+public:
+	/**
+	 * Reduce a list of roots to the ones worth scanning. Empty and missing roots are dropped, as are
+	 * roots that resolve to the same directory as another root or lie inside one, so that a file
+	 * reachable through two paths (e.g. /sdcard and /storage/emulated/0) is only reported once
+	 *
+	 * @param Roots Roots in order of preference
+	 * @return Normalized roots, keeping the spelling of the first root seen for each directory
+	 */
+	static TArray<FString> ResolveRoots(const TArray<FString>& Roots);
+
+	/**
+	 * Refresh every root concurrently. OnDirectoryRefreshed is never invoked from two threads at once
+	 *
+	 * @param Index Index to refresh
+	 * @param Roots Roots as returned by ResolveRoots
+	 * @param OnDirectoryRefreshed Receives the files of every directory below the roots
+	 * @param bCancelled Optional flag polled between directories
+	 * @return Number of directories that had to be listed again
+	 */
+	static int32 Refresh(FRovrMediaIndex& Index, const TArray<FString>& Roots, FRovrMediaIndex::FOnDirectoryRefreshed OnDirectoryRefreshed, const FThreadSafeBool* bCancelled = nullptr);
+
+	/**
+	 * Resolve symbolic links and relative components of a directory where the platform supports it
+	 */
+	static FString CanonicalizeDirectory(const FString& Directory);
+};
@@ -0,0 +1,137 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "RovrMediaSort.h"
+#include "Misc/Paths.h"
+
+
+namespace
+{
+	struct FSortKey
+	{
+		FString BaseName;
+		int64 Value;
+		int32 Index;
+	};
+
+	int64 GetNumericKey(const FRovrMediaEntry& Entry, ERovrMediaSortMode Mode)
+	{
+		switch (Mode)
+		{
+		case ERovrMediaSortMode::ModificationTime:
+			return Entry.ModificationTime.GetTicks();
+		case ERovrMediaSortMode::Size:
+			return Entry.Size;
+		case ERovrMediaSortMode::Duration:
+			return static_cast<int64>(Entry.Duration * 1000.0f);
+		default:
+			return 0;
+		}
+	}
+
+	/** Advance past a run of digits and return it without leading zeros */
+	void ReadDigitRun(const TCHAR*& Str, const TCHAR*& OutStart, int32& OutLen)
+	{
+		while (*Str == TEXT('0') && FChar::IsDigit(Str[1]))
+		{
+			++Str;
+		}
+
+		OutStart = Str;
+		while (FChar::IsDigit(*Str))
+		{
+			++Str;
+		}
+		OutLen = static_cast<int32>(Str - OutStart);
+	}
+}
+
+int32 RovrMediaSort::CompareNatural(const TCHAR* A, const TCHAR* B)
+{
+	while (*A && *B)
+	{
+		if (FChar::IsDigit(*A) && FChar::IsDigit(*B))
+		{
+			const TCHAR* DigitsA;
+			const TCHAR* DigitsB;
+			int32 LenA, LenB;
+			ReadDigitRun(A, DigitsA, LenA);
+			ReadDigitRun(B, DigitsB, LenB);
+
+			// Without leading zeros the longer run is the larger number
+			if (LenA != LenB)
+			{
+				return LenA - LenB;
+			}
+
+			for (int32 Digit = 0; Digit < LenA; ++Digit)
+			{
+				if (DigitsA[Digit] != DigitsB[Digit])
+				{
+					return DigitsA[Digit] - DigitsB[Digit];
+				}
+			}
+			continue;
+		}
+
+		const TCHAR LowerA = FChar::ToLower(*A);
+		const TCHAR LowerB = FChar::ToLower(*B);
+		if (LowerA != LowerB)
+		{
+			return LowerA - LowerB;
+		}
+
+		++A;
+		++B;
+	}
+
+	return (*A ? 1 : 0) - (*B ? 1 : 0);
+}
+
+void RovrMediaSort::Sort(TArray<FRovrMediaEntry>& Entries, ERovrMediaSortMode Mode, bool bDescending)
+{
+	if (Entries.Num() < 2)
+	{
+		return;
+	}
+
+	TArray<FSortKey> Keys;
+	Keys.Reserve(Entries.Num());
+	for (int32 Index = 0; Index < Entries.Num(); ++Index)
+	{
+		Keys.Add({ FPaths::GetBaseFilename(Entries[Index].Path), GetNumericKey(Entries[Index], Mode), Index });
+	}
+
+	const int32 Direction = bDescending ? -1 : 1;
+
+	Keys.Sort([Mode, Direction](const FSortKey& A, const FSortKey& B)
+	{
+		int32 Result = 0;
+		if (Mode == ERovrMediaSortMode::Name)
+		{
+			Result = Direction * FCString::Stricmp(*A.BaseName, *B.BaseName);
+		}
+		else if (Mode == ERovrMediaSortMode::NaturalName)
+		{
+			Result = Direction * RovrMediaSort::CompareNatural(*A.BaseName, *B.BaseName);
+		}
+		else
+		{
+			Result = Direction * (A.Value < B.Value ? -1 : (A.Value > B.Value ? 1 : 0));
+			if (Result == 0)
+			{
+				Result = RovrMediaSort::CompareNatural(*A.BaseName, *B.BaseName);
+			}
+		}
+
+		return Result != 0 ? Result < 0 : A.Index < B.Index;
+	});
+
+	TArray<FRovrMediaEntry> Sorted;
+	Sorted.Reserve(Entries.Num());
+	for (const FSortKey& Key : Keys)
+	{
+		Sorted.Add(MoveTemp(Entries[Key.Index]));
+	}
+	Entries = MoveTemp(Sorted);
+}
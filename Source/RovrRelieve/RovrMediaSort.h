@@ -0,0 +1,30 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RovrMediaTypes.h"
+
+
+/**
+ * Sorting stage for media queries. Sort keys are computed once per entry and the entries are
+ * ordered with an O(n log n) sort, ties keep their original order.
+ */
+namespace RovrMediaSort
+{
+	/**
+	 * Compare two file names ignoring case, with runs of digits compared by their numeric value
+	 *
+	 * @return Negative, zero or positive like Stricmp
+	 */
+	int32 CompareNatural(const TCHAR* A, const TCHAR* B);
+
+	/**
+	 * Sort media entries in place
+	 *
+	 * @param Entries Entries to sort
+	 * @param Mode Primary sort key; name based modes use the base file name, the others fall back to natural name order on ties
+	 * @param bDescending Reverse the primary key order
+	 */
+	void Sort(TArray<FRovrMediaEntry>& Entries, ERovrMediaSortMode Mode, bool bDescending = false);
+}
@@ -0,0 +1,227 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "RovrMediaTypes.generated.h"
+
+
+/**
+ * Orderings supported by the media queries
+ */
+UENUM(BlueprintType, Category = FileManager)
+enum class ERovrMediaSortMode : uint8
+{
+	/** Base file name, compared character by character ignoring case */
+	Name,
+	/** Base file name with digit runs compared by value, so "Video2" comes before "Video10" */
+	NaturalName,
+	ModificationTime,
+	Size,
+	Duration
+};
+
+/**
+ * How a 360 video maps onto the sphere, from its spherical video metadata
+ */
+UENUM(BlueprintType, Category = FileManager)
+enum class ERovrMediaProjection : uint8
+{
+	/** No spherical metadata, a regular flat video */
+	Flat,
+	Equirectangular,
+	Cubemap,
+	/** Custom projection mesh */
+	Mesh
+};
+
+/**
+ * How the views of a stereoscopic video are packed into its frames
+ */
+UENUM(BlueprintType, Category = FileManager)
+enum class ERovrMediaStereoLayout : uint8
+{
+	Mono,
+	/** Left eye on top */
+	TopBottom,
+	/** Left eye on the left */
+	LeftRight,
+	/** Left eye on the right */
+	RightLeft,
+	Custom
+};
+
+/**
+ * Which files a media query returns. Empty lists accept everything; the categories are combined
+ * with AND, the entries within a category with OR
+ */
+USTRUCT(BlueprintType, Category = FileManager)
+struct FRovrMediaFilterSpec
+{
+	GENERATED_BODY()
+
+	/** Accepted extensions, case insensitive, with or without the leading dot (e.g. mp4, mkv, webm, jpg, png) */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = FileManager)
+	TArray<FString> Extensions;
+
+	/** Accepted file name prefixes, case sensitive */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = FileManager)
+	TArray<FString> Prefixes;
+
+	/** Glob patterns using * and ?, case insensitive. Patterns containing a '/' are matched against the full path, the others against the file name */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = FileManager)
+	TArray<FString> Patterns;
+
+	/** Minimum file size in bytes */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = FileManager)
+	int64 MinSize = 0;
+
+	/** Maximum file size in bytes, zero for no limit */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = FileManager)
+	int64 MaxSize = 0;
+};
+
+/**
+ * A single file known to the media index
+ */
+USTRUCT(BlueprintType, Category = FileManager)
+struct FRovrMediaEntry
+{
+	GENERATED_BODY()
+
+	/** Full path of the file, as produced by the directory walk */
+	UPROPERTY(BlueprintReadOnly, Category = FileManager)
+	FString Path;
+
+	/** Lower-case extension without the leading dot */
+	UPROPERTY(BlueprintReadOnly, Category = FileManager)
+	FString Extension;
+
+	/** File size in bytes */
+	UPROPERTY(BlueprintReadOnly, Category = FileManager)
+	int64 Size = 0;
+
+	/** Last modification time (UTC) */
+	UPROPERTY(BlueprintReadOnly, Category = FileManager)
+	FDateTime ModificationTime;
+
+	/** Playback duration in seconds, zero when unknown */
+	UPROPERTY(BlueprintReadOnly, Category = FileManager)
+	float Duration = 0.0f;
+
+	/** Whether the header of the file was parsed and the video fields below are valid */
+	UPROPERTY(BlueprintReadOnly, Category = FileManager)
+	bool bHasVideoInfo = false;
+
+	/** Display width of the video track in pixels */
+	UPROPERTY(BlueprintReadOnly, Category = FileManager)
+	int32 Width = 0;
+
+	/** Display height of the video track in pixels */
+	UPROPERTY(BlueprintReadOnly, Category = FileManager)
+	int32 Height = 0;
+
+	/** Sample entry type of the video track, e.g. avc1 or hvc1 */
+	UPROPERTY(BlueprintReadOnly, Category = FileManager)
+	FString Codec;
+
+	UPROPERTY(BlueprintReadOnly, Category = FileManager)
+	ERovrMediaProjection Projection = ERovrMediaProjection::Flat;
+
+	UPROPERTY(BlueprintReadOnly, Category = FileManager)
+	ERovrMediaStereoLayout StereoLayout = ERovrMediaStereoLayout::Mono;
+
+	/** Sampled content hash identifying copies of the same file under different paths, zero until computed */
+	UPROPERTY(BlueprintReadOnly, Category = FileManager)
+	int64 Fingerprint = 0;
+
+	/** Whether probing the header was attempted, so files without video info are not probed again */
+	bool bProbed = false;
+
+	/** Whether the file could not be read for its fingerprint, so it is only tried again once it changed */
+	bool bFingerprintFailed = false;
+
+	/** Take over the probed header fields and the fingerprint of another entry for the same, unchanged file */
+	void CopyProbedFields(const FRovrMediaEntry& Other)
+	{
+		Fingerprint = Other.Fingerprint;
+		bFingerprintFailed = Other.bFingerprintFailed;
+		CopyHeaderFields(Other);
+	}
+
+	/** Take over the probed header fields of another entry with the same content */
+	void CopyHeaderFields(const FRovrMediaEntry& Other)
+	{
+		Duration = Other.Duration;
+		bHasVideoInfo = Other.bHasVideoInfo;
+		Width = Other.Width;
+		Height = Other.Height;
+		Codec = Other.Codec;
+		Projection = Other.Projection;
+		StereoLayout = Other.StereoLayout;
+		bProbed = Other.bProbed;
+	}
+
+	friend FArchive& operator<<(FArchive& Ar, FRovrMediaEntry& Entry)
+	{
+		Ar << Entry.Path;
+		Ar << Entry.Extension;
+		Ar << Entry.Size;
+		Ar << Entry.ModificationTime;
+		Ar << Entry.Duration;
+		Ar << Entry.bHasVideoInfo;
+		Ar << Entry.Width;
+		Ar << Entry.Height;
+		Ar << Entry.Codec;
+		Ar << Entry.Projection;
+		Ar << Entry.StereoLayout;
+		Ar << Entry.Fingerprint;
+		Ar << Entry.bProbed;
+		Ar << Entry.bFingerprintFailed;
+		return Ar;
+	}
+};
+
+/**
+ * Kind of change reported by the media watcher
+ */
+UENUM(BlueprintType, Category = FileManager)
+enum class ERovrMediaChangeType : uint8
+{
+	Added,
+	Removed,
+	/** The file was rewritten in place; size or modification time changed */
+	Modified,
+	/** The file moved from OldPath to Path */
+	Renamed
+};
+
+/**
+ * A single incremental change to the media roots
+ */
+USTRUCT(BlueprintType, Category = FileManager)
+struct FRovrMediaChange
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = FileManager)
+	ERovrMediaChangeType Type = ERovrMediaChangeType::Added;
+
+	/** Path of the file after the change */
+	UPROPERTY(BlueprintReadOnly, Category = FileManager)
+	FString Path;
+
+	/** Previous path of a renamed file, empty otherwise */
+	UPROPERTY(BlueprintReadOnly, Category = FileManager)
+	FString OldPath;
+
+	FRovrMediaChange() = default;
+
+	FRovrMediaChange(ERovrMediaChangeType InType, const FString& InPath, const FString& InOldPath = FString())
+		: Type(InType)
+		, Path(InPath)
+		, OldPath(InOldPath)
+	{
+	}
+};
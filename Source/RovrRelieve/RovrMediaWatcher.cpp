@@ -0,0 +1,408 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "RovrMediaWatcher.h"
+#include "RovrDirectoryEnumerator.h"
+#include "RovrRelieve.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/Paths.h"
+
+#if ROVR_MEDIA_WATCHER_INOTIFY
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+
+namespace
+{
+	/** How long the watcher thread blocks waiting for events, which also bounds how long stopping takes */
+	const int32 WaitMilliseconds = 250;
+
+	/** Poll interval when change notifications are not available */
+	const double PollIntervalSeconds = 2.0;
+
+	/** Poll interval backing up change notifications */
+	const double SafetyPollIntervalSeconds = 30.0;
+
+	/** Copying or unzipping many files changes the index continuously, so it is written at most this often */
+	const double SaveIntervalSeconds = 10.0;
+
+#if ROVR_MEDIA_WATCHER_INOTIFY
+	const uint32 WatchMask = IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+#endif
+
+	void DiffSnapshots(const TMap<FString, FRovrMediaEntry>& Before, const TMap<FString, FRovrMediaEntry>& After, TArray<FRovrMediaChange>& OutChanges)
+	{
+		TArray<const FRovrMediaEntry*> Vanished;
+		for (const TPair<FString, FRovrMediaEntry>& Previous : Before)
+		{
+			if (!After.Contains(Previous.Key))
+			{
+				Vanished.Add(&Previous.Value);
+			}
+		}
+
+		for (const TPair<FString, FRovrMediaEntry>& Current : After)
+		{
+			const FRovrMediaEntry* Previous = Before.Find(Current.Key);
+			if (!Previous)
+			{
+				// Polling cannot see moves, but a file that vanished with the same size and timestamp most likely moved here
+				const int32 MovedIndex = Vanished.IndexOfByPredicate([&Current](const FRovrMediaEntry* Candidate)
+				{
+					return Candidate->Size == Current.Value.Size && Candidate->ModificationTime == Current.Value.ModificationTime;
+				});
+
+				if (MovedIndex != INDEX_NONE)
+				{
+					OutChanges.Emplace(ERovrMediaChangeType::Renamed, Current.Key, Vanished[MovedIndex]->Path);
+					Vanished.RemoveAtSwap(MovedIndex);
+				}
+				else
+				{
+					OutChanges.Emplace(ERovrMediaChangeType::Added, Current.Key);
+				}
+			}
+			else if (Previous->Size != Current.Value.Size || Previous->ModificationTime != Current.Value.ModificationTime)
+			{
+				OutChanges.Emplace(ERovrMediaChangeType::Modified, Current.Key);
+			}
+		}
+
+		for (const FRovrMediaEntry* Entry : Vanished)
+		{
+			OutChanges.Emplace(ERovrMediaChangeType::Removed, Entry->Path);
+		}
+	}
+}
+
+FRovrMediaWatcher::FRovrMediaWatcher(const TSharedRef<FRovrMediaIndex, ESPMode::ThreadSafe>& InIndex, const TArray<FString>& InRoots, FOnChanges InOnChanges)
+	: Index(InIndex)
+	, Roots(InRoots)
+	, OnChanges(MoveTemp(InOnChanges))
+	, bStopping(false)
+{
+	Thread = FRunnableThread::Create(this, TEXT("RovrMediaWatcher"), 0, TPri_BelowNormal);
+}
+
+FRovrMediaWatcher::~FRovrMediaWatcher()
+{
+	if (Thread)
+	{
+		Thread->Kill(true);
+		delete Thread;
+		Thread = nullptr;
+	}
+
+#if ROVR_MEDIA_WATCHER_INOTIFY
+	if (InotifyFd >= 0)
+	{
+		close(InotifyFd);
+	}
+#endif
+}
+
+void FRovrMediaWatcher::Stop()
+{
+	bStopping = true;
+}
+
+uint32 FRovrMediaWatcher::Run()
+{
+	bool bHasNotifications = false;
+
+#if ROVR_MEDIA_WATCHER_INOTIFY
+	InotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (InotifyFd >= 0)
+	{
+		for (const FString& Root : Roots)
+		{
+			AddWatches(Root, nullptr);
+		}
+		bHasNotifications = true;
+	}
+	else
+	{
+		UE_LOG(LogRovrRelieve, Warning, TEXT("inotify is unavailable (errno %d), media roots will be polled"), errno);
+	}
+#endif
+
+	double LastPollTime = FPlatformTime::Seconds();
+	double LastSaveTime = LastPollTime;
+
+	while (!bStopping)
+	{
+		TArray<FRovrMediaChange> Changes;
+		bool bPoll = false;
+
+#if ROVR_MEDIA_WATCHER_INOTIFY
+		if (bHasNotifications)
+		{
+			pollfd PollFd;
+			PollFd.fd = InotifyFd;
+			PollFd.events = POLLIN;
+			PollFd.revents = 0;
+
+			if (poll(&PollFd, 1, WaitMilliseconds) > 0 && !ReadEvents(Changes))
+			{
+				// Events were lost, only a full revalidation can tell what happened
+				bPoll = true;
+			}
+		}
+#endif
+
+		if (!bHasNotifications)
+		{
+			FPlatformProcess::Sleep(WaitMilliseconds / 1000.0f);
+		}
+
+		const double Now = FPlatformTime::Seconds();
+		if (Now - LastPollTime >= (bHasNotifications ? SafetyPollIntervalSeconds : PollIntervalSeconds))
+		{
+			bPoll = true;
+		}
+
+		if (Changes.Num() > 0)
+		{
+			Index->ApplyChanges(Changes);
+		}
+
+		// Runs after the notified changes were applied, so it only reports what the notifications missed
+		if (bPoll)
+		{
+			PollRoots(Changes);
+			LastPollTime = Now;
+		}
+
+		if (Changes.Num() > 0 && !bStopping)
+		{
+			OnChanges(MoveTemp(Changes));
+		}
+
+		// Saving an index that did not change since the last save does not touch the disk
+		if (Now - LastSaveTime >= SaveIntervalSeconds)
+		{
+			Index->Save();
+			LastSaveTime = Now;
+		}
+	}
+
+	// Changes applied since the last periodic save
+	Index->Save();
+
+	return 0;
+}
+
+TMap<FString, FRovrMediaEntry> FRovrMediaWatcher::SnapshotRoots() const
+{
+	TArray<FRovrMediaEntry> Entries;
+	for (const FString& Root : Roots)
+	{
+		Index->Query(Root, Entries);
+	}
+
+	TMap<FString, FRovrMediaEntry> Snapshot;
+	Snapshot.Reserve(Entries.Num());
+	for (FRovrMediaEntry& Entry : Entries)
+	{
+		FString Path = Entry.Path;
+		Snapshot.Add(MoveTemp(Path), MoveTemp(Entry));
+	}
+	return Snapshot;
+}
+
+void FRovrMediaWatcher::PollRoots(TArray<FRovrMediaChange>& OutChanges)
+{
+	const TMap<FString, FRovrMediaEntry> Before = SnapshotRoots();
+
+	for (const FString& Root : Roots)
+	{
+		Index->Refresh(Root);
+	}
+
+	DiffSnapshots(Before, SnapshotRoots(), OutChanges);
+}
+
+#if ROVR_MEDIA_WATCHER_INOTIFY
+void FRovrMediaWatcher::AddWatches(const FString& Directory, TArray<FRovrMediaChange>* OutAdded)
+{
+	TArray<FString> Pending;
+	Pending.Add(Directory);
+
+	while (Pending.Num() > 0)
+	{
+		const FString Current = Pending.Pop(false);
+
+		// Watch before listing, so files created in between are reported by inotify
+		const int32 WatchDescriptor = inotify_add_watch(InotifyFd, TCHAR_TO_UTF8(*Current), WatchMask);
+		if (WatchDescriptor < 0)
+		{
+			UE_LOG(LogRovrRelieve, Warning, TEXT("Unable to watch '%s' (errno %d), changes there are only found by polling"), *Current, errno);
+		}
+		else
+		{
+			WatchedDirectories.Add(WatchDescriptor, Current);
+		}
+
+		FRovrDirectoryEnumerator::FListing Listing;
+		FRovrDirectoryEnumerator::List(Current, [OutAdded](const TCHAR*) { return OutAdded != nullptr; }, Listing);
+
+		Pending.Append(Listing.Directories);
+
+		if (OutAdded)
+		{
+			for (const TPair<FString, FFileStatData>& File : Listing.Files)
+			{
+				OutAdded->Emplace(ERovrMediaChangeType::Added, File.Key);
+			}
+		}
+	}
+}
+
+void FRovrMediaWatcher::RenameWatches(const FString& OldDirectory, const FString& NewDirectory)
+{
+	const FString OldPrefix = OldDirectory + TEXT("/");
+	for (TPair<int32, FString>& Watch : WatchedDirectories)
+	{
+		if (Watch.Value == OldDirectory || Watch.Value.StartsWith(OldPrefix, ESearchCase::CaseSensitive))
+		{
+			Watch.Value = NewDirectory + Watch.Value.RightChop(OldDirectory.Len());
+		}
+	}
+}
+
+bool FRovrMediaWatcher::ReadEvents(TArray<FRovrMediaChange>& OutChanges)
+{
+	alignas(inotify_event) char Buffer[16 * 1024];
+
+	bool bOverflowed = false;
+
+	// Moves are reported as a MOVED_FROM/MOVED_TO pair sharing a cookie
+	TMap<uint32, TTuple<FString, bool>> PendingMoves;
+
+	for (;;)
+	{
+		const ssize_t Length = read(InotifyFd, Buffer, sizeof(Buffer));
+		if (Length <= 0)
+		{
+			break;
+		}
+
+		for (const char* Cursor = Buffer; Cursor < Buffer + Length;)
+		{
+			const inotify_event* Event = reinterpret_cast<const inotify_event*>(Cursor);
+			Cursor += sizeof(inotify_event) + Event->len;
+
+			if (Event->mask & IN_Q_OVERFLOW)
+			{
+				bOverflowed = true;
+				continue;
+			}
+
+			if (Event->mask & IN_IGNORED)
+			{
+				WatchedDirectories.Remove(Event->wd);
+				continue;
+			}
+
+			const FString* Directory = WatchedDirectories.Find(Event->wd);
+			if (!Directory || Event->len == 0)
+			{
+				continue;
+			}
+
+			const FString Path = *Directory / UTF8_TO_TCHAR(Event->name);
+			const bool bIsDirectory = (Event->mask & IN_ISDIR) != 0;
+
+			if (Event->mask & IN_CREATE)
+			{
+				// New files are reported once they are closed after writing, only directories need action now
+				if (bIsDirectory)
+				{
+					AddWatches(Path, &OutChanges);
+				}
+			}
+			else if (Event->mask & IN_CLOSE_WRITE)
+			{
+				FRovrMediaEntry Existing;
+				OutChanges.Emplace(Index->FindEntry(Path, Existing) ? ERovrMediaChangeType::Modified : ERovrMediaChangeType::Added, Path);
+			}
+			else if (Event->mask & IN_DELETE)
+			{
+				// The files of a deleted directory were already reported one by one
+				if (!bIsDirectory)
+				{
+					OutChanges.Emplace(ERovrMediaChangeType::Removed, Path);
+				}
+			}
+			else if (Event->mask & IN_MOVED_FROM)
+			{
+				PendingMoves.Add(Event->cookie, MakeTuple(Path, bIsDirectory));
+			}
+			else if (Event->mask & IN_MOVED_TO)
+			{
+				TTuple<FString, bool> From;
+				if (PendingMoves.RemoveAndCopyValue(Event->cookie, From))
+				{
+					if (bIsDirectory)
+					{
+						TArray<FRovrMediaEntry> Moved;
+						Index->Query(From.Get<0>(), Moved);
+						for (const FRovrMediaEntry& Entry : Moved)
+						{
+							OutChanges.Emplace(ERovrMediaChangeType::Renamed, Path + Entry.Path.RightChop(From.Get<0>().Len()), Entry.Path);
+						}
+						RenameWatches(From.Get<0>(), Path);
+					}
+					else
+					{
+						OutChanges.Emplace(ERovrMediaChangeType::Renamed, Path, From.Get<0>());
+					}
+				}
+				else if (bIsDirectory)
+				{
+					AddWatches(Path, &OutChanges);
+				}
+				else
+				{
+					OutChanges.Emplace(ERovrMediaChangeType::Added, Path);
+				}
+			}
+		}
+	}
+
+	// Whatever was moved without arriving anywhere left the watched tree
+	for (const TPair<uint32, TTuple<FString, bool>>& Move : PendingMoves)
+	{
+		const FString& Path = Move.Value.Get<0>();
+		if (!Move.Value.Get<1>())
+		{
+			OutChanges.Emplace(ERovrMediaChangeType::Removed, Path);
+			continue;
+		}
+
+		TArray<FRovrMediaEntry> Moved;
+		Index->Query(Path, Moved);
+		for (const FRovrMediaEntry& Entry : Moved)
+		{
+			OutChanges.Emplace(ERovrMediaChangeType::Removed, Entry.Path);
+		}
+
+		const FString Prefix = Path + TEXT("/");
+		for (auto It = WatchedDirectories.CreateIterator(); It; ++It)
+		{
+			if (It.Value() == Path || It.Value().StartsWith(Prefix, ESearchCase::CaseSensitive))
+			{
+				inotify_rm_watch(InotifyFd, It.Key());
+				It.RemoveCurrent();
+			}
+		}
+	}
+
+	return !bOverflowed;
+}
+#endif
@@ -0,0 +1,78 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "RovrMediaIndex.h"
+
+#if PLATFORM_LINUX || PLATFORM_ANDROID
+#define ROVR_MEDIA_WATCHER_INOTIFY 1
+#else
+#define ROVR_MEDIA_WATCHER_INOTIFY 0
+#endif
+
+class FRunnableThread;
+
+
+/**
+ * Watches the media roots for files being added, removed, rewritten or renamed while the app runs,
+ * keeps the media index up to date and reports the changes as deltas.
+ *
+ * Linux and Android use inotify, with a slow poll as a safety net for storage that does not deliver
+ * events for writes made through another view (e.g. MTP). Other platforms poll the directory
+ * modification times through the media index. The index is saved every few seconds while changes come in
+ * and once more when the watcher stops.
+ */
+class FRovrMediaWatcher : public FRunnable
+{
+public:
+	/** Receives the changes of one cycle on the watcher thread, after they were applied to the index */
+	using FOnChanges = TFunction<void(TArray<FRovrMediaChange>&&)>;
+
+	/**
+	 * Start watching
+	 *
+	 * @param InIndex Index to keep up to date
+	 * @param InRoots Roots as returned by FRovrMediaScanner::ResolveRoots
+	 * @param InOnChanges Delegate receiving the changes
+	 */
+	FRovrMediaWatcher(const TSharedRef<FRovrMediaIndex, ESPMode::ThreadSafe>& InIndex, const TArray<FString>& InRoots, FOnChanges InOnChanges);
+	virtual ~FRovrMediaWatcher();
+
+	//~ Begin FRunnable Interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+	//~ End FRunnable Interface
+
+private:
+	/** Revalidate every root through the index and diff the indexed files before and after */
+	void PollRoots(TArray<FRovrMediaChange>& OutChanges);
+
+	/** Snapshot of the indexed files below the roots, keyed by path */
+	TMap<FString, FRovrMediaEntry> SnapshotRoots() const;
+
+#if ROVR_MEDIA_WATCHER_INOTIFY
+	/** Watch Directory and everything below it, optionally reporting the files found as added */
+	void AddWatches(const FString& Directory, TArray<FRovrMediaChange>* OutAdded);
+
+	/** Read and translate all pending inotify events; returns false if the queue overflowed */
+	bool ReadEvents(TArray<FRovrMediaChange>& OutChanges);
+
+	/** Re-key the watches below a renamed directory */
+	void RenameWatches(const FString& OldDirectory, const FString& NewDirectory);
+
+	int32 InotifyFd = -1;
+
+	/** Watch descriptor to watched directory */
+	TMap<int32, FString> WatchedDirectories;
+#endif
+
+	TSharedRef<FRovrMediaIndex, ESPMode::ThreadSafe> Index;
+	TArray<FString> Roots;
+	FOnChanges OnChanges;
+
+	FThreadSafeBool bStopping;
+	FRunnableThread* Thread = nullptr;
+};
@@ -0,0 +1,900 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "RovrMp4Probe.h"
+#include "RovrRelieve.h"
+#include "HAL/PlatformFilemanager.h"
+
+
+namespace
+{
+	constexpr uint32 MakeFourCC(const char (&Code)[5])
+	{
+		return (uint32(uint8(Code[0])) << 24) | (uint32(uint8(Code[1])) << 16) | (uint32(uint8(Code[2])) << 8) | uint32(uint8(Code[3]));
+	}
+
+	/** Upper bounds for the boxes read into memory; anything larger is malformed or not worth it */
+	const int64 MaxHeaderBoxSize = 4 * 1024;
+	const int64 MaxSampleDescriptionSize = 1024 * 1024;
+	const int64 MaxSphericalXmlSize = 64 * 1024;
+	const int64 MaxSampleTableSize = 32 * 1024 * 1024;
+	const int64 MaxKeyframeSize = 32 * 1024 * 1024;
+	const int64 MaxCoverArtSize = 16 * 1024 * 1024;
+
+	/** Guards against looping over corrupt files with thousands of tiny boxes */
+	const int32 MaxBoxesPerContainer = 1024;
+
+	/** Size of a VisualSampleEntry up to its child boxes, excluding the box header */
+	const int64 VisualSampleEntrySize = 78;
+
+	/** Spherical Video V1 uuid box */
+	const uint8 SphericalV1Uuid[16] = { 0xff, 0xcc, 0x82, 0x63, 0xf8, 0x55, 0x4a, 0x93, 0x88, 0x14, 0x58, 0x7a, 0x02, 0x52, 0x1f, 0xdd };
+
+	struct FBox
+	{
+		uint32 Type = 0;
+		int64 PayloadOffset = 0;
+		int64 End = 0;
+
+		int64 PayloadSize() const { return End - PayloadOffset; }
+	};
+
+	uint32 ReadBE32(const uint8* Data)
+	{
+		return (uint32(Data[0]) << 24) | (uint32(Data[1]) << 16) | (uint32(Data[2]) << 8) | uint32(Data[3]);
+	}
+
+	uint64 ReadBE64(const uint8* Data)
+	{
+		return (uint64(ReadBE32(Data)) << 32) | ReadBE32(Data + 4);
+	}
+
+	/** Bounds checked big-endian reader over a box loaded into memory */
+	struct FBoxCursor
+	{
+		const uint8* Data;
+		int64 Size;
+		int64 Offset = 0;
+
+		FBoxCursor(const uint8* InData, int64 InSize)
+			: Data(InData)
+			, Size(InSize)
+		{
+		}
+
+		bool Has(int64 Count) const { return Offset + Count <= Size; }
+		void Skip(int64 Count) { Offset += Count; }
+		uint8 U8() { return Data[Offset++]; }
+		uint16 U16() { const uint16 Value = uint16((Data[Offset] << 8) | Data[Offset + 1]); Offset += 2; return Value; }
+		uint32 U32() { const uint32 Value = ReadBE32(Data + Offset); Offset += 4; return Value; }
+		uint64 U64() { const uint64 Value = ReadBE64(Data + Offset); Offset += 8; return Value; }
+
+		/** Read the header of the child box at the cursor and advance past it */
+		bool NextBox(int64 End, FBox& OutBox)
+		{
+			if (Offset + 8 > End)
+			{
+				return false;
+			}
+
+			const int64 Start = Offset;
+			uint64 BoxSize = U32();
+			OutBox.Type = U32();
+
+			if (BoxSize == 1)
+			{
+				if (!Has(8))
+				{
+					return false;
+				}
+				BoxSize = U64();
+			}
+			else if (BoxSize == 0)
+			{
+				BoxSize = End - Start;
+			}
+
+			// Compared unsigned, so a largesize above the int64 range cannot turn negative and pass
+			if (BoxSize < uint64(Offset - Start) || BoxSize > uint64(End - Start))
+			{
+				return false;
+			}
+
+			OutBox.PayloadOffset = Offset;
+			OutBox.End = Start + int64(BoxSize);
+			Offset = OutBox.End;
+			return true;
+		}
+	};
+
+	struct FTrackInfo
+	{
+		uint32 Handler = 0;
+		uint32 Codec = 0;
+		int32 Width = 0;
+		int32 Height = 0;
+		ERovrMediaProjection Projection = ERovrMediaProjection::Flat;
+		ERovrMediaStereoLayout StereoLayout = ERovrMediaStereoLayout::Mono;
+
+		/** Payload of the decoder configuration box of the sample entry */
+		TArray<uint8> CodecConfig;
+	};
+
+	/** Media timing and sample tables of a track, read when a sample has to be located */
+	struct FSampleTables
+	{
+		uint32 Timescale = 0;
+		uint64 Duration = 0;
+
+		/** Payloads of the tables, including their full box headers */
+		TArray<uint8> TimeToSample;
+		TArray<uint8> SyncSamples;
+		TArray<uint8> SampleSizes;
+		TArray<uint8> SampleToChunk;
+		TArray<uint8> ChunkOffsets;
+		bool bLargeChunkOffsets = false;
+	};
+
+	bool IsCodecConfig(uint32 Type)
+	{
+		return Type == MakeFourCC("avcC") || Type == MakeFourCC("hvcC") || Type == MakeFourCC("vpcC") || Type == MakeFourCC("av1C");
+	}
+
+	/** Reads box headers and payloads from a file without touching the bytes in between */
+	class FBoxFile
+	{
+	public:
+		explicit FBoxFile(IFileHandle& InFile)
+			: File(InFile)
+			, FileSize(InFile.Size())
+		{
+		}
+
+		int64 Size() const { return FileSize; }
+
+		bool ReadBoxHeader(int64 Offset, int64 End, FBox& OutBox)
+		{
+			uint8 Header[16];
+			if (End - Offset < 8 || !File.Seek(Offset) || !File.Read(Header, 8))
+			{
+				return false;
+			}
+
+			uint64 BoxSize = ReadBE32(Header);
+			int64 HeaderSize = 8;
+			OutBox.Type = ReadBE32(Header + 4);
+
+			if (BoxSize == 1)
+			{
+				if (!File.Read(Header + 8, 8))
+				{
+					return false;
+				}
+				BoxSize = ReadBE64(Header + 8);
+				HeaderSize = 16;
+			}
+			else if (BoxSize == 0)
+			{
+				// Extends to the end of the file
+				BoxSize = End - Offset;
+			}
+
+			// Compared unsigned, so a largesize above the int64 range cannot turn negative and pass
+			if (BoxSize < uint64(HeaderSize) || BoxSize > uint64(End - Offset))
+			{
+				return false;
+			}
+
+			OutBox.PayloadOffset = Offset + HeaderSize;
+			OutBox.End = Offset + int64(BoxSize);
+			return true;
+		}
+
+		bool Read(int64 Offset, int64 Size, TArray<uint8>& OutData)
+		{
+			if (Offset < 0 || Size < 0 || Offset > FileSize || Size > FileSize - Offset)
+			{
+				return false;
+			}
+
+			OutData.SetNumUninitialized(int32(Size));
+			return File.Seek(Offset) && File.Read(OutData.GetData(), Size);
+		}
+
+		bool ReadPayload(const FBox& Box, int64 MaxSize, TArray<uint8>& OutPayload)
+		{
+			const int64 PayloadSize = Box.PayloadSize();
+			if (PayloadSize < 0 || PayloadSize > MaxSize)
+			{
+				return false;
+			}
+
+			OutPayload.SetNumUninitialized(int32(PayloadSize));
+			return File.Seek(Box.PayloadOffset) && File.Read(OutPayload.GetData(), PayloadSize);
+		}
+
+		/** Invoke Visitor for every child box of a container, stopping early when it returns false */
+		template <typename VisitorType>
+		void ForEachChild(int64 Offset, int64 End, VisitorType&& Visitor)
+		{
+			FBox Child;
+			for (int32 NumBoxes = 0; NumBoxes < MaxBoxesPerContainer && ReadBoxHeader(Offset, End, Child); ++NumBoxes)
+			{
+				if (!Visitor(Child))
+				{
+					return;
+				}
+				Offset = Child.End;
+			}
+		}
+
+	private:
+		IFileHandle& File;
+		int64 FileSize;
+	};
+
+	void ParseMovieHeader(const TArray<uint8>& Payload, FRovrMediaEntry& Entry)
+	{
+		FBoxCursor Cursor(Payload.GetData(), Payload.Num());
+		if (!Cursor.Has(4))
+		{
+			return;
+		}
+
+		const uint8 Version = Cursor.U8();
+		Cursor.Skip(3);
+
+		uint32 Timescale;
+		uint64 Duration;
+		if (Version == 1)
+		{
+			if (!Cursor.Has(28))
+			{
+				return;
+			}
+			Cursor.Skip(16);
+			Timescale = Cursor.U32();
+			Duration = Cursor.U64();
+		}
+		else
+		{
+			if (!Cursor.Has(16))
+			{
+				return;
+			}
+			Cursor.Skip(8);
+			Timescale = Cursor.U32();
+			Duration = Cursor.U32();
+
+			// All ones marks an unknown duration
+			if (Duration == MAX_uint32)
+			{
+				Duration = 0;
+			}
+		}
+
+		if (Timescale > 0 && Duration != MAX_uint64)
+		{
+			Entry.Duration = float(double(Duration) / Timescale);
+		}
+	}
+
+	void ParseMediaHeader(const TArray<uint8>& Payload, FSampleTables& Tables)
+	{
+		FBoxCursor Cursor(Payload.GetData(), Payload.Num());
+		if (!Cursor.Has(4))
+		{
+			return;
+		}
+
+		const uint8 Version = Cursor.U8();
+		Cursor.Skip(3);
+
+		if (Version == 1 && Cursor.Has(28))
+		{
+			Cursor.Skip(16);
+			Tables.Timescale = Cursor.U32();
+			Tables.Duration = Cursor.U64();
+		}
+		else if (Version == 0 && Cursor.Has(16))
+		{
+			Cursor.Skip(8);
+			Tables.Timescale = Cursor.U32();
+			Tables.Duration = Cursor.U32();
+		}
+	}
+
+	void ParseTrackHeader(const TArray<uint8>& Payload, FTrackInfo& Track)
+	{
+		FBoxCursor Cursor(Payload.GetData(), Payload.Num());
+		if (!Cursor.Has(4))
+		{
+			return;
+		}
+
+		const uint8 Version = Cursor.U8();
+		Cursor.Skip(3);
+
+		// Times, track ID and duration, then reserved, layer, group, volume, reserved and the matrix
+		Cursor.Skip((Version == 1 ? 32 : 20) + 8 + 8 + 36);
+		if (!Cursor.Has(8))
+		{
+			return;
+		}
+
+		// 16.16 fixed point
+		Track.Width = int32(Cursor.U32() >> 16);
+		Track.Height = int32(Cursor.U32() >> 16);
+	}
+
+	void ParseProjection(FBoxCursor& Cursor, int64 End, FTrackInfo& Track)
+	{
+		FBox Box;
+		while (Cursor.NextBox(End, Box))
+		{
+			switch (Box.Type)
+			{
+			case MakeFourCC("equi"): Track.Projection = ERovrMediaProjection::Equirectangular; return;
+			case MakeFourCC("cbmp"): Track.Projection = ERovrMediaProjection::Cubemap; return;
+			case MakeFourCC("mshp"): Track.Projection = ERovrMediaProjection::Mesh; return;
+			default: break;
+			}
+		}
+	}
+
+	void ParseSampleDescription(const TArray<uint8>& Payload, FTrackInfo& Track)
+	{
+		FBoxCursor Cursor(Payload.GetData(), Payload.Num());
+		if (!Cursor.Has(8))
+		{
+			return;
+		}
+
+		// Full box header and entry count; only the first sample entry matters
+		Cursor.Skip(4);
+		if (Cursor.U32() == 0)
+		{
+			return;
+		}
+
+		FBox SampleEntry;
+		if (!Cursor.NextBox(Payload.Num(), SampleEntry))
+		{
+			return;
+		}
+
+		Track.Codec = SampleEntry.Type;
+
+		if (Track.Handler != MakeFourCC("vide") || SampleEntry.PayloadSize() < VisualSampleEntrySize)
+		{
+			return;
+		}
+
+		// Reserved, data reference index and pre-defined fields precede the coded size
+		Cursor.Offset = SampleEntry.PayloadOffset + 24;
+		const int32 CodedWidth = Cursor.U16();
+		const int32 CodedHeight = Cursor.U16();
+
+		if (Track.Width == 0 || Track.Height == 0)
+		{
+			Track.Width = CodedWidth;
+			Track.Height = CodedHeight;
+		}
+
+		Cursor.Offset = SampleEntry.PayloadOffset + VisualSampleEntrySize;
+
+		FBox Child;
+		while (Cursor.NextBox(SampleEntry.End, Child))
+		{
+			if (Child.Type == MakeFourCC("st3d") && Child.PayloadSize() >= 5)
+			{
+				// Stereo mode follows the full box header
+				switch (Payload[Child.PayloadOffset + 4])
+				{
+				case 1: Track.StereoLayout = ERovrMediaStereoLayout::TopBottom; break;
+				case 2: Track.StereoLayout = ERovrMediaStereoLayout::LeftRight; break;
+				case 3: Track.StereoLayout = ERovrMediaStereoLayout::Custom; break;
+				case 4: Track.StereoLayout = ERovrMediaStereoLayout::RightLeft; break;
+				default: Track.StereoLayout = ERovrMediaStereoLayout::Mono; break;
+				}
+			}
+			else if (IsCodecConfig(Child.Type))
+			{
+				Track.CodecConfig = TArray<uint8>(Payload.GetData() + Child.PayloadOffset, int32(Child.PayloadSize()));
+			}
+			else if (Child.Type == MakeFourCC("sv3d"))
+			{
+				FBoxCursor SphericalCursor(Payload.GetData(), Child.End);
+				SphericalCursor.Offset = Child.PayloadOffset;
+
+				FBox SphericalBox;
+				while (SphericalCursor.NextBox(Child.End, SphericalBox))
+				{
+					if (SphericalBox.Type == MakeFourCC("proj"))
+					{
+						FBoxCursor ProjectionCursor(Payload.GetData(), SphericalBox.End);
+						ProjectionCursor.Offset = SphericalBox.PayloadOffset;
+						ParseProjection(ProjectionCursor, SphericalBox.End, Track);
+					}
+				}
+			}
+		}
+	}
+
+	void ParseSphericalV1(const TArray<uint8>& Payload, FTrackInfo& Track)
+	{
+		if (Payload.Num() <= 16 || FMemory::Memcmp(Payload.GetData(), SphericalV1Uuid, 16) != 0)
+		{
+			return;
+		}
+
+		const FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(Payload.GetData() + 16), Payload.Num() - 16);
+		const FString Xml(Converted.Length(), Converted.Get());
+
+		if (!Xml.Contains(TEXT("<GSpherical:Spherical>true")))
+		{
+			return;
+		}
+
+		// Version 1 only defines the equirectangular projection
+		Track.Projection = ERovrMediaProjection::Equirectangular;
+
+		if (Xml.Contains(TEXT("<GSpherical:StereoMode>top-bottom")))
+		{
+			Track.StereoLayout = ERovrMediaStereoLayout::TopBottom;
+		}
+		else if (Xml.Contains(TEXT("<GSpherical:StereoMode>left-right")))
+		{
+			Track.StereoLayout = ERovrMediaStereoLayout::LeftRight;
+		}
+	}
+
+	/** Parse a track box; with OutTables, its timing and sample tables are read as well */
+	void ParseTrack(FBoxFile& File, const FBox& Trak, FTrackInfo& Track, FSampleTables* OutTables = nullptr)
+	{
+		TArray<uint8> Payload;
+
+		File.ForEachChild(Trak.PayloadOffset, Trak.End, [&](const FBox& Box)
+		{
+			if (Box.Type == MakeFourCC("tkhd"))
+			{
+				if (File.ReadPayload(Box, MaxHeaderBoxSize, Payload))
+				{
+					ParseTrackHeader(Payload, Track);
+				}
+			}
+			else if (Box.Type == MakeFourCC("uuid"))
+			{
+				if (File.ReadPayload(Box, MaxSphericalXmlSize, Payload))
+				{
+					ParseSphericalV1(Payload, Track);
+				}
+			}
+			else if (Box.Type == MakeFourCC("mdia"))
+			{
+				File.ForEachChild(Box.PayloadOffset, Box.End, [&](const FBox& MediaBox)
+				{
+					if (MediaBox.Type == MakeFourCC("hdlr"))
+					{
+						// Full box header and pre-defined field precede the handler type
+						if (File.ReadPayload(MediaBox, MaxHeaderBoxSize, Payload) && Payload.Num() >= 12)
+						{
+							Track.Handler = ReadBE32(Payload.GetData() + 8);
+						}
+					}
+					else if (MediaBox.Type == MakeFourCC("mdhd") && OutTables)
+					{
+						if (File.ReadPayload(MediaBox, MaxHeaderBoxSize, Payload))
+						{
+							ParseMediaHeader(Payload, *OutTables);
+						}
+					}
+					else if (MediaBox.Type == MakeFourCC("minf"))
+					{
+						File.ForEachChild(MediaBox.PayloadOffset, MediaBox.End, [&](const FBox& InfoBox)
+						{
+							if (InfoBox.Type != MakeFourCC("stbl"))
+							{
+								return true;
+							}
+
+							// Probing only needs the sample description; the sample tables are skipped unless asked for
+							File.ForEachChild(InfoBox.PayloadOffset, InfoBox.End, [&](const FBox& TableBox)
+							{
+								if (TableBox.Type == MakeFourCC("stsd"))
+								{
+									if (File.ReadPayload(TableBox, MaxSampleDescriptionSize, Payload))
+									{
+										ParseSampleDescription(Payload, Track);
+									}
+									return OutTables != nullptr;
+								}
+
+								if (OutTables && Track.Handler == MakeFourCC("vide"))
+								{
+									switch (TableBox.Type)
+									{
+									case MakeFourCC("stts"): File.ReadPayload(TableBox, MaxSampleTableSize, OutTables->TimeToSample); break;
+									case MakeFourCC("stss"): File.ReadPayload(TableBox, MaxSampleTableSize, OutTables->SyncSamples); break;
+									case MakeFourCC("stsz"): File.ReadPayload(TableBox, MaxSampleTableSize, OutTables->SampleSizes); break;
+									case MakeFourCC("stsc"): File.ReadPayload(TableBox, MaxSampleTableSize, OutTables->SampleToChunk); break;
+									case MakeFourCC("stco"): File.ReadPayload(TableBox, MaxSampleTableSize, OutTables->ChunkOffsets); break;
+									case MakeFourCC("co64"):
+										OutTables->bLargeChunkOffsets = File.ReadPayload(TableBox, MaxSampleTableSize, OutTables->ChunkOffsets);
+										break;
+									default: break;
+									}
+								}
+								return true;
+							});
+							return false;
+						});
+					}
+					return true;
+				});
+			}
+			return true;
+		});
+	}
+
+	/** Number of entries of a sample table following HeaderSize bytes, 0 if the table is truncated */
+	uint32 GetEntryCount(const TArray<uint8>& Table, int64 EntrySize, int64 HeaderSize = 8)
+	{
+		if (Table.Num() < HeaderSize)
+		{
+			return 0;
+		}
+
+		const uint32 NumEntries = ReadBE32(Table.GetData() + HeaderSize - 4);
+		return Table.Num() >= HeaderSize + int64(NumEntries) * EntrySize ? NumEntries : 0;
+	}
+
+	/** Index of the sample being decoded at Time, in media timescale units */
+	uint32 FindSampleAtTime(const TArray<uint8>& TimeToSample, uint64 Time)
+	{
+		const uint32 NumEntries = GetEntryCount(TimeToSample, 8);
+		const uint8* Entries = TimeToSample.GetData() + 8;
+
+		uint64 EntryTime = 0;
+		uint32 FirstSample = 0;
+		for (uint32 Index = 0; Index < NumEntries; ++Index)
+		{
+			const uint32 Count = ReadBE32(Entries + Index * 8);
+			const uint32 Delta = ReadBE32(Entries + Index * 8 + 4);
+			if (Delta > 0 && Time < EntryTime + uint64(Count) * Delta)
+			{
+				return FirstSample + uint32((Time - EntryTime) / Delta);
+			}
+			EntryTime += uint64(Count) * Delta;
+			FirstSample += Count;
+		}
+		return FirstSample > 0 ? FirstSample - 1 : 0;
+	}
+
+	uint64 GetSampleTime(const TArray<uint8>& TimeToSample, uint32 Sample)
+	{
+		const uint32 NumEntries = GetEntryCount(TimeToSample, 8);
+		const uint8* Entries = TimeToSample.GetData() + 8;
+
+		uint64 EntryTime = 0;
+		for (uint32 Index = 0; Index < NumEntries; ++Index)
+		{
+			const uint32 Count = ReadBE32(Entries + Index * 8);
+			const uint32 Delta = ReadBE32(Entries + Index * 8 + 4);
+			if (Sample < Count)
+			{
+				return EntryTime + uint64(Sample) * Delta;
+			}
+			Sample -= Count;
+			EntryTime += uint64(Count) * Delta;
+		}
+		return EntryTime;
+	}
+
+	/** Closest sync sample at or before Sample, or the first one if none precedes it */
+	uint32 FindSyncSample(const TArray<uint8>& SyncSamples, uint32 Sample)
+	{
+		// Without the table every sample is a sync sample
+		const uint32 NumEntries = GetEntryCount(SyncSamples, 4);
+		if (NumEntries == 0)
+		{
+			return Sample;
+		}
+
+		// Entries are ascending and one-based
+		const uint8* Entries = SyncSamples.GetData() + 8;
+		uint32 Low = 0;
+		uint32 High = NumEntries;
+		while (Low < High)
+		{
+			const uint32 Middle = Low + (High - Low) / 2;
+			if (ReadBE32(Entries + Middle * 4) <= Sample + 1)
+			{
+				Low = Middle + 1;
+			}
+			else
+			{
+				High = Middle;
+			}
+		}
+
+		const uint32 SyncNumber = ReadBE32(Entries + (Low > 0 ? Low - 1 : 0) * 4);
+		return SyncNumber > 0 ? SyncNumber - 1 : 0;
+	}
+
+	uint32 GetNumSamples(const TArray<uint8>& SampleSizes)
+	{
+		return SampleSizes.Num() >= 12 ? ReadBE32(SampleSizes.GetData() + 8) : 0;
+	}
+
+	bool GetSampleSize(const TArray<uint8>& SampleSizes, uint32 Sample, uint32& OutSize)
+	{
+		if (SampleSizes.Num() < 12 || Sample >= GetNumSamples(SampleSizes))
+		{
+			return false;
+		}
+
+		// A size shared by every sample replaces the table
+		OutSize = ReadBE32(SampleSizes.GetData() + 4);
+		if (OutSize == 0)
+		{
+			if (SampleSizes.Num() < 12 + (int64(Sample) + 1) * 4)
+			{
+				return false;
+			}
+			OutSize = ReadBE32(SampleSizes.GetData() + 12 + int64(Sample) * 4);
+		}
+		return true;
+	}
+
+	/** File offset of a sample: the offset of its chunk plus the sizes of the samples before it in the chunk */
+	bool GetSampleOffset(const FSampleTables& Tables, uint32 Sample, int64& OutOffset)
+	{
+		const int64 OffsetSize = Tables.bLargeChunkOffsets ? 8 : 4;
+		const uint32 NumChunks = GetEntryCount(Tables.ChunkOffsets, OffsetSize);
+		const uint32 NumRuns = GetEntryCount(Tables.SampleToChunk, 12);
+		const uint8* Runs = Tables.SampleToChunk.GetData() + 8;
+
+		// Runs of chunks sharing a sample count, each starting at a one-based chunk number
+		uint64 FirstSampleOfRun = 0;
+		for (uint32 Run = 0; Run < NumRuns; ++Run)
+		{
+			const uint32 FirstChunk = ReadBE32(Runs + Run * 12);
+			const uint32 SamplesPerChunk = ReadBE32(Runs + Run * 12 + 4);
+			const uint32 EndChunk = Run + 1 < NumRuns ? ReadBE32(Runs + (Run + 1) * 12) : NumChunks + 1;
+			if (FirstChunk == 0 || EndChunk <= FirstChunk || SamplesPerChunk == 0)
+			{
+				continue;
+			}
+
+			const uint64 SamplesInRun = uint64(EndChunk - FirstChunk) * SamplesPerChunk;
+			if (Sample < FirstSampleOfRun + SamplesInRun)
+			{
+				const uint64 SampleInRun = Sample - FirstSampleOfRun;
+				const uint32 Chunk = FirstChunk - 1 + uint32(SampleInRun / SamplesPerChunk);
+				if (Chunk >= NumChunks)
+				{
+					return false;
+				}
+
+				const uint8* ChunkOffset = Tables.ChunkOffsets.GetData() + 8 + int64(Chunk) * OffsetSize;
+				OutOffset = int64(Tables.bLargeChunkOffsets ? ReadBE64(ChunkOffset) : ReadBE32(ChunkOffset));
+
+				for (uint32 Preceding = Sample - uint32(SampleInRun % SamplesPerChunk); Preceding < Sample; ++Preceding)
+				{
+					uint32 Size;
+					if (!GetSampleSize(Tables.SampleSizes, Preceding, Size))
+					{
+						return false;
+					}
+					OutOffset += Size;
+				}
+				return true;
+			}
+			FirstSampleOfRun += SamplesInRun;
+		}
+		return false;
+	}
+
+	FString FourCCToString(uint32 FourCC)
+	{
+		ANSICHAR Code[5] = { ANSICHAR(FourCC >> 24), ANSICHAR(FourCC >> 16), ANSICHAR(FourCC >> 8), ANSICHAR(FourCC), 0 };
+		return FString(ANSI_TO_TCHAR(Code)).TrimEnd();
+	}
+}
+
+bool FRovrMp4Probe::CanProbe(const FString& Extension)
+{
+	return Extension == TEXT("mp4") || Extension == TEXT("m4v") || Extension == TEXT("mov") || Extension == TEXT("3gp");
+}
+
+bool FRovrMp4Probe::Probe(const FString& Path, FRovrMediaEntry& InOutEntry)
+{
+	InOutEntry.bProbed = true;
+
+	TUniquePtr<IFileHandle> Handle(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*Path));
+	if (!Handle)
+	{
+		return false;
+	}
+
+	FBoxFile File(*Handle);
+
+	bool bFoundMovie = false;
+	bool bFoundVideo = false;
+	TArray<uint8> Payload;
+
+	// The movie box may come before or after the media data; either way the media data is seeked over
+	File.ForEachChild(0, File.Size(), [&](const FBox& Box)
+	{
+		if (Box.Type != MakeFourCC("moov"))
+		{
+			return true;
+		}
+
+		bFoundMovie = true;
+		File.ForEachChild(Box.PayloadOffset, Box.End, [&](const FBox& MovieBox)
+		{
+			if (MovieBox.Type == MakeFourCC("mvhd"))
+			{
+				if (File.ReadPayload(MovieBox, MaxHeaderBoxSize, Payload))
+				{
+					ParseMovieHeader(Payload, InOutEntry);
+				}
+			}
+			else if (MovieBox.Type == MakeFourCC("trak") && !bFoundVideo)
+			{
+				FTrackInfo Track;
+				ParseTrack(File, MovieBox, Track);
+
+				if (Track.Handler == MakeFourCC("vide"))
+				{
+					bFoundVideo = true;
+					InOutEntry.Width = Track.Width;
+					InOutEntry.Height = Track.Height;
+					InOutEntry.Codec = FourCCToString(Track.Codec);
+					InOutEntry.Projection = Track.Projection;
+					InOutEntry.StereoLayout = Track.StereoLayout;
+				}
+			}
+			return true;
+		});
+		return false;
+	});
+
+	InOutEntry.bHasVideoInfo = bFoundVideo;
+
+	if (!bFoundMovie)
+	{
+		UE_LOG(LogRovrRelieve, Verbose, TEXT("No movie header found in '%s'"), *Path);
+	}
+	return bFoundMovie;
+}
+
+bool FRovrMp4Probe::ReadKeyframe(const FString& Path, float Position, FRovrMp4Keyframe& OutKeyframe)
+{
+	TUniquePtr<IFileHandle> Handle(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*Path));
+	if (!Handle)
+	{
+		return false;
+	}
+
+	FBoxFile File(*Handle);
+
+	FTrackInfo Track;
+	FSampleTables Tables;
+	bool bFoundVideo = false;
+
+	File.ForEachChild(0, File.Size(), [&](const FBox& Box)
+	{
+		if (Box.Type != MakeFourCC("moov"))
+		{
+			return true;
+		}
+
+		File.ForEachChild(Box.PayloadOffset, Box.End, [&](const FBox& MovieBox)
+		{
+			if (MovieBox.Type == MakeFourCC("trak"))
+			{
+				Track = FTrackInfo();
+				Tables = FSampleTables();
+				ParseTrack(File, MovieBox, Track, &Tables);
+				bFoundVideo = Track.Handler == MakeFourCC("vide");
+			}
+			return !bFoundVideo;
+		});
+		return false;
+	});
+
+	const uint32 NumSamples = GetNumSamples(Tables.SampleSizes);
+	if (!bFoundVideo || Tables.Timescale == 0 || NumSamples == 0)
+	{
+		UE_LOG(LogRovrRelieve, Verbose, TEXT("No video samples found in '%s'"), *Path);
+		return false;
+	}
+
+	// Without a media duration the time to sample table still covers every sample
+	const uint64 Duration = Tables.Duration > 0 ? Tables.Duration : GetSampleTime(Tables.TimeToSample, NumSamples);
+	const uint64 TargetTime = uint64(double(Duration) * FMath::Clamp(Position, 0.0f, 1.0f));
+	const uint32 Sample = FindSyncSample(Tables.SyncSamples, FMath::Min(FindSampleAtTime(Tables.TimeToSample, TargetTime), NumSamples - 1));
+
+	uint32 SampleSize = 0;
+	int64 SampleOffset = 0;
+	if (!GetSampleSize(Tables.SampleSizes, Sample, SampleSize) || !GetSampleOffset(Tables, Sample, SampleOffset) || SampleSize == 0 || SampleSize > MaxKeyframeSize)
+	{
+		UE_LOG(LogRovrRelieve, Verbose, TEXT("Unable to locate sample %u in '%s'"), Sample, *Path);
+		return false;
+	}
+
+	if (!File.Read(SampleOffset, SampleSize, OutKeyframe.Sample))
+	{
+		return false;
+	}
+
+	OutKeyframe.Codec = Track.Codec;
+	OutKeyframe.Width = Track.Width;
+	OutKeyframe.Height = Track.Height;
+	OutKeyframe.CodecConfig = MoveTemp(Track.CodecConfig);
+	OutKeyframe.Time = double(GetSampleTime(Tables.TimeToSample, Sample)) / Tables.Timescale;
+	return true;
+}
+
+bool FRovrMp4Probe::ReadCoverArt(const FString& Path, TArray<uint8>& OutImage)
+{
+	TUniquePtr<IFileHandle> Handle(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*Path));
+	if (!Handle)
+	{
+		return false;
+	}
+
+	FBoxFile File(*Handle);
+
+	bool bFound = false;
+	TArray<uint8> Payload;
+
+	// moov/udta/meta/ilst/covr/data; only the boxes on that path are read
+	auto FindChild = [&File](const FBox& Parent, int64 Skip, uint32 Type, FBox& OutChild)
+	{
+		bool bFoundChild = false;
+		File.ForEachChild(Parent.PayloadOffset + Skip, Parent.End, [&](const FBox& Child)
+		{
+			bFoundChild = Child.Type == Type;
+			if (bFoundChild)
+			{
+				OutChild = Child;
+			}
+			return !bFoundChild;
+		});
+		return bFoundChild;
+	};
+
+	File.ForEachChild(0, File.Size(), [&](const FBox& Box)
+	{
+		if (Box.Type != MakeFourCC("moov"))
+		{
+			return true;
+		}
+
+		FBox UserData, Meta, ItemList, Cover, Data;
+		if (!FindChild(Box, 0, MakeFourCC("udta"), UserData) || !FindChild(UserData, 0, MakeFourCC("meta"), Meta))
+		{
+			return false;
+		}
+
+		// ISO meta boxes are full boxes; QuickTime writes them without version and flags
+		const int64 MetaSkip = File.Read(Meta.PayloadOffset, 4, Payload) && ReadBE32(Payload.GetData()) == 0 ? 4 : 0;
+		if (!FindChild(Meta, MetaSkip, MakeFourCC("ilst"), ItemList) || !FindChild(ItemList, 0, MakeFourCC("covr"), Cover) || !FindChild(Cover, 0, MakeFourCC("data"), Data))
+		{
+			return false;
+		}
+
+		// Type and locale precede the image
+		if (Data.PayloadSize() > 8 && Data.PayloadSize() - 8 <= MaxCoverArtSize)
+		{
+			bFound = File.Read(Data.PayloadOffset + 8, Data.PayloadSize() - 8, OutImage);
+		}
+		return false;
+	});
+
+	return bFound;
+}
@@ -0,0 +1,48 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RovrMediaTypes.h"
+#include "RovrVideoFrameDecoder.h"
+
+/**
+ * Reads duration, resolution, codec and spherical video metadata from the header boxes of MP4/QuickTime
+ * files. Boxes are walked with ranged reads that seek over everything else, so the media payload is never
+ * read and probing a multi-GB file costs a handful of small reads.
+ *
+ * Spherical metadata is taken from the st3d/sv3d boxes of the video sample entry (Spherical Video V2)
+ * and from the XML uuid box of the video track (Spherical Video V1).
+ */
+class FRovrMp4Probe
+{
+public:
+	/** Whether files with the given lower-case extension can be probed */
+	static bool CanProbe(const FString& Extension);
+
+	/**
+	 * Probe a file and fill the header fields of InOutEntry. Marks the entry as probed even on failure
+	 *
+	 * @param Path File to probe
+	 * @param InOutEntry Entry receiving duration and video information
+	 * @return Whether a movie header was found
+	 */
+	static bool Probe(const FString& Path, FRovrMediaEntry& InOutEntry);
+
+	/**
+	 * Read the sync sample of the first video track closest before a position, through its sample tables.
+	 * Only the tables and the sample itself are read
+	 *
+	 * @param Position Share of the duration to seek to, e.g. 0.1 for a representative frame past any fade in
+	 * @param OutKeyframe Receives the sample and its decoder configuration
+	 * @return Whether the file has a video track with a readable sync sample
+	 */
+	static bool ReadKeyframe(const FString& Path, float Position, FRovrMp4Keyframe& OutKeyframe);
+
+	/**
+	 * Read the cover art of the iTunes metadata (moov/udta/meta/ilst/covr), as stored: JPEG, PNG or BMP
+	 *
+	 * @return Whether the file has cover art
+	 */
+	static bool ReadCoverArt(const FString& Path, TArray<uint8>& OutImage);
+};
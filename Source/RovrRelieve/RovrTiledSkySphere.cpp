@@ -0,0 +1,598 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "RovrTiledSkySphere.h"
+#include "RovrRelieve.h"
+#include "RovrDecodeScheduler.h"
+#include "RovrImageDecode.h"
+#include "RovrPyramidFile.h"
+#include "RovrTexture.h"
+#include "RovrTexturePool.h"
+#include "RovrThumbnailCache.h"
+#include "Async/Async.h"
+#include "Camera/PlayerCameraManager.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Hash/CityHash.h"
+#include "IImageWrapperModule.h"
+#include "Materials/MaterialInstanceDynamic.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Modules/ModuleManager.h"
+#include "ProceduralMeshComponent.h"
+
+
+namespace
+{
+	/** Largest angle a segment of a patch spans, so the patches stay round */
+	const float MaxSegmentDegrees = 5.0f;
+
+	TAutoConsoleVariable<int32> CVarPyramidCacheMaxSizeMB(
+		TEXT("rovr.PyramidCache.MaxSizeMB"),
+		512,
+		TEXT("Size the pyramids the tiled sky sphere keeps of loaded images may take on disk, in megabytes.\n")
+		TEXT("The least recently shown pyramids are deleted beyond it."),
+		ECVF_Default);
+
+	FString GetPyramidCacheDirectory()
+	{
+		return FPaths::ProjectSavedDir() / TEXT("RovrPyramids");
+	}
+
+	/** Pyramids cut with other settings are kept apart, so switching settings does not thrash the cache */
+	FString GetPyramidCacheFilename(uint64 Key, int32 TileSize, ERovrCompressQuality Compression)
+	{
+		return GetPyramidCacheDirectory() / FString::Printf(TEXT("%016llx_%d_%d.%s"), Key, TileSize, int32(Compression), FRovrPyramidFile::Extension);
+	}
+
+	/** Delete the least recently shown pyramids beyond rovr.PyramidCache.MaxSizeMB */
+	void TrimPyramidCache()
+	{
+		IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+		TArray<TPair<FDateTime, FString>> Files;
+		int64 TotalSize = 0;
+		PlatformFile.IterateDirectoryStat(*GetPyramidCacheDirectory(), [&Files, &TotalSize](const TCHAR* Filename, const FFileStatData& StatData)
+		{
+			if (!StatData.bIsDirectory && FPaths::GetExtension(Filename) == FRovrPyramidFile::Extension)
+			{
+				Files.Emplace(StatData.ModificationTime, Filename);
+				TotalSize += StatData.FileSize;
+			}
+			return true;
+		});
+
+		const int64 MaxSize = int64(CVarPyramidCacheMaxSizeMB.GetValueOnAnyThread()) * 1024 * 1024;
+		Files.Sort([](const TPair<FDateTime, FString>& A, const TPair<FDateTime, FString>& B) { return A.Key < B.Key; });
+		for (int32 Index = 0; Index < Files.Num() && TotalSize > MaxSize; ++Index)
+		{
+			const int64 Size = PlatformFile.FileSize(*Files[Index].Value);
+			if (PlatformFile.DeleteFile(*Files[Index].Value))
+			{
+				TotalSize -= Size;
+			}
+		}
+	}
+
+	/** Direction of an equirect coordinate: the image's centre lies ahead on +X, its top edge straight up */
+	FVector EquirectToDirection(const FVector2D& Coordinate)
+	{
+		float SinLongitude, CosLongitude, SinLatitude, CosLatitude;
+		FMath::SinCos(&SinLongitude, &CosLongitude, (Coordinate.X - 0.5f) * 2.0f * PI);
+		FMath::SinCos(&SinLatitude, &CosLatitude, (0.5f - Coordinate.Y) * PI);
+		return FVector(CosLatitude * CosLongitude, CosLatitude * SinLongitude, SinLatitude);
+	}
+}
+
+ARovrTiledSkySphere::ARovrTiledSkySphere()
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	Mesh = CreateDefaultSubobject<UProceduralMeshComponent>(TEXT("Mesh"));
+	Mesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Mesh->CastShadow = false;
+	RootComponent = Mesh;
+}
+
+void ARovrTiledSkySphere::LoadImageFile(const FString& Path)
+{
+	StartLoad([Path](TArray<uint8>& OutBytes)
+	{
+		return FFileHelper::LoadFileToArray(OutBytes, *Path);
+	},
+	[Path]()
+	{
+		// A rewritten file gets a new stamp, which no longer matches its cached pyramid
+		const FFileStatData StatData = FPlatformFileManager::Get().GetPlatformFile().GetStatData(*Path);
+		FImageIdentity Identity;
+		Identity.Key = FRovrThumbnailCache::MakeFileId(Path);
+		Identity.Stamp = FRovrThumbnailCache::MakeStamp(StatData.FileSize, StatData.ModificationTime);
+		return Identity;
+	}, FMath::Max<int64>(IFileManager::Get().FileSize(*Path), 0));
+}
+
+void ARovrTiledSkySphere::LoadImageBytes(const TArray<uint8>& Bytes)
+{
+	TSharedRef<TArray<uint8>, ESPMode::ThreadSafe> SharedBytes = MakeShared<TArray<uint8>, ESPMode::ThreadSafe>(Bytes);
+	StartLoad([SharedBytes](TArray<uint8>& OutBytes)
+	{
+		OutBytes = MoveTemp(*SharedBytes);
+		return OutBytes.Num() > 0;
+	},
+	[SharedBytes]()
+	{
+		// Downloads have no path, so the same bytes are the same image
+		FImageIdentity Identity;
+		Identity.Key = CityHash64(reinterpret_cast<const char*>(SharedBytes->GetData()), SharedBytes->Num());
+		Identity.Stamp = Identity.Key;
+		return Identity;
+	}, Bytes.Num());
+}
+
+void ARovrTiledSkySphere::LoadPyramidFile(const FString& Path)
+{
+	CancelLoad();
+	const uint32 LoadGeneration = ++Generation;
+
+	TWeakObjectPtr<ARovrTiledSkySphere> WeakThis(this);
+	Async(EAsyncExecution::ThreadPool, [WeakThis, Path, LoadGeneration]()
+	{
+		TSharedPtr<IRovrTileSource, ESPMode::ThreadSafe> Tiles = FRovrPyramidFile::Open(Path);
+
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, Tiles, LoadGeneration]()
+		{
+			if (ARovrTiledSkySphere* This = WeakThis.Get())
+			{
+				This->FinishLoad(LoadGeneration, Tiles);
+			}
+		});
+	});
+}
+
+void ARovrTiledSkySphere::StartLoad(TFunction<bool(TArray<uint8>&)> ReadBytes, TFunction<FImageIdentity()> Identify, int64 CompressedBytes)
+{
+	// Modules can only be loaded on the game thread, the decoding happens on a worker
+	FModuleManager::LoadModuleChecked<IImageWrapperModule>(TEXT("ImageWrapper"));
+
+	CancelLoad();
+	const uint32 LoadGeneration = ++Generation;
+	const int32 CutTileSize = Align(FMath::Clamp(TileSize, 128, 4096), 4);
+	const ERovrCompressQuality Compression = bCompressTiles ? ERovrCompressQuality::Normal : ERovrCompressQuality::None;
+	const bool bCache = bCachePyramids;
+
+	// The tiles cut from the image take about as much as the decoded image
+	const int64 MemoryBytes = FRovrDecodeScheduler::EstimateDecodeBytes(CompressedBytes) * 2;
+
+	TWeakObjectPtr<ARovrTiledSkySphere> WeakThis(this);
+	LoadDecodeId = FRovrDecodeScheduler::Get().Enqueue(ERovrDecodePriority::Visible, MemoryBytes, [WeakThis, ReadBytes = MoveTemp(ReadBytes), Identify = MoveTemp(Identify), LoadGeneration, CutTileSize, Compression, bCache](const FRovrDecodeScheduler::FCancelFlag& bCancelled)
+	{
+		TSharedPtr<IRovrTileSource, ESPMode::ThreadSafe> Tiles;
+		FImageIdentity Identity;
+		FString CacheFilename;
+		if (bCache)
+		{
+			Identity = Identify();
+			CacheFilename = GetPyramidCacheFilename(Identity.Key, CutTileSize, Compression);
+
+			TSharedPtr<FRovrPyramidFile, ESPMode::ThreadSafe> Cached = FPaths::FileExists(CacheFilename) ? FRovrPyramidFile::Open(CacheFilename) : nullptr;
+			if (Cached.IsValid() && Cached->GetSourceStamp() == Identity.Stamp)
+			{
+				// The modification time orders the cache for trimming
+				FPlatformFileManager::Get().GetPlatformFile().SetTimeStamp(*CacheFilename, FDateTime::UtcNow());
+				Tiles = Cached;
+			}
+		}
+
+		TSharedPtr<FRovrMemoryTileSource, ESPMode::ThreadSafe> Built;
+		if (!Tiles.IsValid() && !*bCancelled)
+		{
+			TArray<uint8> Bytes;
+			TArray<uint8> Pixels;
+			int32 Width = 0;
+			int32 Height = 0;
+			if (ReadBytes(Bytes) && RovrImageDecode::Decode(Bytes, Pixels, Width, Height) && !*bCancelled)
+			{
+				Bytes.Empty();
+				Built = FRovrMemoryTileSource::Build(FRovrImageView(Pixels, Width, Height, ERovrPixelLayout::BGRA8), CutTileSize, Compression, true);
+				Tiles = Built;
+			}
+		}
+
+		// A newer image or EndPlay took over; the generation check would drop the result anyway
+		if (!*bCancelled)
+		{
+			AsyncTask(ENamedThreads::GameThread, [WeakThis, Tiles, LoadGeneration]()
+			{
+				if (ARovrTiledSkySphere* This = WeakThis.Get())
+				{
+					This->FinishLoad(LoadGeneration, Tiles);
+				}
+			});
+		}
+
+		// Written once the image shows, so the first visit is not held up
+		if (Built.IsValid() && bCache && FRovrPyramidFile::Write(*Built, Identity.Stamp, CacheFilename))
+		{
+			TrimPyramidCache();
+		}
+	});
+}
+
+void ARovrTiledSkySphere::CancelLoad()
+{
+	if (LoadDecodeId != 0)
+	{
+		FRovrDecodeScheduler::Get().Cancel(LoadDecodeId);
+		LoadDecodeId = 0;
+	}
+}
+
+void ARovrTiledSkySphere::FinishLoad(uint32 LoadGeneration, const TSharedPtr<IRovrTileSource, ESPMode::ThreadSafe>& Tiles)
+{
+	// A newer image replaces this one
+	if (Generation != LoadGeneration)
+	{
+		return;
+	}
+	LoadDecodeId = 0;
+
+	if (Tiles.IsValid())
+	{
+		SetTileSource(Tiles);
+	}
+	else
+	{
+		UE_LOG(LogRovrRelieve, Warning, TEXT("Unable to load the image of %s"), *GetName());
+	}
+
+	OnImageLoaded.Broadcast(Tiles.IsValid());
+}
+
+void ARovrTiledSkySphere::SetTileSource(const TSharedPtr<IRovrTileSource, ESPMode::ThreadSafe>& InSource)
+{
+	++Generation;
+	ReleaseTiles();
+
+	Source = InSource.IsValid() && InSource->GetNumLevels() > 0 ? InSource : nullptr;
+	BuildPatches();
+}
+
+int64 ARovrTiledSkySphere::GetResidentBytes() const
+{
+	return Source.IsValid() ? Resident.Num() * GetTileBytes() : 0;
+}
+
+void ARovrTiledSkySphere::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (!Source.IsValid() || Patches.Num() == 0)
+	{
+		return;
+	}
+
+	const APlayerController* Player = GetWorld()->GetFirstPlayerController();
+	if (!Player || !Player->PlayerCameraManager)
+	{
+		return;
+	}
+
+	const FVector ViewDirection = GetActorTransform().InverseTransformVectorNoScale(Player->PlayerCameraManager->GetCameraRotation().Vector());
+
+	TArray<int32> Levels;
+	TArray<int32> Order;
+	ChooseLevels(ViewDirection, Levels, Order);
+
+	const uint64 Frame = GFrameCounter;
+	const FRovrTileId Lowest(Source->GetNumLevels() - 1, 0, 0);
+	if (!Resident.Contains(Lowest) && !FailedTiles.Contains(Lowest))
+	{
+		RequestTile(Lowest);
+	}
+
+	// Tiles nearest to the view are asked for first, each patch's coarsest missing level before finer ones,
+	// so quality rises a level at a time while the wanted tile streams in
+	int32 NumRequests = 0;
+	for (const int32 Index : Order)
+	{
+		FPatch& Patch = Patches[Index];
+
+		for (int32 Level = Source->GetNumLevels() - 1; Level >= Levels[Index] && NumRequests < MaxTileRequestsPerFrame; --Level)
+		{
+			const FRovrTileId Tile = GetTileForPatch(Patch, Level);
+			if (FailedTiles.Contains(Tile))
+			{
+				continue;
+			}
+
+			const FResidentTile* Entry = Resident.Find(Tile);
+			if (!Entry)
+			{
+				RequestTile(Tile);
+				++NumRequests;
+				break;
+			}
+			if (!Entry->Texture)
+			{
+				break;
+			}
+		}
+
+		for (int32 Level = Levels[Index]; Level < Source->GetNumLevels(); ++Level)
+		{
+			const FRovrTileId Tile = GetTileForPatch(Patch, Level);
+			FResidentTile* Loaded = Resident.Find(Tile);
+			if (Loaded && Loaded->Texture)
+			{
+				Loaded->LastUsedFrame = Frame;
+				if (!(Patch.Shown == Tile))
+				{
+					ShowTile(Index, Tile, Loaded->Texture);
+				}
+				break;
+			}
+		}
+	}
+
+	// Tiles nobody shows stay loaded, in case the head turns back, until the budget runs short
+	const int64 Budget = int64(MemoryBudgetMB) * 1024 * 1024;
+	for (int64 Bytes = GetResidentBytes(); Bytes > Budget; Bytes -= GetTileBytes())
+	{
+		const FRovrTileId* Oldest = nullptr;
+		uint64 OldestFrame = Frame;
+		for (const TPair<FRovrTileId, FResidentTile>& Pair : Resident)
+		{
+			if (Pair.Value.Texture && Pair.Value.LastUsedFrame < OldestFrame && !(Pair.Key == Lowest))
+			{
+				Oldest = &Pair.Key;
+				OldestFrame = Pair.Value.LastUsedFrame;
+			}
+		}
+
+		if (!Oldest)
+		{
+			break;
+		}
+
+		const FRovrTileId Evicted = *Oldest;
+		FRovrTexturePool::Get().Release(Resident.FindAndRemoveChecked(Evicted).Texture);
+	}
+}
+
+void ARovrTiledSkySphere::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	CancelLoad();
+	++Generation;
+	ReleaseTiles();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ARovrTiledSkySphere::AddReferencedObjects(UObject* InThis, FReferenceCollector& Collector)
+{
+	ARovrTiledSkySphere* This = CastChecked<ARovrTiledSkySphere>(InThis);
+	for (TPair<FRovrTileId, FResidentTile>& Pair : This->Resident)
+	{
+		Collector.AddReferencedObject(Pair.Value.Texture, This);
+	}
+
+	Super::AddReferencedObjects(InThis, Collector);
+}
+
+void ARovrTiledSkySphere::BuildPatches()
+{
+	Mesh->ClearAllMeshSections();
+	Patches.Reset();
+	PatchMaterials.Reset();
+
+	if (!Source.IsValid())
+	{
+		return;
+	}
+
+	const FIntPoint LevelSize = Source->GetLevelSize(0);
+	const FIntPoint NumTiles = Source->GetNumTiles(0);
+	const int32 SourceTileSize = Source->GetTileSize();
+
+	for (int32 TileY = 0; TileY < NumTiles.Y; ++TileY)
+	{
+		for (int32 TileX = 0; TileX < NumTiles.X; ++TileX)
+		{
+			const int32 Index = Patches.Num();
+			FPatch& Patch = Patches.AddDefaulted_GetRef();
+			Patch.Tile = FIntPoint(TileX, TileY);
+
+			const FVector2D Min(float(TileX * SourceTileSize) / LevelSize.X, float(TileY * SourceTileSize) / LevelSize.Y);
+			const FVector2D Max(float(FMath::Min((TileX + 1) * SourceTileSize, LevelSize.X)) / LevelSize.X, float(FMath::Min((TileY + 1) * SourceTileSize, LevelSize.Y)) / LevelSize.Y);
+			const int32 SegmentsX = FMath::Max(FMath::CeilToInt((Max.X - Min.X) * 360.0f / MaxSegmentDegrees), 1);
+			const int32 SegmentsY = FMath::Max(FMath::CeilToInt((Max.Y - Min.Y) * 180.0f / MaxSegmentDegrees), 1);
+			Patch.Direction = EquirectToDirection((Min + Max) * 0.5f);
+
+			for (int32 Y = 0; Y <= SegmentsY; ++Y)
+			{
+				for (int32 X = 0; X <= SegmentsX; ++X)
+				{
+					const FVector2D Coordinate(FMath::Lerp(Min.X, Max.X, float(X) / SegmentsX), FMath::Lerp(Min.Y, Max.Y, float(Y) / SegmentsY));
+					const FVector Direction = EquirectToDirection(Coordinate);
+
+					Patch.Coordinates.Add(Coordinate);
+					Patch.Vertices.Add(Direction * Radius);
+					Patch.Normals.Add(-Direction);
+					Patch.AngularRadius = FMath::Max(Patch.AngularRadius, FMath::Acos(FMath::Clamp(FVector::DotProduct(Direction, Patch.Direction), -1.0f, 1.0f)));
+				}
+			}
+
+			// Wound to face the centre of the sphere
+			TArray<int32> Triangles;
+			for (int32 Y = 0; Y < SegmentsY; ++Y)
+			{
+				for (int32 X = 0; X < SegmentsX; ++X)
+				{
+					const int32 TopLeft = Y * (SegmentsX + 1) + X;
+					const int32 BottomLeft = TopLeft + SegmentsX + 1;
+					Triangles.Append({ TopLeft, BottomLeft + 1, TopLeft + 1 });
+					Triangles.Append({ TopLeft, BottomLeft, BottomLeft + 1 });
+				}
+			}
+
+			Patch.UVs.Init(FVector2D::ZeroVector, Patch.Vertices.Num());
+			Mesh->CreateMeshSection(Index, Patch.Vertices, Triangles, Patch.Normals, Patch.UVs, TArray<FColor>(), TArray<FProcMeshTangent>(), false);
+
+			// Hidden until a tile arrives
+			Mesh->SetMeshSectionVisible(Index, false);
+
+			UMaterialInstanceDynamic* Material = TileMaterial ? UMaterialInstanceDynamic::Create(TileMaterial, this) : nullptr;
+			Mesh->SetMaterial(Index, Material);
+			PatchMaterials.Add(Material);
+		}
+	}
+}
+
+void ARovrTiledSkySphere::ReleaseTiles()
+{
+	for (const TPair<FRovrTileId, FResidentTile>& Pair : Resident)
+	{
+		if (Pair.Value.Texture)
+		{
+			FRovrTexturePool::Get().Release(Pair.Value.Texture);
+		}
+	}
+	Resident.Reset();
+	FailedTiles.Reset();
+}
+
+void ARovrTiledSkySphere::ChooseLevels(const FVector& ViewDirection, TArray<int32>& OutLevels, TArray<int32>& OutOrder) const
+{
+	const int32 LowestLevel = Source->GetNumLevels() - 1;
+
+	TArray<float> Angles;
+	OutLevels.SetNumUninitialized(Patches.Num());
+	OutOrder.SetNumUninitialized(Patches.Num());
+	Angles.SetNumUninitialized(Patches.Num());
+
+	for (int32 Index = 0; Index < Patches.Num(); ++Index)
+	{
+		// Angle from the view direction to the nearest edge of the patch
+		const FPatch& Patch = Patches[Index];
+		const float Angle = FMath::Max(FMath::Acos(FMath::Clamp(FVector::DotProduct(ViewDirection, Patch.Direction), -1.0f, 1.0f)) - Patch.AngularRadius, 0.0f);
+		Angles[Index] = FMath::RadiansToDegrees(Angle);
+
+		const int32 Level = Angles[Index] <= FullResolutionAngle ? 0 : 1 + FMath::FloorToInt((Angles[Index] - FullResolutionAngle) / LevelStepAngle);
+		OutLevels[Index] = FMath::Min(Level, LowestLevel);
+		OutOrder[Index] = Index;
+	}
+
+	OutOrder.Sort([&Angles](int32 A, int32 B) { return Angles[A] < Angles[B]; });
+
+	// Patches furthest from the view give up resolution first, until the tiles wanted fit into the budget
+	const int64 MaxTiles = FMath::Max<int64>(int64(MemoryBudgetMB) * 1024 * 1024 / GetTileBytes(), 1);
+	TSet<FRovrTileId> Wanted;
+	for (;;)
+	{
+		Wanted.Reset();
+		Wanted.Add(FRovrTileId(LowestLevel, 0, 0));
+		for (int32 Index = 0; Index < Patches.Num(); ++Index)
+		{
+			Wanted.Add(GetTileForPatch(Patches[Index], OutLevels[Index]));
+		}
+
+		if (Wanted.Num() <= MaxTiles)
+		{
+			return;
+		}
+
+		int32 Furthest = OutOrder.Num() - 1;
+		while (Furthest >= 0 && OutLevels[OutOrder[Furthest]] == LowestLevel)
+		{
+			--Furthest;
+		}
+
+		if (Furthest < 0)
+		{
+			return;
+		}
+		++OutLevels[OutOrder[Furthest]];
+	}
+}
+
+FRovrTileId ARovrTiledSkySphere::GetTileForPatch(const FPatch& Patch, int32 Level) const
+{
+	// The patch's centre decides: odd level sizes halve with rounding, so tiles of lower levels line up with the patches only to
+	// within a texel, which the tile borders cover
+	const FIntPoint LevelSize = Source->GetLevelSize(Level);
+	const FIntPoint NumTiles = Source->GetNumTiles(Level);
+	const FVector2D Centre = (Patch.Coordinates[0] + Patch.Coordinates.Last()) * 0.5f;
+
+	return FRovrTileId(Level,
+		FMath::Clamp(FMath::FloorToInt(Centre.X * LevelSize.X / Source->GetTileSize()), 0, NumTiles.X - 1),
+		FMath::Clamp(FMath::FloorToInt(Centre.Y * LevelSize.Y / Source->GetTileSize()), 0, NumTiles.Y - 1));
+}
+
+void ARovrTiledSkySphere::RequestTile(const FRovrTileId& Tile)
+{
+	// Present but without a texture while loading, so the tile is asked for once
+	Resident.Add(Tile);
+
+	TWeakObjectPtr<ARovrTiledSkySphere> WeakThis(this);
+	const uint32 TileGeneration = Generation;
+	Async(EAsyncExecution::ThreadPool, [WeakThis, TileSource = Source, Tile, TileGeneration]()
+	{
+		TArray<uint8> Data;
+		const bool bRead = TileSource->ReadTile(Tile, Data);
+
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, Tile, TileGeneration, bRead, Data = MoveTemp(Data)]() mutable
+		{
+			ARovrTiledSkySphere* This = WeakThis.Get();
+			FResidentTile* Entry = This && This->Generation == TileGeneration ? This->Resident.Find(Tile) : nullptr;
+			if (!Entry)
+			{
+				return;
+			}
+
+			const int32 Size = This->Source->GetTileTextureSize();
+			UTexture2D* Texture = bRead ? FRovrTexturePool::Get().Acquire(Size, Size, This->Source->GetFormat()) : nullptr;
+
+			// Failed tiles leave the resident set, so they take none of the budget, and are not asked for again
+			if (!Texture)
+			{
+				UE_LOG(LogRovrRelieve, Warning, TEXT("Unable to %s tile %d,%d of level %d"), bRead ? TEXT("create a texture for") : TEXT("read"), Tile.X, Tile.Y, Tile.Level);
+				This->Resident.Remove(Tile);
+				This->FailedTiles.Add(Tile);
+				return;
+			}
+
+			Entry->Texture = Texture;
+			RovrTexture::UploadRegionData(Texture, 0, FIntPoint::ZeroValue, MoveTemp(Data), Size, Size);
+		});
+	});
+}
+
+void ARovrTiledSkySphere::ShowTile(int32 PatchIndex, const FRovrTileId& Tile, UTexture2D* Texture)
+{
+	FPatch& Patch = Patches[PatchIndex];
+
+	// Texel position in the tile texture, whose first texels are the border
+	const FVector2D LevelSize(Source->GetLevelSize(Tile.Level));
+	const FVector2D Origin(Tile.X * Source->GetTileSize() - IRovrTileSource::Border, Tile.Y * Source->GetTileSize() - IRovrTileSource::Border);
+	const float TextureSize = Source->GetTileTextureSize();
+	for (int32 Vertex = 0; Vertex < Patch.Coordinates.Num(); ++Vertex)
+	{
+		Patch.UVs[Vertex] = (Patch.Coordinates[Vertex] * LevelSize - Origin) / TextureSize;
+	}
+
+	Mesh->UpdateMeshSection(PatchIndex, Patch.Vertices, Patch.Normals, Patch.UVs, TArray<FColor>(), TArray<FProcMeshTangent>());
+	if (UMaterialInstanceDynamic* Material = PatchMaterials[PatchIndex])
+	{
+		Material->SetTextureParameterValue(TileParameter, Texture);
+	}
+	Mesh->SetMeshSectionVisible(PatchIndex, true);
+
+	Patch.Shown = Tile;
+}
+
+int64 ARovrTiledSkySphere::GetTileBytes() const
+{
+	const int32 Size = Source->GetTileTextureSize();
+	return RovrTexture::CalcMipSize(Size, Size, Source->GetFormat());
+}
@@ -0,0 +1,204 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "RovrImageTiles.h"
+#include "RovrTiledSkySphere.generated.h"
+
+class UMaterialInstanceDynamic;
+class UMaterialInterface;
+class UProceduralMeshComponent;
+class UTexture2D;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnRovrSkyImageLoaded, bool, bSuccess);
+
+
+/**
+ * Sky sphere for large equirect scenes that keeps full resolution tiles only where the headset looks.
+ *
+ * The sphere is made of one patch per full resolution tile. Each frame, patches within FullResolutionAngle
+ * of the view direction ask for their full resolution tile, and further patches for a lower level of the
+ * tile pyramid; while a tile loads, a patch shows the best lower level already loaded. The lowest level,
+ * a single tile, is always loaded, so the whole sphere has an image from the start. Tile textures come
+ * from the texture pool and stay within MemoryBudgetMB; patches furthest from the view drop to lower
+ * levels first when the budget runs short, and tiles nobody shows are released least recently used first.
+ *
+ * Tiles are read from an IRovrTileSource on worker threads, coarse levels before fine ones, so the view
+ * sharpens step by step. Images loaded through LoadImageFile or LoadImageBytes are cut into an in-memory
+ * pyramid, ETC2 compressed where the RHI samples it, which is kept as a pyramid file so the next visit
+ * skips the decode; LoadPyramidFile shows a prebuilt pyramid file straight away.
+ */
+UCLASS()
+class ROVRRELIEVE_API ARovrTiledSkySphere : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ARovrTiledSkySphere();
+
+	/**
+	 * Load an equirect image from a file and show it once it is cut into tiles. Decoding and cutting run on a worker thread
+	 *
+	 * @param Path JPEG or PNG file
+	 */
+	UFUNCTION(BlueprintCallable, Category = Sky)
+		void LoadImageFile(const FString& Path);
+
+	/**
+	 * Load an equirect image from memory, e.g. a download, and show it once it is cut into tiles
+	 *
+	 * @param Bytes JPEG or PNG file
+	 */
+	UFUNCTION(BlueprintCallable, Category = Sky)
+		void LoadImageBytes(const TArray<uint8>& Bytes);
+
+	/**
+	 * Show a pyramid file, e.g. one built by the RovrBuildPyramids commandlet. Only the file's index is read
+	 * up front; the lowest level shows within a frame or two and finer tiles follow as the head turns
+	 *
+	 * @param Path .rovrpyr file
+	 */
+	UFUNCTION(BlueprintCallable, Category = Sky)
+		void LoadPyramidFile(const FString& Path);
+
+	/** Show the tiles of a source, replacing the current image. The tiles must cover an equirect image */
+	void SetTileSource(const TSharedPtr<IRovrTileSource, ESPMode::ThreadSafe>& InSource);
+
+	/** Memory the tile textures take, counting tiles still loading */
+	UFUNCTION(BlueprintPure, Category = Sky)
+		int64 GetResidentBytes() const;
+
+	/** Fired on the game thread when a load finished, successfully or not */
+	UPROPERTY(BlueprintAssignable, Category = Sky)
+		FOnRovrSkyImageLoaded OnImageLoaded;
+
+	/** Material of the patches: unlit and one sided, sampling the texture parameter named TileParameter with the first UV set */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Sky)
+		UMaterialInterface* TileMaterial = nullptr;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Sky)
+		FName TileParameter = TEXT("Tile");
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Sky, meta = (ClampMin = "100"))
+		float Radius = 10000.0f;
+
+	/** Size of the tiles images are cut into, without borders. Smaller tiles follow the view more closely but take more draw calls */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Sky, meta = (ClampMin = "128", ClampMax = "4096"))
+		int32 TileSize = 1024;
+
+	/** Compress tiles to ETC2 where the RHI supports it, for an eighth of the memory */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Sky)
+		bool bCompressTiles = true;
+
+	/** Keep the pyramids of loaded images in Saved/RovrPyramids, so showing an image again reads its tiles instead of decoding it */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Sky)
+		bool bCachePyramids = true;
+
+	/** Patches reaching within this angle of the view direction get full resolution tiles. The headset sees about 50 degrees to each side */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Sky, meta = (ClampMin = "0", ClampMax = "180"))
+		float FullResolutionAngle = 65.0f;
+
+	/** Beyond FullResolutionAngle, patches drop a level for every further step of this many degrees */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Sky, meta = (ClampMin = "1", ClampMax = "180"))
+		float LevelStepAngle = 30.0f;
+
+	/** Memory tile textures may take */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Sky, meta = (ClampMin = "1"))
+		int32 MemoryBudgetMB = 48;
+
+	/** Tile reads started per frame, spreading uploads over frames while the head turns */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Sky, meta = (ClampMin = "1"))
+		int32 MaxTileRequestsPerFrame = 2;
+
+	UPROPERTY(VisibleAnywhere, Category = Sky)
+		UProceduralMeshComponent* Mesh;
+
+	//~ Begin AActor Interface
+	virtual void Tick(float DeltaSeconds) override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	//~ End AActor Interface
+
+	static void AddReferencedObjects(UObject* InThis, FReferenceCollector& Collector);
+
+private:
+	struct FPatch
+	{
+		/** Full resolution tile the patch covers */
+		FIntPoint Tile;
+
+		/** Equirect coordinates of the patch's vertices, from 0 to 1 */
+		TArray<FVector2D> Coordinates;
+		TArray<FVector> Vertices;
+		TArray<FVector> Normals;
+		TArray<FVector2D> UVs;
+
+		/** Direction to the patch's centre and the largest angle from it to the patch's edge, in radians */
+		FVector Direction;
+		float AngularRadius = 0.0f;
+
+		/** Tile the patch shows; Level is INDEX_NONE before it shows any */
+		FRovrTileId Shown = FRovrTileId(INDEX_NONE, 0, 0);
+	};
+
+	struct FResidentTile
+	{
+		/** Null while the tile loads */
+		UTexture2D* Texture = nullptr;
+		uint64 LastUsedFrame = 0;
+	};
+
+	/** Which image a load shows, naming its cached pyramid, and which version of it */
+	struct FImageIdentity
+	{
+		uint64 Key = 0;
+		uint64 Stamp = 0;
+	};
+
+	/**
+	 * Show an image from its cached pyramid or, failing that, by decoding and cutting it on a worker thread
+	 *
+	 * @param Identify Identity of the image, called on the worker before ReadBytes
+	 * @param CompressedBytes Size of the image file, from which the decode's memory is estimated
+	 */
+	void StartLoad(TFunction<bool(TArray<uint8>&)> ReadBytes, TFunction<FImageIdentity()> Identify, int64 CompressedBytes);
+
+	/** Drop the decode of an image still waiting in the decode scheduler */
+	void CancelLoad();
+
+	/** Game thread side of a load */
+	void FinishLoad(uint32 LoadGeneration, const TSharedPtr<IRovrTileSource, ESPMode::ThreadSafe>& Tiles);
+	void BuildPatches();
+	void ReleaseTiles();
+
+	/**
+	 * Level each patch should show, for a view direction in the actor's space
+	 *
+	 * @param OutOrder Receives the patch indices, nearest to the view first
+	 */
+	void ChooseLevels(const FVector& ViewDirection, TArray<int32>& OutLevels, TArray<int32>& OutOrder) const;
+
+	/** Tile of a level that holds a patch */
+	FRovrTileId GetTileForPatch(const FPatch& Patch, int32 Level) const;
+
+	void RequestTile(const FRovrTileId& Tile);
+	void ShowTile(int32 PatchIndex, const FRovrTileId& Tile, UTexture2D* Texture);
+	int64 GetTileBytes() const;
+
+	TSharedPtr<IRovrTileSource, ESPMode::ThreadSafe> Source;
+	TArray<FPatch> Patches;
+	TMap<FRovrTileId, FResidentTile> Resident;
+
+	/** Tiles that could not be read or given a texture; never asked for again, and patches show a coarser level instead */
+	TSet<FRovrTileId> FailedTiles;
+
+	/** Bumped for every image, so tiles and loads still running for an older one are dropped */
+	uint32 Generation = 0;
+
+	/** Decode scheduler id of the image being loaded, 0 when none */
+	int32 LoadDecodeId = 0;
+
+	UPROPERTY(Transient)
+		TArray<UMaterialInstanceDynamic*> PatchMaterials;
+};
@@ -0,0 +1,137 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "RovrVideoThumbnailer.h"
+#include "RovrRelieve.h"
+#include "RovrImageResize.h"
+#include "Features/IModularFeatures.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/ThreadSafeBool.h"
+#include "IImageWrapper.h"
+#include "IImageWrapperModule.h"
+#include "Modules/ModuleManager.h"
+
+
+namespace
+{
+	TAutoConsoleVariable<float> CVarVideoThumbnailPosition(
+		TEXT("rovr.VideoThumbnail.Position"),
+		0.1f,
+		TEXT("Share of a video's duration at which its thumbnail frame is taken, past fade ins and titles"),
+		ECVF_Default);
+
+	constexpr uint32 MakeFourCC(const char (&Code)[5])
+	{
+		return (uint32(uint8(Code[0])) << 24) | (uint32(uint8(Code[1])) << 16) | (uint32(uint8(Code[2])) << 8) | uint32(uint8(Code[3]));
+	}
+
+	/** Sample entries whose samples are complete JPEG images */
+	bool IsMotionJpeg(uint32 Codec)
+	{
+		return Codec == MakeFourCC("jpeg") || Codec == MakeFourCC("mjpa") || Codec == MakeFourCC("dmb1");
+	}
+
+	/** Decode a JPEG, PNG or BMP image to BGRA8 */
+	bool DecodeImage(const TArray<uint8>& Compressed, TArray<uint8>& OutPixels, int32& OutWidth, int32& OutHeight)
+	{
+		IImageWrapperModule* ImageWrapperModule = FModuleManager::GetModulePtr<IImageWrapperModule>(TEXT("ImageWrapper"));
+		if (!ImageWrapperModule)
+		{
+			return false;
+		}
+
+		const EImageFormat Format = ImageWrapperModule->DetectImageFormat(Compressed.GetData(), Compressed.Num());
+		const TSharedPtr<IImageWrapper> ImageWrapper = Format != EImageFormat::Invalid ? ImageWrapperModule->CreateImageWrapper(Format) : nullptr;
+		if (!ImageWrapper.IsValid() || !ImageWrapper->SetCompressed(Compressed.GetData(), Compressed.Num()) || !ImageWrapper->GetRaw(ERGBFormat::BGRA, 8, OutPixels))
+		{
+			return false;
+		}
+
+		OutWidth = ImageWrapper->GetWidth();
+		OutHeight = ImageWrapper->GetHeight();
+		return OutWidth > 0 && OutHeight > 0;
+	}
+
+	bool DecodeKeyframe(const FRovrMp4Keyframe& Keyframe, TArray<uint8>& OutPixels, int32& OutWidth, int32& OutHeight)
+	{
+		if (IsMotionJpeg(Keyframe.Codec))
+		{
+			return DecodeImage(Keyframe.Sample, OutPixels, OutWidth, OutHeight);
+		}
+
+		// Decoding takes a while; holding the lock through it would stall every other modular feature lookup
+		TArray<IRovrVideoFrameDecoder*> Decoders;
+		{
+			IModularFeatures::FScopedLockModularFeatureList ScopedLock;
+			Decoders = IModularFeatures::Get().GetModularFeatureImplementations<IRovrVideoFrameDecoder>(IRovrVideoFrameDecoder::GetModularFeatureName());
+		}
+
+		bool bHasDecoder = false;
+		for (IRovrVideoFrameDecoder* Decoder : Decoders)
+		{
+			if (!Decoder->CanDecode(Keyframe.Codec))
+			{
+				continue;
+			}
+
+			bHasDecoder = true;
+			if (Decoder->DecodeKeyframe(Keyframe, OutPixels, OutWidth, OutHeight))
+			{
+				return OutWidth > 0 && OutHeight > 0 && OutPixels.Num() >= int64(OutWidth) * OutHeight * 4;
+			}
+		}
+
+		// Linux and Mac have no RovrVideoDecoder backend, so their H.264 and HEVC videos only get cover art
+		static FThreadSafeBool bReportedMissingDecoder = false;
+		if (!bHasDecoder && !bReportedMissingDecoder.AtomicSet(true))
+		{
+			UE_LOG(LogRovrRelieve, Log, TEXT("No video decoder for codec %08x on this platform, video thumbnails fall back to cover art"), Keyframe.Codec);
+		}
+		return false;
+	}
+}
+
+bool FRovrVideoThumbnailer::Generate(const FString& Path, int32 MaxWidth, int32 MaxHeight, FRovrVideoThumbnail& OutThumbnail)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	TArray<uint8> Frame;
+	int32 FrameWidth = 0;
+	int32 FrameHeight = 0;
+
+	FRovrMp4Keyframe Keyframe;
+	bool bDecoded = FRovrMp4Probe::ReadKeyframe(Path, CVarVideoThumbnailPosition.GetValueOnAnyThread(), Keyframe) && DecodeKeyframe(Keyframe, Frame, FrameWidth, FrameHeight);
+	if (!bDecoded)
+	{
+		TArray<uint8> CoverArt;
+		bDecoded = FRovrMp4Probe::ReadCoverArt(Path, CoverArt) && DecodeImage(CoverArt, Frame, FrameWidth, FrameHeight);
+	}
+
+	if (!bDecoded)
+	{
+		UE_LOG(LogRovrRelieve, Verbose, TEXT("No decodable frame or cover art in '%s'"), *Path);
+		return false;
+	}
+
+	const FIntPoint Size = RovrImageResize::FitSize(FrameWidth, FrameHeight, MaxWidth, MaxHeight);
+	if (Size.X <= 0)
+	{
+		return false;
+	}
+
+	OutThumbnail.Width = Size.X;
+	OutThumbnail.Height = Size.Y;
+	if (Size.X == FrameWidth && Size.Y == FrameHeight)
+	{
+		OutThumbnail.Pixels = MoveTemp(Frame);
+	}
+	else
+	{
+		OutThumbnail.Pixels.SetNumUninitialized(Size.X * Size.Y * 4);
+		RovrImageResize::ResizeArea(Frame.GetData(), int64(FrameWidth) * 4, FrameWidth, FrameHeight, OutThumbnail.Pixels.GetData(), int64(Size.X) * 4, Size.X, Size.Y);
+	}
+
+	UE_LOG(LogRovrRelieve, Verbose, TEXT("Made a %dx%d thumbnail of '%s' from a %dx%d frame in %.1f ms"),
+		Size.X, Size.Y, *Path, FrameWidth, FrameHeight, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+	return true;
+}
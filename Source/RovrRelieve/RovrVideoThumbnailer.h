@@ -0,0 +1,42 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RovrMp4Probe.h"
+#include "RovrVideoFrameDecoder.h"
+
+/**
+ * Thumbnail made by FRovrVideoThumbnailer, tightly packed BGRA8
+ */
+struct FRovrVideoThumbnail
+{
+	TArray<uint8> Pixels;
+	int32 Width = 0;
+	int32 Height = 0;
+};
+
+/**
+ * Portable thumbnails of MP4/MOV videos, for platforms without MediaStore. The sync sample closest before
+ * rovr.VideoThumbnail.Position of the duration is read through the sample tables, decoded on its own and
+ * scaled down with an area filter. Motion JPEG is decoded here; other codecs need a registered
+ * IRovrVideoFrameDecoder, which the RovrVideoDecoder plugin provides for H.264 and HEVC on Windows and
+ * Android. Files whose frames cannot be decoded fall back to their cover art.
+ *
+ * Linux has no such decoder: the engine ships no H.264 or HEVC software decoder for it, and bundling one
+ * would add an LGPL or patent-encumbered library to the build. Linux builds therefore show motion JPEG
+ * frames, cover art or nothing, and log once when a video needs a decoder they lack.
+ */
+class FRovrVideoThumbnailer
+{
+public:
+	/**
+	 * Make the thumbnail of a video. Blocks on file reads and decoding, so call it on a worker thread.
+	 * Thread safe once the ImageWrapper module is loaded
+	 *
+	 * @param MaxWidth Width of the box the thumbnail is fitted into, keeping the aspect ratio of the frame
+	 * @param MaxHeight Height of that box
+	 * @return Whether a frame or cover art was decoded
+	 */
+	static bool Generate(const FString& Path, int32 MaxWidth, int32 MaxHeight, FRovrVideoThumbnail& OutThumbnail);
+};
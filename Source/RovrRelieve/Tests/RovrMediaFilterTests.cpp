@@ -0,0 +1,219 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "HAL/PlatformTLS.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "Misc/Paths.h"
+#include "RovrMediaFilter.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	FRovrMediaEntry MakeEntry(const FString& Path, int64 Size = 0)
+	{
+		FRovrMediaEntry Entry;
+		Entry.Path = Path;
+		Entry.Size = Size;
+		return Entry;
+	}
+
+	/**
+	 * Forwards to the allocator it stands in for and counts the allocations the owning thread makes
+	 * meanwhile, so those of other threads do not disturb the count. It is never destroyed, as other
+	 * threads may still be inside it after GMalloc was restored
+	 */
+	class FCountingMalloc final : public FMalloc
+	{
+	public:
+		explicit FCountingMalloc(FMalloc* InInner)
+			: Inner(InInner)
+		{
+		}
+
+		virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+		{
+			CountIfOwner();
+			return Inner->Malloc(Count, Alignment);
+		}
+
+		virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			CountIfOwner();
+			return Inner->Realloc(Original, Count, Alignment);
+		}
+
+		virtual void Free(void* Original) override
+		{
+			Inner->Free(Original);
+		}
+
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override
+		{
+			return Inner->GetAllocationSize(Original, SizeOut);
+		}
+
+		virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override
+		{
+			return Inner->QuantizeSize(Count, Alignment);
+		}
+
+		virtual bool IsInternallyThreadSafe() const override
+		{
+			return Inner->IsInternallyThreadSafe();
+		}
+
+		virtual void Trim(bool bTrimThreadCaches) override
+		{
+			Inner->Trim(bTrimThreadCaches);
+		}
+
+		virtual const TCHAR* GetDescriptiveName() override
+		{
+			return TEXT("RovrCountingMalloc");
+		}
+
+		FMalloc* const Inner;
+		uint32 OwnerThreadId = 0;
+		FThreadSafeCounter NumAllocations;
+
+	private:
+		void CountIfOwner()
+		{
+			if (FPlatformTLS::GetCurrentThreadId() == OwnerThreadId)
+			{
+				NumAllocations.Increment();
+			}
+		}
+	};
+
+	/** Allocations the calling thread makes while Work runs */
+	int32 CountAllocations(TFunctionRef<void()> Work)
+	{
+		static FCountingMalloc* Counter = new FCountingMalloc(GMalloc);
+		Counter->OwnerThreadId = FPlatformTLS::GetCurrentThreadId();
+		Counter->NumAllocations.Reset();
+
+		GMalloc = Counter;
+		Work();
+		GMalloc = Counter->Inner;
+		return Counter->NumAllocations.GetValue();
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrMediaFilterWildcardTest, "Rovr.MediaFilter.Wildcard", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FRovrMediaFilterWildcardTest::RunTest(const FString& Parameters)
+{
+	TestTrue(TEXT("* matches everything"), FRovrMediaFilter::WildcardMatch(TEXT("Beach.mp4"), TEXT("*")));
+	TestTrue(TEXT("* matches nothing"), FRovrMediaFilter::WildcardMatch(TEXT("Beach.mp4"), TEXT("Beach*.mp4")));
+	TestTrue(TEXT("Case is ignored"), FRovrMediaFilter::WildcardMatch(TEXT("BEACH.MP4"), TEXT("beach.mp4")));
+	TestTrue(TEXT("? matches one character"), FRovrMediaFilter::WildcardMatch(TEXT("Clip7.mp4"), TEXT("Clip?.mp4")));
+	TestFalse(TEXT("? does not match zero characters"), FRovrMediaFilter::WildcardMatch(TEXT("Clip.mp4"), TEXT("Clip?.mp4")));
+	TestTrue(TEXT("* backtracks"), FRovrMediaFilter::WildcardMatch(TEXT("a.mp4.part.mp4"), TEXT("*.mp4")));
+	TestFalse(TEXT("The whole string has to match"), FRovrMediaFilter::WildcardMatch(TEXT("a.mp4.part"), TEXT("*.mp4")));
+	TestTrue(TEXT("Empty string against *"), FRovrMediaFilter::WildcardMatch(TEXT(""), TEXT("**")));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrMediaFilterMatchTest, "Rovr.MediaFilter.Match", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FRovrMediaFilterMatchTest::RunTest(const FString& Parameters)
+{
+	TestTrue(TEXT("An empty spec accepts everything"), FRovrMediaFilter(FRovrMediaFilterSpec()).Matches(MakeEntry(TEXT("/sdcard/Movies/anything"))));
+
+	FRovrMediaFilterSpec Spec;
+	Spec.Extensions = { TEXT(".MP4"), TEXT("mkv"), TEXT("") };
+	Spec.Prefixes = { TEXT("360_"), TEXT("VR_") };
+	Spec.MinSize = 100;
+	Spec.MaxSize = 1000;
+	const FRovrMediaFilter Filter(Spec);
+
+	TestEqual(TEXT("Extensions lose their dot and case; empty ones are dropped"), Filter.GetExtensions().Num(), 2);
+	TestTrue(TEXT("Matching entry"), Filter.Matches(MakeEntry(TEXT("/sdcard/Movies/360_Beach.mp4"), 500)));
+	TestTrue(TEXT("Extension case is ignored"), Filter.Matches(MakeEntry(TEXT("/sdcard/Movies/VR_Beach.MKV"), 500)));
+	TestFalse(TEXT("Other extension"), Filter.Matches(MakeEntry(TEXT("/sdcard/Movies/360_Beach.webm"), 500)));
+	TestFalse(TEXT("No extension"), Filter.Matches(MakeEntry(TEXT("/sdcard/Movies/360_Beach"), 500)));
+	TestFalse(TEXT("Prefixes are case sensitive"), Filter.Matches(MakeEntry(TEXT("/sdcard/Movies/vr_Beach.mp4"), 500)));
+	TestFalse(TEXT("Prefixes apply to the file name, not the path"), Filter.Matches(MakeEntry(TEXT("/sdcard/360_Movies/Beach.mp4"), 500)));
+	TestFalse(TEXT("Too small"), Filter.Matches(MakeEntry(TEXT("/sdcard/Movies/360_Beach.mp4"), 99)));
+	TestFalse(TEXT("Too large"), Filter.Matches(MakeEntry(TEXT("/sdcard/Movies/360_Beach.mp4"), 1001)));
+
+	FRovrMediaFilterSpec PatternSpec;
+	PatternSpec.Patterns = { TEXT("*_tb.*"), TEXT("*\\Stereo\\*") };
+	const FRovrMediaFilter PatternFilter(PatternSpec);
+
+	TestTrue(TEXT("Name pattern"), PatternFilter.Matches(MakeEntry(TEXT("/sdcard/Stereo/Beach_TB.mp4"))));
+	TestFalse(TEXT("Name patterns apply to the file name"), PatternFilter.Matches(MakeEntry(TEXT("/sdcard/Stereo_tb.x/Beach.mp4"))));
+	TestFalse(TEXT("Path patterns apply to the full path"), PatternFilter.Matches(MakeEntry(TEXT("/sdcard/Mono/Beach_tb.mp4"))));
+	TestTrue(TEXT("Bare file names skip path patterns"), PatternFilter.MatchesFileName(TEXT("Beach_tb.mp4")));
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrMediaFilterBenchmarkTest, "Rovr.MediaFilter.Benchmark", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FRovrMediaFilterBenchmarkTest::RunTest(const FString& Parameters)
+{
+	const int32 NumEntries = 100000;
+
+	TArray<FRovrMediaEntry> Entries;
+	Entries.Reserve(NumEntries);
+	for (int32 Index = 0; Index < NumEntries; ++Index)
+	{
+		Entries.Add(MakeEntry(FString::Printf(TEXT("/storage/emulated/0/Movies/Trip %d/%s%d.%s"), Index / 100, Index % 3 ? TEXT("360_") : TEXT(""), Index, Index % 4 ? TEXT("mp4") : TEXT("jpg")), Index));
+	}
+
+	FRovrMediaFilterSpec Spec;
+	Spec.Extensions = { TEXT("mp4"), TEXT("mkv"), TEXT("webm") };
+	Spec.Prefixes = { TEXT("360_") };
+	Spec.Patterns = { TEXT("*Trip*/*") };
+	const FRovrMediaFilter Filter(Spec);
+
+	// The filter the queries used before, with its per entry string temporaries, as the baseline
+	int32 NumLegacy = 0;
+	auto MatchLegacy = [&Entries, &Spec, &NumLegacy]()
+	{
+		NumLegacy = 0;
+		for (const FRovrMediaEntry& Entry : Entries)
+		{
+			const FString FileName = FPaths::GetCleanFilename(Entry.Path);
+			if (FileName.Left(4) == TEXT("360_") && Spec.Extensions.Contains(FPaths::GetExtension(FileName).ToLower()) && Entry.Path.MatchesWildcard(TEXT("*Trip*/*")))
+			{
+				++NumLegacy;
+			}
+		}
+	};
+
+	int32 NumMatched = 0;
+	auto MatchFilter = [&Entries, &Filter, &NumMatched]()
+	{
+		NumMatched = 0;
+		for (const FRovrMediaEntry& Entry : Entries)
+		{
+			NumMatched += Filter.Matches(Entry) ? 1 : 0;
+		}
+	};
+
+	double Start = FPlatformTime::Seconds();
+	MatchLegacy();
+	const double LegacySeconds = FPlatformTime::Seconds() - Start;
+
+	Start = FPlatformTime::Seconds();
+	MatchFilter();
+	const double FilterSeconds = FPlatformTime::Seconds() - Start;
+
+	// Counted in passes of their own, so counting does not show up in the times
+	const int32 LegacyAllocations = CountAllocations(MatchLegacy);
+	const int32 FilterAllocations = CountAllocations(MatchFilter);
+
+	TestEqual(TEXT("Both filters accept the same entries"), NumMatched, NumLegacy);
+	TestEqual(TEXT("FRovrMediaFilter matches without allocating"), FilterAllocations, 0);
+	AddInfo(FString::Printf(TEXT("%d entries: string temporaries %.2f ms and %d allocations, FRovrMediaFilter %.2f ms and %d allocations"), NumEntries, LegacySeconds * 1000.0, LegacyAllocations, FilterSeconds * 1000.0, FilterAllocations));
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,271 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "Math/RandomStream.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/LocalTimestampDirectoryVisitor.h"
+#include "Misc/Paths.h"
+#include "UObject/Class.h"
+#include "RovrMediaFilter.h"
+#include "RovrMediaIndex.h"
+#include "RovrMediaScanner.h"
+#include "RovrMediaSort.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	FRovrMediaEntry MakeEntry(const TCHAR* Name, int64 Size = 0)
+	{
+		FRovrMediaEntry Entry;
+		Entry.Path = FString(TEXT("/storage/emulated/0/Movies/")) + Name;
+		Entry.Extension = TEXT("mp4");
+		Entry.Size = Size;
+		return Entry;
+	}
+
+	FString JoinBaseNames(const TArray<FRovrMediaEntry>& Entries)
+	{
+		FString Joined;
+		for (const FRovrMediaEntry& Entry : Entries)
+		{
+			Joined += (Joined.IsEmpty() ? TEXT("") : TEXT(",")) + FPaths::GetBaseFilename(Entry.Path);
+		}
+		return Joined;
+	}
+
+	/** Random entries with names like "Clip 0042 take 7", sizes and modification times */
+	TArray<FRovrMediaEntry> MakeRandomEntries(int32 Num, int32 Seed)
+	{
+		FRandomStream Random(Seed);
+		TArray<FRovrMediaEntry> Entries;
+		Entries.Reserve(Num);
+		for (int32 Index = 0; Index < Num; ++Index)
+		{
+			FRovrMediaEntry Entry = MakeEntry(*FString::Printf(TEXT("%s %d take %d.mp4"), Random.RandRange(0, 1) ? TEXT("Clip") : TEXT("clip"), Random.RandRange(0, Num), Random.RandRange(1, 20)), Random.RandRange(0, 1 << 30));
+			Entry.ModificationTime = FDateTime(2020, 1, 1) + FTimespan::FromSeconds(Random.RandRange(0, 1 << 26));
+			Entry.Duration = Random.FRandRange(0.0f, 3600.0f);
+			Entries.Add(MoveTemp(Entry));
+		}
+		return Entries;
+	}
+
+	/** The sort GetAllFilesInDirectory used before RovrMediaSort, kept as the benchmark baseline */
+	void BubbleSortByName(TArray<FRovrMediaEntry>& Entries)
+	{
+		for (int32 Pass = 0; Pass < Entries.Num(); ++Pass)
+		{
+			for (int32 Index = 0; Index + 1 < Entries.Num() - Pass; ++Index)
+			{
+				if (FCString::Stricmp(*FPaths::GetBaseFilename(Entries[Index].Path), *FPaths::GetBaseFilename(Entries[Index + 1].Path)) > 0)
+				{
+					Entries.Swap(Index, Index + 1);
+				}
+			}
+		}
+	}
+
+	/** Folder of empty files named like MakeRandomEntries, every tenth of them a photo the filter drops */
+	FString MakeMediaDirectory(int32 Num, int32 Seed)
+	{
+		const FString Directory = FPaths::AutomationTransientDir() / FString::Printf(TEXT("MediaSort%d"), Num);
+		IFileManager::Get().DeleteDirectory(*Directory, false, true);
+		IFileManager::Get().MakeDirectory(*Directory, true);
+
+		FRandomStream Random(Seed);
+		for (int32 Index = 0; Index < Num; ++Index)
+		{
+			// The index keeps names unique, so duplicates of the random part are told apart
+			const FString Name = FString::Printf(TEXT("%s %d take %d-%d.%s"), Random.RandRange(0, 1) ? TEXT("Clip") : TEXT("clip"), Random.RandRange(0, Num), Random.RandRange(1, 20), Index, Index % 10 == 9 ? TEXT("jpg") : TEXT("mp4"));
+			FFileHelper::SaveStringToFile(FString(), *(Directory / Name));
+		}
+		return Directory;
+	}
+
+	/** GetAllFilesInDirectory before the media index: a listing of the folder, filtered and bubble sorted by name */
+	TArray<FRovrMediaEntry> ListAndBubbleSort(const FString& Directory)
+	{
+		TArray<FString> DirectoriesToSkip;
+		IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+		FLocalTimestampDirectoryVisitor Visitor(PlatformFile, DirectoriesToSkip, DirectoriesToSkip, false);
+		PlatformFile.IterateDirectory(*Directory, Visitor);
+
+		TArray<FRovrMediaEntry> Entries;
+		for (const TPair<FString, FDateTime>& File : Visitor.FileTimes)
+		{
+			if (FPaths::GetExtension(File.Key).Equals(TEXT("mp4"), ESearchCase::IgnoreCase))
+			{
+				FRovrMediaEntry Entry;
+				Entry.Path = File.Key;
+				Entries.Add(MoveTemp(Entry));
+			}
+		}
+
+		BubbleSortByName(Entries);
+		return Entries;
+	}
+
+	/**
+	 * What GetAllFilesInDirectory does now, the steps of UrovrInstance::QueryMediaIndex, on an index of its
+	 * own so the benchmark leaves the one saved for the app alone
+	 */
+	TArray<FRovrMediaEntry> QueryIndex(FRovrMediaIndex& Index, const FString& Directory)
+	{
+		FRovrMediaFilterSpec Spec;
+		Spec.Extensions.Add(TEXT("mp4"));
+		const FRovrMediaFilter Filter(Spec);
+		Index.RequireExtensions(Filter.GetExtensions());
+
+		TArray<FString> Roots;
+		Roots.Add(Directory);
+		const TArray<FString> ResolvedRoots = FRovrMediaScanner::ResolveRoots(Roots);
+		FRovrMediaScanner::Refresh(Index, ResolvedRoots, [](const TArray<FRovrMediaEntry>&) {});
+
+		TArray<FRovrMediaEntry> Entries;
+		for (const FString& Root : ResolvedRoots)
+		{
+			Index.Query(Root, Entries);
+		}
+
+		Entries.RemoveAll([&Filter](const FRovrMediaEntry& Entry)
+		{
+			return !Filter.Matches(Entry);
+		});
+
+		RovrMediaSort::Sort(Entries, ERovrMediaSortMode::Name);
+		return Entries;
+	}
+
+	bool IsSortedByNatural(const TArray<FRovrMediaEntry>& Entries)
+	{
+		for (int32 Index = 1; Index < Entries.Num(); ++Index)
+		{
+			if (RovrMediaSort::CompareNatural(*FPaths::GetBaseFilename(Entries[Index - 1].Path), *FPaths::GetBaseFilename(Entries[Index].Path)) > 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrMediaSortCompareNaturalTest, "Rovr.MediaSort.CompareNatural", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FRovrMediaSortCompareNaturalTest::RunTest(const FString& Parameters)
+{
+	TestTrue(TEXT("Video2 before Video10"), RovrMediaSort::CompareNatural(TEXT("Video2"), TEXT("Video10")) < 0);
+	TestTrue(TEXT("Video10 after Video9"), RovrMediaSort::CompareNatural(TEXT("Video10"), TEXT("Video9")) > 0);
+	TestTrue(TEXT("Case is ignored"), RovrMediaSort::CompareNatural(TEXT("VIDEO"), TEXT("video")) == 0);
+	TestTrue(TEXT("Leading zeros are ignored"), RovrMediaSort::CompareNatural(TEXT("Clip007"), TEXT("Clip7")) == 0);
+	TestTrue(TEXT("Digits within equal runs compare by value"), RovrMediaSort::CompareNatural(TEXT("a123b"), TEXT("a124a")) < 0);
+	TestTrue(TEXT("A prefix goes first"), RovrMediaSort::CompareNatural(TEXT("Clip"), TEXT("Clip 1")) < 0);
+	TestTrue(TEXT("Numbers beyond 64 bits compare by length"), RovrMediaSort::CompareNatural(TEXT("x99999999999999999999"), TEXT("x100000000000000000000")) < 0);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrMediaSortOrderTest, "Rovr.MediaSort.Order", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FRovrMediaSortOrderTest::RunTest(const FString& Parameters)
+{
+	TArray<FRovrMediaEntry> Entries;
+	Entries.Add(MakeEntry(TEXT("Video10.mp4"), 300));
+	Entries.Add(MakeEntry(TEXT("video2.mp4"), 100));
+	Entries.Add(MakeEntry(TEXT("Beach.mkv"), 300));
+	Entries.Add(MakeEntry(TEXT("Video9.mp4"), 200));
+
+	RovrMediaSort::Sort(Entries, ERovrMediaSortMode::Name);
+	TestEqual(TEXT("Name order"), JoinBaseNames(Entries), FString(TEXT("Beach,Video10,video2,Video9")));
+
+	RovrMediaSort::Sort(Entries, ERovrMediaSortMode::NaturalName);
+	TestEqual(TEXT("Natural name order"), JoinBaseNames(Entries), FString(TEXT("Beach,video2,Video9,Video10")));
+
+	RovrMediaSort::Sort(Entries, ERovrMediaSortMode::NaturalName, true);
+	TestEqual(TEXT("Descending natural name order"), JoinBaseNames(Entries), FString(TEXT("Video10,Video9,video2,Beach")));
+
+	// Equal sizes fall back to ascending natural name order, whichever the direction
+	RovrMediaSort::Sort(Entries, ERovrMediaSortMode::Size, true);
+	TestEqual(TEXT("Descending size order"), JoinBaseNames(Entries), FString(TEXT("Beach,Video10,Video9,video2")));
+
+	// Entries equal in every key keep the order they came in
+	TArray<FRovrMediaEntry> Copies;
+	Copies.Add(MakeEntry(TEXT("Same.mp4"), 1));
+	Copies.Add(MakeEntry(TEXT("same.mp4"), 2));
+	Copies.Add(MakeEntry(TEXT("SAME.mp4"), 3));
+	RovrMediaSort::Sort(Copies, ERovrMediaSortMode::Name);
+	TestTrue(TEXT("Ties keep their order"), Copies[0].Size == 1 && Copies[1].Size == 2 && Copies[2].Size == 3);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRovrMediaSortBenchmarkTest, "Rovr.MediaSort.Benchmark", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FRovrMediaSortBenchmarkTest::RunTest(const FString& Parameters)
+{
+	// Real folders, listed and sorted the way GetAllFilesInDirectory did before and does now. The bubble sort
+	// is quadratic and would take minutes on the largest folder, so it stops at 10k files
+	const int32 FolderSizes[] = { 1000, 10000, 50000 };
+	const int32 MaxBubbleSortFiles = 10000;
+	for (const int32 NumFiles : FolderSizes)
+	{
+		const FString Directory = MakeMediaDirectory(NumFiles, NumFiles);
+
+		FRovrMediaIndex Index(FPaths::AutomationTransientDir() / FString::Printf(TEXT("MediaSort%d.bin"), NumFiles));
+		double Start = FPlatformTime::Seconds();
+		const TArray<FRovrMediaEntry> Scanned = QueryIndex(Index, Directory);
+		const double ScanSeconds = FPlatformTime::Seconds() - Start;
+
+		// Unchanged folders are served from the index
+		Start = FPlatformTime::Seconds();
+		const TArray<FRovrMediaEntry> Queried = QueryIndex(Index, Directory);
+		const double QuerySeconds = FPlatformTime::Seconds() - Start;
+
+		TestEqual(TEXT("Every video is found"), Scanned.Num(), NumFiles - NumFiles / 10);
+		TestEqual(TEXT("A second query finds the same videos"), Queried.Num(), Scanned.Num());
+
+		FString BubbleInfo = TEXT("bubble sort skipped");
+		if (NumFiles <= MaxBubbleSortFiles)
+		{
+			Start = FPlatformTime::Seconds();
+			const TArray<FRovrMediaEntry> Bubble = ListAndBubbleSort(Directory);
+			const double BubbleSeconds = FPlatformTime::Seconds() - Start;
+			BubbleInfo = FString::Printf(TEXT("listing and bubble sort %.2f ms"), BubbleSeconds * 1000.0);
+
+			// Both sorts are stable and compare the same keys, so they agree file by file
+			bool bSame = Bubble.Num() == Scanned.Num();
+			for (int32 EntryIndex = 0; bSame && EntryIndex < Bubble.Num(); ++EntryIndex)
+			{
+				bSame = FPaths::GetCleanFilename(Bubble[EntryIndex].Path) == FPaths::GetCleanFilename(Scanned[EntryIndex].Path);
+			}
+			TestTrue(TEXT("The media index lists the folder in the bubble sort's order"), bSame);
+		}
+
+		AddInfo(FString::Printf(TEXT("Folder of %d files: %s, first query %.2f ms, second query %.2f ms"), NumFiles, *BubbleInfo, ScanSeconds * 1000.0, QuerySeconds * 1000.0));
+		IFileManager::Get().DeleteDirectory(*Directory, false, true);
+	}
+
+	const TArray<FRovrMediaEntry> Source = MakeRandomEntries(100000, 2);
+	const ERovrMediaSortMode Modes[] = { ERovrMediaSortMode::Name, ERovrMediaSortMode::NaturalName, ERovrMediaSortMode::ModificationTime, ERovrMediaSortMode::Size, ERovrMediaSortMode::Duration };
+	for (ERovrMediaSortMode Mode : Modes)
+	{
+		TArray<FRovrMediaEntry> Sorted = Source;
+		const double Start = FPlatformTime::Seconds();
+		RovrMediaSort::Sort(Sorted, Mode);
+		const double Seconds = FPlatformTime::Seconds() - Start;
+
+		TestEqual(TEXT("Sort keeps every entry"), Sorted.Num(), Source.Num());
+		if (Mode == ERovrMediaSortMode::NaturalName)
+		{
+			TestTrue(TEXT("Natural name sort is ordered"), IsSortedByNatural(Sorted));
+		}
+
+		AddInfo(FString::Printf(TEXT("100000 entries by %s: %.2f ms"), *UEnum::GetValueAsString(Mode), Seconds * 1000.0));
+	}
+
+	return true;
+}
+
+#endif
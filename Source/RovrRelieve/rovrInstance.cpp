@@ -2,8 +2,29 @@
 
 
 #include "rovrInstance.h"
+#include "RovrCubemap.h"
+#include "RovrImageDecode.h"
+#include "RovrMediaFilter.h"
+#include "RovrMediaIndex.h"
+#include "RovrMediaList.h"
+#include "RovrMediaScanner.h"
+#include "RovrMediaSort.h"
+#include "RovrMediaWatcher.h"
+#include "RovrMp4Probe.h"
+#include "RovrTexture.h"
+#include "RovrTexturePool.h"
+#include "RovrThumbnailAtlas.h"
+#include "RovrThumbnailCache.h"
+#include "RovrVideoThumbnailer.h"
+#include "RovrRelieve.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Hash/CityHash.h"
+#include "IImageWrapperModule.h"
+#include "Modules/ModuleManager.h"
 #include "Containers/Array.h"
-#include "Misc/LocalTimestampDirectoryVisitor.h"
+#include "Async/Async.h"
+#include "Engine/TextureCube.h"
+#include "Misc/FileHelper.h"
 #include <string>
 #include <iostream>
 
@@ -13,151 +34,613 @@
 #define DEBUGMESSAGE(x, colour, ...) if(GEngine){GEngine->AddOnScreenDebugMessage(-1, 10.0f, colour, x);}
 
 
-TArray<FString> UrovrInstance::GetAllFilesInDirectory(const FString directory, const bool fullPath, const FString onlyFilesStartingWith, const FString onlyFilesWithExtension, const FString SDCardDirectory)
+void UrovrInstance::Init()
 {
-	// Get all files in directory
-	TArray<FString> directoriesToSkip;
-	IPlatformFile &PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
-	FLocalTimestampDirectoryVisitor Visitor(PlatformFile, directoriesToSkip, directoriesToSkip, false);
-	PlatformFile.IterateDirectory(*directory, Visitor);
-	TArray<FString> files;
+	Super::Init();
+
+	GetMediaIndex();
+}
+
+void UrovrInstance::Shutdown()
+{
+	CancelAllMediaScans();
+	StopWatchingMedia();
+	*bMediaInspectionCancelled = true;
+
+	if (MediaIndex.IsValid())
+	{
+		MediaIndex->Save();
+	}
+
+	Super::Shutdown();
+}
 
-	//DEBUGMESSAGE(getenv("EXTERNAL_STORAGE"));
+FRovrMediaIndex& UrovrInstance::GetMediaIndex()
+{
+	if (!MediaIndex.IsValid())
+	{
+		MediaIndex = MakeShared<FRovrMediaIndex, ESPMode::ThreadSafe>(FPaths::ProjectSavedDir() / TEXT("MediaIndex.bin"));
+		MediaIndex->Load();
+	}
+	return *MediaIndex;
+}
 
-	for (TMap<FString, FDateTime>::TIterator TimestampIt(Visitor.FileTimes); TimestampIt; ++TimestampIt)
+URovrThumbnailAtlas* UrovrInstance::GetThumbnailAtlas()
+{
+	if (!ThumbnailAtlas)
 	{
-		const FString filePath = TimestampIt.Key();
-		const FString fileName = FPaths::GetCleanFilename(filePath);
-		//DEBUGMESSAGE(fileName);
-		bool shouldAddFile = true;
+		ThumbnailAtlas = NewObject<URovrThumbnailAtlas>(this);
+	}
+	return ThumbnailAtlas;
+}
+
+TArray<FRovrMediaEntry> UrovrInstance::QueryMediaIndex(const TArray<FString>& Roots, const FRovrMediaFilterSpec& Filter, ERovrMediaSortMode SortBy, bool bDescending)
+{
+	const FRovrMediaFilter CompiledFilter(Filter);
+
+	FRovrMediaIndex& Index = GetMediaIndex();
+	Index.RequireExtensions(CompiledFilter.GetExtensions());
 
-		// Check if filename starts with required characters
-		if (!onlyFilesStartingWith.IsEmpty())
+	const TArray<FString> ResolvedRoots = FRovrMediaScanner::ResolveRoots(Roots);
+
+	if (FRovrMediaScanner::Refresh(Index, ResolvedRoots, [](const TArray<FRovrMediaEntry>&) {}) > 0)
+	{
+		// The caller only waits for the entries, the index is written on a worker
+		TSharedPtr<FRovrMediaIndex, ESPMode::ThreadSafe> SharedIndex = MediaIndex;
+		Async(EAsyncExecution::ThreadPool, [SharedIndex]()
 		{
-			const FString left = fileName.Left(onlyFilesStartingWith.Len());
+			SharedIndex->Save();
+		});
+	}
 
-			if (!(fileName.Left(onlyFilesStartingWith.Len()).Equals(onlyFilesStartingWith)))
-				shouldAddFile = false;
-		}
+	TArray<FRovrMediaEntry> Entries;
+	for (const FString& Root : ResolvedRoots)
+	{
+		Index.Query(Root, Entries);
+	}
 
-		// Check if file extension is required characters
-		if (!onlyFilesWithExtension.IsEmpty())
+	Entries.RemoveAll([&CompiledFilter](const FRovrMediaEntry& Entry)
+	{
+		return !CompiledFilter.Matches(Entry);
+	});
+
+	RovrMediaSort::Sort(Entries, SortBy, bDescending);
+
+	ScheduleMediaInspection(ResolvedRoots);
+
+	return Entries;
+}
+
+URovrMediaList* UrovrInstance::CreateMediaList(const TArray<FString>& Roots, const FRovrMediaFilterSpec& Filter, ERovrMediaSortMode SortBy, bool bDescending, bool bMergeDuplicates)
+{
+	URovrMediaList* List = NewObject<URovrMediaList>(this);
+	List->Initialize(FRovrMediaScanner::ResolveRoots(Roots), MakeShared<FRovrMediaFilter>(Filter), SortBy, bDescending, bMergeDuplicates, QueryMediaIndex(Roots, Filter, SortBy, bDescending));
+
+	MediaLists.RemoveAll([](const TWeakObjectPtr<URovrMediaList>& Existing) { return !Existing.IsValid(); });
+	MediaLists.Add(List);
+
+	return List;
+}
+
+int32 UrovrInstance::QueryMediaIndexAsync(const TArray<FString>& Roots, const FRovrMediaFilterSpec& Filter, ERovrMediaSortMode SortBy, bool bDescending, int32 BatchSize, const FOnMediaScanBatch& OnBatch, const FOnMediaScanComplete& OnComplete)
+{
+	const int32 ScanId = NextMediaScanId++;
+
+	FMediaScan& Scan = MediaScans.Add(ScanId);
+	Scan.OnBatch = OnBatch;
+	Scan.OnComplete = OnComplete;
+
+	const FRovrMediaFilter CompiledFilter(Filter);
+	GetMediaIndex().RequireExtensions(CompiledFilter.GetExtensions());
+
+	TSharedPtr<FRovrMediaIndex, ESPMode::ThreadSafe> Index = MediaIndex;
+	TSharedRef<FThreadSafeBool, ESPMode::ThreadSafe> bCancelled = Scan.bCancelled;
+	TWeakObjectPtr<UrovrInstance> WeakThis(this);
+	BatchSize = FMath::Max(BatchSize, 1);
+
+	Async(EAsyncExecution::ThreadPool, [Index, bCancelled, WeakThis, ScanId, Roots, CompiledFilter, SortBy, bDescending, BatchSize]()
+	{
+		TArray<FRovrMediaEntry> AllEntries;
+		TArray<FRovrMediaEntry> Batch;
+
+		auto FlushBatch = [&]()
 		{
-			if (!(FPaths::GetExtension(fileName, false).Equals(onlyFilesWithExtension, ESearchCase::IgnoreCase)))
-				shouldAddFile = false;
+			if (Batch.Num() > 0)
+			{
+				AsyncTask(ENamedThreads::GameThread, [WeakThis, ScanId, Batch = MoveTemp(Batch)]()
+				{
+					if (UrovrInstance* This = WeakThis.Get())
+					{
+						This->DeliverMediaScanBatch(ScanId, Batch);
+					}
+				});
+				Batch.Reset();
+			}
+		};
+
+		const TArray<FString> ResolvedRoots = FRovrMediaScanner::ResolveRoots(Roots);
+
+		const int32 NumListed = FRovrMediaScanner::Refresh(*Index, ResolvedRoots, [&](const TArray<FRovrMediaEntry>& Files)
+		{
+			for (const FRovrMediaEntry& Entry : Files)
+			{
+				if (CompiledFilter.Matches(Entry))
+				{
+					AllEntries.Add(Entry);
+					Batch.Add(Entry);
+
+					if (Batch.Num() >= BatchSize)
+					{
+						FlushBatch();
+					}
+				}
+			}
+		}, &bCancelled.Get());
+		FlushBatch();
+
+		if (NumListed > 0)
+		{
+			Index->Save();
 		}
 
-		// Add full path to results
-		if (shouldAddFile)
+		RovrMediaSort::Sort(AllEntries, SortBy, bDescending);
+
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, ScanId, ResolvedRoots, AllEntries = MoveTemp(AllEntries)]()
 		{
-			files.Add(fullPath ? filePath : fileName);
+			if (UrovrInstance* This = WeakThis.Get())
+			{
+				This->CompleteMediaScan(ScanId, AllEntries);
+				This->ScheduleMediaInspection(ResolvedRoots);
+			}
+		});
+	});
+
+	return ScanId;
+}
+
+void UrovrInstance::DeliverMediaScanBatch(int32 ScanId, const TArray<FRovrMediaEntry>& Entries)
+{
+	const FMediaScan* Scan = MediaScans.Find(ScanId);
+	if (Scan && !*Scan->bCancelled)
+	{
+		Scan->OnBatch.ExecuteIfBound(Entries);
+	}
+}
+
+void UrovrInstance::CompleteMediaScan(int32 ScanId, const TArray<FRovrMediaEntry>& Entries)
+{
+	FMediaScan Scan;
+	if (MediaScans.RemoveAndCopyValue(ScanId, Scan))
+	{
+		if (*Scan.bCancelled)
+		{
+			Scan.OnComplete.ExecuteIfBound(TArray<FRovrMediaEntry>(), true);
+		}
+		else
+		{
+			Scan.OnComplete.ExecuteIfBound(Entries, false);
 		}
 	}
+}
 
-	//DEBUGMESSAGE(TEXT("\n"));
+void UrovrInstance::CancelMediaScan(int32 ScanId)
+{
+	if (FMediaScan* Scan = MediaScans.Find(ScanId))
+	{
+		*Scan->bCancelled = true;
+	}
+}
 
-	FLocalTimestampDirectoryVisitor Visitor1(PlatformFile, directoriesToSkip, directoriesToSkip, false);
-	PlatformFile.IterateDirectory(*SDCardDirectory, Visitor1);
-	//bool SDCardDirectoryExists = true;
-	//SDCardDirectoryExists;
-	//DEBUGMESSAGE(TEXT(SDCardDirectoryExists));
-	
+void UrovrInstance::CancelAllMediaScans()
+{
+	for (TPair<int32, FMediaScan>& Scan : MediaScans)
+	{
+		*Scan.Value.bCancelled = true;
+	}
+}
 
-	if (!(SDCardDirectory == "") && PlatformFile.DirectoryExists(*SDCardDirectory))
+bool UrovrInstance::ProbeVideoFile(const FString& Path, FRovrMediaEntry& OutEntry)
+{
+	const FFileStatData StatData = FPlatformFileManager::Get().GetPlatformFile().GetStatData(*Path);
+	if (!StatData.bIsValid || StatData.bIsDirectory)
 	{
+		return false;
+	}
 
-		DEBUGMESSAGE(TEXT("INSIDE"), FColor::Green);
-		for (TMap<FString, FDateTime>::TIterator TimestampIt(Visitor1.FileTimes); TimestampIt; ++TimestampIt)
+	FRovrMediaEntry Cached;
+	if (GetMediaIndex().FindEntry(Path, Cached) && Cached.bProbed && Cached.Size == StatData.FileSize && Cached.ModificationTime == StatData.ModificationTime)
+	{
+		OutEntry = Cached;
+		return Cached.Duration > 0.0f || Cached.bHasVideoInfo;
+	}
+
+	OutEntry = FRovrMediaEntry();
+	OutEntry.Path = Path;
+	OutEntry.Extension = FPaths::GetExtension(Path).ToLower();
+	OutEntry.Size = StatData.FileSize;
+	OutEntry.ModificationTime = StatData.ModificationTime;
+
+	return FRovrMp4Probe::Probe(Path, OutEntry);
+}
+
+int32 UrovrInstance::RequestVideoThumbnail(const FString& Path, int32 Width, int32 Height, const FOnVideoThumbnail& OnThumbnail, ERovrDecodePriority Priority)
+{
+	const FFileStatData StatData = FPlatformFileManager::Get().GetPlatformFile().GetStatData(*Path);
+	if (!StatData.bIsValid || StatData.bIsDirectory || Width <= 0 || Height <= 0)
+	{
+		OnThumbnail.ExecuteIfBound(Path, nullptr);
+		return 0;
+	}
+
+	// Copies of a fingerprinted video share one thumbnail
+	uint64 FileId = FRovrThumbnailCache::MakeFileId(Path);
+	uint64 Stamp = FRovrThumbnailCache::MakeStamp(StatData.FileSize, StatData.ModificationTime);
+	FRovrThumbnailCache::Get().ResolveContent(FileId, Stamp);
+
+	// Unlike MediaStore thumbnails these come in any size, which is therefore part of the key
+	const uint64 CacheKey = CityHash128to64(Uint128_64(FileId, (uint64(Width) << 32) | uint32(Height)));
+
+	if (UTexture2D* Cached = FRovrThumbnailCache::Get().Acquire(CacheKey, Stamp))
+	{
+		OnThumbnail.ExecuteIfBound(Path, Cached);
+		return 0;
+	}
+
+	// Modules can only be loaded on the game thread, the decoding happens on a worker
+	FModuleManager::LoadModuleChecked<IImageWrapperModule>(TEXT("ImageWrapper"));
+
+	const ERovrMipFilter MipFilter = RovrTexture::GetDefaultMipFilter();
+	const ERovrCompressQuality Compression = RovrTexture::GetDefaultCompression();
+
+	// The frame is not probed before the decode; 4K frames are common among 360 videos
+	const int64 MemoryBytes = 3840 * 2160 * 4 + int64(Width) * Height * 4;
+	return FRovrDecodeScheduler::Get().Enqueue(Priority, MemoryBytes, [Path, Width, Height, FileId, CacheKey, Stamp, MipFilter, Compression, OnThumbnail](const FRovrDecodeScheduler::FCancelFlag& bCancelled)
+	{
+		FRovrTextureData Encoded;
+		FRovrVideoThumbnail Thumbnail;
+		if (FRovrVideoThumbnailer::Generate(Path, Width, Height, Thumbnail))
 		{
-			const FString filePath = TimestampIt.Key();
-			const FString fileName = FPaths::GetCleanFilename(filePath);
-			DEBUGMESSAGE(fileName, FColor::Yellow);
-			bool shouldAddFile = true;
+			RovrTexture::Encode(FRovrImageView(Thumbnail.Pixels, Thumbnail.Width, Thumbnail.Height, ERovrPixelLayout::BGRA8), ERovrPixelConvertFlags::ForceOpaque, MipFilter, Compression, Encoded);
+			FRovrThumbnailCache::Get().Add(CacheKey, FileId, Stamp, Encoded.GetView());
+		}
 
-			 //Check if filename starts with required characters
-			if (!onlyFilesStartingWith.IsEmpty())
+		// The thumbnail is cached for the next request, but the tile that asked for it is gone
+		if (*bCancelled)
+		{
+			return;
+		}
+
+		AsyncTask(ENamedThreads::GameThread, [Path, OnThumbnail, Encoded = MoveTemp(Encoded), bCancelled]()
+		{
+			if (*bCancelled)
 			{
-				const FString left = fileName.Left(onlyFilesStartingWith.Len());
+				return;
+			}
+
+			UTexture2D* Texture = Encoded.GetView().IsValid() ? FRovrTexturePool::Get().Acquire(Encoded.GetView()) : nullptr;
+			OnThumbnail.ExecuteIfBound(Path, Texture);
+		});
+	});
+}
 
-				if (!(fileName.Left(onlyFilesStartingWith.Len()).Equals(onlyFilesStartingWith)))
-					shouldAddFile = false;
+void UrovrInstance::ConvertEquirectToCube(const TArray<uint8>& Bytes, int32 FaceSize, bool bEquiAngular, bool bBicubic, const FOnEquirectConverted& OnConverted)
+{
+	// Copied once here; the worker takes the copy over
+	TSharedRef<TArray<uint8>, ESPMode::ThreadSafe> SharedBytes = MakeShared<TArray<uint8>, ESPMode::ThreadSafe>(Bytes);
+	StartEquirectToCube([SharedBytes](TArray<uint8>& OutBytes)
+	{
+		OutBytes = MoveTemp(*SharedBytes);
+		return OutBytes.Num() > 0;
+	}, Bytes.Num(), FaceSize, bEquiAngular, bBicubic, OnConverted);
+}
+
+void UrovrInstance::ConvertEquirectFileToCube(const FString& Path, int32 FaceSize, bool bEquiAngular, bool bBicubic, const FOnEquirectConverted& OnConverted)
+{
+	StartEquirectToCube([Path](TArray<uint8>& OutBytes)
+	{
+		return FFileHelper::LoadFileToArray(OutBytes, *Path);
+	}, FMath::Max<int64>(IFileManager::Get().FileSize(*Path), 0), FaceSize, bEquiAngular, bBicubic, OnConverted);
+}
+
+void UrovrInstance::StartEquirectToCube(TFunction<bool(TArray<uint8>&)> ReadBytes, int64 CompressedBytes, int32 FaceSize, bool bEquiAngular, bool bBicubic, const FOnEquirectConverted& OnConverted)
+{
+	// Larger faces would take gigabytes, and their size in bytes overflows the texture APIs
+	if (FaceSize < 0 || FaceSize > RovrCubemap::MaxFaceSize)
+	{
+		UE_LOG(LogRovrRelieve, Warning, TEXT("Unable to convert an equirect image to cube faces of %d texels, the largest is %d"), FaceSize, RovrCubemap::MaxFaceSize);
+		OnConverted.ExecuteIfBound(nullptr);
+		return;
+	}
+
+	// Modules can only be loaded on the game thread, the decoding happens on a worker
+	FModuleManager::LoadModuleChecked<IImageWrapperModule>(TEXT("ImageWrapper"));
+
+	const ERovrCubeProjection Projection = bEquiAngular ? ERovrCubeProjection::EquiAngular : ERovrCubeProjection::Cubemap;
+	const ERovrResampleFilter Filter = bBicubic ? ERovrResampleFilter::Bicubic : ERovrResampleFilter::Bilinear;
+
+	// The faces of the default size take about as much as the decoded image
+	const int64 MemoryBytes = FRovrDecodeScheduler::EstimateDecodeBytes(CompressedBytes) * 2;
+	FRovrDecodeScheduler::Get().Enqueue(ERovrDecodePriority::Visible, MemoryBytes, [ReadBytes = MoveTemp(ReadBytes), FaceSize, Projection, Filter, OnConverted](const FRovrDecodeScheduler::FCancelFlag& bCancelled)
+	{
+		TArray<uint8> Faces;
+		int32 Size = 0;
+		{
+			TArray<uint8> Bytes;
+			TArray<uint8> Pixels;
+			int32 Width = 0;
+			int32 Height = 0;
+			if (ReadBytes(Bytes) && RovrImageDecode::Decode(Bytes, Pixels, Width, Height))
+			{
+				Bytes.Empty();
+				Size = FaceSize > 0 ? FaceSize : RovrCubemap::GetFaceSize(Width);
+				Faces.SetNumUninitialized(int64(Size) * Size * 4 * RovrCubemap::NumFaces);
+				if (!RovrCubemap::FromEquirect(FRovrImageView(Pixels, Width, Height, ERovrPixelLayout::BGRA8), Size, Projection, Filter, Faces.GetData()))
+				{
+					Faces.Empty();
+				}
+			}
+		}
+
+		// EAC faces are sampled from a 2D texture by the material
+		if (Projection == ERovrCubeProjection::EquiAngular && Faces.Num() > 0)
+		{
+			TArray<uint8> Packed;
+			Packed.SetNumUninitialized(Faces.Num());
+			RovrCubemap::PackFaces3x2(Faces.GetData(), Size, Packed.GetData());
+			Faces = MoveTemp(Packed);
+		}
+
+		AsyncTask(ENamedThreads::GameThread, [Faces = MoveTemp(Faces), Size, Projection, OnConverted]() mutable
+		{
+			UTexture* Texture = nullptr;
+			if (Faces.Num() > 0)
+			{
+				Texture = Projection == ERovrCubeProjection::EquiAngular
+					? static_cast<UTexture*>(RovrTexture::CreateTransient(MoveTemp(Faces), Size * 3, Size * 2, ERovrPixelLayout::BGRA8))
+					: static_cast<UTexture*>(RovrCubemap::CreateTextureCube(Faces, Size));
 			}
 
-			 //Check if file extension is required characters
-			if (!onlyFilesWithExtension.IsEmpty())
+			if (!Texture)
 			{
-				if (!(FPaths::GetExtension(fileName, false).Equals(onlyFilesWithExtension, ESearchCase::IgnoreCase)))
-					shouldAddFile = false;
+				UE_LOG(LogRovrRelieve, Warning, TEXT("Unable to convert an equirect image to cube faces"));
 			}
+			OnConverted.ExecuteIfBound(Texture);
+		});
+	});
+}
+
+void UrovrInstance::StartWatchingMedia(const TArray<FString>& Roots, const FRovrMediaFilterSpec& Filter)
+{
+	StopWatchingMedia();
 
-			 //Add full path to results
-			if (shouldAddFile)
+	MediaWatchFilter = MakeShared<FRovrMediaFilter>(Filter);
+	MediaWatchRoots = FRovrMediaScanner::ResolveRoots(Roots);
+	GetMediaIndex().RequireExtensions(MediaWatchFilter->GetExtensions());
+
+	TWeakObjectPtr<UrovrInstance> WeakThis(this);
+	MediaWatcher = MakeShared<FRovrMediaWatcher>(MediaIndex.ToSharedRef(), MediaWatchRoots, [WeakThis](TArray<FRovrMediaChange>&& Changes)
+	{
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, Changes = MoveTemp(Changes)]()
+		{
+			if (UrovrInstance* This = WeakThis.Get())
 			{
-				files.Add(fullPath ? filePath : fileName);
+				This->DeliverMediaChanges(Changes);
 			}
+		});
+	});
+}
+
+void UrovrInstance::StopWatchingMedia()
+{
+	// Joins the watcher thread, so no further changes are posted once this returns
+	MediaWatcher.Reset();
+	MediaWatchFilter.Reset();
+	MediaWatchRoots.Reset();
+}
+
+void UrovrInstance::DeliverMediaChanges(const TArray<FRovrMediaChange>& Changes)
+{
+	const FRovrMediaIndex& Index = GetMediaIndex();
+
+	// Cached thumbnails of files that went away or were rewritten are stale
+	FRovrThumbnailCache& ThumbnailCache = FRovrThumbnailCache::Get();
+	for (const FRovrMediaChange& Change : Changes)
+	{
+		if (Change.Type == ERovrMediaChangeType::Renamed)
+		{
+			ThumbnailCache.RemoveFile(FRovrThumbnailCache::MakeFileId(Change.OldPath));
+		}
+		else if (Change.Type != ERovrMediaChangeType::Added)
+		{
+			ThumbnailCache.RemoveFile(FRovrThumbnailCache::MakeFileId(Change.Path));
 		}
 	}
-	//files.Sort();
 
-	for (int x = 0; x < files.Num()-1; x++) {
-		for (int y = 0; y < files.Num() - x - 1; y++) {
+	// Lists apply their own filters to the unfiltered changes
+	for (const TWeakObjectPtr<URovrMediaList>& List : MediaLists)
+	{
+		if (URovrMediaList* ListPtr = List.Get())
+		{
+			ListPtr->ApplyChanges(Changes, Index);
+		}
+	}
+
+	// New and rewritten files need their headers probed, and a fingerprint before duplicates can be merged
+	ScheduleMediaInspection(MediaWatchRoots);
 
-			if (FPaths::GetBaseFilename(files[y]) > FPaths::GetBaseFilename(files[y + 1])) {
-				FString temp = files[y];
-				files[y] = files[y + 1];
-				files[y + 1] = temp;
+	if (!MediaWatchFilter.IsValid())
+	{
+		return;
+	}
+
+	const FRovrMediaFilter& Filter = *MediaWatchFilter;
+
+	// Files still on disk are matched with their indexed size, removed ones only by name
+	auto PassesFilter = [&Index, &Filter](const FString& Path)
+	{
+		FRovrMediaEntry Entry;
+		return Index.FindEntry(Path, Entry) ? Filter.Matches(Entry) : Filter.MatchesFileName(*FPaths::GetCleanFilename(Path));
+	};
+
+	TArray<FRovrMediaChange> Matching;
+	for (const FRovrMediaChange& Change : Changes)
+	{
+		const bool bMatches = PassesFilter(Change.Path);
+
+		if (Change.Type != ERovrMediaChangeType::Renamed)
+		{
+			if (bMatches)
+			{
+				Matching.Add(Change);
 			}
+			continue;
+		}
 
+		// A rename can move a file into or out of the filter
+		const bool bMatchedBefore = PassesFilter(Change.OldPath);
+		if (bMatches && bMatchedBefore)
+		{
+			Matching.Add(Change);
+		}
+		else if (bMatches)
+		{
+			Matching.Emplace(ERovrMediaChangeType::Added, Change.Path);
+		}
+		else if (bMatchedBefore)
+		{
+			Matching.Emplace(ERovrMediaChangeType::Removed, Change.OldPath);
 		}
 	}
 
-
-	return files;
+	if (Matching.Num() > 0)
+	{
+		OnMediaChanged.Broadcast(Matching);
+	}
 }
 
-UTexture2D* UrovrInstance::testinsal123(int32 imageWidth, int32 imageHeight, TArray<FColor> ColorArray)
+void UrovrInstance::ScheduleMediaInspection(const TArray<FString>& ResolvedRoots)
 {
-	//FString testName;
-	//FCreateTexture2DParameters params;
-	//FImageUtils::CreateTexture2D(imageWidth, imageHeight, ColorArray, outputTexture, "test", EObjectFlags::RF_Transient, params);
-	//for (FColor x : ColorArray) {
-	//	int red = x.R;
-	//	colorOutput = FString::FromInt(red);
-	//	DEBUGMESSAGE(colorOutput, FColor::Red);
-	//}
+	PendingMediaInspectionRoots.Append(ResolvedRoots);
+	if (bMediaInspecting || PendingMediaInspectionRoots.Num() == 0 || *bMediaInspectionCancelled)
+	{
+		return;
+	}
 
-	
+	bMediaInspecting = true;
 
+	TSharedPtr<FRovrMediaIndex, ESPMode::ThreadSafe> Index = MediaIndex;
+	TSharedRef<FThreadSafeBool, ESPMode::ThreadSafe> bCancelled = bMediaInspectionCancelled;
+	TWeakObjectPtr<UrovrInstance> WeakThis(this);
+	TArray<FString> Roots = PendingMediaInspectionRoots.Array();
+	PendingMediaInspectionRoots.Reset();
 
-	UTexture2D* texture = UTexture2D::CreateTransient(imageWidth, imageHeight, EPixelFormat::PF_B8G8R8A8);
+	Async(EAsyncExecution::ThreadPool, [Index, bCancelled, WeakThis, Roots]()
+	{
+		// Fingerprints first, so copies of a file are probed once
+		int32 NumUpdated = 0;
+		for (const FString& Root : Roots)
+		{
+			NumUpdated += Index->ComputeFingerprints(Root, &bCancelled.Get());
+			NumUpdated += Index->ProbeHeaders(Root, &bCancelled.Get());
+		}
 
-	// Create the texture
+		if (NumUpdated > 0)
+		{
+			Index->Save();
+		}
 
+		// Copies of a video share their thumbnails, also those fingerprinted in earlier sessions
+		TArray<FRovrMediaEntry> Entries;
+		for (const FString& Root : Roots)
+		{
+			Index->Query(Root, Entries);
+		}
 
-	// Lock the texture so it can be modified
-	uint8* MipData = static_cast<uint8*>(texture->PlatformData->Mips[0].BulkData.Lock(LOCK_READ_WRITE));
+		FRovrThumbnailCache& ThumbnailCache = FRovrThumbnailCache::Get();
+		for (const FRovrMediaEntry& Entry : Entries)
+		{
+			if (Entry.Fingerprint != 0)
+			{
+				ThumbnailCache.SetContentId(FRovrThumbnailCache::MakeFileId(Entry.Path), FRovrThumbnailCache::MakeStamp(Entry.Size, Entry.ModificationTime), uint64(Entry.Fingerprint));
+			}
+		}
 
-	// Create base mip.
-	uint8* DestPtr = NULL;
-	const FColor* SrcPtr = NULL;
-	for (int32 y = 0; y < imageHeight; y++)
-	{
-		DestPtr = &MipData[(imageHeight - 1 - y) * imageWidth * sizeof(FColor)];
-		SrcPtr = const_cast<FColor*>(&ColorArray[(imageHeight - 1 - y) * imageWidth]);
-		for (int32 x = 0; x < imageWidth; x++)
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, NumUpdated]()
 		{
-			*DestPtr++ = SrcPtr->B;
-			*DestPtr++ = SrcPtr->G;
-			*DestPtr++ = SrcPtr->R;
+			if (UrovrInstance* This = WeakThis.Get())
+			{
+				This->CompleteMediaInspection(NumUpdated);
+			}
+		});
+	});
+}
+
+void UrovrInstance::CompleteMediaInspection(int32 NumUpdated)
+{
+	bMediaInspecting = false;
 
-			*DestPtr++ = 0xFF;
-			SrcPtr++;
+	if (NumUpdated > 0)
+	{
+		for (const TWeakObjectPtr<URovrMediaList>& List : MediaLists)
+		{
+			if (URovrMediaList* ListPtr = List.Get())
+			{
+				ListPtr->UpdateProbedFields(*MediaIndex);
+			}
 		}
 	}
 
-	// Unlock the texture
-	texture->PlatformData->Mips[0].BulkData.Unlock();
-	texture->UpdateResource();
+	// Roots requested while this pass was running
+	ScheduleMediaInspection(TArray<FString>());
+}
+
+TArray<FString> UrovrInstance::GetAllFilesInDirectory(const FString directory, const bool fullPath, const FString onlyFilesStartingWith, const FString onlyFilesWithExtension, const FString SDCardDirectory)
+{
+	// Missing or duplicate roots, such as an empty SD card directory, are skipped by the scanner
+	TArray<FString> roots;
+	roots.Add(directory);
+	roots.Add(SDCardDirectory);
+
+	FRovrMediaFilterSpec filter;
+	if (!onlyFilesStartingWith.IsEmpty())
+		filter.Prefixes.Add(onlyFilesStartingWith);
+	if (!onlyFilesWithExtension.IsEmpty())
+		filter.Extensions.Add(onlyFilesWithExtension);
+
+	const TArray<FRovrMediaEntry> entries = QueryMediaIndex(roots, filter, ERovrMediaSortMode::Name);
+
+	TArray<FString> files;
+	files.Reserve(entries.Num());
+	for (const FRovrMediaEntry& entry : entries)
+	{
+		files.Add(fullPath ? entry.Path : FPaths::GetCleanFilename(entry.Path));
+	}
+
+	return files;
+}
+
+UTexture2D* UrovrInstance::testinsal123(int32 imageWidth, int32 imageHeight, const TArray<FColor>& ColorArray)
+{
+	// FColor is laid out as B, G, R, A. The Blueprint keeps its array, so the colors are copied once into a
+	// buffer the pool hands on; the render thread forces alpha when it uploads them
+	TArray<uint8> Pixels;
+	Pixels.SetNumUninitialized(ColorArray.Num() * sizeof(FColor));
+	FMemory::Memcpy(Pixels.GetData(), ColorArray.GetData(), Pixels.Num());
+
+	UTexture2D* texture = FRovrTexturePool::Get().Acquire(MoveTemp(Pixels), imageWidth, imageHeight, ERovrPixelLayout::BGRA8, 0, ERovrPixelConvertFlags::ForceOpaque, RovrTexture::GetDefaultMipFilter(), RovrTexture::GetDefaultCompression());
+	if (!texture)
+	{
+		UE_LOG(LogRovrRelieve, Warning, TEXT("testinsal123: %d colors do not cover a %dx%d image"), ColorArray.Num(), imageWidth, imageHeight);
+	}
 	return texture;
 }
 
+void UrovrInstance::ReleaseTexture(UTexture2D* Texture)
+{
+	FRovrTexturePool::Get().Release(Texture);
+}
+
+float UrovrInstance::GetTexturePoolHitRate() const
+{
+	return FRovrTexturePool::Get().GetStats().GetHitRate();
+}
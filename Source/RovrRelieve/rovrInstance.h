@@ -8,11 +8,34 @@
 #include "Misc/Paths.h"
 #include "Engine/Texture2D.h"
 #include "ImageUtils.h"
+#include "HAL/ThreadSafeBool.h"
+#include "RovrMediaTypes.h"
+#include "RovrDecodeScheduler.h"
 
 
 #include "rovrInstance.generated.h"
 
 
+/** Dynamic delegate receiving a batch of files from an asynchronous media scan */
+DECLARE_DYNAMIC_DELEGATE_OneParam(FOnMediaScanBatch, const TArray<FRovrMediaEntry>&, Entries);
+
+/** Dynamic delegate broadcast once an asynchronous media scan finished, with every matching file in the requested order */
+DECLARE_DYNAMIC_DELEGATE_TwoParams(FOnMediaScanComplete, const TArray<FRovrMediaEntry>&, Entries, bool, bCancelled);
+
+/** Multicast delegate broadcast on the game thread with the files that changed below the watched roots */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnMediaChanged, const TArray<FRovrMediaChange>&, Changes);
+
+/** Dynamic delegate receiving a video thumbnail made by RequestVideoThumbnail, or nullptr on failure */
+DECLARE_DYNAMIC_DELEGATE_TwoParams(FOnVideoThumbnail, const FString&, Path, UTexture2D*, Texture);
+
+/** Dynamic delegate receiving the faces made by ConvertEquirectToCube: a UTextureCube, a UTexture2D for EAC faces, or nullptr on failure */
+DECLARE_DYNAMIC_DELEGATE_OneParam(FOnEquirectConverted, UTexture*, Texture);
+
+class FRovrMediaFilter;
+class FRovrMediaIndex;
+class FRovrMediaWatcher;
+class URovrMediaList;
+class URovrThumbnailAtlas;
 
 /**
  * 
@@ -23,9 +46,200 @@ class ROVRRELIEVE_API UrovrInstance : public UGameInstance
 	GENERATED_BODY()
 
 public:
+	virtual void Init() override;
+	virtual void Shutdown() override;
+
 	UFUNCTION(BlueprintCallable, Category = FileManager, meta = (AdvancedDisplay = 1))
 		TArray<FString> GetAllFilesInDirectory(FString directory, bool fullPath, FString onlyFilesStartingWith, FString onlyFilesWithExtension = "mp4", FString SDCardDirectory = "");
 	UFUNCTION(BlueprintCallable, Category = FileManager, meta = (AdvancedDisplay = 1))
-		UTexture2D* testinsal123(int32 imageWidth, int32 imageHeight, TArray<FColor> ColorArray);
+		UTexture2D* testinsal123(int32 imageWidth, int32 imageHeight, const TArray<FColor>& ColorArray);
+
+	/**
+	 * Hand a texture created by testinsal123 or Get Video Thumbnail back for reuse, e.g. when its lobby
+	 * entry scrolls out of view. The texture must not be used afterwards
+	 */
+	UFUNCTION(BlueprintCallable, Category = FileManager)
+		void ReleaseTexture(UTexture2D* Texture);
+
+	/** Share of texture requests served from the texture pool */
+	UFUNCTION(BlueprintPure, Category = FileManager)
+		float GetTexturePoolHitRate() const;
+
+	/**
+	 * Query the persistent media index. Only directories whose modification time changed since the
+	 * last query are listed again, everything else is served from the index saved on disk. Video headers
+	 * are probed on a worker afterwards, so new videos come back without duration and video information
+	 * until a later query, or until a media list picks them up
+	 *
+	 * @param Roots Directories to search recursively and concurrently; empty, missing and duplicate roots are ignored
+	 * @param Filter Which files to return; compiled once and matched without allocating
+	 * @param SortBy Order of the returned entries
+	 * @param bDescending Reverse the order given by SortBy
+	 */
+	UFUNCTION(BlueprintCallable, Category = FileManager, meta = (AdvancedDisplay = 1))
+		TArray<FRovrMediaEntry> QueryMediaIndex(const TArray<FString>& Roots, const FRovrMediaFilterSpec& Filter, ERovrMediaSortMode SortBy = ERovrMediaSortMode::NaturalName, bool bDescending = false);
+
+	/**
+	 * Query the media index into a list handle, so UI can page through the result instead of copying it.
+	 * While media is being watched the list is patched with every change and broadcasts its OnChanged; it
+	 * also picks up the video headers and fingerprints read in the background
+	 *
+	 * @param bMergeDuplicates Show copies of the same file below several roots once, as soon as their fingerprints are known
+	 * @see QueryMediaIndex
+	 */
+	UFUNCTION(BlueprintCallable, Category = FileManager, meta = (AdvancedDisplay = 2))
+		URovrMediaList* CreateMediaList(const TArray<FString>& Roots, const FRovrMediaFilterSpec& Filter, ERovrMediaSortMode SortBy = ERovrMediaSortMode::NaturalName, bool bDescending = false, bool bMergeDuplicates = true);
+
+	/**
+	 * Asynchronous variant of QueryMediaIndex. The roots are revalidated on a worker thread and matching
+	 * files are handed back to the game thread in batches, so the lobby can start populating straight away
+	 *
+	 * @param BatchSize Maximum number of files per OnBatch call
+	 * @param OnBatch Delegate receiving unsorted batches of matching files while the scan runs
+	 * @param OnComplete Delegate receiving every matching file in the requested order once the scan finished or was cancelled
+	 * @return Identifier to pass to CancelMediaScan
+	 */
+	UFUNCTION(BlueprintCallable, Category = FileManager, meta = (AdvancedDisplay = 3))
+		int32 QueryMediaIndexAsync(const TArray<FString>& Roots, const FRovrMediaFilterSpec& Filter, ERovrMediaSortMode SortBy, bool bDescending, int32 BatchSize, const FOnMediaScanBatch& OnBatch, const FOnMediaScanComplete& OnComplete);
+
+	/**
+	 * Stop an asynchronous media scan. No further batches are delivered and OnComplete reports the scan as cancelled
+	 */
+	UFUNCTION(BlueprintCallable, Category = FileManager)
+		void CancelMediaScan(int32 ScanId);
+
+	/**
+	 * Stop every running asynchronous media scan, e.g. when leaving the lobby
+	 */
+	UFUNCTION(BlueprintCallable, Category = FileManager)
+		void CancelAllMediaScans();
+
+	/**
+	 * Read duration, resolution, codec and 360 layout from the header boxes of an MP4/MOV file, without
+	 * reading its media payload. Files known to the media index are served from it while unchanged
+	 *
+	 * @return Whether a movie header was found
+	 */
+	UFUNCTION(BlueprintCallable, Category = FileManager)
+		bool ProbeVideoFile(const FString& Path, FRovrMediaEntry& OutEntry);
+
+	/**
+	 * Make a thumbnail of a video without platform services, e.g. on desktop where MediaStore is unavailable.
+	 * A keyframe near the start is decoded and scaled on a worker thread, in its turn in the decode
+	 * scheduler; thumbnails are kept in the thumbnail cache, so unchanged videos are decoded once
+	 *
+	 * @param Width Width of the box the thumbnail is fitted into, keeping the aspect ratio of the video
+	 * @param Height Height of that box
+	 * @param OnThumbnail Called on the game thread with the texture, to be handed back with ReleaseTexture
+	 * @param Priority Visible for tiles in view, Prefetch for tiles about to scroll in
+	 * @return Id of the decode, to cancel it with CancelImageDecode when the tile scrolls away; 0 when
+	 *         OnThumbnail was already called, e.g. for cached thumbnails
+	 */
+	UFUNCTION(BlueprintCallable, Category = FileManager, meta = (AdvancedDisplay = 4))
+		int32 RequestVideoThumbnail(const FString& Path, int32 Width, int32 Height, const FOnVideoThumbnail& OnThumbnail, ERovrDecodePriority Priority = ERovrDecodePriority::Visible);
+
+	/**
+	 * Resample an equirect 360 image, e.g. a download, to the faces of a cube for the sky. Cube faces spread
+	 * the texels evenly instead of crowding them at the poles, so they need less memory for the same
+	 * sharpness and do not pinch at the poles. Decoding and resampling run on worker threads
+	 *
+	 * @param Bytes JPEG or PNG file
+	 * @param FaceSize Size of the faces, 0 to keep the image's sharpness at the horizon; above 8192 the conversion fails
+	 * @param bEquiAngular Make equi-angular faces packed 3x2 into a 2D texture (EAC) instead of a cube texture
+	 * @param bBicubic Filter with Catmull-Rom instead of bilinear, for sharper faces at a higher cost
+	 * @param OnConverted Called on the game thread with the texture
+	 */
+	UFUNCTION(BlueprintCallable, Category = FileManager)
+		void ConvertEquirectToCube(const TArray<uint8>& Bytes, int32 FaceSize, bool bEquiAngular, bool bBicubic, const FOnEquirectConverted& OnConverted);
+
+	/**
+	 * Variant of ConvertEquirectToCube reading the image from a file on the worker thread
+	 *
+	 * @see ConvertEquirectToCube
+	 */
+	UFUNCTION(BlueprintCallable, Category = FileManager)
+		void ConvertEquirectFileToCube(const FString& Path, int32 FaceSize, bool bEquiAngular, bool bBicubic, const FOnEquirectConverted& OnConverted);
+
+	/**
+	 * Keep the media index up to date while the app runs and broadcast OnMediaChanged with the files that
+	 * were added, removed, rewritten or renamed, so lists can be patched instead of rescanned.
+	 * Replaces any previous watch
+	 *
+	 * @param Roots Directories to watch recursively; empty, missing and duplicate roots are ignored
+	 * @param Filter Which files to report changes for
+	 */
+	UFUNCTION(BlueprintCallable, Category = FileManager)
+		void StartWatchingMedia(const TArray<FString>& Roots, const FRovrMediaFilterSpec& Filter);
+
+	/**
+	 * Stop the watch started by StartWatchingMedia
+	 */
+	UFUNCTION(BlueprintCallable, Category = FileManager)
+		void StopWatchingMedia();
+
+	/**
+	 * Atlas the lobby grid packs its thumbnails into, shared by every lobby widget
+	 */
+	UFUNCTION(BlueprintPure, Category = FileManager)
+		URovrThumbnailAtlas* GetThumbnailAtlas();
+
+	/** Broadcast with the changes found below the watched roots */
+	UPROPERTY(BlueprintAssignable, Category = FileManager)
+		FOnMediaChanged OnMediaChanged;
+
+private:
+	struct FMediaScan
+	{
+		TSharedRef<FThreadSafeBool, ESPMode::ThreadSafe> bCancelled = MakeShared<FThreadSafeBool, ESPMode::ThreadSafe>(false);
+		FOnMediaScanBatch OnBatch;
+		FOnMediaScanComplete OnComplete;
+	};
+
+	FRovrMediaIndex& GetMediaIndex();
+
+	/** Game thread side of an asynchronous scan */
+	void DeliverMediaScanBatch(int32 ScanId, const TArray<FRovrMediaEntry>& Entries);
+	void CompleteMediaScan(int32 ScanId, const TArray<FRovrMediaEntry>& Entries);
+
+	/** Game thread side of the media watcher */
+	void DeliverMediaChanges(const TArray<FRovrMediaChange>& Changes);
+
+	/** Probe the headers of and fingerprint the files below the roots on a worker thread, after any pass already running */
+	void ScheduleMediaInspection(const TArray<FString>& ResolvedRoots);
+
+	/** Game thread side of an inspection pass */
+	void CompleteMediaInspection(int32 NumUpdated);
+
+	/**
+	 * Read, decode and resample an equirect image on a worker thread
+	 *
+	 * @param CompressedBytes Size of the image file, from which the decode's memory is estimated
+	 */
+	void StartEquirectToCube(TFunction<bool(TArray<uint8>&)> ReadBytes, int64 CompressedBytes, int32 FaceSize, bool bEquiAngular, bool bBicubic, const FOnEquirectConverted& OnConverted);
+
+	TSharedPtr<FRovrMediaIndex, ESPMode::ThreadSafe> MediaIndex;
+
+	/** Running asynchronous scans, only accessed on the game thread */
+	TMap<int32, FMediaScan> MediaScans;
+
+	int32 NextMediaScanId = 1;
+
+	TSharedPtr<FRovrMediaWatcher> MediaWatcher;
+
+	/** Filter and roots of the running watch, only accessed on the game thread */
+	TSharedPtr<FRovrMediaFilter> MediaWatchFilter;
+	TArray<FString> MediaWatchRoots;
+
+	/** Lists handed out by CreateMediaList, patched with the watcher's changes */
+	TArray<TWeakObjectPtr<URovrMediaList>> MediaLists;
+
+	TSharedRef<FThreadSafeBool, ESPMode::ThreadSafe> bMediaInspectionCancelled = MakeShared<FThreadSafeBool, ESPMode::ThreadSafe>(false);
+
+	/** Whether an inspection pass is running, and the roots to inspect once it finished */
+	bool bMediaInspecting = false;
+	TSet<FString> PendingMediaInspectionRoots;
+
+	UPROPERTY(Transient)
+		URovrThumbnailAtlas* ThumbnailAtlas = nullptr;
 
 };